@@ -32,23 +32,50 @@
 #include "vk_layer_utils.h"
 
 #include <algorithm>
+#include <atomic>
 #include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
 #include <fstream>
 #include <mutex>
-#include <iomanip>
 #include <iostream>
 #include <ostream>
 #include <sstream>
+#include <stddef.h>
 #include <string.h>
 #include <string>
 #include <type_traits>
 #include <map>
+#include <memory>
 #include <thread>
 #include <unordered_map>
 #include <vector>
 #include <unordered_set>
 #include <utility>
 
+#if defined(API_DUMP_USE_ZLIB)
+#include <zlib.h>
+#endif
+#if defined(API_DUMP_USE_ZSTD)
+#include <zstd.h>
+#endif
+
+#if !defined(_WIN32)
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#if defined(__linux__)
+#include <sys/syscall.h>
+#elif defined(__APPLE__)
+#include <pthread.h>
+#endif
+
 #ifdef ANDROID
 
 #include <android/log.h>
@@ -66,11 +93,291 @@
 #define API_DUMP_ENV_VAR_FLUSH_FILE "VK_APIDUMP_FLUSH"
 #define API_DUMP_ENV_VAR_OUTPUT_RANGE "VK_APIDUMP_OUTPUT_RANGE"
 #define API_DUMP_ENV_VAR_TIMESTAMP "VK_APIDUMP_TIMESTAMP"
+#define API_DUMP_ENV_VAR_ASYNC_OUTPUT "VK_APIDUMP_ASYNC_OUTPUT"
+#define API_DUMP_ENV_VAR_MAPPED_OUTPUT "VK_APIDUMP_MAPPED_OUTPUT"
+#define API_DUMP_ENV_VAR_COMPRESSION "VK_APIDUMP_COMPRESSION"
+#define API_DUMP_ENV_VAR_INCLUDE_FUNCTIONS "VK_APIDUMP_INCLUDE_FUNCTIONS"
+#define API_DUMP_ENV_VAR_EXCLUDE_FUNCTIONS "VK_APIDUMP_EXCLUDE_FUNCTIONS"
+#define API_DUMP_ENV_VAR_OS_THREAD_ID "VK_APIDUMP_OS_THREAD_ID"
+#define API_DUMP_ENV_VAR_TRIGGER_SIGNALS "VK_APIDUMP_TRIGGER_SIGNALS"
+#define API_DUMP_ENV_VAR_TRIGGER_FILE "VK_APIDUMP_TRIGGER_FILE"
+#define API_DUMP_ENV_VAR_TRIGGER_LABEL "VK_APIDUMP_TRIGGER_LABEL"
+#define API_DUMP_ENV_VAR_FLIGHT_RECORDER_FRAMES "VK_APIDUMP_FLIGHT_RECORDER_FRAMES"
+#define API_DUMP_ENV_VAR_FLIGHT_RECORDER_MAX_SIZE "VK_APIDUMP_FLIGHT_RECORDER_MAX_SIZE"
+#define API_DUMP_ENV_VAR_FLIGHT_RECORDER_SIGNAL "VK_APIDUMP_FLIGHT_RECORDER_SIGNAL"
+#define API_DUMP_ENV_VAR_SHOW_DURATION "VK_APIDUMP_SHOW_DURATION"
+#define API_DUMP_ENV_VAR_LATENCY_FILE "VK_APIDUMP_LATENCY_FILE"
+#define API_DUMP_ENV_VAR_TRACE_FULL_ARGS "VK_APIDUMP_TRACE_FULL_ARGS"
+#define API_DUMP_ENV_VAR_DELTA_OUTPUT "VK_APIDUMP_DELTA"
+#define API_DUMP_ENV_VAR_MODE "VK_APIDUMP_MODE"
 
 enum class ApiDumpFormat {
     Text,
     Html,
     Json,
+    Binary,
+    Trace,
+};
+
+// A binary capture is an ApiDumpBinaryFileHeader followed by records, each starting with an
+// ApiDumpBinaryRecordHeader. All values are stored in the byte order and struct layout of the
+// capturing process, so captures are converted by a vkapidump-convert built for the same platform
+// and from the same Vulkan headers as the layer.
+static const char API_DUMP_BINARY_MAGIC[8] = {'V', 'K', 'A', 'P', 'I', 'D', 'M', 'P'};
+static const uint32_t API_DUMP_BINARY_VERSION = 3;
+static const uint32_t API_DUMP_BINARY_FRAME_MARKER = UINT32_MAX;
+
+struct ApiDumpBinaryFileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t header_version;  // VK_HEADER_VERSION of the capturing layer.
+    uint32_t pointer_size;
+    uint32_t reserved;
+};
+
+struct ApiDumpBinaryRecordHeader {
+    uint32_t size;      // Size of the record, including this header.
+    uint32_t function;  // Index of the api call, or API_DUMP_BINARY_FRAME_MARKER.
+    uint64_t thread;
+    uint64_t os_thread;  // Thread id given to the capturing thread by the operating system.
+    uint64_t frame;
+    int64_t time;       // Microseconds since the start of the capture.
+    uint64_t duration;  // Nanoseconds the call spent below the layer, if it was measured.
+};
+
+// What the layer writes for the api calls it dumps.
+enum class ApiDumpMode {
+    Full,     // Every call with its parameters.
+    Summary,  // Only the number of calls made to each function in each frame.
+};
+
+// What happens when an application thread's async output buffer is full.
+enum class ApiDumpOverflowPolicy {
+    Block,  // Wait for the writer thread to make room.
+    Drop,   // Discard the api call.
+    Grow,   // Allocate a larger buffer for the thread.
+};
+
+// Kind of a record handed to the output. The separators between json api calls depend on the
+// order records are written in, so they are added by whoever writes the records out.
+enum class ApiDumpRecordKind : uint32_t {
+    Call,
+    Frame,
+};
+
+//====================================== Output Formatting =======================================//
+
+// Growable character buffer the output of an api call is formatted into. It supports the subset of
+// std::ostream's interface the dump functions use and formats every value exactly like a default
+// std::ostream does, without the locale lookups, sentries and virtual calls of an iostream. The
+// buffer keeps its storage when cleared, so once it has grown to fit the largest call, formatting
+// does not allocate.
+class ApiDumpFormatter {
+   public:
+    ApiDumpFormatter() : buffer(new char[INITIAL_CAPACITY]), length(0), capacity(INITIAL_CAPACITY) {}
+
+    inline const char *data() const { return buffer.get(); }
+    inline char *data() { return buffer.get(); }
+    inline size_t size() const { return length; }
+    inline std::string str() const { return std::string(buffer.get(), length); }
+    inline void clear() { length = 0; }
+
+    inline ApiDumpFormatter &write(const char *data, size_t size) {
+        memcpy(reserve(size), data, size);
+        length += size;
+        return *this;
+    }
+
+    inline ApiDumpFormatter &operator<<(const char *string) { return write(string, strlen(string)); }
+    inline ApiDumpFormatter &operator<<(const std::string &string) { return write(string.data(), string.size()); }
+
+    // Like std::ostream, all character types are written as characters.
+    inline ApiDumpFormatter &operator<<(char value) {
+        *reserve(1) = value;
+        ++length;
+        return *this;
+    }
+    inline ApiDumpFormatter &operator<<(signed char value) { return *this << static_cast<char>(value); }
+    inline ApiDumpFormatter &operator<<(unsigned char value) { return *this << static_cast<char>(value); }
+
+    inline ApiDumpFormatter &operator<<(bool value) { return *this << (value ? '1' : '0'); }
+    inline ApiDumpFormatter &operator<<(short value) { return appendSigned(value); }
+    inline ApiDumpFormatter &operator<<(unsigned short value) { return appendUnsigned(value); }
+    inline ApiDumpFormatter &operator<<(int value) { return appendSigned(value); }
+    inline ApiDumpFormatter &operator<<(unsigned int value) { return appendUnsigned(value); }
+    inline ApiDumpFormatter &operator<<(long value) { return appendSigned(value); }
+    inline ApiDumpFormatter &operator<<(unsigned long value) { return appendUnsigned(value); }
+    inline ApiDumpFormatter &operator<<(long long value) { return appendSigned(value); }
+    inline ApiDumpFormatter &operator<<(unsigned long long value) { return appendUnsigned(value); }
+
+    // std::ostream writes floating point values with printf's %g at its default precision of 6.
+    inline ApiDumpFormatter &operator<<(float value) { return *this << static_cast<double>(value); }
+    inline ApiDumpFormatter &operator<<(double value) {
+        char *out = reserve(MAX_NUMBER_LENGTH);
+        length += snprintf(out, MAX_NUMBER_LENGTH, "%g", value);
+        return *this;
+    }
+
+    // Matches the pointer format of the standard library the layer is built with.
+    inline ApiDumpFormatter &operator<<(const void *pointer) {
+        const uintptr_t value = reinterpret_cast<uintptr_t>(pointer);
+#if defined(_MSC_VER)
+        return appendHex(value, static_cast<int>(2 * sizeof(void *)), true);
+#elif defined(_LIBCPP_VERSION)
+        char *out = reserve(MAX_NUMBER_LENGTH);
+        length += snprintf(out, MAX_NUMBER_LENGTH, "%p", pointer);
+        return *this;
+#else
+        if (value == 0) return *this << '0';
+        write("0x", 2);
+        return appendHex(value, 0);
+#endif
+    }
+
+    // Object pointers are written as addresses. Function pointers are not, std::ostream writes them
+    // through their conversion to bool.
+    template <typename T>
+    inline typename std::enable_if<!std::is_function<T>::value, ApiDumpFormatter &>::type operator<<(T *pointer) {
+        return *this << static_cast<const void *>(pointer);
+    }
+    inline ApiDumpFormatter &operator<<(char *string) { return *this << static_cast<const char *>(string); }
+
+    // Unscoped enums are written as the integer type they promote to.
+    template <typename T>
+    inline typename std::enable_if<std::is_enum<T>::value, ApiDumpFormatter &>::type operator<<(T value) {
+        return *this << +value;
+    }
+
+    // Writes value in hexadecimal, zero padded to at least width digits.
+    inline ApiDumpFormatter &appendHex(uint64_t value, int width, bool uppercase = false) {
+        const char *digits = uppercase ? "0123456789ABCDEF" : "0123456789abcdef";
+        char text[16];
+        int count = 0;
+        do {
+            text[sizeof(text) - ++count] = digits[value & 0xF];
+            value >>= 4;
+        } while (value != 0);
+        while (count < width && count < static_cast<int>(sizeof(text))) text[sizeof(text) - ++count] = '0';
+        return write(text + sizeof(text) - count, count);
+    }
+
+   private:
+    static const size_t INITIAL_CAPACITY = 4096;
+    static const size_t MAX_NUMBER_LENGTH = 32;
+
+    // Returns space for size more characters at the end of the buffer.
+    inline char *reserve(size_t size) {
+        if (length + size > capacity) {
+            size_t new_capacity = capacity * 2;
+            while (new_capacity < length + size) new_capacity *= 2;
+            std::unique_ptr<char[]> new_buffer(new char[new_capacity]);
+            memcpy(new_buffer.get(), buffer.get(), length);
+            buffer = std::move(new_buffer);
+            capacity = new_capacity;
+        }
+        return buffer.get() + length;
+    }
+
+    template <typename T>
+    inline ApiDumpFormatter &appendUnsigned(T value) {
+        char text[20];
+        int count = 0;
+        do {
+            text[sizeof(text) - ++count] = static_cast<char>('0' + value % 10);
+            value /= 10;
+        } while (value != 0);
+        return write(text + sizeof(text) - count, count);
+    }
+
+    template <typename T>
+    inline ApiDumpFormatter &appendSigned(T value) {
+        typedef typename std::make_unsigned<T>::type U;
+        if (value >= 0) return appendUnsigned(static_cast<U>(value));
+        *this << '-';
+        return appendUnsigned(static_cast<U>(0 - static_cast<U>(value)));
+    }
+
+    std::unique_ptr<char[]> buffer;
+    size_t length;
+    size_t capacity;
+};
+
+// Name of an element of an array, e.g. "pBindings[2]" or "[2]", formatted without allocating.
+class ApiDumpIndexName {
+   public:
+    ApiDumpIndexName(const char *name, size_t index) {
+        size_t length = strlen(name);
+        if (length > sizeof(text) - 24) length = sizeof(text) - 24;
+        memcpy(text, name, length);
+        text[length++] = '[';
+        char digits[20];
+        int count = 0;
+        do {
+            digits[sizeof(digits) - ++count] = static_cast<char>('0' + index % 10);
+            index /= 10;
+        } while (index != 0);
+        memcpy(text + length, digits + sizeof(digits) - count, count);
+        length += count;
+        text[length++] = ']';
+        text[length] = '\0';
+    }
+
+    inline const char *c_str() const { return text; }
+
+   private:
+    char text[256];
+};
+
+// Where a record names the frame it was made in, and the frame it names. Its head is written before
+// the call goes down the chain, and another thread may present before the record is written out, so
+// the number is corrected in output order by ApiDumpWriteRecord().
+struct ApiDumpFrameField {
+    uint64_t frame;
+    uint32_t start;  // Offsets of the number in the record, or both 0 if the record does not name its frame.
+    uint32_t end;
+};
+
+inline void ApiDumpAppend(std::string &output, const char *data, size_t size) { output.append(data, size); }
+
+template <typename Output>
+inline void ApiDumpAppend(Output &output, const char *data, size_t size) {
+    output.write(data, size);
+}
+
+// Appends a record to the output, naming frame, the frame the output is on, instead of the frame
+// its head named. Binary records hold the number as a uint64_t, text records in decimal.
+template <typename Output>
+inline void ApiDumpWriteRecord(Output &output, const char *data, size_t size, const ApiDumpFrameField &field, uint64_t frame,
+                               bool binary) {
+    if (field.end == 0 || field.frame == frame) {
+        ApiDumpAppend(output, data, size);
+        return;
+    }
+    ApiDumpAppend(output, data, field.start);
+    if (binary) {
+        ApiDumpAppend(output, reinterpret_cast<const char *>(&frame), sizeof(frame));
+    } else {
+        const std::string number = std::to_string(frame);
+        ApiDumpAppend(output, number.data(), number.size());
+    }
+    ApiDumpAppend(output, data + field.end, size - field.end);
+}
+
+// Output of a single api call. Each thread builds up its record privately while the call is in
+// flight, and the finished record is appended to the shared output in one piece by
+// ApiDumpInstance::commitRecord(), so the output lock is never held across a driver call.
+struct ApiDumpRecord {
+    ApiDumpFormatter stream;
+    bool open = false;
+    uint64_t duration = 0;  // Nanoseconds the driver took for the call, if it was measured.
+
+    // Delta output compares calls by their text without the line naming the thread, frame and time,
+    // and without the duration. These are the offsets of those parts in stream, or 0 if not written.
+    size_t header_end = 0;
+    size_t duration_start = 0;
+    size_t duration_end = 0;
+
+    ApiDumpFrameField frame = {};
 };
 
 static const uint64_t OUTPUT_RANGE_UNLIMITED = 0;
@@ -223,9 +530,565 @@ class ConditionalFrameOutput {
     }
 };
 
+// Categories of api calls that can be named in the function filter lists.
+static const uint32_t API_DUMP_CATEGORY_COMMANDS = 1 << 0;  // vkCmd*
+static const uint32_t API_DUMP_CATEGORY_QUEUE = 1 << 1;     // vkQueue*
+static const uint32_t API_DUMP_CATEGORY_MEMORY = 1 << 2;    // Device memory allocation, mapping and binding
+static const uint32_t API_DUMP_CATEGORY_SYNC = 1 << 3;      // Fences, semaphores, events and idle waits
+static const uint32_t API_DUMP_CATEGORY_WSI = 1 << 4;       // Surfaces, swapchains, displays and presentation
+
+// Selects the api calls that are dumped. The include and exclude lists are comma separated function
+// names, globs using '*' and '?', and category names. Every function is matched against them once,
+// by the generated resolve_function_filter(), and the result is kept as one bit per function index,
+// so deciding whether to dump a call is a single bit test.
+class ApiDumpFunctionFilter {
+   public:
+    inline void parse(const std::string &include_list, const std::string &exclude_list) {
+        include = splitList(include_list);
+        exclude = splitList(exclude_list);
+    }
+
+    inline void resolve(uint32_t function, const char *name, uint32_t categories) {
+        if (bits.size() <= function / 64) bits.resize(function / 64 + 1, 0);
+        const bool enabled = (include.empty() || matches(include, name, categories)) && !matches(exclude, name, categories);
+        if (enabled) bits[function / 64] |= uint64_t(1) << (function % 64);
+    }
+
+    inline bool enabled(uint32_t function) const { return (bits[function / 64] >> (function % 64)) & 1; }
+
+   private:
+    struct Pattern {
+        std::string glob;
+        uint32_t categories;  // Nonzero if the pattern is a category name
+    };
+
+    inline static std::vector<Pattern> splitList(const std::string &list) {
+        std::vector<Pattern> patterns;
+        size_t start = 0;
+        while (start <= list.size()) {
+            size_t end = list.find(',', start);
+            if (end == std::string::npos) end = list.size();
+            size_t first = list.find_first_not_of(" \t", start);
+            size_t last = list.find_last_not_of(" \t", end - 1);
+            if (first < end && last != std::string::npos && last >= first) {
+                Pattern pattern;
+                pattern.glob = list.substr(first, last - first + 1);
+                pattern.categories = categoryBits(pattern.glob);
+                patterns.push_back(pattern);
+            }
+            start = end + 1;
+        }
+        return patterns;
+    }
+
+    inline static uint32_t categoryBits(std::string name) {
+        std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+        if (name == "commands")
+            return API_DUMP_CATEGORY_COMMANDS;
+        else if (name == "queue")
+            return API_DUMP_CATEGORY_QUEUE;
+        else if (name == "memory")
+            return API_DUMP_CATEGORY_MEMORY;
+        else if (name == "sync")
+            return API_DUMP_CATEGORY_SYNC;
+        else if (name == "wsi")
+            return API_DUMP_CATEGORY_WSI;
+        else
+            return 0;
+    }
+
+    inline static bool matches(const std::vector<Pattern> &patterns, const char *name, uint32_t categories) {
+        for (const Pattern &pattern : patterns) {
+            if (pattern.categories != 0 ? (pattern.categories & categories) != 0 : globMatch(pattern.glob.c_str(), name))
+                return true;
+        }
+        return false;
+    }
+
+    inline static bool globMatch(const char *glob, const char *name) {
+        const char *star = NULL;
+        const char *resume = NULL;
+        while (*name != '\0') {
+            if (*glob == '*') {
+                star = glob++;
+                resume = name;
+            } else if (*glob == '?' || *glob == *name) {
+                ++glob;
+                ++name;
+            } else if (star != NULL) {
+                glob = star + 1;
+                name = ++resume;
+            } else {
+                return false;
+            }
+        }
+        while (*glob == '*') ++glob;
+        return *glob == '\0';
+    }
+
+    std::vector<Pattern> include;
+    std::vector<Pattern> exclude;
+    std::vector<uint64_t> bits;
+};
+
+// Generated. Resolves the filter for every function the layer dumps.
+void resolve_function_filter(ApiDumpFunctionFilter &filter);
+
+// Generated. Number of function indices, and the name of the function with an index.
+uint32_t api_dump_function_count();
+const char *api_dump_function_name(uint32_t function);
+
+//==================================== Memory Mapped Output ======================================//
+
+// Stream buffer writing a log file through memory mappings instead of write calls. The file is grown
+// in chunks, the chunk being written is mapped, and output is copied straight into the mapping. Full
+// chunks are handed to a background thread that writes them back and unmaps them, so writing a
+// capture of any size only costs memory copies on the threads producing it. When closed, the file
+// is truncated to the length that was actually written.
+class ApiDumpMappedFileBuffer : public std::streambuf {
+   public:
+    ApiDumpMappedFileBuffer() {}
+
+    ~ApiDumpMappedFileBuffer() { close(); }
+
+    // Returns false if the file cannot be mapped, e.g. on Windows or when it is a pipe or device.
+    bool open(const std::string &filename, size_t chunk_size) {
+#if defined(_WIN32)
+        return false;
+#else
+        const size_t page_size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+        chunk_bytes = (std::max(chunk_size, page_size) + page_size - 1) / page_size * page_size;
+        fd = ::open(filename.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0) return false;
+        struct stat file_stat;
+        if (fstat(fd, &file_stat) != 0 || !S_ISREG(file_stat.st_mode) || !mapChunk(0)) {
+            ::close(fd);
+            fd = -1;
+            return false;
+        }
+        retire_thread = std::thread(&ApiDumpMappedFileBuffer::retireChunks, this);
+        return true;
+#endif
+    }
+
+    void close() {
+#if !defined(_WIN32)
+        if (fd < 0) return;
+        retireChunk();
+        {
+            std::lock_guard<std::mutex> lg(retire_mutex);
+            stopping = true;
+        }
+        retire_cv.notify_one();
+        retire_thread.join();
+        // If this fails the file keeps the unused, zero filled tail of its last chunk.
+        const int result = ftruncate(fd, static_cast<off_t>(length));
+        (void)result;
+        ::close(fd);
+        fd = -1;
+#endif
+    }
+
+   protected:
+    int_type overflow(int_type ch) override {
+#if defined(_WIN32)
+        return traits_type::eof();
+#else
+        if (fd < 0) return traits_type::eof();
+        const uint64_t next_offset = chunk_offset + chunk_bytes;
+        retireChunk();
+        if (!mapChunk(next_offset)) return traits_type::eof();
+        if (!traits_type::eq_int_type(ch, traits_type::eof())) {
+            *pptr() = traits_type::to_char_type(ch);
+            pbump(1);
+        }
+        return traits_type::not_eof(ch);
+#endif
+    }
+
+    // What has been copied into the mapping is already visible to readers of the file, so flushing
+    // only has to wait for the background write back when the file is closed.
+    int sync() override { return 0; }
+
+   private:
+#if !defined(_WIN32)
+    inline uint64_t written() const { return chunk_offset + static_cast<uint64_t>(pptr() - pbase()); }
+
+    bool mapChunk(uint64_t offset) {
+        if (ftruncate(fd, static_cast<off_t>(offset + chunk_bytes)) != 0) return false;
+        void *mapping = mmap(NULL, chunk_bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, static_cast<off_t>(offset));
+        if (mapping == MAP_FAILED) return false;
+        char *chunk = static_cast<char *>(mapping);
+        chunk_offset = offset;
+        setp(chunk, chunk + chunk_bytes);
+        return true;
+    }
+
+    void retireChunk() {
+        if (pbase() == NULL) return;
+        length = written();
+        {
+            std::lock_guard<std::mutex> lg(retire_mutex);
+            retired_chunks.push_back(pbase());
+        }
+        retire_cv.notify_one();
+        setp(NULL, NULL);
+    }
+
+    // Writing back each full chunk as soon as it is retired keeps the amount of dirty memory the
+    // capture holds bounded, however long it runs.
+    void retireChunks() {
+        std::unique_lock<std::mutex> lock(retire_mutex);
+        while (true) {
+            retire_cv.wait(lock, [this] { return stopping || !retired_chunks.empty(); });
+            if (retired_chunks.empty()) break;
+            std::vector<char *> chunks;
+            chunks.swap(retired_chunks);
+            lock.unlock();
+            for (char *chunk : chunks) {
+                msync(chunk, chunk_bytes, MS_SYNC);
+                munmap(chunk, chunk_bytes);
+            }
+            lock.lock();
+        }
+    }
+
+    int fd = -1;
+    size_t chunk_bytes = 0;
+    uint64_t chunk_offset = 0;
+    uint64_t length = 0;
+
+    std::mutex retire_mutex;
+    std::condition_variable retire_cv;
+    std::vector<char *> retired_chunks;
+    bool stopping = false;
+    std::thread retire_thread;
+#endif
+};
+
+//====================================== Compressed Output =======================================//
+
+// Compression applied to the output file.
+enum class ApiDumpCompression {
+    None,
+    Gzip,
+    Zstd,
+};
+
+// Stream buffer writing a compressed log file. Output is collected into blocks, and a background
+// thread compresses every block into its own gzip member or zstd frame and appends it to the file.
+// Concatenated members and frames are themselves a valid .gz or .zst file, so the file can be
+// decompressed with the standard tools up to the last block that was written, even if the
+// application never exits cleanly. Flushing ends the current block.
+class ApiDumpCompressedFileBuffer : public std::streambuf {
+   public:
+    ApiDumpCompressedFileBuffer() {}
+
+    ~ApiDumpCompressedFileBuffer() { close(); }
+
+    // Returns whether the layer was built with support for the compression.
+    static bool supported(ApiDumpCompression compression) {
+        switch (compression) {
+#if defined(API_DUMP_USE_ZLIB)
+            case ApiDumpCompression::Gzip:
+                return true;
+#endif
+#if defined(API_DUMP_USE_ZSTD)
+            case ApiDumpCompression::Zstd:
+                return true;
+#endif
+            default:
+                return false;
+        }
+    }
+
+    static const char *extension(ApiDumpCompression compression) {
+        return compression == ApiDumpCompression::Gzip ? ".gz" : ".zst";
+    }
+
+    bool open(const std::string &filename, ApiDumpCompression compression) {
+        if (!supported(compression)) return false;
+        file.open(filename, std::ofstream::out | std::ofstream::trunc | std::ofstream::binary);
+        if (!file.is_open()) return false;
+        this->compression = compression;
+        block.resize(BLOCK_SIZE);
+        setp(block.data(), block.data() + block.size());
+        compress_thread = std::thread(&ApiDumpCompressedFileBuffer::compressBlocks, this);
+        return true;
+    }
+
+    void close() {
+        if (!file.is_open()) return;
+        submitBlock();
+        {
+            std::lock_guard<std::mutex> lg(block_mutex);
+            stopping = true;
+        }
+        block_cv.notify_all();
+        compress_thread.join();
+        file.close();
+    }
+
+   protected:
+    int_type overflow(int_type ch) override {
+        if (!file.is_open()) return traits_type::eof();
+        submitBlock();
+        if (!traits_type::eq_int_type(ch, traits_type::eof())) {
+            *pptr() = traits_type::to_char_type(ch);
+            pbump(1);
+        }
+        return traits_type::not_eof(ch);
+    }
+
+    int sync() override {
+        if (pptr() != pbase()) submitBlock();
+        return 0;
+    }
+
+   private:
+    static const size_t BLOCK_SIZE = 4 << 20;
+    static const size_t MAX_PENDING_BLOCKS = 4;
+
+    // Hands the current block to the compression thread, waiting if it is too far behind, and starts
+    // a new one.
+    void submitBlock() {
+        block.resize(pptr() - pbase());
+        {
+            std::unique_lock<std::mutex> lock(block_mutex);
+            block_cv.wait(lock, [this] { return pending_blocks.size() < MAX_PENDING_BLOCKS; });
+            pending_blocks.push_back(std::move(block));
+            if (!free_blocks.empty()) {
+                block = std::move(free_blocks.back());
+                free_blocks.pop_back();
+            }
+        }
+        block_cv.notify_all();
+        block.resize(BLOCK_SIZE);
+        setp(block.data(), block.data() + block.size());
+    }
+
+    void compressBlocks() {
+        std::vector<char> compressed;
+        std::unique_lock<std::mutex> lock(block_mutex);
+        while (true) {
+            block_cv.wait(lock, [this] { return stopping || !pending_blocks.empty(); });
+            if (pending_blocks.empty()) break;
+            std::vector<char> input = std::move(pending_blocks.front());
+            pending_blocks.pop_front();
+            lock.unlock();
+            block_cv.notify_all();
+
+            if (!input.empty() && compressBlock(input, compressed)) {
+                file.write(compressed.data(), compressed.size());
+                file.flush();
+            }
+
+            lock.lock();
+            free_blocks.push_back(std::move(input));
+        }
+#if defined(API_DUMP_USE_ZLIB)
+        if (gzip_initialized) deflateEnd(&gzip_stream);
+#endif
+#if defined(API_DUMP_USE_ZSTD)
+        if (zstd_context != NULL) ZSTD_freeCCtx(zstd_context);
+#endif
+    }
+
+    bool compressBlock(const std::vector<char> &input, std::vector<char> &output) {
+#if defined(API_DUMP_USE_ZLIB)
+        if (compression == ApiDumpCompression::Gzip) {
+            // A window size of 15 + 16 selects the gzip format, and every block is finished as its own member.
+            // The fastest level lets compression keep up with the application, zstd compresses better at
+            // the same speed.
+            if (!gzip_initialized) {
+                if (deflateInit2(&gzip_stream, Z_BEST_SPEED, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+                    return false;
+                gzip_initialized = true;
+            } else if (deflateReset(&gzip_stream) != Z_OK) {
+                return false;
+            }
+            output.resize(deflateBound(&gzip_stream, static_cast<uLong>(input.size())));
+            gzip_stream.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(input.data()));
+            gzip_stream.avail_in = static_cast<uInt>(input.size());
+            gzip_stream.next_out = reinterpret_cast<Bytef *>(output.data());
+            gzip_stream.avail_out = static_cast<uInt>(output.size());
+            if (deflate(&gzip_stream, Z_FINISH) != Z_STREAM_END) return false;
+            output.resize(output.size() - gzip_stream.avail_out);
+            return true;
+        }
+#endif
+#if defined(API_DUMP_USE_ZSTD)
+        if (compression == ApiDumpCompression::Zstd) {
+            if (zstd_context == NULL) zstd_context = ZSTD_createCCtx();
+            if (zstd_context == NULL) return false;
+            output.resize(ZSTD_compressBound(input.size()));
+            // Level 3 is zstd's default.
+            const size_t size = ZSTD_compressCCtx(zstd_context, output.data(), output.size(), input.data(), input.size(), 3);
+            if (ZSTD_isError(size)) return false;
+            output.resize(size);
+            return true;
+        }
+#endif
+        return false;
+    }
+
+    std::ofstream file;
+    ApiDumpCompression compression = ApiDumpCompression::None;
+    std::vector<char> block;
+
+    std::mutex block_mutex;
+    std::condition_variable block_cv;
+    std::deque<std::vector<char> > pending_blocks;
+    std::vector<std::vector<char> > free_blocks;
+    bool stopping = false;
+    std::thread compress_thread;
+
+#if defined(API_DUMP_USE_ZLIB)
+    z_stream gzip_stream = {};
+    bool gzip_initialized = false;
+#endif
+#if defined(API_DUMP_USE_ZSTD)
+    ZSTD_CCtx *zstd_context = NULL;
+#endif
+};
+
+//========================================= Shader Files =========================================//
+
+// XXH64 of the given bytes, with a seed of 0.
+inline uint64_t ApiDumpHash64(const void *data, size_t size) {
+    static const uint64_t PRIME1 = 11400714785074694791ULL;
+    static const uint64_t PRIME2 = 14029467366897019727ULL;
+    static const uint64_t PRIME3 = 1609587929392839161ULL;
+    static const uint64_t PRIME4 = 9650029242287828579ULL;
+    static const uint64_t PRIME5 = 2870177450012600261ULL;
+    struct Lane {
+        static inline uint64_t rotl(uint64_t value, int bits) { return (value << bits) | (value >> (64 - bits)); }
+        static inline uint64_t read64(const uint8_t *p) {
+            uint64_t value;
+            memcpy(&value, p, sizeof(value));
+            return value;
+        }
+        static inline uint64_t round(uint64_t acc, uint64_t input) { return rotl(acc + input * PRIME2, 31) * PRIME1; }
+        static inline uint64_t merge(uint64_t hash, uint64_t acc) { return (hash ^ round(0, acc)) * PRIME1 + PRIME4; }
+    };
+
+    const uint8_t *p = static_cast<const uint8_t *>(data);
+    const uint8_t *const end = p + size;
+    uint64_t hash;
+    if (size >= 32) {
+        uint64_t v1 = PRIME1 + PRIME2, v2 = PRIME2, v3 = 0, v4 = 0 - PRIME1;
+        for (; p + 32 <= end; p += 32) {
+            v1 = Lane::round(v1, Lane::read64(p));
+            v2 = Lane::round(v2, Lane::read64(p + 8));
+            v3 = Lane::round(v3, Lane::read64(p + 16));
+            v4 = Lane::round(v4, Lane::read64(p + 24));
+        }
+        hash = Lane::rotl(v1, 1) + Lane::rotl(v2, 7) + Lane::rotl(v3, 12) + Lane::rotl(v4, 18);
+        hash = Lane::merge(Lane::merge(Lane::merge(Lane::merge(hash, v1), v2), v3), v4);
+    } else {
+        hash = PRIME5;
+    }
+    hash += size;
+    for (; p + 8 <= end; p += 8) hash = Lane::rotl(hash ^ Lane::round(0, Lane::read64(p)), 27) * PRIME1 + PRIME4;
+    if (p + 4 <= end) {
+        uint32_t word;
+        memcpy(&word, p, sizeof(word));
+        hash = Lane::rotl(hash ^ (word * PRIME1), 23) * PRIME2 + PRIME3;
+        p += 4;
+    }
+    for (; p < end; ++p) hash = Lane::rotl(hash ^ (*p * PRIME5), 11) * PRIME1;
+    hash ^= hash >> 33;
+    hash *= PRIME2;
+    hash ^= hash >> 29;
+    hash *= PRIME3;
+    hash ^= hash >> 32;
+    return hash;
+}
+
+// Writes each distinct shader module once, as a SPIR-V file named by the hash of its code, so that
+// applications recreating the same modules do not fill the output directory with copies. The files
+// are written by a background thread, the calling thread only hashes and copies the code.
+class ApiDumpShaderWriter {
+   public:
+    ApiDumpShaderWriter() {}
+
+    ~ApiDumpShaderWriter() { close(); }
+
+    void open(const std::string &output_dir) {
+        directory = output_dir;
+        write_thread = std::thread(&ApiDumpShaderWriter::writeFiles, this);
+    }
+
+    void close() {
+        if (!write_thread.joinable()) return;
+        {
+            std::lock_guard<std::mutex> lg(write_mutex);
+            stopping = true;
+        }
+        write_cv.notify_one();
+        write_thread.join();
+    }
+
+    // Returns the name of the file holding the code, relative to the output directory.
+    std::string write(const uint32_t *code, size_t size) {
+        char hash[17];
+        snprintf(hash, sizeof(hash), "%016llx", static_cast<unsigned long long>(ApiDumpHash64(code, size)));
+        const std::string name = std::string("shader_") + hash + ".spv";
+        {
+            std::lock_guard<std::mutex> lg(write_mutex);
+            if (!written.insert(name).second) return name;
+            const char *bytes = reinterpret_cast<const char *>(code);
+            pending.emplace_back(name, std::vector<char>(bytes, bytes + size));
+        }
+        write_cv.notify_one();
+        return name;
+    }
+
+   private:
+    void writeFiles() {
+        std::unique_lock<std::mutex> lock(write_mutex);
+        while (true) {
+            write_cv.wait(lock, [this] { return stopping || !pending.empty(); });
+            if (pending.empty()) break;
+            std::vector<std::pair<std::string, std::vector<char> > > files;
+            files.swap(pending);
+            lock.unlock();
+            for (const auto &file : files) {
+                std::ofstream stream(directory + file.first, std::ofstream::out | std::ofstream::trunc | std::ofstream::binary);
+                stream.write(file.second.data(), file.second.size());
+            }
+            lock.lock();
+        }
+    }
+
+    std::string directory;
+    std::mutex write_mutex;
+    std::condition_variable write_cv;
+    std::unordered_set<std::string> written;
+    std::vector<std::pair<std::string, std::vector<char> > > pending;
+    bool stopping = false;
+    std::thread write_thread;
+};
+
 class ApiDumpSettings {
    public:
     ApiDumpSettings() {
+        output_format = readFormatOption("lunarg_api_dump.output_format", ApiDumpFormat::Text);
+        std::string env_value = GetPlatformEnvVar(API_DUMP_ENV_VAR_OUTPUT_FMT);
+        if (!env_value.empty()) {
+            if (ToLowerString(env_value) == "html") {
+                output_format = ApiDumpFormat::Html;
+            } else if (ToLowerString(env_value) == "json") {
+                output_format = ApiDumpFormat::Json;
+            } else if (ToLowerString(env_value) == "binary") {
+                output_format = ApiDumpFormat::Binary;
+            } else if (ToLowerString(env_value) == "trace") {
+                output_format = ApiDumpFormat::Trace;
+            } else {
+                output_format = ApiDumpFormat::Text;
+            }
+        }
+
         std::string filename_string = "";
         // If the layer settings file has a flag indicating to output to a file,
         // do so, to the appropriate filename.
@@ -244,14 +1107,72 @@ class ApiDumpSettings {
         // If an environment variable is set, always output to that filename instead,
         // whether or not the settings file enables the option.  Just assume a non-empty
         // string is asking for the file output to the given name.
-        std::string env_value = GetPlatformEnvVar(API_DUMP_ENV_VAR_LOG_FILE);
+        env_value = GetPlatformEnvVar(API_DUMP_ENV_VAR_LOG_FILE);
         if (!env_value.empty()) {
             filename_string = env_value;
         }
+        // The flight recorder keeps binary records in memory, and writes nothing until it is saved.
+        flight_recorder_frames = std::max(readIntOption("lunarg_api_dump.flight_recorder_frames", 0), 0);
+        env_value = GetPlatformEnvVar(API_DUMP_ENV_VAR_FLIGHT_RECORDER_FRAMES);
+        if (!env_value.empty()) {
+            flight_recorder_frames = std::max(atoi(env_value.c_str()), 0);
+        }
+        flight_recorder_max_size = std::max(readIntOption("lunarg_api_dump.flight_recorder_max_size", 256), 0);
+        env_value = GetPlatformEnvVar(API_DUMP_ENV_VAR_FLIGHT_RECORDER_MAX_SIZE);
+        if (!env_value.empty()) {
+            flight_recorder_max_size = std::max(atoi(env_value.c_str()), 0);
+        }
+        if (flight_recorder_frames > 0) {
+            output_format = ApiDumpFormat::Binary;
+            flight_recorder_filename = filename_string.empty() ? "vk_apidump.bin" : filename_string;
+            filename_string.clear();
+        }
+        bool mapped_output = readBoolOption("lunarg_api_dump.mapped_output", false);
+        env_value = GetPlatformEnvVar(API_DUMP_ENV_VAR_MAPPED_OUTPUT);
+        if (!env_value.empty()) {
+            mapped_output = GetStringBooleanValue(env_value);
+        }
+        const size_t mapped_chunk_size = std::max(readIntOption("lunarg_api_dump.mapped_chunk_size", 64), 1);
+
+        compression = readCompressionOption("lunarg_api_dump.compression", ApiDumpCompression::None);
+        env_value = GetPlatformEnvVar(API_DUMP_ENV_VAR_COMPRESSION);
+        if (!env_value.empty()) {
+            compression = parseCompressionOption(env_value, ApiDumpCompression::None);
+        }
+        // vkapidump-convert reads binary captures as they are, so they are never compressed.
+        if (output_format == ApiDumpFormat::Binary) compression = ApiDumpCompression::None;
+        if (compression != ApiDumpCompression::None && !ApiDumpCompressedFileBuffer::supported(compression)) {
+            const char *msg = "api_dump: the requested output compression is not supported, writing uncompressed output\n";
+#ifdef ANDROID
+            __android_log_print(ANDROID_LOG_DEBUG, "api_dump", "%s", msg);
+#else
+            fprintf(stderr, "%s", msg);
+#endif
+            compression = ApiDumpCompression::None;
+        }
+
         // If one of the above has set a filename, open the file as an output stream.
+        // A compressed or memory mapped file is used if requested and possible, the file stream otherwise.
         if (!filename_string.empty()) {
             use_cout = false;
-            output_stream.open(filename_string, std::ofstream::out | std::ostream::trunc);
+            if (compression != ApiDumpCompression::None) {
+                const std::string extension = ApiDumpCompressedFileBuffer::extension(compression);
+                if (filename_string.size() < extension.size() ||
+                    filename_string.compare(filename_string.size() - extension.size(), extension.size(), extension) != 0) {
+                    filename_string += extension;
+                }
+            }
+            if (compression != ApiDumpCompression::None && compressed_file.open(filename_string, compression)) {
+                use_compressed_file = true;
+                compressed_stream.rdbuf(&compressed_file);
+            } else if (mapped_output && mapped_file.open(filename_string, mapped_chunk_size << 20)) {
+                use_mapped_file = true;
+                mapped_stream.rdbuf(&mapped_file);
+            } else {
+                std::ios_base::openmode mode = std::ofstream::out | std::ostream::trunc;
+                if (output_format == ApiDumpFormat::Binary) mode |= std::ostream::binary;
+                output_stream.open(filename_string, mode);
+            }
             size_t last_slash_idx = filename_string.find_last_of("\\/");
             if (std::string::npos != last_slash_idx) {
                 output_dir = filename_string.substr(0, last_slash_idx + 1);
@@ -264,20 +1185,8 @@ class ApiDumpSettings {
         // Get the remaining settings (some we also want to provide the ability to override
         // using environment variables).
 
-        output_format = readFormatOption("lunarg_api_dump.output_format", ApiDumpFormat::Text);
-        env_value = GetPlatformEnvVar(API_DUMP_ENV_VAR_OUTPUT_FMT);
-        if (!env_value.empty()) {
-            if (ToLowerString(env_value) == "html") {
-                output_format = ApiDumpFormat::Html;
-            } else if (ToLowerString(env_value) == "json") {
-                output_format = ApiDumpFormat::Json;
-            } else {
-                output_format = ApiDumpFormat::Text;
-            }
-        }
-
-        show_params = readBoolOption("lunarg_api_dump.detailed", true);
-        env_value = GetPlatformEnvVar(API_DUMP_ENV_VAR_DETAILED_OUTPUT);
+        show_params = readBoolOption("lunarg_api_dump.detailed", true);
+        env_value = GetPlatformEnvVar(API_DUMP_ENV_VAR_DETAILED_OUTPUT);
         if (!env_value.empty()) {
             show_params = GetStringBooleanValue(env_value);
         }
@@ -300,14 +1209,105 @@ class ApiDumpSettings {
             show_timestamp = GetStringBooleanValue(env_value);
         }
 
+        show_duration = readBoolOption("lunarg_api_dump.show_duration", false);
+        env_value = GetPlatformEnvVar(API_DUMP_ENV_VAR_SHOW_DURATION);
+        if (!env_value.empty()) {
+            show_duration = GetStringBooleanValue(env_value);
+        }
+        latency_file = getLayerOption("lunarg_api_dump.latency_file");
+        env_value = GetPlatformEnvVar(API_DUMP_ENV_VAR_LATENCY_FILE);
+        if (!env_value.empty()) {
+            latency_file = env_value;
+        }
+        trace_full_args = readBoolOption("lunarg_api_dump.trace_full_args", false);
+        env_value = GetPlatformEnvVar(API_DUMP_ENV_VAR_TRACE_FULL_ARGS);
+        if (!env_value.empty()) {
+            trace_full_args = GetStringBooleanValue(env_value);
+        }
+        delta_output = readBoolOption("lunarg_api_dump.delta", false);
+        env_value = GetPlatformEnvVar(API_DUMP_ENV_VAR_DELTA_OUTPUT);
+        if (!env_value.empty()) {
+            delta_output = GetStringBooleanValue(env_value);
+        }
+        // Back references are only written as text.
+        if (output_format != ApiDumpFormat::Text) delta_output = false;
+        mode = readModeOption("lunarg_api_dump.mode", ApiDumpMode::Full);
+        env_value = GetPlatformEnvVar(API_DUMP_ENV_VAR_MODE);
+        if (!env_value.empty()) {
+            mode = parseModeOption(env_value, ApiDumpMode::Full);
+        }
+        // The flight recorder always records the calls themselves.
+        if (flight_recorder_frames > 0) mode = ApiDumpMode::Full;
+
+        show_os_thread_id = readBoolOption("lunarg_api_dump.show_os_thread_id", false);
+        env_value = GetPlatformEnvVar(API_DUMP_ENV_VAR_OS_THREAD_ID);
+        if (!env_value.empty()) {
+            show_os_thread_id = GetStringBooleanValue(env_value);
+        }
+
         indent_size = std::max(readIntOption("lunarg_api_dump.indent_size", 4), 0);
         show_type = readBoolOption("lunarg_api_dump.show_types", true);
         name_size = std::max(readIntOption("lunarg_api_dump.name_size", 32), 0);
         type_size = std::max(readIntOption("lunarg_api_dump.type_size", 0), 0);
         use_spaces = readBoolOption("lunarg_api_dump.use_spaces", true);
         show_shader = readBoolOption("lunarg_api_dump.show_shader", false);
+        if (show_shader && !use_cout && output_format != ApiDumpFormat::Binary) shader_writer.open(output_dir);
         show_thread_and_frame = readBoolOption("lunarg_api_dump.show_thread_and_frame", true);
 
+        async_output = readBoolOption("lunarg_api_dump.async_output", false);
+        env_value = GetPlatformEnvVar(API_DUMP_ENV_VAR_ASYNC_OUTPUT);
+        if (!env_value.empty()) {
+            async_output = GetStringBooleanValue(env_value);
+        }
+        // Records only go to memory in flight recorder mode, so there is nothing to write asynchronously.
+        if (flight_recorder_frames > 0) async_output = false;
+        async_buffer_size = std::max(readIntOption("lunarg_api_dump.async_buffer_size", 1024), 16);
+        async_overflow = readOverflowOption("lunarg_api_dump.async_overflow", ApiDumpOverflowPolicy::Block);
+
+        std::string include_functions = getLayerOption("lunarg_api_dump.include_functions");
+        env_value = GetPlatformEnvVar(API_DUMP_ENV_VAR_INCLUDE_FUNCTIONS);
+        if (!env_value.empty()) {
+            include_functions = env_value;
+        }
+        std::string exclude_functions = getLayerOption("lunarg_api_dump.exclude_functions");
+        env_value = GetPlatformEnvVar(API_DUMP_ENV_VAR_EXCLUDE_FUNCTIONS);
+        if (!env_value.empty()) {
+            exclude_functions = env_value;
+        }
+        function_filter.parse(include_functions, exclude_functions);
+        resolve_function_filter(function_filter);
+
+        trigger_signals = readBoolOption("lunarg_api_dump.trigger_signals", false);
+        env_value = GetPlatformEnvVar(API_DUMP_ENV_VAR_TRIGGER_SIGNALS);
+        if (!env_value.empty()) {
+            trigger_signals = GetStringBooleanValue(env_value);
+        }
+        flight_recorder_signal = readBoolOption("lunarg_api_dump.flight_recorder_signal", false);
+        env_value = GetPlatformEnvVar(API_DUMP_ENV_VAR_FLIGHT_RECORDER_SIGNAL);
+        if (!env_value.empty()) {
+            flight_recorder_signal = GetStringBooleanValue(env_value);
+        }
+        if (flight_recorder_frames == 0) flight_recorder_signal = false;
+        if (flight_recorder_signal && trigger_signals) {
+            const char *msg = "api_dump: SIGUSR1 starts output with trigger signals on, so it does not save the flight recorder\n";
+#ifdef ANDROID
+            __android_log_print(ANDROID_LOG_DEBUG, "api_dump", "%s", msg);
+#else
+            fprintf(stderr, "%s", msg);
+#endif
+            flight_recorder_signal = false;
+        }
+        trigger_file = getLayerOption("lunarg_api_dump.trigger_file");
+        env_value = GetPlatformEnvVar(API_DUMP_ENV_VAR_TRIGGER_FILE);
+        if (!env_value.empty()) {
+            trigger_file = env_value;
+        }
+        trigger_label = getLayerOption("lunarg_api_dump.trigger_label");
+        env_value = GetPlatformEnvVar(API_DUMP_ENV_VAR_TRIGGER_LABEL);
+        if (!env_value.empty()) {
+            trigger_label = env_value;
+        }
+
         std::string cond_range_string;
         env_value = GetPlatformEnvVar(API_DUMP_ENV_VAR_OUTPUT_RANGE);
         if (!env_value.empty()) {
@@ -326,10 +1326,12 @@ class ApiDumpSettings {
         }
 
         // Generate HTML heading if specified
-        if (output_format == ApiDumpFormat::Html) {
+        if (mode == ApiDumpMode::Summary) {
+            // The summary table is written by ApiDumpCallSummary.
+        } else if (output_format == ApiDumpFormat::Html) {
             // clang-format off
             // Insert html heading
-            stream() <<
+            output() <<
                 "<!doctype html>"
                 "<html>"
                     "<head>"
@@ -429,59 +1431,106 @@ class ApiDumpSettings {
                         "<div id='wrapper'>";
             // clang-format on
         } else if (output_format == ApiDumpFormat::Json) {
-            stream() << "[\n";
-        }
-
-        if (isFrameInRange(0)) {
-            setupInterFrameOutputFormatting(0);
+            output() << "[\n";
+        } else if (output_format == ApiDumpFormat::Trace) {
+            // Every event after this one starts with its separator, so events can be streamed as they happen.
+            output() << "[\n{\"name\" : \"process_name\", \"ph\" : \"M\", \"pid\" : 1, \"args\" : {\"name\" : \"Vulkan API Dump\"}}";
+        } else if (output_format == ApiDumpFormat::Binary && flight_recorder_frames == 0) {
+            ApiDumpBinaryFileHeader header = {};
+            memcpy(header.magic, API_DUMP_BINARY_MAGIC, sizeof(header.magic));
+            header.version = API_DUMP_BINARY_VERSION;
+            header.header_version = VK_HEADER_VERSION;
+            header.pointer_size = sizeof(void *);
+            output().write(reinterpret_cast<const char *>(&header), sizeof(header));
         }
     }
 
     ~ApiDumpSettings() {
-        if (output_format == ApiDumpFormat::Html) {
+        if (mode == ApiDumpMode::Summary) {
+            // The summary table is closed by ApiDumpCallSummary.
+        } else if (output_format == ApiDumpFormat::Html) {
             // Close off html
-            stream() << "</div></body></html>";
+            output() << "</div></body></html>";
         } else if (output_format == ApiDumpFormat::Json) {
             // Close off json
-            stream() << "\n]" << std::endl;
+            output() << "\n]" << std::endl;
+        } else if (output_format == ApiDumpFormat::Trace) {
+            // Trace viewers also load a trace whose closing bracket is missing, e.g. after a crash.
+            output() << "\n]" << std::endl;
         }
-        if (!use_cout) output_stream.close();
+        if (use_compressed_file) {
+            compressed_stream.flush();
+            compressed_file.close();
+        } else if (use_mapped_file) {
+            mapped_stream.flush();
+            mapped_file.close();
+        } else if (!use_cout) {
+            output_stream.close();
+        }
+    }
+
+    // Opens the frame the output starts on. That is frame 0, unless vkapidump-convert is converting
+    // a flight recorder capture.
+    void beginFrameOutput(uint64_t frame_count) const {
+        if (mode == ApiDumpMode::Summary || !isFrameInRange(frame_count)) return;
+        ApiDumpFormatter frame_output;
+        setupInterFrameOutputFormatting(frame_output, frame_count, true);
+        output().write(frame_output.data(), frame_output.size());
     }
 
-    void setupInterFrameOutputFormatting(uint64_t frame_count) const /*name change? */
+    void setupInterFrameOutputFormatting(ApiDumpFormatter &frame_output, uint64_t frame_count, bool first_frame = false,
+                                         int64_t frame_time = 0) const /*name change? */
     {
         static bool hasPrintedAFrame = false;
         switch (format()) {
             case (ApiDumpFormat::Html):
-                if (frame_count > 0) {
-                    if (condFrameOutput.isFrameInRange(frame_count - 1)) stream() << "</details>";
+                if (!first_frame) {
+                    if (condFrameOutput.isFrameInRange(frame_count - 1)) frame_output << "</details>";
                 }
                 if (condFrameOutput.isFrameInRange(frame_count)) {
-                    stream() << "<details class='frm'><summary>Frame ";
+                    frame_output << "<details class='frm'><summary>Frame ";
                     if (show_thread_and_frame) {
-                        stream() << frame_count;
+                        frame_output << frame_count;
                     }
-                    stream() << "</summary>";
+                    frame_output << "</summary>";
                 }
                 break;
 
             case (ApiDumpFormat::Json):
 
-                if (frame_count > 0) {
-                    if (condFrameOutput.isFrameInRange(frame_count - 1)) stream() << "\n" << indentation(1) << "]\n}";
+                if (!first_frame) {
+                    if (condFrameOutput.isFrameInRange(frame_count - 1)) frame_output << "\n" << indentation(1) << "]\n}";
                 }
                 if (condFrameOutput.isFrameInRange(frame_count)) {
                     if (!hasPrintedAFrame) {
                         hasPrintedAFrame = true;
                     } else {
-                        stream() << ",\n";
+                        frame_output << ",\n";
                     }
-                    stream() << "{\n";
+                    frame_output << "{\n";
                     if (show_thread_and_frame) {
-                        stream() << indentation(1) << "\"frameNumber\" : \"" << frame_count << "\",\n";
+                        frame_output << indentation(1) << "\"frameNumber\" : \"" << frame_count << "\",\n";
                     }
-                    stream() << indentation(1) << "\"apiCalls\" :\n";
-                    stream() << indentation(1) << "[\n";
+                    frame_output << indentation(1) << "\"apiCalls\" :\n";
+                    frame_output << indentation(1) << "[\n";
+                }
+                break;
+            case (ApiDumpFormat::Binary):
+                // Frame markers let the converter rebuild the frame boundaries, whatever its output range.
+                if (!first_frame) {
+                    ApiDumpBinaryRecordHeader marker = {};
+                    marker.size = sizeof(marker);
+                    marker.function = API_DUMP_BINARY_FRAME_MARKER;
+                    marker.frame = frame_count;
+                    frame_output.write(reinterpret_cast<const char *>(&marker), sizeof(marker));
+                }
+                break;
+            case (ApiDumpFormat::Trace):
+                // A global instant event marks where each frame starts, across all threads.
+                if (!first_frame && condFrameOutput.isFrameInRange(frame_count)) {
+                    frame_output << ",\n{\"name\" : \"Frame " << frame_count
+                                 << "\", \"cat\" : \"frame\", \"ph\" : \"i\", \"s\" : \"g\", \"pid\" : 1, \"tid\" : 0, \"ts\" : "
+                                 << frame_time << "}";
                 }
                 break;
             case (ApiDumpFormat::Text):
@@ -494,10 +1543,10 @@ class ApiDumpSettings {
     void closeFrameOutput() const {
         switch (format()) {
             case (ApiDumpFormat::Html):
-                stream() << "</details>";
+                output() << "</details>";
                 break;
             case (ApiDumpFormat::Json):
-                stream() << "\n" << indentation(1) << "]\n}";
+                output() << "\n" << indentation(1) << "]\n}";
                 break;
             case (ApiDumpFormat::Text):
                 break;
@@ -508,7 +1557,7 @@ class ApiDumpSettings {
 
     inline ApiDumpFormat format() const { return output_format; }
 
-    std::ostream &formatNameType(std::ostream &stream, int indents, const char *name, const char *type) const {
+    ApiDumpFormatter &formatNameType(ApiDumpFormatter &stream, int indents, const char *name, const char *type) const {
         stream << indentation(indents) << name << ": ";
 
         if (use_spaces)
@@ -531,7 +1580,11 @@ class ApiDumpSettings {
             return tabs(indents);
     }
 
-    inline bool shouldFlush() const { return should_flush; }
+    // Every flush ends a block of compressed output, so compressed output is only flushed at frame
+    // boundaries, where the previous frame is complete.
+    inline bool shouldFlush(bool frame_ended) const {
+        return should_flush && (compression == ApiDumpCompression::None || frame_ended);
+    }
 
     inline bool showAddress() const { return show_address; }
 
@@ -539,18 +1592,79 @@ class ApiDumpSettings {
 
     inline bool showShader() const { return show_shader; }
 
+    // Shader code is written to files beside the output, unless the output goes to stdout.
+    inline bool writeShaderFiles() const { return show_shader && !use_cout; }
+
+    inline std::string shaderFile(const uint32_t *code, size_t size) const { return shader_writer.write(code, size); }
+
     inline bool showType() const { return show_type; }
 
     inline bool showTimestamp() const { return show_timestamp; }
 
     inline bool showThreadAndFrame() const { return show_thread_and_frame; }
 
-    inline std::ostream &stream() const { return use_cout ? std::cout : *(std::ofstream *)&output_stream; }
+    inline bool showOSThreadID() const { return show_os_thread_id; }
+
+    inline bool showDuration() const { return show_duration; }
+
+    inline const std::string &latencyFile() const { return latency_file; }
+
+    inline bool traceFullArgs() const { return trace_full_args; }
+
+    inline bool deltaOutput() const { return delta_output; }
+
+    inline ApiDumpMode dumpMode() const { return mode; }
+
+    // Driver calls are timed when their duration is shown, latency statistics are kept or a trace is written.
+    inline bool measureCalls() const {
+        return show_duration || !latency_file.empty() || output_format == ApiDumpFormat::Trace;
+    }
+
+    // Stream for the api call currently being dumped on the calling thread.
+    inline ApiDumpFormatter &stream() const { return threadRecord().stream; }
+
+    // The real output stream. Only written while holding ApiDumpInstance::outputMutex().
+    inline std::ostream &output() const {
+        if (use_cout) return std::cout;
+        if (use_compressed_file) return *(std::ostream *)&compressed_stream;
+        if (use_mapped_file) return *(std::ostream *)&mapped_stream;
+        return *(std::ofstream *)&output_stream;
+    }
+
+    inline static ApiDumpRecord &threadRecord() {
+        static thread_local ApiDumpRecord record;
+        return record;
+    }
+
+    inline bool useCout() const { return use_cout; }
+
+    inline bool asyncOutput() const { return async_output; }
+
+    // Size of each thread's async output buffer, in bytes.
+    inline size_t asyncBufferSize() const { return static_cast<size_t>(async_buffer_size) * 1024; }
+
+    inline ApiDumpOverflowPolicy asyncOverflow() const { return async_overflow; }
 
     inline std::string directory() const { return output_dir; }
 
     inline bool isFrameInRange(uint64_t frame) const { return condFrameOutput.isFrameInRange(frame); }
 
+    inline bool isFunctionEnabled(uint32_t function) const { return function_filter.enabled(function); }
+
+    inline bool triggerSignals() const { return trigger_signals; }
+
+    inline int flightRecorderFrames() const { return flight_recorder_frames; }
+
+    inline size_t flightRecorderMaxSize() const { return static_cast<size_t>(flight_recorder_max_size) << 20; }
+
+    inline const std::string &flightRecorderFilename() const { return flight_recorder_filename; }
+
+    inline bool flightRecorderSignal() const { return flight_recorder_signal; }
+
+    inline const std::string &triggerFile() const { return trigger_file; }
+
+    inline const std::string &triggerLabel() const { return trigger_label; }
+
    private:
     // Utility member to enable easier comparison by forcing a string to all lower-case
     inline static std::string ToLowerString(const std::string &value) {
@@ -637,6 +1751,53 @@ class ApiDumpSettings {
             return ApiDumpFormat::Html;
         else if (lowered_option == "json")
             return ApiDumpFormat::Json;
+        else if (lowered_option == "binary")
+            return ApiDumpFormat::Binary;
+        else if (lowered_option == "trace")
+            return ApiDumpFormat::Trace;
+        else
+            return default_value;
+    }
+
+    inline static ApiDumpCompression parseCompressionOption(const std::string &option, ApiDumpCompression default_value) {
+        std::string lowered_option = ToLowerString(option);
+        if (lowered_option == "none")
+            return ApiDumpCompression::None;
+        else if (lowered_option == "gzip")
+            return ApiDumpCompression::Gzip;
+        else if (lowered_option == "zstd")
+            return ApiDumpCompression::Zstd;
+        else
+            return default_value;
+    }
+
+    inline static ApiDumpCompression readCompressionOption(const char *option, ApiDumpCompression default_value) {
+        return parseCompressionOption(std::string(getLayerOption(option)), default_value);
+    }
+
+    inline static ApiDumpMode parseModeOption(const std::string &option, ApiDumpMode default_value) {
+        std::string lowered_option = ToLowerString(option);
+        if (lowered_option == "full")
+            return ApiDumpMode::Full;
+        else if (lowered_option == "summary")
+            return ApiDumpMode::Summary;
+        else
+            return default_value;
+    }
+
+    inline static ApiDumpMode readModeOption(const char *option, ApiDumpMode default_value) {
+        return parseModeOption(std::string(getLayerOption(option)), default_value);
+    }
+
+    inline static ApiDumpOverflowPolicy readOverflowOption(const char *option, ApiDumpOverflowPolicy default_value) {
+        const char *string_option = getLayerOption(option);
+        std::string lowered_option = ToLowerString(std::string(string_option));
+        if (lowered_option == "block")
+            return ApiDumpOverflowPolicy::Block;
+        else if (lowered_option == "drop")
+            return ApiDumpOverflowPolicy::Drop;
+        else if (lowered_option == "grow")
+            return ApiDumpOverflowPolicy::Grow;
         else
             return default_value;
     }
@@ -648,43 +1809,1427 @@ class ApiDumpSettings {
     bool use_cout;
     std::string output_dir = "";
     std::ofstream output_stream;
+    bool use_mapped_file = false;
+    ApiDumpMappedFileBuffer mapped_file;
+    std::ostream mapped_stream{NULL};
+    ApiDumpCompression compression;
+    bool use_compressed_file = false;
+    ApiDumpCompressedFileBuffer compressed_file;
+    std::ostream compressed_stream{NULL};
     ApiDumpFormat output_format;
     bool show_params;
     bool show_address;
     bool should_flush;
     bool show_timestamp;
+    bool show_os_thread_id;
+    bool show_duration;
+    std::string latency_file;
+    bool trace_full_args;
+    bool delta_output;
+    ApiDumpMode mode;
+
+    bool show_type;
+    int indent_size;
+    int name_size;
+    int type_size;
+    bool use_spaces;
+    bool show_shader;
+    mutable ApiDumpShaderWriter shader_writer;
+    bool show_thread_and_frame;
+
+    bool async_output;
+    int async_buffer_size;
+    ApiDumpOverflowPolicy async_overflow;
+
+    bool use_conditional_output = false;
+    ConditionalFrameOutput condFrameOutput;
+
+    ApiDumpFunctionFilter function_filter;
+
+    bool trigger_signals;
+    std::string trigger_file;
+    std::string trigger_label;
+
+    int flight_recorder_frames;
+    int flight_recorder_max_size;
+    std::string flight_recorder_filename;
+    bool flight_recorder_signal;
+
+    static const char *const SPACES;
+    static const int MAX_SPACES = 144;
+    static const char *const TABS;
+    static const int MAX_TABS = 36;
+};
+
+const char *const ApiDumpSettings::SPACES =
+    "                                                                                                                          "
+    "    "
+    "                  ";
+const char *const ApiDumpSettings::TABS = "\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t";
+
+//=================================== Async Output Writer ========================================//
+
+// Single producer, single consumer byte ring holding the finished records of one application thread.
+// The producer is the thread that owns the ring, the consumer is the ApiDumpAsyncWriter thread.
+class ApiDumpRing {
+   public:
+    struct Header {
+        uint64_t sequence;  // Global commit order of the record.
+        uint32_t size;      // Payload bytes following the header.
+        uint32_t kind;      // ApiDumpRecordKind, or PADDING if the rest of the ring is unused.
+        ApiDumpFrameField frame;
+    };
+
+    static const uint32_t PADDING = UINT32_MAX;
+
+    explicit ApiDumpRing(size_t size) : data(new char[alignedSize(size)]), capacity(alignedSize(size)) {}
+
+    ~ApiDumpRing() { delete[] data; }
+
+    // Records are kept aligned to the header size, so there is always room for a padding header
+    // when a record does not fit before the end of the ring.
+    inline static size_t alignedSize(size_t size) { return (size + sizeof(Header) - 1) & ~(sizeof(Header) - 1); }
+
+    inline static size_t recordSize(size_t payload_size) { return sizeof(Header) + alignedSize(payload_size); }
+
+    inline size_t size() const { return capacity; }
+
+    // Producer: returns space for a record of record_size bytes, or NULL if the ring is full.
+    inline char *reserve(size_t record_size) {
+        const uint64_t head = write_pos.load(std::memory_order_relaxed);
+        const uint64_t tail = read_pos.load(std::memory_order_acquire);
+        const size_t offset = static_cast<size_t>(head % capacity);
+        const size_t skip = capacity - offset < record_size ? capacity - offset : 0;
+        if (head + skip + record_size - tail > capacity) return NULL;
+
+        if (skip > 0) reinterpret_cast<Header *>(data + offset)->kind = PADDING;
+        reserved_pos = head + skip;
+        return data + static_cast<size_t>(reserved_pos % capacity);
+    }
+
+    // Producer: makes the record written to the last reserve() visible to the consumer.
+    inline void publish(size_t record_size) { write_pos.store(reserved_pos + record_size, std::memory_order_release); }
+
+    // Consumer: returns the oldest published record, or NULL if there is none.
+    inline const Header *peek() {
+        uint64_t tail = read_pos.load(std::memory_order_relaxed);
+        const uint64_t head = write_pos.load(std::memory_order_acquire);
+        if (tail == head) return NULL;
+
+        const Header *header = reinterpret_cast<const Header *>(data + static_cast<size_t>(tail % capacity));
+        if (header->kind == PADDING) {
+            tail += capacity - tail % capacity;
+            read_pos.store(tail, std::memory_order_release);
+            if (tail == head) return NULL;
+            header = reinterpret_cast<const Header *>(data + static_cast<size_t>(tail % capacity));
+        }
+        return header;
+    }
+
+    // Consumer: releases the record returned by the last peek().
+    inline void pop(const Header *header) {
+        read_pos.store(read_pos.load(std::memory_order_relaxed) + recordSize(header->size), std::memory_order_release);
+    }
+
+    std::atomic<ApiDumpRing *> next{nullptr};
+
+   private:
+    char *data;
+    size_t capacity;
+    uint64_t reserved_pos = 0;
+    std::atomic<uint64_t> write_pos{0};
+    std::atomic<uint64_t> read_pos{0};
+};
+
+// All records of one application thread. When a ring is outgrown under the grow policy, the producer
+// links a larger ring in as `next` and never touches the old one again. The consumer moves on to
+// the new ring once the old one is drained.
+struct ApiDumpThreadQueue {
+    explicit ApiDumpThreadQueue(size_t size) : producer(new ApiDumpRing(size)), consumer(producer) {}
+
+    ~ApiDumpThreadQueue() {
+        while (consumer != NULL) {
+            ApiDumpRing *next = consumer->next.load(std::memory_order_acquire);
+            delete consumer;
+            consumer = next;
+        }
+    }
+
+    // Consumer: returns the oldest published record, or NULL if there is none.
+    inline const ApiDumpRing::Header *peek() {
+        const ApiDumpRing::Header *header = consumer->peek();
+        while (header == NULL) {
+            ApiDumpRing *next = consumer->next.load(std::memory_order_acquire);
+            if (next == NULL) return NULL;
+            // The producer is done with the old ring once it has linked the next one, but it may have
+            // published a last record just before doing so.
+            header = consumer->peek();
+            if (header != NULL) break;
+            delete consumer;
+            consumer = next;
+            header = consumer->peek();
+        }
+        return header;
+    }
+
+    inline void pop(const ApiDumpRing::Header *header) { consumer->pop(header); }
+
+    ApiDumpRing *producer;
+    ApiDumpRing *consumer;
+};
+
+// Background thread writing the records of all application threads to the output. Application
+// threads copy each finished record into their own ring and never wait on the output, and the
+// writer thread drains the rings in commit order into large batched writes. When it runs out of
+// records the writer sleeps until one is published, and a thread blocked on a full ring sleeps
+// until the writer frees space. Either side only takes the wake mutex when the other is asleep.
+class ApiDumpAsyncWriter {
+   public:
+    // Returns the text to write in front of a record of the given kind. Only called from the writer
+    // thread, in commit order.
+    typedef std::function<const char *(ApiDumpRecordKind)> PrefixCallback;
+
+    // The output starts on first_frame, and each frame record starts the next frame.
+    ApiDumpAsyncWriter(const ApiDumpSettings &settings, PrefixCallback prefix, uint64_t first_frame)
+        : id(nextId()), settings(settings), prefix(prefix), first_frame(first_frame), thread(&ApiDumpAsyncWriter::run, this) {}
+
+    ~ApiDumpAsyncWriter() {
+        {
+            std::lock_guard<std::mutex> lg(wake_mutex);
+            stop.store(true, std::memory_order_release);
+            record_published.notify_one();
+        }
+        thread.join();
+        // Threads that are still running only reuse their queue while its writer is the one they
+        // made it for, so every queue can be freed.
+        for (auto queue : queues) delete queue;
+
+        const uint64_t dropped = dropped_records.load();
+        if (dropped > 0) {
+            std::stringstream msg;
+            msg << "api_dump: dropped " << dropped << " api calls because the async output buffer was full\n";
+#ifdef ANDROID
+            __android_log_print(ANDROID_LOG_DEBUG, "api_dump", "%s", msg.str().c_str());
+#else
+            fprintf(stderr, "%s", msg.str().c_str());
+#endif
+        }
+    }
+
+    // Copies a finished record into the calling thread's ring.
+    void push(ApiDumpRecordKind kind, const char *data, size_t size, const ApiDumpFrameField &frame) {
+        ApiDumpThreadQueue &queue = threadQueue();
+        const size_t record_size = ApiDumpRing::recordSize(size);
+        char *record = queue.producer->reserve(record_size);
+        while (record == NULL) {
+            if (record_size > queue.producer->size() || settings.asyncOverflow() == ApiDumpOverflowPolicy::Grow) {
+                grow(queue, record_size);
+            } else if (settings.asyncOverflow() == ApiDumpOverflowPolicy::Drop && kind == ApiDumpRecordKind::Call) {
+                // Frame records are never dropped, the output would no longer be well formed.
+                dropped_records.fetch_add(1, std::memory_order_relaxed);
+                return;
+            } else {
+                record = waitForSpace(queue, record_size);
+                continue;
+            }
+            record = queue.producer->reserve(record_size);
+        }
+
+        // The sequence number is only taken once the record is sure to be published, so the writer
+        // never waits on a record that will not come.
+        ApiDumpRing::Header *header = reinterpret_cast<ApiDumpRing::Header *>(record);
+        header->sequence = next_sequence.fetch_add(1, std::memory_order_relaxed);
+        header->size = static_cast<uint32_t>(size);
+        header->kind = static_cast<uint32_t>(kind);
+        header->frame = frame;
+        memcpy(record + sizeof(ApiDumpRing::Header), data, size);
+        queue.producer->publish(record_size);
+
+        // Pairs with the fence in waitForRecord(): either the writer sees this record before it goes
+        // to sleep, or this thread sees that it is asleep.
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (writer_waiting.load(std::memory_order_relaxed)) {
+            std::lock_guard<std::mutex> lg(wake_mutex);
+            record_published.notify_one();
+        }
+    }
+
+   private:
+    // The calling thread's queue, and the writer it was made for. The writer owns the queue.
+    struct ThreadQueueHandle {
+        uint64_t writer = 0;
+        ApiDumpThreadQueue *queue = NULL;
+    };
+
+    static uint64_t nextId() {
+        static std::atomic<uint64_t> next_id{1};
+        return next_id.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    inline ApiDumpThreadQueue &threadQueue() {
+        static thread_local ThreadQueueHandle handle;
+        if (handle.writer != id) {
+            handle.writer = id;
+            handle.queue = new ApiDumpThreadQueue(settings.asyncBufferSize());
+            std::lock_guard<std::mutex> lg(queues_mutex);
+            queues.push_back(handle.queue);
+            queues_version.fetch_add(1, std::memory_order_release);
+        }
+        return *handle.queue;
+    }
+
+    inline void grow(ApiDumpThreadQueue &queue, size_t record_size) {
+        size_t size = queue.producer->size() * 2;
+        while (size < record_size) size *= 2;
+        ApiDumpRing *ring = new ApiDumpRing(size);
+        queue.producer->next.store(ring, std::memory_order_release);
+        queue.producer = ring;
+    }
+
+    // Block policy: sleeps until the writer has freed enough of the calling thread's ring for the
+    // record, and returns the space reserved for it.
+    char *waitForSpace(ApiDumpThreadQueue &queue, size_t record_size) {
+        std::unique_lock<std::mutex> lock(wake_mutex);
+        blocked_producers.fetch_add(1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        char *record = queue.producer->reserve(record_size);
+        while (record == NULL) {
+            space_freed.wait(lock);
+            record = queue.producer->reserve(record_size);
+        }
+        blocked_producers.fetch_sub(1, std::memory_order_relaxed);
+        return record;
+    }
+
+    // Pairs with the fence in waitForSpace(): either the blocked thread sees the space just freed, or
+    // the writer sees that a thread is blocked.
+    inline void wakeBlockedProducers() {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (blocked_producers.load(std::memory_order_relaxed) > 0) {
+            std::lock_guard<std::mutex> lg(wake_mutex);
+            space_freed.notify_all();
+        }
+    }
+
+    // Whether the record numbered sequence is published, new queues were added, or the writer is
+    // being stopped.
+    inline bool hasWork(const std::vector<ApiDumpThreadQueue *> &active, uint64_t active_version, uint64_t sequence) {
+        if (stop.load(std::memory_order_acquire) || queues_version.load(std::memory_order_acquire) != active_version)
+            return true;
+        for (ApiDumpThreadQueue *queue : active) {
+            const ApiDumpRing::Header *header = queue->peek();
+            if (header != NULL && header->sequence == sequence) return true;
+        }
+        return false;
+    }
+
+    // Sleeps until hasWork(). A record committed on another thread but not published yet is waited
+    // for the same way, as its thread publishes it right after.
+    void waitForRecord(const std::vector<ApiDumpThreadQueue *> &active, uint64_t active_version, uint64_t sequence) {
+        std::unique_lock<std::mutex> lock(wake_mutex);
+        writer_waiting.store(true, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        while (!hasWork(active, active_version, sequence)) record_published.wait(lock);
+        writer_waiting.store(false, std::memory_order_relaxed);
+    }
+
+    void writeBatch(std::string &batch, bool &frame_ended) {
+        if (batch.empty()) return;
+        std::ostream &output = settings.output();
+        output.write(batch.data(), batch.size());
+        if (settings.shouldFlush(frame_ended)) output.flush();
+        batch.clear();
+        frame_ended = false;
+    }
+
+    void run() {
+        static const size_t BATCH_SIZE = 1 << 20;
+        std::string batch;
+        batch.reserve(BATCH_SIZE);
+        std::vector<ApiDumpThreadQueue *> active;
+        uint64_t active_version = UINT64_MAX;
+        uint64_t sequence = 0;
+        uint64_t frame = first_frame;
+        const bool binary = settings.format() == ApiDumpFormat::Binary;
+        size_t current = 0;
+        bool frame_ended = false;
+
+        while (true) {
+            const bool stopping = stop.load(std::memory_order_acquire);
+            const uint64_t version = queues_version.load(std::memory_order_acquire);
+            if (version != active_version) {
+                std::lock_guard<std::mutex> lg(queues_mutex);
+                active = queues;
+                active_version = version;
+                current = 0;
+            }
+
+            // Consecutive records usually come from the same thread, so look at the queue the last
+            // record came from first.
+            bool found = false;
+            for (size_t i = 0; i < active.size() && !found; ++i) {
+                const size_t index = (current + i) % active.size();
+                const ApiDumpRing::Header *header = active[index]->peek();
+                if (header != NULL && header->sequence == sequence) {
+                    const ApiDumpRecordKind kind = static_cast<ApiDumpRecordKind>(header->kind);
+                    if (kind == ApiDumpRecordKind::Frame) {
+                        frame_ended = true;
+                        ++frame;
+                    }
+                    batch += prefix(kind);
+                    ApiDumpWriteRecord(batch, reinterpret_cast<const char *>(header + 1), header->size, header->frame, frame,
+                                       binary);
+                    active[index]->pop(header);
+                    current = index;
+                    found = true;
+                }
+            }
+            if (found) {
+                ++sequence;
+                wakeBlockedProducers();
+                if (batch.size() >= BATCH_SIZE) writeBatch(batch, frame_ended);
+                continue;
+            }
+
+            // A record was committed but is not published yet.
+            if (sequence < next_sequence.load(std::memory_order_acquire)) {
+                waitForRecord(active, active_version, sequence);
+                continue;
+            }
+
+            writeBatch(batch, frame_ended);
+            if (stopping) break;
+            waitForRecord(active, active_version, sequence);
+        }
+    }
+
+    const uint64_t id;
+    const ApiDumpSettings &settings;
+    PrefixCallback prefix;
+    const uint64_t first_frame;
+
+    std::mutex queues_mutex;
+    std::vector<ApiDumpThreadQueue *> queues;
+    std::atomic<uint64_t> queues_version{0};
+
+    std::atomic<uint64_t> next_sequence{0};
+    std::atomic<uint64_t> dropped_records{0};
+
+    std::mutex wake_mutex;
+    std::condition_variable record_published;
+    std::condition_variable space_freed;
+    std::atomic<bool> writer_waiting{false};
+    std::atomic<uint32_t> blocked_producers{0};
+    std::atomic<bool> stop{false};
+    std::thread thread;
+};
+
+//======================================= Flight Recorder ========================================//
+
+// Keeps the binary records of the last frames in memory, and writes nothing while the application
+// runs. Each thread appends to its own buffer, and the records are numbered so that save() can put
+// them back in the order they were made. Frames beyond the frame count, or the oldest frames once
+// the records take more than the size limit, are dropped. The frame being recorded is always kept.
+// save() writes the kept frames out as a binary capture that starts with the frame marker of the
+// oldest frame. Signal handlers cannot write files, so with save_on_signal they only request a save,
+// which is then carried out by a background thread. Condition variables cannot be notified from a
+// signal handler, so the request is a byte written to a pipe that the thread sleeps reading.
+class ApiDumpFlightRecorder {
+   public:
+    ApiDumpFlightRecorder(size_t max_frames, size_t max_bytes, const std::string &filename, bool save_on_signal)
+        : id(nextId()), max_frames(max_frames), max_bytes(max_bytes > 0 ? max_bytes : SIZE_MAX), filename(filename) {
+#if !defined(_WIN32)
+        if (save_on_signal && pipe(save_pipe) == 0) {
+            fcntl(save_pipe[0], F_SETFD, FD_CLOEXEC);
+            fcntl(save_pipe[1], F_SETFD, FD_CLOEXEC);
+            thread = std::thread(&ApiDumpFlightRecorder::run, this);
+        }
+#endif
+    }
+
+    ~ApiDumpFlightRecorder() {
+#if !defined(_WIN32)
+        if (thread.joinable()) {
+            stop = true;
+            requestSave();
+            thread.join();
+            close(save_pipe[0]);
+            close(save_pipe[1]);
+        }
+#endif
+    }
+
+    // A call is kept with the frame it is appended in, which is the frame its record is made to name.
+    inline void append(ApiDumpRecordKind kind, const char *data, size_t size, const ApiDumpFrameField &field) {
+        ThreadBuffer &buffer = threadBuffer();
+        uint64_t frame;
+        uint64_t sequence;
+        if (kind == ApiDumpRecordKind::Frame) {
+            // The marker is numbered before its frame starts, so it comes before every record of the frame.
+            sequence = next_sequence.fetch_add(1, std::memory_order_relaxed);
+            frame = current_frame.fetch_add(1, std::memory_order_acq_rel) + 1;
+            if (frame >= max_frames) dropFramesBefore(frame - max_frames + 1);
+        } else {
+            frame = current_frame.load(std::memory_order_acquire);
+            sequence = next_sequence.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        const RecordHeader header = {sequence, size};
+        const size_t record_size = sizeof(header) + size;
+        {
+            std::lock_guard<std::mutex> lock(buffer.mutex);
+            if (buffer.chunks.empty() || buffer.chunks.back().frame != frame) {
+                // The buffer of this thread's oldest dropped frame is reused for the new frame.
+                std::vector<char> chunk;
+                const uint64_t oldest = oldest_frame.load(std::memory_order_relaxed);
+                while (!buffer.chunks.empty() && buffer.chunks.front().frame < oldest) {
+                    total_bytes.fetch_sub(buffer.chunks.front().data.size(), std::memory_order_relaxed);
+                    chunk.swap(buffer.chunks.front().data);
+                    buffer.chunks.pop_front();
+                }
+                chunk.clear();
+                buffer.chunks.push_back(Chunk{frame, std::move(chunk)});
+            }
+            std::vector<char> &chunk = buffer.chunks.back().data;
+            chunk.insert(chunk.end(), reinterpret_cast<const char *>(&header), reinterpret_cast<const char *>(&header + 1));
+            const size_t record_start = chunk.size();
+            chunk.insert(chunk.end(), data, data + size);
+            if (field.end != 0 && field.frame != frame) memcpy(chunk.data() + record_start + field.start, &frame, sizeof(frame));
+        }
+        if (total_bytes.fetch_add(record_size, std::memory_order_relaxed) + record_size > max_bytes &&
+            oldest_frame.load(std::memory_order_relaxed) < frame)
+            trim(frame);
+    }
+
+#if !defined(_WIN32)
+    // Safe to call from a signal handler. Only valid with save_on_signal.
+    inline void requestSave() {
+        const char request = 0;
+        const ssize_t written = write(save_pipe[1], &request, 1);
+        (void)written;
+    }
+#endif
+
+    // The first save is written to the log file, later saves add their number before its extension.
+    // The kept records are copied out under each thread's lock, and written once no lock is held that
+    // append() could wait on.
+    inline void save() {
+        std::lock_guard<std::mutex> save_lock(save_mutex);
+        std::string path = filename;
+        if (save_count > 0) {
+            size_t extension = path.find_last_of('.');
+            const size_t last_slash = path.find_last_of("\\/");
+            if (extension == std::string::npos || (last_slash != std::string::npos && extension < last_slash))
+                extension = path.size();
+            path.insert(extension, "-" + std::to_string(save_count));
+        }
+        ++save_count;
+
+        std::vector<Chunk> chunks;
+        {
+            std::lock_guard<std::mutex> lock(buffers_mutex);
+            const uint64_t oldest = oldest_frame.load(std::memory_order_relaxed);
+            for (const std::shared_ptr<ThreadBuffer> &buffer : buffers) {
+                std::lock_guard<std::mutex> buffer_lock(buffer->mutex);
+                for (const Chunk &chunk : buffer->chunks) {
+                    if (chunk.frame >= oldest) chunks.push_back(chunk);
+                }
+            }
+        }
+
+        struct Record {
+            uint64_t frame;
+            uint64_t sequence;
+            const char *data;
+            size_t size;
+            bool operator<(const Record &other) const {
+                return frame != other.frame ? frame < other.frame : sequence < other.sequence;
+            }
+        };
+        std::vector<Record> records;
+        for (const Chunk &chunk : chunks) {
+            size_t offset = 0;
+            while (offset < chunk.data.size()) {
+                RecordHeader header;
+                memcpy(&header, chunk.data.data() + offset, sizeof(header));
+                offset += sizeof(header);
+                records.push_back(Record{chunk.frame, header.sequence, chunk.data.data() + offset, header.size});
+                offset += header.size;
+            }
+        }
+        std::sort(records.begin(), records.end());
+
+        std::ofstream file(path, std::ofstream::out | std::ofstream::trunc | std::ofstream::binary);
+        ApiDumpBinaryFileHeader header = {};
+        memcpy(header.magic, API_DUMP_BINARY_MAGIC, sizeof(header.magic));
+        header.version = API_DUMP_BINARY_VERSION;
+        header.header_version = VK_HEADER_VERSION;
+        header.pointer_size = sizeof(void *);
+        file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        for (const Record &record : records) file.write(record.data, record.size);
+    }
+
+   private:
+    struct RecordHeader {
+        uint64_t sequence;
+        uint64_t size;
+    };
+
+    // The records one thread made in one frame, each behind a RecordHeader.
+    struct Chunk {
+        uint64_t frame;
+        std::vector<char> data;
+    };
+
+    struct ThreadBuffer {
+        std::mutex mutex;
+        std::deque<Chunk> chunks;
+    };
+
+    // Holds on to the calling thread's buffer. The recorder keeps the buffer too, so the records of
+    // a thread that has exited are still saved.
+    struct ThreadBufferHandle {
+        uint64_t recorder = 0;
+        std::shared_ptr<ThreadBuffer> buffer;
+    };
+
+    static uint64_t nextId() {
+        static std::atomic<uint64_t> next_id{1};
+        return next_id.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    inline ThreadBuffer &threadBuffer() {
+        static thread_local ThreadBufferHandle handle;
+        if (handle.recorder != id) {
+            handle.recorder = id;
+            handle.buffer = std::make_shared<ThreadBuffer>();
+            std::lock_guard<std::mutex> lock(buffers_mutex);
+            buffers.push_back(handle.buffer);
+        }
+        return *handle.buffer;
+    }
+
+    inline void dropFramesBefore(uint64_t frame) {
+        uint64_t oldest = oldest_frame.load(std::memory_order_relaxed);
+        while (oldest < frame && !oldest_frame.compare_exchange_weak(oldest, frame, std::memory_order_relaxed)) {
+        }
+    }
+
+    // Drops the oldest frames until the rest fit in max_bytes, and frees the dropped frames of every
+    // thread, including those that have exited or are not recording. Skipped while a save or another
+    // trim holds the buffers.
+    void trim(uint64_t frame) {
+        std::unique_lock<std::mutex> lock(buffers_mutex, std::try_to_lock);
+        if (!lock.owns_lock()) return;
+
+        std::map<uint64_t, size_t> frame_bytes;
+        for (const std::shared_ptr<ThreadBuffer> &buffer : buffers) {
+            std::lock_guard<std::mutex> buffer_lock(buffer->mutex);
+            for (const Chunk &chunk : buffer->chunks) frame_bytes[chunk.frame] += chunk.data.size();
+        }
+        size_t total = 0;
+        for (const auto &entry : frame_bytes) total += entry.second;
+        uint64_t oldest = oldest_frame.load(std::memory_order_relaxed);
+        for (const auto &entry : frame_bytes) {
+            if (entry.first >= frame || (entry.first >= oldest && total <= max_bytes)) break;
+            if (entry.first >= oldest) oldest = entry.first + 1;
+            total -= entry.second;
+        }
+        dropFramesBefore(oldest);
+
+        oldest = oldest_frame.load(std::memory_order_relaxed);
+        for (auto buffer = buffers.begin(); buffer != buffers.end();) {
+            {
+                std::lock_guard<std::mutex> buffer_lock((*buffer)->mutex);
+                std::deque<Chunk> &chunks = (*buffer)->chunks;
+                while (!chunks.empty() && chunks.front().frame < oldest) {
+                    total_bytes.fetch_sub(chunks.front().data.size(), std::memory_order_relaxed);
+                    chunks.pop_front();
+                }
+            }
+            // Only the recorder holds the buffers of threads that have exited.
+            if (buffer->use_count() == 1 && (*buffer)->chunks.empty())
+                buffer = buffers.erase(buffer);
+            else
+                ++buffer;
+        }
+    }
+
+#if !defined(_WIN32)
+    // Saves once for every request, until the destructor's request finds stop set.
+    void run() {
+        char request;
+        while (true) {
+            const ssize_t count = read(save_pipe[0], &request, 1);
+            if (count < 0 && errno == EINTR) continue;
+            if (count <= 0 || stop) break;
+            save();
+        }
+    }
+#endif
+
+    const uint64_t id;
+    const size_t max_frames;
+    const size_t max_bytes;
+    const std::string filename;
+
+    std::mutex buffers_mutex;
+    std::vector<std::shared_ptr<ThreadBuffer> > buffers;
+    std::atomic<uint64_t> current_frame{0};
+    std::atomic<uint64_t> oldest_frame{0};
+    std::atomic<uint64_t> next_sequence{0};
+    std::atomic<size_t> total_bytes{0};
+
+    std::mutex save_mutex;
+    uint32_t save_count = 0;
+    int save_pipe[2] = {-1, -1};
+    std::atomic<bool> stop{false};
+    std::thread thread;
+};
+
+//===================================== Latency Statistics =======================================//
+
+// Per function histograms of how long the driver took for each call. Durations are sorted into
+// eight buckets per power of two, so the reported percentiles are within 12.5% of the true value,
+// and recording a call only takes a few relaxed atomic adds. A function's histogram is allocated
+// the first time it is called.
+class ApiDumpLatencyStats {
+   public:
+    ApiDumpLatencyStats(const std::string &filename) : filename(filename), function_count(api_dump_function_count()) {
+        histograms.reset(new std::atomic<Histogram *>[function_count]);
+        for (uint32_t i = 0; i < function_count; ++i) histograms[i].store(NULL, std::memory_order_relaxed);
+    }
+
+    ~ApiDumpLatencyStats() {
+        for (uint32_t i = 0; i < function_count; ++i) delete histograms[i].load(std::memory_order_relaxed);
+    }
+
+    inline void add(uint32_t function, uint64_t duration) {
+        if (function >= function_count) return;
+        Histogram *histogram = histograms[function].load(std::memory_order_acquire);
+        if (histogram == NULL) {
+            Histogram *created = new Histogram();
+            if (histograms[function].compare_exchange_strong(histogram, created, std::memory_order_acq_rel))
+                histogram = created;
+            else
+                delete created;
+        }
+        histogram->buckets[bucketIndex(duration)].fetch_add(1, std::memory_order_relaxed);
+        histogram->count.fetch_add(1, std::memory_order_relaxed);
+        histogram->total.fetch_add(duration, std::memory_order_relaxed);
+        uint64_t max = histogram->max.load(std::memory_order_relaxed);
+        while (duration > max && !histogram->max.compare_exchange_weak(max, duration, std::memory_order_relaxed)) {
+        }
+    }
+
+    // Writes one line per function that was called, the functions the driver spent the most time in first.
+    void write() const {
+        std::vector<std::pair<uint64_t, uint32_t> > order;
+        for (uint32_t i = 0; i < function_count; ++i) {
+            const Histogram *histogram = histograms[i].load(std::memory_order_acquire);
+            if (histogram != NULL) order.push_back(std::make_pair(histogram->total.load(std::memory_order_relaxed), i));
+        }
+        std::sort(order.rbegin(), order.rend());
+
+        std::ofstream file(filename, std::ofstream::out | std::ofstream::trunc);
+        file << "function,count,total_ns,mean_ns,p50_ns,p99_ns,max_ns\n";
+        for (const auto &entry : order) {
+            const Histogram &histogram = *histograms[entry.second].load(std::memory_order_acquire);
+            const uint64_t count = histogram.count.load(std::memory_order_relaxed);
+            const uint64_t max = histogram.max.load(std::memory_order_relaxed);
+            file << api_dump_function_name(entry.second) << "," << count << "," << entry.first << "," << entry.first / count
+                 << "," << std::min(percentile(histogram, count, 50), max) << ","
+                 << std::min(percentile(histogram, count, 99), max) << "," << max << "\n";
+        }
+    }
+
+   private:
+    static const int SUB_BUCKETS = 8;
+    static const int BUCKET_COUNT = (64 - 2) * SUB_BUCKETS;
+
+    struct Histogram {
+        Histogram() {
+            for (int i = 0; i < BUCKET_COUNT; ++i) buckets[i].store(0, std::memory_order_relaxed);
+            count.store(0, std::memory_order_relaxed);
+            total.store(0, std::memory_order_relaxed);
+            max.store(0, std::memory_order_relaxed);
+        }
+
+        std::atomic<uint64_t> buckets[BUCKET_COUNT];
+        std::atomic<uint64_t> count;
+        std::atomic<uint64_t> total;
+        std::atomic<uint64_t> max;
+    };
+
+    // Values below SUB_BUCKETS get a bucket each, larger values share a bucket with the values
+    // that agree with them in their three bits below the highest set bit.
+    inline static int bucketIndex(uint64_t value) {
+        if (value < SUB_BUCKETS) return static_cast<int>(value);
+        int exponent = 0;
+        for (int shift = 32; shift > 0; shift >>= 1) {
+            if ((value >> (exponent + shift)) != 0) exponent += shift;
+        }
+        return (exponent - 2) * SUB_BUCKETS + static_cast<int>((value >> (exponent - 3)) & (SUB_BUCKETS - 1));
+    }
+
+    // Largest value that falls into the bucket.
+    inline static uint64_t bucketLimit(int index) {
+        if (index < SUB_BUCKETS) return static_cast<uint64_t>(index);
+        const int exponent = index / SUB_BUCKETS + 2;
+        const uint64_t step = uint64_t(1) << (exponent - 3);
+        return (SUB_BUCKETS + static_cast<uint64_t>(index % SUB_BUCKETS)) * step + step - 1;
+    }
+
+    inline static uint64_t percentile(const Histogram &histogram, uint64_t count, uint64_t percent) {
+        const uint64_t rank = (count * percent + 99) / 100;
+        uint64_t seen = 0;
+        for (int i = 0; i < BUCKET_COUNT; ++i) {
+            seen += histogram.buckets[i].load(std::memory_order_relaxed);
+            if (seen >= rank) return bucketLimit(i);
+        }
+        return bucketLimit(BUCKET_COUNT - 1);
+    }
+
+    const std::string filename;
+    const uint32_t function_count;
+    std::unique_ptr<std::atomic<Histogram *>[]> histograms;
+};
+
+//========================================= Object Names =========================================//
+
+// Handles are pointers or counters, so their bits are mixed before they pick a slot in a table.
+inline uint64_t ApiDumpHashHandle(uint64_t handle) {
+    handle ^= handle >> 33;
+    handle *= 0xff51afd7ed558ccdULL;
+    handle ^= handle >> 33;
+    return handle;
+}
+
+// Hashes text a word at a time, continuing from the hash of the text before it.
+inline uint64_t ApiDumpHashText(uint64_t hash, const char *text, size_t size) {
+    const char *end = text + size;
+    for (; text + sizeof(uint64_t) <= end; text += sizeof(uint64_t)) {
+        uint64_t word;
+        memcpy(&word, text, sizeof(word));
+        hash = (hash ^ word) * 0x9e3779b97f4a7c15ULL;
+        hash ^= hash >> 32;
+    }
+    uint64_t tail = size;
+    memcpy(&tail, text, end - text);
+    return ApiDumpHashHandle(hash ^ tail);
+}
+
+// Names given to handles with vkSetDebugUtilsObjectNameEXT and vkDebugMarkerSetObjectNameEXT. Every
+// handle dumped looks up its name, so lookups take no lock and allocate nothing. Handles are kept in
+// an open addressing table that readers probe with atomic loads. Each distinct name is copied once
+// into large blocks and kept until exit, so a name that was looked up stays valid. Naming an object takes a lock. A full
+// table is replaced by a larger copy, and the old table is kept for readers that are still probing it.
+class ApiDumpObjectNames {
+   public:
+    ~ApiDumpObjectNames() {
+        for (Table *table : tables) delete table;
+    }
+
+    // Returns NULL if the object has no name.
+    inline const char *find(uint64_t object) const {
+        const Table *table = current.load(std::memory_order_acquire);
+        if (table == NULL || object == 0) return NULL;
+        for (size_t i = static_cast<size_t>(ApiDumpHashHandle(object)) & table->mask;; i = (i + 1) & table->mask) {
+            const uint64_t key = table->slots[i].object.load(std::memory_order_acquire);
+            if (key == object) return table->slots[i].name.load(std::memory_order_acquire);
+            if (key == 0) return NULL;
+        }
+    }
+
+    // Names the object, or removes its name if name is NULL.
+    void set(uint64_t object, const char *name) {
+        if (object == 0) return;
+        std::lock_guard<std::mutex> lg(mutex);
+        Table *table = current.load(std::memory_order_relaxed);
+        if (table != NULL) {
+            Slot &slot = findSlot(*table, object);
+            if (slot.object.load(std::memory_order_relaxed) == object) {
+                // Naming an object again with the name it already has is common, and stores nothing.
+                const char *new_name = name != NULL ? internName(name) : NULL;
+                if (slot.name.load(std::memory_order_relaxed) != new_name) slot.name.store(new_name, std::memory_order_release);
+                return;
+            }
+        }
+        if (name == NULL) return;
+
+        // Slots of removed names are only reclaimed when the table is copied.
+        if (table == NULL || (used + 1) * 4 > (table->mask + 1) * 3) table = grow(table);
+        Slot &slot = findSlot(*table, object);
+        slot.name.store(internName(name), std::memory_order_relaxed);
+        slot.object.store(object, std::memory_order_release);
+        ++used;
+    }
+
+   private:
+    struct Slot {
+        std::atomic<uint64_t> object{0};
+        std::atomic<const char *> name{NULL};
+    };
+
+    struct Table {
+        explicit Table(size_t capacity) : mask(capacity - 1), slots(new Slot[capacity]) {}
+        const size_t mask;
+        std::unique_ptr<Slot[]> slots;
+    };
+
+    static const size_t MIN_CAPACITY = 1024;
+    static const size_t NAME_BLOCK_SIZE = 64 * 1024;
+
+    // The object's slot, or the empty slot it would go in.
+    inline static Slot &findSlot(const Table &table, uint64_t object) {
+        for (size_t i = static_cast<size_t>(ApiDumpHashHandle(object)) & table.mask;; i = (i + 1) & table.mask) {
+            const uint64_t key = table.slots[i].object.load(std::memory_order_relaxed);
+            if (key == object || key == 0) return table.slots[i];
+        }
+    }
+
+    struct NameHash {
+        size_t operator()(const char *name) const { return static_cast<size_t>(ApiDumpHashText(0, name, strlen(name))); }
+    };
+
+    struct NameEqual {
+        bool operator()(const char *a, const char *b) const { return strcmp(a, b) == 0; }
+    };
+
+    // Applications often give many objects the same name, or rename objects back and forth, so each
+    // distinct name is only copied the first time it is seen.
+    const char *internName(const char *name) {
+        const auto interned = names.find(name);
+        if (interned != names.end()) return *interned;
+        const size_t size = strlen(name) + 1;
+        if (name_blocks.empty() || name_block_used + size > NAME_BLOCK_SIZE) {
+            name_blocks.emplace_back(new char[size > NAME_BLOCK_SIZE ? size : NAME_BLOCK_SIZE]);
+            name_block_used = 0;
+        }
+        char *copy = name_blocks.back().get() + name_block_used;
+        memcpy(copy, name, size);
+        name_block_used += size;
+        names.insert(copy);
+        return copy;
+    }
+
+    // Copies the named objects into a table with room for twice as many, and publishes it.
+    Table *grow(const Table *old_table) {
+        size_t named = 0;
+        const size_t old_capacity = old_table != NULL ? old_table->mask + 1 : 0;
+        for (size_t i = 0; i < old_capacity; ++i) {
+            if (old_table->slots[i].name.load(std::memory_order_relaxed) != NULL) ++named;
+        }
+        size_t capacity = MIN_CAPACITY;
+        while (capacity < (named + 1) * 2) capacity *= 2;
+
+        Table *table = new Table(capacity);
+        for (size_t i = 0; i < old_capacity; ++i) {
+            const char *name = old_table->slots[i].name.load(std::memory_order_relaxed);
+            if (name == NULL) continue;
+            const uint64_t object = old_table->slots[i].object.load(std::memory_order_relaxed);
+            Slot &slot = findSlot(*table, object);
+            slot.name.store(name, std::memory_order_relaxed);
+            slot.object.store(object, std::memory_order_relaxed);
+        }
+        used = named;
+        tables.push_back(table);
+        current.store(table, std::memory_order_release);
+        return table;
+    }
+
+    std::atomic<Table *> current{NULL};
+    std::mutex mutex;
+    size_t used = 0;
+    std::vector<Table *> tables;
+    std::vector<std::unique_ptr<char[]> > name_blocks;
+    size_t name_block_used = 0;
+    std::unordered_set<const char *, NameHash, NameEqual> names;
+};
+
+//===================================== Command Buffer Levels ====================================//
+
+// The level of every allocated command buffer, which decides how its VkCommandBufferBeginInfo is
+// dumped. Command buffers are spread over shards by their handle, and each shard is an open addressing
+// table behind its own lock, so threads recording from different pools rarely wait on each other.
+// Nothing is allocated once the tables are large enough. Each entry keeps the level next to the handle
+// and points to the record of its pool. Destroying a pool frees all of its command buffers at once by
+// moving the record to its next generation, and entries of an older generation count as free.
+class ApiDumpCommandBuffers {
+   public:
+    ~ApiDumpCommandBuffers() {
+        for (Pool *pool : pool_records) delete pool;
+    }
+
+    void add(VkDevice device, VkCommandPool cmd_pool, const VkCommandBuffer *cmd_buffers, uint32_t count,
+             VkCommandBufferLevel level) {
+        Pool *pool = findPool(device, cmd_pool);
+        const uint32_t generation = pool->generation.load(std::memory_order_acquire);
+        for (uint32_t i = 0; i < count; ++i) {
+            if (cmd_buffers[i] == VK_NULL_HANDLE) continue;
+            Shard &shard = shardOf(cmd_buffers[i]);
+            std::lock_guard<std::mutex> lg(shard.mutex);
+            Entry &entry = insertEntry(shard, cmd_buffers[i]);
+            entry.pool = pool;
+            entry.generation = generation;
+            entry.level = level;
+        }
+    }
+
+    void erase(const VkCommandBuffer *cmd_buffers, uint32_t count) {
+        for (uint32_t i = 0; i < count; ++i) {
+            if (cmd_buffers[i] == VK_NULL_HANDLE) continue;
+            Shard &shard = shardOf(cmd_buffers[i]);
+            std::lock_guard<std::mutex> lg(shard.mutex);
+            Entry *entry = findEntry(shard, cmd_buffers[i]);
+            if (entry != NULL) entry->pool = NULL;
+        }
+    }
+
+    void erasePool(VkDevice device, VkCommandPool cmd_pool) {
+        if (cmd_pool == VK_NULL_HANDLE) return;
+        std::lock_guard<std::mutex> lg(pool_mutex);
+        const auto pool_iter = pools.find(std::make_pair(device, cmd_pool));
+        if (pool_iter == pools.end()) return;
+        pool_iter->second->generation.fetch_add(1, std::memory_order_release);
+        free_pools.push_back(pool_iter->second);
+        pools.erase(pool_iter);
+    }
+
+    // Returns false if the command buffer is not allocated.
+    bool find(VkCommandBuffer cmd_buffer, VkCommandBufferLevel &level) {
+        Shard &shard = shardOf(cmd_buffer);
+        std::lock_guard<std::mutex> lg(shard.mutex);
+        const Entry *entry = findEntry(shard, cmd_buffer);
+        if (entry == NULL) return false;
+        level = entry->level;
+        return true;
+    }
+
+   private:
+    struct Pool {
+        std::atomic<uint32_t> generation{0};
+    };
+
+    struct Entry {
+        VkCommandBuffer cmd_buffer;
+        Pool *pool;
+        uint32_t generation;
+        VkCommandBufferLevel level;
+    };
+
+    struct Shard {
+        std::mutex mutex;
+        std::vector<Entry> entries;
+        size_t used = 0;
+    };
+
+    static const uint32_t SHARD_BITS = 4;
+    static const size_t MIN_CAPACITY = 64;
+
+    inline static bool isLive(const Entry &entry) {
+        return entry.pool != NULL && entry.pool->generation.load(std::memory_order_acquire) == entry.generation;
+    }
+
+    inline Shard &shardOf(VkCommandBuffer cmd_buffer) {
+        return shards[ApiDumpHashHandle(reinterpret_cast<uint64_t>(cmd_buffer)) >> (64 - SHARD_BITS)];
+    }
+
+    inline static size_t firstSlot(const Shard &shard, VkCommandBuffer cmd_buffer) {
+        return static_cast<size_t>(ApiDumpHashHandle(reinterpret_cast<uint64_t>(cmd_buffer))) & (shard.entries.size() - 1);
+    }
+
+    inline static Entry *findEntry(Shard &shard, VkCommandBuffer cmd_buffer) {
+        if (shard.entries.empty()) return NULL;
+        const size_t mask = shard.entries.size() - 1;
+        for (size_t i = firstSlot(shard, cmd_buffer);; i = (i + 1) & mask) {
+            Entry &entry = shard.entries[i];
+            if (entry.cmd_buffer == cmd_buffer) return isLive(entry) ? &entry : NULL;
+            if (entry.cmd_buffer == VK_NULL_HANDLE) return NULL;
+        }
+    }
+
+    // The command buffer's entry, a free entry it can take over, or the empty slot it goes in.
+    static Entry &insertEntry(Shard &shard, VkCommandBuffer cmd_buffer) {
+        if ((shard.used + 1) * 4 > shard.entries.size() * 3) rehash(shard);
+        const size_t mask = shard.entries.size() - 1;
+        Entry *free_entry = NULL;
+        for (size_t i = firstSlot(shard, cmd_buffer);; i = (i + 1) & mask) {
+            Entry &entry = shard.entries[i];
+            if (entry.cmd_buffer == cmd_buffer) return entry;
+            if (entry.cmd_buffer == VK_NULL_HANDLE) {
+                if (free_entry != NULL) {
+                    // The command buffer is not further along, so the free entry can hold it instead.
+                    free_entry->cmd_buffer = cmd_buffer;
+                    return *free_entry;
+                }
+                entry.cmd_buffer = cmd_buffer;
+                ++shard.used;
+                return entry;
+            }
+            if (free_entry == NULL && !isLive(entry)) free_entry = &entry;
+        }
+    }
+
+    // Moves the live entries into a table with room for at least twice as many.
+    static void rehash(Shard &shard) {
+        std::vector<Entry> old_entries;
+        old_entries.swap(shard.entries);
+        size_t live = 0;
+        for (const Entry &entry : old_entries) {
+            if (entry.cmd_buffer != VK_NULL_HANDLE && isLive(entry)) ++live;
+        }
+        size_t capacity = MIN_CAPACITY;
+        while (capacity < (live + 1) * 2) capacity *= 2;
+
+        shard.entries.assign(capacity, Entry{VK_NULL_HANDLE, NULL, 0, VK_COMMAND_BUFFER_LEVEL_PRIMARY});
+        shard.used = live;
+        const size_t mask = capacity - 1;
+        for (const Entry &entry : old_entries) {
+            if (entry.cmd_buffer == VK_NULL_HANDLE || !isLive(entry)) continue;
+            size_t i = firstSlot(shard, entry.cmd_buffer);
+            while (shard.entries[i].cmd_buffer != VK_NULL_HANDLE) i = (i + 1) & mask;
+            shard.entries[i] = entry;
+        }
+    }
+
+    // Pools are looked up once per allocation call. Records of destroyed pools are reused by new pools,
+    // whose command buffers start on the record's next generation.
+    Pool *findPool(VkDevice device, VkCommandPool cmd_pool) {
+        std::lock_guard<std::mutex> lg(pool_mutex);
+        Pool *&pool = pools[std::make_pair(device, cmd_pool)];
+        if (pool == NULL) {
+            if (!free_pools.empty()) {
+                pool = free_pools.back();
+                free_pools.pop_back();
+            } else {
+                pool = new Pool();
+                pool_records.push_back(pool);
+            }
+        }
+        return pool;
+    }
+
+    Shard shards[1 << SHARD_BITS];
+    std::mutex pool_mutex;
+    std::map<std::pair<VkDevice, VkCommandPool>, Pool *> pools;
+    std::vector<Pool *> free_pools;
+    std::vector<Pool *> pool_records;
+};
+
+//========================================= Delta Output =========================================//
+
+// Decides which api calls delta output writes in full. Calls are identified by a hash of their
+// text, and each frame is compared with the last frame that had output. Runs of calls that match
+// that frame, or that repeat the call before them, are written as a single back reference, like
+// "Frame 121, calls 14-380: same as frame 120, calls 14-380". References always name the calls that
+// were written in full, so they never have to be followed twice. Calls are numbered from 1 in each
+// frame, and calls written in full show their number. Only used under the output lock.
+class ApiDumpDeltaEncoder {
+   public:
+    explicit ApiDumpDeltaEncoder(uint64_t frame) : frame(frame) {}
+
+    // Returns true if the call has to be written in full. A run of calls the call ends is written to
+    // references first.
+    bool addCall(uint64_t key, ApiDumpFormatter &references) {
+        Call call = {key, frame, static_cast<uint32_t>(calls.size())};
+        if (run_length > 0 && extendRun(call)) {
+            calls.push_back(call);
+            return false;
+        }
+        endRun(references);
+        const bool new_run = startRun(call);
+        calls.push_back(call);
+        return !new_run;
+    }
+
+    // Number of the last call added in its frame.
+    inline uint32_t callNumber() const { return static_cast<uint32_t>(calls.size()); }
+
+    // Ends the current frame. A frame without output leaves the previous one to compare with.
+    void nextFrame(uint64_t next_frame, ApiDumpFormatter &references) {
+        endRun(references);
+        if (!calls.empty()) {
+            previous.swap(calls);
+            previous_index.clear();
+            for (uint32_t i = 0; i < previous.size(); ++i) previous_index.push_back(std::make_pair(previous[i].key, i));
+            std::sort(previous_index.begin(), previous_index.end());
+            calls.clear();
+        }
+        previous_next = 0;
+        frame = next_frame;
+    }
+
+    inline void finish(ApiDumpFormatter &references) { endRun(references); }
+
+   private:
+    // A call, and where it was written in full.
+    struct Call {
+        uint64_t key;
+        uint64_t origin_frame;
+        uint32_t origin_call;
+    };
+
+    // A run goes on while its calls were written in full one after the other, or all as the same call.
+    inline bool extendRun(Call &call) {
+        const Call *match = NULL;
+        if (run_from_previous) {
+            if (previous_next < previous.size() && previous[previous_next].key == call.key) match = &previous[previous_next];
+        } else if (calls.back().key == call.key) {
+            match = &calls.back();
+        }
+        if (match == NULL || match->origin_frame != run_origin_frame) return false;
+        if (match->origin_call == run_origin_call + run_length && (run_length == 1 || !run_repeats)) {
+            run_repeats = false;
+        } else if (match->origin_call == run_origin_call && (run_length == 1 || run_repeats)) {
+            run_repeats = true;
+        } else {
+            return false;
+        }
+        if (run_from_previous) ++previous_next;
+        call.origin_frame = match->origin_frame;
+        call.origin_call = match->origin_call;
+        ++run_length;
+        return true;
+    }
+
+    // Looks for the call in the previous frame, preferring the first match after the calls matched
+    // so far, and then checks whether it repeats the call before it.
+    inline bool startRun(Call &call) {
+        auto match = std::lower_bound(previous_index.begin(), previous_index.end(), std::make_pair(call.key, previous_next));
+        if (match == previous_index.end() || match->first != call.key) {
+            match = std::lower_bound(previous_index.begin(), previous_index.end(), std::make_pair(call.key, uint32_t(0)));
+        }
+        if (match != previous_index.end() && match->first == call.key) {
+            const Call &origin = previous[match->second];
+            call.origin_frame = origin.origin_frame;
+            call.origin_call = origin.origin_call;
+            run_from_previous = true;
+            previous_next = match->second + 1;
+        } else if (!calls.empty() && calls.back().key == call.key) {
+            call.origin_frame = calls.back().origin_frame;
+            call.origin_call = calls.back().origin_call;
+            run_from_previous = false;
+        } else {
+            return false;
+        }
+        run_first = static_cast<uint32_t>(calls.size());
+        run_origin_frame = call.origin_frame;
+        run_origin_call = call.origin_call;
+        run_length = 1;
+        run_repeats = false;
+        return true;
+    }
+
+    inline void endRun(ApiDumpFormatter &references) {
+        if (run_length == 0) return;
+        references << "Frame " << frame << ", ";
+        writeCalls(references, run_first, run_length);
+        references << ": same as frame " << run_origin_frame << ", ";
+        writeCalls(references, run_origin_call, run_repeats ? 1 : run_length);
+        references << "\n\n";
+        run_length = 0;
+    }
+
+    inline static void writeCalls(ApiDumpFormatter &references, uint32_t first, uint32_t count) {
+        if (count == 1)
+            references << "call " << first + 1;
+        else
+            references << "calls " << first + 1 << '-' << first + count;
+    }
+
+    uint64_t frame;
+    std::vector<Call> calls;
+    std::vector<Call> previous;
+    std::vector<std::pair<uint64_t, uint32_t> > previous_index;
+    uint32_t previous_next = 0;  // Where the previous frame is expected to continue
+
+    uint32_t run_first = 0;
+    uint32_t run_length = 0;
+    bool run_from_previous = false;  // Whether the run follows the previous frame, or repeats the call before it
+    bool run_repeats = false;        // Whether every call of the run was written in full as the same call
+    uint64_t run_origin_frame = 0;
+    uint32_t run_origin_call = 0;
+};
+
+//========================================= Call Summary =========================================//
+
+// Counts the calls made to each function, for summary mode. Every thread counts into its own array,
+// which only it writes, so counting a call is a load and a store without any lock or atomic add.
+// At the end of each frame the arrays are read and the calls made since the last frame are written
+// as one table row per function called, in CSV, or in JSON when the output format is json.
+class ApiDumpCallSummary {
+   public:
+    explicit ApiDumpCallSummary(bool json) : json(json), function_count(api_dump_function_count()), frame_counts(function_count, 0) {}
+
+    ~ApiDumpCallSummary() {
+        for (Counters *counters : thread_counters) delete counters;
+    }
+
+    inline void count(uint32_t function) {
+        static thread_local Counters *counters = NULL;
+        if (counters == NULL) counters = addThread();
+        std::atomic<uint64_t> &count = counters->counts[function];
+        count.store(count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+
+    // Writes the calls made during the frame that just ended. Frames without calls are left out.
+    void endFrame(uint64_t frame, ApiDumpFormatter &output) {
+        std::lock_guard<std::mutex> lg(mutex);
+        bool any_calls = false;
+        for (Counters *counters : thread_counters) {
+            for (uint32_t i = 0; i < function_count; ++i) {
+                const uint64_t count = counters->counts[i].load(std::memory_order_relaxed);
+                frame_counts[i] += count - counters->written[i];
+                counters->written[i] = count;
+                any_calls |= frame_counts[i] != 0;
+            }
+        }
+        if (!any_calls) return;
+
+        writeStart(output);
+        if (json) output << (first_row ? "" : ",\n") << "{\"frame\" : " << frame << ", \"calls\" : {";
+        bool first_function = true;
+        for (uint32_t i = 0; i < function_count; ++i) {
+            if (frame_counts[i] == 0) continue;
+            if (json)
+                output << (first_function ? "" : ", ") << '"' << api_dump_function_name(i) << "\" : " << frame_counts[i];
+            else
+                output << frame << ',' << api_dump_function_name(i) << ',' << frame_counts[i] << '\n';
+            first_function = false;
+            frame_counts[i] = 0;
+        }
+        if (json) output << "}}";
+        first_row = false;
+    }
+
+    // Writes the last frame and closes the table.
+    void finish(uint64_t frame, ApiDumpFormatter &output) {
+        endFrame(frame, output);
+        writeStart(output);
+        if (json) output << "\n]\n";
+    }
+
+   private:
+    struct Counters {
+        explicit Counters(uint32_t function_count) : counts(new std::atomic<uint64_t>[function_count]), written(function_count, 0) {
+            for (uint32_t i = 0; i < function_count; ++i) counts[i].store(0, std::memory_order_relaxed);
+        }
+
+        std::unique_ptr<std::atomic<uint64_t>[]> counts;
+        std::vector<uint64_t> written;  // Counts up to the last frame written, only used under the mutex
+    };
 
-    bool show_type;
-    int indent_size;
-    int name_size;
-    int type_size;
-    bool use_spaces;
-    bool show_shader;
-    bool show_thread_and_frame;
+    Counters *addThread() {
+        Counters *counters = new Counters(function_count);
+        std::lock_guard<std::mutex> lg(mutex);
+        thread_counters.push_back(counters);
+        return counters;
+    }
 
-    bool use_conditional_output = false;
-    ConditionalFrameOutput condFrameOutput;
+    inline void writeStart(ApiDumpFormatter &output) {
+        if (started) return;
+        output << (json ? "[\n" : "frame,function,count\n");
+        started = true;
+    }
 
-    static const char *const SPACES;
-    static const int MAX_SPACES = 144;
-    static const char *const TABS;
-    static const int MAX_TABS = 36;
+    const bool json;
+    const uint32_t function_count;
+    std::mutex mutex;
+    std::vector<Counters *> thread_counters;
+    std::vector<uint64_t> frame_counts;
+    bool started = false;
+    bool first_row = true;
 };
 
-const char *const ApiDumpSettings::SPACES =
-    "                                                                                                                          "
-    "    "
-    "                  ";
-const char *const ApiDumpSettings::TABS = "\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t";
+//====================================== Capture Triggers ========================================//
+
+// Polls for the trigger file on a background thread. The callback is told when the file appears,
+// and when it goes away again.
+class ApiDumpTriggerFileWatcher {
+   public:
+    ApiDumpTriggerFileWatcher(const std::string &path, std::function<void(bool)> set_trigger)
+        : path(path), set_trigger(set_trigger) {
+        // The first check is made before any call is dumped, so a file that already exists captures
+        // from the first call.
+        present = std::ifstream(path).good();
+        if (present) set_trigger(true);
+        thread = std::thread(&ApiDumpTriggerFileWatcher::run, this);
+    }
+
+    ~ApiDumpTriggerFileWatcher() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_one();
+        thread.join();
+    }
+
+   private:
+    void run() {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (!stopping) {
+            wake.wait_for(lock, std::chrono::milliseconds(100));
+            const bool exists = std::ifstream(path).good();
+            if (exists != present) {
+                present = exists;
+                set_trigger(present);
+            }
+        }
+    }
+
+    const std::string path;
+    std::function<void(bool)> set_trigger;
+    std::mutex mutex;
+    std::condition_variable wake;
+    bool stopping = false;
+    bool present = false;
+    std::thread thread;
+};
 
 class ApiDumpInstance {
    public:
-    inline ApiDumpInstance() : dump_settings(NULL), frame_count(0), thread_count(0) {
+    inline ApiDumpInstance() : dump_settings(NULL), async_writer(NULL), frame_count(0) {
         program_start = std::chrono::system_clock::now();
     }
 
     inline ~ApiDumpInstance() {
-        if (!first_func_call_on_frame) settings().closeFrameOutput();
+#if !defined(_WIN32)
+        restoreSignalHandlers();
+#endif
+        if (trigger_watcher != NULL) delete trigger_watcher;
+
+        if (latency_stats != NULL) {
+            latency_stats->write();
+            delete latency_stats;
+        }
+
+        if (flight_recorder != NULL) {
+            flight_recorder->save();
+            delete flight_recorder;
+        }
+
+        if (call_summary != NULL) {
+            std::lock_guard<std::recursive_mutex> lg(output_mutex);
+            ApiDumpFormatter summary_output;
+            call_summary->finish(frame_count, summary_output);
+            writeOutput(ApiDumpRecordKind::Frame, summary_output);
+            delete call_summary;
+        }
+
+        if (delta_encoder != NULL) {
+            std::lock_guard<std::recursive_mutex> lg(output_mutex);
+            delta_output.clear();
+            delta_encoder->finish(delta_output);
+            if (delta_output.size() > 0) writeOutput(ApiDumpRecordKind::Call, delta_output);
+            delete delta_encoder;
+        }
+
+        // Drain any records still queued for the writer thread before closing off the output.
+        if (async_writer != NULL) delete async_writer;
+
+        if (!first_func_call_on_frame && settings().dumpMode() == ApiDumpMode::Full) settings().closeFrameOutput();
 
         if (dump_settings != NULL) delete dump_settings;
     }
@@ -696,20 +3241,64 @@ class ApiDumpInstance {
     }
 
     inline void nextFrame() {
-        std::lock_guard<std::recursive_mutex> lg(frame_mutex);
-        ++frame_count;
-
-        should_dump_output = settings().isFrameInRange(frame_count);
-        settings().setupInterFrameOutputFormatting(frame_count);
-        first_func_call_on_frame = true;
+        std::lock_guard<std::recursive_mutex> output_lg(output_mutex);
+        // The settings open the frame the output starts on, so they are created before the count moves on.
+        const ApiDumpSettings &current_settings = settings();
+        ApiDumpFormatter frame_output;
+        uint64_t frame;
+        {
+            std::lock_guard<std::recursive_mutex> lg(frame_mutex);
+            frame = ++frame_count;
+
+            if (current_settings.isFrameInRange(frame_count))
+                output_state.fetch_and(~OUTPUT_FRAME_OUT_OF_RANGE, std::memory_order_relaxed);
+            else
+                output_state.fetch_or(OUTPUT_FRAME_OUT_OF_RANGE, std::memory_order_relaxed);
+            if (call_summary != NULL)
+                call_summary->endFrame(frame - 1, frame_output);
+            else
+                current_settings.setupInterFrameOutputFormatting(frame_output, frame_count, false,
+                                                                 current_time_since_start().count());
+        }
+        if (delta_encoder != NULL) {
+            delta_output.clear();
+            delta_encoder->nextFrame(frame, delta_output);
+            if (delta_output.size() > 0) writeOutput(ApiDumpRecordKind::Call, delta_output);
+        }
+        writeOutput(ApiDumpRecordKind::Frame, frame_output);
     }
 
+    // Checked by every entry point first. While capture is off this is a single relaxed load.
     inline bool shouldDumpOutput() {
-        if (!conditional_initialized) {
-            should_dump_output = settings().isFrameInRange(frame_count);
-            conditional_initialized = true;
-        }
-        return should_dump_output;
+        const uint32_t state = output_state.load(std::memory_order_relaxed);
+        if (state == 0) return true;
+        if ((state & OUTPUT_UNINITIALIZED) == 0) return false;
+        settings();
+        return output_state.load(std::memory_order_relaxed) == 0;
+    }
+
+    // Switches capture on or off from any thread, or from a signal handler.
+    inline void setTriggered(bool triggered) {
+        if (triggered)
+            output_state.fetch_and(~OUTPUT_TRIGGER_OFF, std::memory_order_relaxed);
+        else
+            output_state.fetch_or(OUTPUT_TRIGGER_OFF, std::memory_order_relaxed);
+    }
+
+    // Debug utils labels named like the trigger label toggle capture.
+    inline void checkTriggerLabel(const VkDebugUtilsLabelEXT *label_info) {
+        const std::string &trigger_label = settings().triggerLabel();
+        if (trigger_label.empty() || label_info == NULL || label_info->pLabelName == NULL) return;
+        if (trigger_label == label_info->pLabelName) output_state.fetch_xor(OUTPUT_TRIGGER_OFF, std::memory_order_relaxed);
+    }
+
+    // Checked by every entry point before anything else is done for the call. In summary mode the
+    // call is only counted.
+    inline bool shouldDumpFunction(uint32_t function) {
+        if (!settings().isFunctionEnabled(function)) return false;
+        if (call_summary == NULL) return true;
+        call_summary->count(function);
+        return false;
     }
 
     inline bool firstFunctionCallOnFrame() {
@@ -722,115 +3311,349 @@ class ApiDumpInstance {
 
     inline std::recursive_mutex *outputMutex() { return &output_mutex; }
 
+    // Starts a new record for the calling thread. Everything written to settings().stream() until
+    // the matching commitRecord() belongs to this call.
+    inline void beginRecord() {
+        ApiDumpRecord &record = ApiDumpSettings::threadRecord();
+        record.stream.clear();
+        record.open = true;
+        record.duration = 0;
+        record.header_end = 0;
+        record.duration_start = 0;
+        record.duration_end = 0;
+        record.frame = ApiDumpFrameField();
+    }
+
+    inline bool recordOpen() { return ApiDumpSettings::threadRecord().open; }
+
+    // Appends the calling thread's finished record to the output. This is the only place api call
+    // output takes the output lock, and with async output it is not taken at all.
+    inline void commitRecord() {
+        ApiDumpRecord &record = ApiDumpSettings::threadRecord();
+        if (!record.open) return;
+        record.open = false;
+        if (delta_encoder != NULL)
+            writeDeltaCall(record);
+        else
+            writeOutput(ApiDumpRecordKind::Call, record.stream, record.frame);
+    }
+
+    inline void setObjectName(uint64_t object, const char *name) { object_names.set(object, name); }
+
+    // Returns NULL if the object has no name. The name stays valid until exit.
+    inline const char *getObjectName(uint64_t object) const { return object_names.find(object); }
+
     inline const ApiDumpSettings &settings() {
-        if (dump_settings == NULL) dump_settings = new ApiDumpSettings();
+        if (dump_settings == NULL) {
+            dump_settings = new ApiDumpSettings();
+            if (dump_settings->asyncOutput()) {
+                async_writer = new ApiDumpAsyncWriter(
+                    *dump_settings, [this](ApiDumpRecordKind kind) { return recordPrefix(kind); }, frame_count);
+            }
+            if (dump_settings->flightRecorderFrames() > 0) {
+                flight_recorder = new ApiDumpFlightRecorder(
+                    dump_settings->flightRecorderFrames(), dump_settings->flightRecorderMaxSize(),
+                    dump_settings->flightRecorderFilename(), dump_settings->flightRecorderSignal() && !replaying);
+            }
+            if (!dump_settings->latencyFile().empty() && !replaying) {
+                latency_stats = new ApiDumpLatencyStats(dump_settings->latencyFile());
+            }
+            if (dump_settings->deltaOutput()) delta_encoder = new ApiDumpDeltaEncoder(frame_count);
+            if (dump_settings->dumpMode() == ApiDumpMode::Summary) {
+                call_summary = new ApiDumpCallSummary(dump_settings->format() == ApiDumpFormat::Json);
+            }
+            dump_settings->beginFrameOutput(frame_count);
+            startTriggers();
+        }
 
         return *dump_settings;
     }
 
-    uint64_t threadID() {
-        if (thread_id != UINT64_MAX) {
-            return thread_id;
+    // Threads are numbered in the order they first make an api call. The number is kept in a
+    // thread_local, so only a thread's first call touches the shared counter.
+    inline uint64_t threadID() {
+        if (replaying) {
+            return replay_thread;
         }
-        std::thread::id this_id = std::this_thread::get_id();
-        std::lock_guard<std::recursive_mutex> lg(thread_mutex);
+        static thread_local uint64_t thread_id = next_thread_id.fetch_add(1, std::memory_order_relaxed);
+        return thread_id;
+    }
 
-        for (uint32_t i = 0; i < thread_count; ++i) {
-            if (thread_map[i] == this_id) {
-                return i;
-            }
+    // Thread id the operating system knows the calling thread by, which is what perf, strace and
+    // debuggers show. It is looked up once per thread.
+    inline uint64_t osThreadID() {
+        if (replaying) {
+            return replay_os_thread;
         }
-
-        uint32_t new_index = thread_count;
-        thread_map[thread_count++] = this_id;
-        assert(thread_count < MAX_THREADS);
-        return new_index;
+        static thread_local uint64_t os_thread_id = currentOSThreadID();
+        return os_thread_id;
     }
 
     inline VkCommandBufferLevel getCmdBufferLevel(VkCommandBuffer cmd_buffer) {
-        std::lock_guard<std::recursive_mutex> lg(cmd_buffer_state_mutex);
-        const auto level_iter = cmd_buffer_level.find(cmd_buffer);
-        assert(level_iter != cmd_buffer_level.end());
-        const auto level = level_iter->second;
+        VkCommandBufferLevel level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        const bool allocated = cmd_buffers.find(cmd_buffer, level);
+        // A binary capture limited to an output range may not contain the allocation.
+        assert(allocated || replaying);
+        (void)allocated;
         return level;
     }
 
-    inline void eraseCmdBuffers(VkDevice device, VkCommandPool cmd_pool, std::vector<VkCommandBuffer> cmd_buffers) {
-        cmd_buffers.erase(std::remove(cmd_buffers.begin(), cmd_buffers.end(), nullptr), cmd_buffers.end());
-        if (!cmd_buffers.empty()) {
-            std::lock_guard<std::recursive_mutex> lg(cmd_buffer_state_mutex);
+    inline void eraseCmdBuffers(const VkCommandBuffer *cmd_buffer_array, uint32_t count) {
+        cmd_buffers.erase(cmd_buffer_array, count);
+    }
 
-            const auto pool_cmd_buffers_iter = cmd_buffer_pools.find(std::make_pair(device, cmd_pool));
-            assert(pool_cmd_buffers_iter != cmd_buffer_pools.end());
+    inline void addCmdBuffers(VkDevice device, VkCommandPool cmd_pool, const VkCommandBuffer *cmd_buffer_array, uint32_t count,
+                              VkCommandBufferLevel level) {
+        cmd_buffers.add(device, cmd_pool, cmd_buffer_array, count, level);
+    }
 
-            for (const auto cmd_buffer : cmd_buffers) {
-                pool_cmd_buffers_iter->second.erase(cmd_buffer);
+    inline void eraseCmdBufferPool(VkDevice device, VkCommandPool cmd_pool) { cmd_buffers.erasePool(device, cmd_pool); }
 
-                assert(cmd_buffer_level.count(cmd_buffer) > 0);
-                cmd_buffer_level.erase(cmd_buffer);
-            }
-        }
-    }
+    // vkapidump-convert replays the calls of a binary capture with the thread and time they were
+    // captured with.
+    inline void beginReplay() { replaying = true; }
 
-    inline void addCmdBuffers(VkDevice device, VkCommandPool cmd_pool, std::vector<VkCommandBuffer> cmd_buffers,
-                              VkCommandBufferLevel level) {
-        std::lock_guard<std::recursive_mutex> lg(cmd_buffer_state_mutex);
-        auto &pool_cmd_buffers = cmd_buffer_pools[std::make_pair(device, cmd_pool)];
-        pool_cmd_buffers.insert(cmd_buffers.begin(), cmd_buffers.end());
+    // A flight recorder capture starts on a later frame. Only valid before anything is converted.
+    inline void startAtFrame(uint64_t frame) {
+        assert(dump_settings == NULL);
+        std::lock_guard<std::recursive_mutex> lg(frame_mutex);
+        frame_count = frame;
+    }
 
-        for (const auto cmd_buffer : cmd_buffers) {
-            assert(cmd_buffer_level.count(cmd_buffer) == 0);
-            cmd_buffer_level[cmd_buffer] = level;
+    // Called with the result of every api call. The flight recorder is saved on the first lost device.
+    inline void checkResult(VkResult result) {
+        if (result == VK_ERROR_DEVICE_LOST && flight_recorder != NULL && !device_lost_saved.exchange(true)) {
+            flight_recorder->save();
         }
     }
 
-    inline void eraseCmdBufferPool(VkDevice device, VkCommandPool cmd_pool) {
-        if (cmd_pool != VK_NULL_HANDLE) {
-            std::lock_guard<std::recursive_mutex> lg(cmd_buffer_state_mutex);
+    inline void setReplayCallInfo(uint64_t thread, uint64_t os_thread, int64_t time, uint64_t duration) {
+        replay_thread = thread;
+        replay_os_thread = os_thread;
+        replay_time = std::chrono::microseconds(time);
+        replay_duration = duration;
+    }
 
-            const auto cmd_buffers_iter = cmd_buffer_pools.find(std::make_pair(device, cmd_pool));
-            if (cmd_buffers_iter != cmd_buffer_pools.end()) {
-                for (const auto cmd_buffer : cmd_buffers_iter->second) {
-                    assert(cmd_buffer_level.count(cmd_buffer) > 0);
-                    cmd_buffer_level.erase(cmd_buffer);
-                }
-                cmd_buffers_iter->second.clear();
-            }
-        }
+    // Called by every entry point right before it calls down the chain. Returns 0 if the call is not timed.
+    inline uint64_t beginCall() { return settings().measureCalls() ? steadyNanoseconds() : 0; }
+
+    // Called right after the call down the chain returns, with what the matching beginCall() returned.
+    inline void endCall(uint32_t function, uint64_t call_start) {
+        if (call_start == 0) return;
+        const uint64_t duration = steadyNanoseconds() - call_start;
+        ApiDumpSettings::threadRecord().duration = duration;
+        if (latency_stats != NULL) latency_stats->add(function, duration);
+    }
+
+    // Nanoseconds the driver took for the call being dumped on the calling thread.
+    inline uint64_t callDuration() {
+        if (replaying) return replay_duration;
+        return ApiDumpSettings::threadRecord().duration;
     }
 
     inline std::chrono::microseconds current_time_since_start() {
+        if (replaying) return replay_time;
         std::chrono::system_clock::time_point now = std::chrono::system_clock::now();
         return std::chrono::duration_cast<std::chrono::microseconds>(now - program_start);
     }
 
     static inline ApiDumpInstance &current() { return current_instance; }
 
-    std::unordered_map<uint64_t, std::string> object_name_map;
-
    private:
+    inline static uint64_t steadyNanoseconds() {
+        return static_cast<uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+    }
+
+    inline static uint64_t currentOSThreadID() {
+#if defined(_WIN32)
+        return GetCurrentThreadId();
+#elif defined(__linux__)
+        return static_cast<uint64_t>(syscall(SYS_gettid));
+#elif defined(__APPLE__)
+        uint64_t thread_id = 0;
+        pthread_threadid_np(NULL, &thread_id);
+        return thread_id;
+#else
+        return 0;
+#endif
+    }
+
+    // Capture starts off when a trigger is set up. Signals and the trigger file are runtime triggers
+    // of the application, so vkapidump-convert only follows trigger labels.
+    inline void startTriggers() {
+        const bool use_signals = !replaying && dump_settings->triggerSignals();
+        const bool use_file = !replaying && !dump_settings->triggerFile().empty();
+        uint32_t state = dump_settings->isFrameInRange(frame_count) ? 0 : OUTPUT_FRAME_OUT_OF_RANGE;
+        if (use_signals || use_file || !dump_settings->triggerLabel().empty()) state |= OUTPUT_TRIGGER_OFF;
+        output_state.store(state, std::memory_order_relaxed);
+
+#if !defined(_WIN32)
+        if (use_signals) {
+            installSignalHandler(SIGUSR1, handleTriggerSignal);
+            installSignalHandler(SIGUSR2, handleTriggerSignal);
+        } else if (flight_recorder != NULL && !replaying && dump_settings->flightRecorderSignal()) {
+            installSignalHandler(SIGUSR1, handleSaveSignal);
+        }
+#endif
+        if (use_file) {
+            trigger_watcher =
+                new ApiDumpTriggerFileWatcher(dump_settings->triggerFile(), [this](bool triggered) { setTriggered(triggered); });
+        }
+    }
+
+#if !defined(_WIN32)
+    // The application may use SIGUSR1 and SIGUSR2 too, so the handlers it had are kept, called after
+    // the layer's and put back when the instance is destroyed.
+    struct PreviousSignalHandler {
+        bool installed = false;
+        struct sigaction action;
+    };
+
+    static inline PreviousSignalHandler &previousSignalHandler(int signal_number) {
+        static PreviousSignalHandler previous[2];
+        return previous[signal_number == SIGUSR1 ? 0 : 1];
+    }
+
+    inline void installSignalHandler(int signal_number, void (*handler)(int, siginfo_t *, void *)) {
+        PreviousSignalHandler &previous = previousSignalHandler(signal_number);
+        struct sigaction action = {};
+        action.sa_sigaction = handler;
+        sigemptyset(&action.sa_mask);
+        action.sa_flags = SA_RESTART | SA_SIGINFO;
+        previous.installed = sigaction(signal_number, &action, &previous.action) == 0;
+    }
+
+    inline void restoreSignalHandlers() {
+        const int signal_numbers[] = {SIGUSR1, SIGUSR2};
+        for (const int signal_number : signal_numbers) {
+            PreviousSignalHandler &previous = previousSignalHandler(signal_number);
+            if (previous.installed) sigaction(signal_number, &previous.action, NULL);
+            previous.installed = false;
+        }
+    }
+
+    // The default action of both signals ends the process, which is what the layer's handler is
+    // there to prevent, so only handlers the application installed are called.
+    static void callPreviousSignalHandler(int signal_number, siginfo_t *info, void *context) {
+        const struct sigaction &previous = previousSignalHandler(signal_number).action;
+        if ((previous.sa_flags & SA_SIGINFO) != 0) {
+            if (previous.sa_sigaction != NULL) previous.sa_sigaction(signal_number, info, context);
+        } else if (previous.sa_handler != SIG_DFL && previous.sa_handler != SIG_IGN) {
+            previous.sa_handler(signal_number);
+        }
+    }
+
+    // SIGUSR1 starts capturing, SIGUSR2 stops it.
+    static void handleTriggerSignal(int signal_number, siginfo_t *info, void *context) {
+        current_instance.setTriggered(signal_number == SIGUSR1);
+        callPreviousSignalHandler(signal_number, info, context);
+    }
+
+    // With the flight recorder signal, SIGUSR1 saves the flight recorder.
+    static void handleSaveSignal(int signal_number, siginfo_t *info, void *context) {
+        current_instance.flight_recorder->requestSave();
+        callPreviousSignalHandler(signal_number, info, context);
+    }
+#endif
+
+    // A call is written in the frame the output is on when it is committed, which is not the frame
+    // its head named if another thread presented while it was in flight. The flight recorder and the
+    // async writer correct the frame in their own order, without the output lock.
+    inline void writeOutput(ApiDumpRecordKind kind, const ApiDumpFormatter &text,
+                            const ApiDumpFrameField &frame = ApiDumpFrameField()) {
+        if (flight_recorder != NULL) {
+            flight_recorder->append(kind, text.data(), text.size(), frame);
+            return;
+        }
+        if (async_writer != NULL) {
+            async_writer->push(kind, text.data(), text.size(), frame);
+            return;
+        }
+
+        std::lock_guard<std::recursive_mutex> lg(output_mutex);
+        std::ostream &output = settings().output();
+        output << recordPrefix(kind);
+        // nextFrame() holds the output lock while it moves the frame on and writes the frame's output.
+        ApiDumpWriteRecord(output, text.data(), text.size(), frame, frame_count, settings().format() == ApiDumpFormat::Binary);
+        if (settings().shouldFlush(kind == ApiDumpRecordKind::Frame)) output.flush();
+    }
+
+    // Delta output numbers and compares calls in output order, so it holds the output lock even with
+    // async output. Calls written in full get their number added to the line naming their thread.
+    inline void writeDeltaCall(const ApiDumpRecord &record) {
+        const char *text = record.stream.data();
+        const size_t size = record.stream.size();
+        const size_t key_end = record.duration_end != 0 ? record.duration_start : size;
+        const size_t key_resume = record.duration_end != 0 ? record.duration_end : size;
+        uint64_t key = ApiDumpHashHandle(threadID());
+        key = ApiDumpHashText(key, text + record.header_end, key_end - record.header_end);
+        key = ApiDumpHashText(key, text + key_resume, size - key_resume);
+
+        std::lock_guard<std::recursive_mutex> lg(output_mutex);
+        delta_output.clear();
+        if (delta_encoder->addCall(key, delta_output)) {
+            if (record.header_end >= 2) {
+                ApiDumpWriteRecord(delta_output, text, record.header_end - 2, record.frame, frame_count, false);
+                delta_output << ", Call " << delta_encoder->callNumber();
+                delta_output.write(text + record.header_end - 2, size - record.header_end + 2);
+            } else {
+                delta_output << "Call " << delta_encoder->callNumber() << ":\n";
+                delta_output.write(text, size);
+            }
+        }
+        if (delta_output.size() > 0) writeOutput(ApiDumpRecordKind::Call, delta_output);
+    }
+
+    // Called in output order, under the output lock or from the async writer thread.
+    inline const char *recordPrefix(ApiDumpRecordKind kind) {
+        if (kind == ApiDumpRecordKind::Frame) {
+            first_func_call_on_frame = true;
+            return "";
+        }
+        if (settings().format() != ApiDumpFormat::Json) return "";
+        if (firstFunctionCallOnFrame()) need_record_separator = false;
+        const bool need_separator = need_record_separator;
+        need_record_separator = true;
+        return need_separator ? ",\n" : "";
+    }
+
     static ApiDumpInstance current_instance;
 
     ApiDumpSettings *dump_settings;
+    ApiDumpAsyncWriter *async_writer;
     std::recursive_mutex output_mutex;
     std::recursive_mutex frame_mutex;
     uint64_t frame_count;
-
-    static const size_t MAX_THREADS = 513;
-    std::recursive_mutex thread_mutex;
-    std::thread::id thread_map[MAX_THREADS];
-    uint32_t thread_count;
-    uint64_t thread_id = UINT64_MAX;
-
-    std::recursive_mutex cmd_buffer_state_mutex;
-    std::map<std::pair<VkDevice, VkCommandPool>, std::unordered_set<VkCommandBuffer> > cmd_buffer_pools;
-    std::unordered_map<VkCommandBuffer, VkCommandBufferLevel> cmd_buffer_level;
-
-    bool conditional_initialized = false;
-    bool should_dump_output = true;
+    bool need_record_separator = false;
+
+    ApiDumpObjectNames object_names;
+
+    std::atomic<uint64_t> next_thread_id{0};
+
+    ApiDumpCommandBuffers cmd_buffers;
+
+    // Api calls are dumped while no bit is set.
+    static const uint32_t OUTPUT_FRAME_OUT_OF_RANGE = 1 << 0;
+    static const uint32_t OUTPUT_TRIGGER_OFF = 1 << 1;
+    static const uint32_t OUTPUT_UNINITIALIZED = 1 << 2;
+    std::atomic<uint32_t> output_state{OUTPUT_UNINITIALIZED};
+    ApiDumpTriggerFileWatcher *trigger_watcher = NULL;
+    ApiDumpFlightRecorder *flight_recorder = NULL;
+    ApiDumpLatencyStats *latency_stats = NULL;
+    ApiDumpDeltaEncoder *delta_encoder = NULL;
+    ApiDumpCallSummary *call_summary = NULL;
+    ApiDumpFormatter delta_output;
+    std::atomic<bool> device_lost_saved{false};
     bool first_func_call_on_frame = false;
 
     std::chrono::system_clock::time_point program_start;
+
+    bool replaying = false;
+    uint64_t replay_thread = 0;
+    uint64_t replay_os_thread = 0;
+    std::chrono::microseconds replay_time;
+    uint64_t replay_duration = 0;
 };
 
 // Utility to output an address.
@@ -852,10 +3675,33 @@ ApiDumpInstance ApiDumpInstance::current_instance;
 
 //==================================== Text Backend Helpers ======================================//
 
+// Writes the frame the call is made in, and marks where it is so it can be corrected if the call
+// is written out in a later frame.
+inline void dump_text_frame(ApiDumpInstance &dump_inst, const ApiDumpSettings &settings) {
+    ApiDumpRecord &record = ApiDumpSettings::threadRecord();
+    record.frame.frame = dump_inst.frameCount();
+    record.frame.start = static_cast<uint32_t>(settings.stream().size());
+    settings.stream() << record.frame.frame;
+    record.frame.end = static_cast<uint32_t>(settings.stream().size());
+}
+
+// Marks where the line naming the thread, frame and time of the call ends, for delta output.
+inline void dump_text_header_end(const ApiDumpSettings &settings) {
+    ApiDumpSettings::threadRecord().header_end = settings.stream().size();
+}
+
+// The duration differs from call to call, so delta output leaves it out when comparing calls.
+inline void dump_text_duration(ApiDumpInstance &dump_inst, const ApiDumpSettings &settings) {
+    ApiDumpRecord &record = ApiDumpSettings::threadRecord();
+    record.duration_start = settings.stream().size();
+    settings.stream() << " in " << dump_inst.callDuration() << " ns";
+    record.duration_end = settings.stream().size();
+}
+
 template <typename T, typename... Args>
 inline void dump_text_array(const T *array, size_t len, const ApiDumpSettings &settings, const char *type_string,
                             const char *child_type, const char *name, int indents,
-                            std::ostream &(*dump)(const T, const ApiDumpSettings &, int, Args... args), Args... args) {
+                            ApiDumpFormatter &(*dump)(const T, const ApiDumpSettings &, int, Args... args), Args... args) {
     settings.formatNameType(settings.stream(), indents, name, type_string);
     if (array == NULL) {
         settings.stream() << "NULL\n";
@@ -864,9 +3710,7 @@ inline void dump_text_array(const T *array, size_t len, const ApiDumpSettings &s
     OutputAddress(settings, array, false);
     settings.stream() << "\n";
     for (size_t i = 0; i < len && array != NULL; ++i) {
-        std::stringstream stream;
-        stream << name << '[' << i << ']';
-        std::string indexName = stream.str();
+        ApiDumpIndexName indexName(name, i);
         dump_text_value(array[i], settings, child_type, indexName.c_str(), indents + 1, dump, args...);
     }
 }
@@ -874,7 +3718,7 @@ inline void dump_text_array(const T *array, size_t len, const ApiDumpSettings &s
 template <typename T, typename... Args>
 inline void dump_text_array(const T *array, size_t len, const ApiDumpSettings &settings, const char *type_string,
                             const char *child_type, const char *name, int indents,
-                            std::ostream &(*dump)(const T &, const ApiDumpSettings &, int, Args... args), Args... args) {
+                            ApiDumpFormatter &(*dump)(const T &, const ApiDumpSettings &, int, Args... args), Args... args) {
     settings.formatNameType(settings.stream(), indents, name, type_string);
     if (array == NULL) {
         settings.stream() << "NULL\n";
@@ -883,84 +3727,25 @@ inline void dump_text_array(const T *array, size_t len, const ApiDumpSettings &s
     OutputAddress(settings, array, false);
     settings.stream() << "\n";
     for (size_t i = 0; i < len && array != NULL; ++i) {
-        std::stringstream stream;
-        stream << name << '[' << i << ']';
-        std::string indexName = stream.str();
+        ApiDumpIndexName indexName(name, i);
         dump_text_value(array[i], settings, child_type, indexName.c_str(), indents + 1, dump, args...);
     }
 }
 
-template <typename T, typename... Args>
-inline void dump_text_array_hex(const uint32_t *array, size_t len, const ApiDumpSettings &settings, const char *type_string,
-                                const char *child_type, const char *name, int indents,
-                                std::ostream &(*dump)(const T, const ApiDumpSettings &, int, Args... args), Args... args) {
-    settings.formatNameType(settings.stream(), indents, name, type_string);
-    if (array == NULL) {
-        settings.stream() << "NULL\n";
-        return;
-    }
-    OutputAddress(settings, array, false);
-    std::stringstream stream;
-    const uint8_t *arraybyte = reinterpret_cast<const uint8_t *>(array);
-    for (size_t i = 0; i < (len * 4) && array != NULL; ++i) {
-        stream << std::hex << std::setw(2) << std::setfill('0') << (int)arraybyte[i] << " ";
-        if (i % 32 == 31) {
-            stream << "\n";
-        }
-    }
-
-    if (settings.stream().rdbuf() == std::cout.rdbuf()) {
-        settings.stream() << "\n" << stream.str() << "\n";
-    } else {
-        static uint64_t shaderDumpIndex = 0;
-        std::stringstream shaderDumpFileName;
-        shaderDumpFileName << settings.directory() << "shader_" << shaderDumpIndex << ".hex";
-        settings.stream() << " (" << shaderDumpFileName.str() << ")\n";
-        ++shaderDumpIndex;
-        std::ofstream shaderDumpFile;
-        shaderDumpFile.open(shaderDumpFileName.str(), std::ofstream::out | std::ostream::trunc);
-        shaderDumpFile << stream.str() << "\n";
-        shaderDumpFile.close();
-    }
-}
-
-template <typename T, typename... Args>
-inline void dump_text_array_hex(const uint32_t *array, size_t len, const ApiDumpSettings &settings, const char *type_string,
-                                const char *child_type, const char *name, int indents,
-                                std::ostream &(*dump)(const T &, const ApiDumpSettings &, int, Args... args), Args... args) {
+inline void dump_text_shader(const uint32_t *code, size_t size, const ApiDumpSettings &settings, const char *type_string,
+                             const char *name, int indents) {
     settings.formatNameType(settings.stream(), indents, name, type_string);
-    if (array == NULL) {
+    if (code == NULL) {
         settings.stream() << "NULL\n";
         return;
     }
-    OutputAddress(settings, array, false);
-    std::stringstream stream;
-    const uint8_t *arraybyte = reinterpret_cast<const uint8_t *>(array);
-    for (size_t i = 0; i < (len * 4) && array != NULL; ++i) {
-        stream << std::hex << std::setw(2) << std::setfill('0') << (int)arraybyte[i] << " ";
-        if (i % 32 == 31) {
-            stream << "\n";
-        }
-    }
-
-    if (settings.stream().rdbuf() == std::cout.rdbuf()) {
-        settings.stream() << "\n" << stream.str() << "\n";
-    } else {
-        static uint64_t shaderDumpIndex = 0;
-        std::stringstream shaderDumpFileName;
-        shaderDumpFileName << settings.directory() << "shader_" << shaderDumpIndex << ".hex";
-        settings.stream() << " (" << shaderDumpFileName.str() << ")\n";
-        ++shaderDumpIndex;
-        std::ofstream shaderDumpFile;
-        shaderDumpFile.open(shaderDumpFileName.str(), std::ofstream::out | std::ostream::trunc);
-        shaderDumpFile << stream.str() << "\n";
-        shaderDumpFile.close();
-    }
+    OutputAddress(settings, code, false);
+    settings.stream() << " (" << settings.shaderFile(code, size) << ")\n";
 }
 
 template <typename T, typename... Args>
 inline void dump_text_pointer(const T *pointer, const ApiDumpSettings &settings, const char *type_string, const char *name,
-                              int indents, std::ostream &(*dump)(const T, const ApiDumpSettings &, int, Args... args),
+                              int indents, ApiDumpFormatter &(*dump)(const T, const ApiDumpSettings &, int, Args... args),
                               Args... args) {
     if (pointer == NULL) {
         settings.formatNameType(settings.stream(), indents, name, type_string);
@@ -972,7 +3757,7 @@ inline void dump_text_pointer(const T *pointer, const ApiDumpSettings &settings,
 
 template <typename T, typename... Args>
 inline void dump_text_pointer(const T *pointer, const ApiDumpSettings &settings, const char *type_string, const char *name,
-                              int indents, std::ostream &(*dump)(const T &, const ApiDumpSettings &, int, Args... args),
+                              int indents, ApiDumpFormatter &(*dump)(const T &, const ApiDumpSettings &, int, Args... args),
                               Args... args) {
     if (pointer == NULL) {
         settings.formatNameType(settings.stream(), indents, name, type_string);
@@ -984,14 +3769,14 @@ inline void dump_text_pointer(const T *pointer, const ApiDumpSettings &settings,
 
 template <typename T, typename... Args>
 inline void dump_text_value(const T object, const ApiDumpSettings &settings, const char *type_string, const char *name, int indents,
-                            std::ostream &(*dump)(const T, const ApiDumpSettings &, int, Args... args), Args... args) {
+                            ApiDumpFormatter &(*dump)(const T, const ApiDumpSettings &, int, Args... args), Args... args) {
     settings.formatNameType(settings.stream(), indents, name, type_string);
     dump(object, settings, indents, args...) << "\n";
 }
 
 template <typename T, typename... Args>
 inline void dump_text_value(const T &object, const ApiDumpSettings &settings, const char *type_string, const char *name,
-                            int indents, std::ostream &(*dump)(const T &, const ApiDumpSettings &, int, Args... args),
+                            int indents, ApiDumpFormatter &(*dump)(const T &, const ApiDumpSettings &, int, Args... args),
                             Args... args) {
     settings.formatNameType(settings.stream(), indents, name, type_string);
     dump(object, settings, indents, args...);
@@ -1003,7 +3788,7 @@ inline void dump_text_special(const char *text, const ApiDumpSettings &settings,
     settings.stream() << text << "\n";
 }
 
-inline bool dump_text_bitmaskOption(const std::string &option, std::ostream &stream, bool isFirst) {
+inline bool dump_text_bitmaskOption(const char *option, ApiDumpFormatter &stream, bool isFirst) {
     if (isFirst)
         stream << " (";
     else
@@ -1012,24 +3797,26 @@ inline bool dump_text_bitmaskOption(const std::string &option, std::ostream &str
     return false;
 }
 
-inline std::ostream &dump_text_cstring(const char *object, const ApiDumpSettings &settings, int indents) {
+inline ApiDumpFormatter &dump_text_cstring(const char *object, const ApiDumpSettings &settings, int indents) {
     if (object == NULL)
         return settings.stream() << "NULL";
     else
         return settings.stream() << "\"" << object << "\"";
 }
 
-inline std::ostream &dump_text_void(const void *object, const ApiDumpSettings &settings, int indents) {
+inline ApiDumpFormatter &dump_text_void(const void *object, const ApiDumpSettings &settings, int indents) {
     if (object == NULL) return settings.stream() << "NULL";
     OutputAddress(settings, object, false);
     return settings.stream();
 }
 
-inline std::ostream &dump_text_int(int object, const ApiDumpSettings &settings, int indents) { return settings.stream() << object; }
+inline ApiDumpFormatter &dump_text_int(int object, const ApiDumpSettings &settings, int indents) {
+    return settings.stream() << object;
+}
 
 template <typename T, typename... Args>
 inline void dump_text_pNext(const T *object, const ApiDumpSettings &settings, const char *type_string, int indents,
-                            std::ostream &(*dump)(const T &, const ApiDumpSettings &, int, Args... args), Args... args) {
+                            ApiDumpFormatter &(*dump)(const T &, const ApiDumpSettings &, int, Args... args), Args... args) {
     if (object == NULL)
         settings.stream() << "NULL";
     else if (settings.showAddress()) {
@@ -1041,7 +3828,7 @@ inline void dump_text_pNext(const T *object, const ApiDumpSettings &settings, co
 
 //==================================== Html Backend Helpers ======================================//
 
-inline std::ostream &dump_html_nametype(std::ostream &stream, bool showType, const char *name, const char *type) {
+inline ApiDumpFormatter &dump_html_nametype(ApiDumpFormatter &stream, bool showType, const char *name, const char *type) {
     stream << "<div class='var'>" << name << "</div>";
     if (showType) {
         stream << "<div class='type'>" << type << "</div>";
@@ -1052,7 +3839,7 @@ inline std::ostream &dump_html_nametype(std::ostream &stream, bool showType, con
 template <typename T, typename... Args>
 inline void dump_html_array(const T *array, size_t len, const ApiDumpSettings &settings, const char *type_string,
                             const char *child_type, const char *name, int indents,
-                            std::ostream &(*dump)(const T, const ApiDumpSettings &, int, Args... args), Args... args) {
+                            ApiDumpFormatter &(*dump)(const T, const ApiDumpSettings &, int, Args... args), Args... args) {
     if (array == NULL) {
         settings.stream() << "<details class='data'><summary>";
         dump_html_nametype(settings.stream(), settings.showType(), name, type_string);
@@ -1067,9 +3854,7 @@ inline void dump_html_array(const T *array, size_t len, const ApiDumpSettings &s
     settings.stream() << "\n";
     settings.stream() << "</div></summary>";
     for (size_t i = 0; i < len && array != NULL; ++i) {
-        std::stringstream stream;
-        stream << name << '[' << i << ']';
-        std::string indexName = stream.str();
+        ApiDumpIndexName indexName(name, i);
         dump_html_value(array[i], settings, child_type, indexName.c_str(), indents + 1, dump, args...);
     }
     settings.stream() << "</details>";
@@ -1078,7 +3863,7 @@ inline void dump_html_array(const T *array, size_t len, const ApiDumpSettings &s
 template <typename T, typename... Args>
 inline void dump_html_array(const T *array, size_t len, const ApiDumpSettings &settings, const char *type_string,
                             const char *child_type, const char *name, int indents,
-                            std::ostream &(*dump)(const T &, const ApiDumpSettings &, int, Args... args), Args... args) {
+                            ApiDumpFormatter &(*dump)(const T &, const ApiDumpSettings &, int, Args... args), Args... args) {
     if (array == NULL) {
         settings.stream() << "<details class='data'><summary>";
         dump_html_nametype(settings.stream(), settings.showType(), name, type_string);
@@ -1093,9 +3878,7 @@ inline void dump_html_array(const T *array, size_t len, const ApiDumpSettings &s
     settings.stream() << "\n";
     settings.stream() << "</div></summary>";
     for (size_t i = 0; i < len && array != NULL; ++i) {
-        std::stringstream stream;
-        stream << name << '[' << i << ']';
-        std::string indexName = stream.str();
+        ApiDumpIndexName indexName(name, i);
         dump_html_value(array[i], settings, child_type, indexName.c_str(), indents + 1, dump, args...);
     }
     settings.stream() << "</details>";
@@ -1103,7 +3886,7 @@ inline void dump_html_array(const T *array, size_t len, const ApiDumpSettings &s
 
 template <typename T, typename... Args>
 inline void dump_html_pointer(const T *pointer, const ApiDumpSettings &settings, const char *type_string, const char *name,
-                              int indents, std::ostream &(*dump)(const T, const ApiDumpSettings &, int, Args... args),
+                              int indents, ApiDumpFormatter &(*dump)(const T, const ApiDumpSettings &, int, Args... args),
                               Args... args) {
     if (pointer == NULL) {
         settings.stream() << "<details class='data'><summary>";
@@ -1116,7 +3899,7 @@ inline void dump_html_pointer(const T *pointer, const ApiDumpSettings &settings,
 
 template <typename T, typename... Args>
 inline void dump_html_pointer(const T *pointer, const ApiDumpSettings &settings, const char *type_string, const char *name,
-                              int indents, std::ostream &(*dump)(const T &, const ApiDumpSettings &, int, Args... args),
+                              int indents, ApiDumpFormatter &(*dump)(const T &, const ApiDumpSettings &, int, Args... args),
                               Args... args) {
     if (pointer == NULL) {
         settings.stream() << "<details class='data'><summary>";
@@ -1129,7 +3912,7 @@ inline void dump_html_pointer(const T *pointer, const ApiDumpSettings &settings,
 
 template <typename T, typename... Args>
 inline void dump_html_value(const T object, const ApiDumpSettings &settings, const char *type_string, const char *name, int indents,
-                            std::ostream &(*dump)(const T, const ApiDumpSettings &, int, Args... args), Args... args) {
+                            ApiDumpFormatter &(*dump)(const T, const ApiDumpSettings &, int, Args... args), Args... args) {
     settings.stream() << "<details class='data'><summary>";
     dump_html_nametype(settings.stream(), settings.showType(), name, type_string);
     dump(object, settings, indents, args...);
@@ -1138,7 +3921,7 @@ inline void dump_html_value(const T object, const ApiDumpSettings &settings, con
 
 template <typename T, typename... Args>
 inline void dump_html_value(const T &object, const ApiDumpSettings &settings, const char *type_string, const char *name,
-                            int indents, std::ostream &(*dump)(const T &, const ApiDumpSettings &, int, Args... args),
+                            int indents, ApiDumpFormatter &(*dump)(const T &, const ApiDumpSettings &, int, Args... args),
                             Args... args) {
     settings.stream() << "<details class='data'><summary>";
     dump_html_nametype(settings.stream(), settings.showType(), name, type_string);
@@ -1153,7 +3936,21 @@ inline void dump_html_special(const char *text, const ApiDumpSettings &settings,
     settings.stream() << "<div class='val'>" << text << "</div></summary></details>";
 }
 
-inline bool dump_html_bitmaskOption(const std::string &option, std::ostream &stream, bool isFirst) {
+inline void dump_html_shader(const uint32_t *code, size_t size, const ApiDumpSettings &settings, const char *type_string,
+                             const char *name, int indents) {
+    settings.stream() << "<details class='data'><summary>";
+    dump_html_nametype(settings.stream(), settings.showType(), name, type_string);
+    settings.stream() << "<div class='val'>";
+    if (code == NULL) {
+        settings.stream() << "NULL";
+    } else {
+        OutputAddress(settings, code, false);
+        settings.stream() << " (" << settings.shaderFile(code, size) << ")";
+    }
+    settings.stream() << "</div></summary></details>";
+}
+
+inline bool dump_html_bitmaskOption(const char *option, ApiDumpFormatter &stream, bool isFirst) {
     if (isFirst)
         stream << " (";
     else
@@ -1162,7 +3959,7 @@ inline bool dump_html_bitmaskOption(const std::string &option, std::ostream &str
     return false;
 }
 
-inline std::ostream &dump_html_cstring(const char *object, const ApiDumpSettings &settings, int indents) {
+inline ApiDumpFormatter &dump_html_cstring(const char *object, const ApiDumpSettings &settings, int indents) {
     settings.stream() << "<div class='val'>";
     if (object == NULL)
         settings.stream() << "NULL";
@@ -1171,13 +3968,13 @@ inline std::ostream &dump_html_cstring(const char *object, const ApiDumpSettings
     return settings.stream() << "</div>";
 }
 
-inline std::ostream &dump_html_void(const void *object, const ApiDumpSettings &settings, int indents) {
+inline ApiDumpFormatter &dump_html_void(const void *object, const ApiDumpSettings &settings, int indents) {
     settings.stream() << "<div class='val'>";
     OutputAddress(settings, object, false);
     return settings.stream() << "</div>";
 }
 
-inline std::ostream &dump_html_int(int object, const ApiDumpSettings &settings, int indents) {
+inline ApiDumpFormatter &dump_html_int(int object, const ApiDumpSettings &settings, int indents) {
     settings.stream() << "<div class='val'>";
     settings.stream() << object;
     return settings.stream() << "</div>";
@@ -1185,7 +3982,7 @@ inline std::ostream &dump_html_int(int object, const ApiDumpSettings &settings,
 
 template <typename T, typename... Args>
 inline void dump_html_pNext(const T *object, const ApiDumpSettings &settings, const char *type_string, int indents,
-                            std::ostream &(*dump)(const T &, const ApiDumpSettings &, int, Args... args), Args... args) {
+                            ApiDumpFormatter &(*dump)(const T &, const ApiDumpSettings &, int, Args... args), Args... args) {
     if (object == NULL) {
         settings.stream() << "<details class='data'><summary>";
         dump_html_nametype(settings.stream(), settings.showType(), "pNext", type_string);
@@ -1200,7 +3997,7 @@ inline void dump_html_pNext(const T *object, const ApiDumpSettings &settings, co
 template <typename T, typename... Args>
 inline void dump_json_array(const T *array, size_t len, const ApiDumpSettings &settings, const char *type_string,
                             const char *child_type, const char *name, int indents,
-                            std::ostream &(*dump)(const T, const ApiDumpSettings &, int, Args... args), Args... args) {
+                            ApiDumpFormatter &(*dump)(const T, const ApiDumpSettings &, int, Args... args), Args... args) {
     if (len == 0 || array == NULL) {
         settings.stream() << settings.indentation(indents) << "{\n";
         settings.stream() << settings.indentation(indents + 1) << "\"type\" : \"" << type_string << "\",\n";
@@ -1222,9 +4019,7 @@ inline void dump_json_array(const T *array, size_t len, const ApiDumpSettings &s
         settings.stream() << settings.indentation(indents + 1) << "\"elements\" :\n";
         settings.stream() << settings.indentation(indents + 1) << "[\n";
         for (size_t i = 0; i < len && array != NULL; ++i) {
-            std::stringstream stream;
-            stream << "[" << i << "]";
-            std::string indexName = stream.str();
+            ApiDumpIndexName indexName("", i);
             dump_json_value(array[i], &array[i], settings, child_type, indexName.c_str(), indents + 2, dump, args...);
             if (i < len - 1) settings.stream() << ',';
             settings.stream() << "\n";
@@ -1237,7 +4032,7 @@ inline void dump_json_array(const T *array, size_t len, const ApiDumpSettings &s
 template <typename T, typename... Args>
 inline void dump_json_array(const T *array, size_t len, const ApiDumpSettings &settings, const char *type_string,
                             const char *child_type, const char *name, int indents,
-                            std::ostream &(*dump)(const T &, const ApiDumpSettings &, int, Args... args), Args... args) {
+                            ApiDumpFormatter &(*dump)(const T &, const ApiDumpSettings &, int, Args... args), Args... args) {
     if (len == 0 || array == NULL) {
         settings.stream() << settings.indentation(indents) << "{\n";
         settings.stream() << settings.indentation(indents + 1) << "\"type\" : \"" << type_string << "\",\n";
@@ -1258,9 +4053,7 @@ inline void dump_json_array(const T *array, size_t len, const ApiDumpSettings &s
         settings.stream() << settings.indentation(indents + 1) << "\"elements\" :\n";
         settings.stream() << settings.indentation(indents + 1) << "[\n";
         for (size_t i = 0; i < len && array != NULL; ++i) {
-            std::stringstream stream;
-            stream << "[" << i << "]";
-            std::string indexName = stream.str();
+            ApiDumpIndexName indexName("", i);
             dump_json_value(array[i], &array[i], settings, child_type, indexName.c_str(), indents + 2, dump, args...);
             if (i < len - 1) settings.stream() << ',';
             settings.stream() << "\n";
@@ -1272,7 +4065,7 @@ inline void dump_json_array(const T *array, size_t len, const ApiDumpSettings &s
 
 template <typename T, typename... Args>
 inline void dump_json_pointer(const T *pointer, const ApiDumpSettings &settings, const char *type_string, const char *name,
-                              int indents, std::ostream &(*dump)(const T, const ApiDumpSettings &, int, Args... args),
+                              int indents, ApiDumpFormatter &(*dump)(const T, const ApiDumpSettings &, int, Args... args),
                               Args... args) {
     if (pointer == NULL) {
         settings.stream() << settings.indentation(indents) << "{\n";
@@ -1289,7 +4082,7 @@ inline void dump_json_pointer(const T *pointer, const ApiDumpSettings &settings,
 
 template <typename T, typename... Args>
 inline void dump_json_pointer(const T *pointer, const ApiDumpSettings &settings, const char *type_string, const char *name,
-                              int indents, std::ostream &(*dump)(const T &, const ApiDumpSettings &, int, Args... args),
+                              int indents, ApiDumpFormatter &(*dump)(const T &, const ApiDumpSettings &, int, Args... args),
                               Args... args) {
     if (pointer == NULL) {
         settings.stream() << settings.indentation(indents) << "{\n";
@@ -1310,7 +4103,7 @@ extern bool is_struct(const char *t);
 template <typename T, typename... Args>
 inline void dump_json_value(const T object, const void *pObject, const ApiDumpSettings &settings, const char *type_string,
                             const char *name, int indents,
-                            std::ostream &(*dump)(const T, const ApiDumpSettings &, int, Args... args), Args... args) {
+                            ApiDumpFormatter &(*dump)(const T, const ApiDumpSettings &, int, Args... args), Args... args) {
     bool isPnext = !strcmp(name, "pNext") | !strcmp(name, "pUserData");
     const char *star = (isPnext && !strstr(type_string, "void")) ? "*" : "";
     settings.stream() << settings.indentation(indents) << "{\n";
@@ -1339,7 +4132,7 @@ inline void dump_json_value(const T object, const void *pObject, const ApiDumpSe
 template <typename T, typename... Args>
 inline void dump_json_value(const T &object, const void *pObject, const ApiDumpSettings &settings, const char *type_string,
                             const char *name, int indents,
-                            std::ostream &(*dump)(const T &, const ApiDumpSettings &, int, Args... args), Args... args) {
+                            ApiDumpFormatter &(*dump)(const T &, const ApiDumpSettings &, int, Args... args), Args... args) {
     bool isPnext = !strcmp(name, "pNext") | !strcmp(name, "pUserData");
     const char *star = (isPnext && !strstr(type_string, "void")) ? "*" : "";
     settings.stream() << settings.indentation(indents) << "{\n";
@@ -1378,7 +4171,22 @@ inline void dump_json_special(const char *text, const ApiDumpSettings &settings,
     settings.stream() << settings.indentation(indents) << "}";
 }
 
-inline bool dump_json_bitmaskOption(const std::string &option, std::ostream &stream, bool isFirst) {
+inline void dump_json_shader(const uint32_t *code, size_t size, const ApiDumpSettings &settings, const char *type_string,
+                             const char *name, int indents) {
+    settings.stream() << settings.indentation(indents) << "{\n";
+    settings.stream() << settings.indentation(indents + 1) << "\"type\" : \"" << type_string << "\",\n";
+    settings.stream() << settings.indentation(indents + 1) << "\"name\" : \"" << name << "\",\n";
+    settings.stream() << settings.indentation(indents + 1) << "\"address\" : ";
+    OutputAddress(settings, code, true);
+    if (code != NULL) {
+        settings.stream() << ",\n";
+        settings.stream() << settings.indentation(indents + 1) << "\"value\" : ";
+        settings.stream() << "\"" << settings.shaderFile(code, size) << "\"";
+    }
+    settings.stream() << "\n" << settings.indentation(indents) << "}";
+}
+
+inline bool dump_json_bitmaskOption(const char *option, ApiDumpFormatter &stream, bool isFirst) {
     if (isFirst)
         stream << "(";
     else
@@ -1387,7 +4195,7 @@ inline bool dump_json_bitmaskOption(const std::string &option, std::ostream &str
     return false;
 }
 
-inline std::ostream &dump_json_cstring(const char *object, const ApiDumpSettings &settings, int indents) {
+inline ApiDumpFormatter &dump_json_cstring(const char *object, const ApiDumpSettings &settings, int indents) {
     if (object == NULL)
         settings.stream() << "\"\"";
     else
@@ -1395,13 +4203,13 @@ inline std::ostream &dump_json_cstring(const char *object, const ApiDumpSettings
     return settings.stream();
 }
 
-inline std::ostream &dump_json_void(const void *object, const ApiDumpSettings &settings, int indents) {
+inline ApiDumpFormatter &dump_json_void(const void *object, const ApiDumpSettings &settings, int indents) {
     OutputAddress(settings, object, true);
     settings.stream() << "\n";
     return settings.stream();
 }
 
-inline std::ostream &dump_json_int(int object, const ApiDumpSettings &settings, int indents) {
+inline ApiDumpFormatter &dump_json_int(int object, const ApiDumpSettings &settings, int indents) {
     settings.stream() << settings.indentation(indents) << "\"value\" : ";
     settings.stream() << '"' << object << "\"";
     return settings.stream();
@@ -1409,7 +4217,7 @@ inline std::ostream &dump_json_int(int object, const ApiDumpSettings &settings,
 
 template <typename T, typename... Args>
 inline void dump_json_pNext(const T *object, const ApiDumpSettings &settings, const char *type_string, int indents,
-                            std::ostream &(*dump)(const T, const ApiDumpSettings &, int, Args... args), Args... args) {
+                            ApiDumpFormatter &(*dump)(const T, const ApiDumpSettings &, int, Args... args), Args... args) {
     if (object == NULL) {
         settings.stream() << settings.indentation(indents) << "{\n";
         settings.stream() << settings.indentation(indents + 1) << "\"type\" : \"" << type_string << "*\",\n";
@@ -1427,7 +4235,7 @@ inline void dump_json_pNext(const T *object, const ApiDumpSettings &settings, co
 
 template <typename T, typename... Args>
 inline void dump_json_pNext(const T *object, const ApiDumpSettings &settings, const char *type_string, int indents,
-                            std::ostream &(*dump)(const T &, const ApiDumpSettings &, int, Args... args), Args... args) {
+                            ApiDumpFormatter &(*dump)(const T &, const ApiDumpSettings &, int, Args... args), Args... args) {
     if (object == NULL) {
         settings.stream() << settings.indentation(indents) << "{\n";
         settings.stream() << settings.indentation(indents + 1) << "\"type\" : \"" << type_string << "*\",\n";
@@ -1442,3 +4250,230 @@ inline void dump_json_pNext(const T *object, const ApiDumpSettings &settings, co
         dump_json_value(*object, object, settings, type_string, "pNext", indents, dump, args...);
     }
 }
+
+//=================================== Trace Backend Helpers ======================================//
+
+// Opens the trace event of an api call, up to its timestamp. Every event starts with the separator
+// from the event before it. Each thread gets its own track, numbered like the thread in the other
+// formats, or by its operating system id when that is shown.
+inline void dump_trace_event_head(ApiDumpInstance &dump_inst, const char *name, const char *phase) {
+    const ApiDumpSettings &settings(dump_inst.settings());
+    const uint64_t track = settings.showOSThreadID() ? dump_inst.osThreadID() : dump_inst.threadID();
+    settings.stream() << ",\n{\"name\" : \"" << name << "\", \"cat\" : \"vulkan\", \"ph\" : \"" << phase
+                      << "\", \"pid\" : 1, \"tid\" : " << track << ", \"ts\" : " << dump_inst.current_time_since_start().count();
+}
+
+// Trace durations are in microseconds, the nanoseconds measured are kept as decimals.
+inline void dump_trace_duration(const ApiDumpSettings &settings, uint64_t duration) {
+    char decimals[8];
+    snprintf(decimals, sizeof(decimals), ".%03u", static_cast<unsigned>(duration % 1000));
+    settings.stream() << duration / 1000 << decimals;
+}
+
+//=================================== Binary Backend Helpers =====================================//
+
+// Writes the raw values of an api call to a binary capture. Pointers are followed and the data they
+// point to is written after the value holding them, as a presence byte followed by an element count
+// and the elements.
+class ApiDumpBinaryWriter {
+   public:
+    explicit ApiDumpBinaryWriter(ApiDumpFormatter &stream) : stream(stream) {}
+
+    inline void writeBytes(const void *data, size_t size) { stream.write(static_cast<const char *>(data), size); }
+
+    template <typename T>
+    inline void writeValue(const T &value) {
+        writeBytes(&value, sizeof(T));
+    }
+
+    inline void writeAbsent() { writeValue<uint8_t>(0); }
+
+    inline void writePresent(uint64_t count) {
+        writeValue<uint8_t>(1);
+        writeValue<uint64_t>(count);
+    }
+
+    inline void writeCString(const char *string) {
+        if (string == NULL) {
+            writeAbsent();
+            return;
+        }
+        const uint64_t length = strlen(string);
+        writePresent(length);
+        writeBytes(string, length);
+    }
+
+    inline void writeCStringArray(const char *const *strings, uint64_t count) {
+        if (strings == NULL) {
+            writeAbsent();
+            return;
+        }
+        writePresent(count);
+        for (uint64_t i = 0; i < count; ++i) writeCString(strings[i]);
+    }
+
+    // Records start at the beginning of the calling thread's record stream, the size is filled in
+    // once the record is complete.
+    inline void beginRecord(uint32_t function, uint64_t thread, uint64_t os_thread, uint64_t frame, int64_t time) {
+        ApiDumpBinaryRecordHeader header = {};
+        header.function = function;
+        header.thread = thread;
+        header.os_thread = os_thread;
+        header.frame = frame;
+        header.time = time;
+        writeValue(header);
+
+        ApiDumpFrameField &field = ApiDumpSettings::threadRecord().frame;
+        field.frame = frame;
+        field.start = static_cast<uint32_t>(offsetof(ApiDumpBinaryRecordHeader, frame));
+        field.end = static_cast<uint32_t>(field.start + sizeof(header.frame));
+    }
+
+    // The duration is only known once the call has returned, so it is filled in along with the size.
+    inline void endRecord(uint64_t duration) {
+        const uint32_t size = static_cast<uint32_t>(stream.size());
+        memcpy(stream.data(), &size, sizeof(size));
+        memcpy(stream.data() + offsetof(ApiDumpBinaryRecordHeader, duration), &duration, sizeof(duration));
+    }
+
+   private:
+    ApiDumpFormatter &stream;
+};
+
+// Reads back the values written by ApiDumpBinaryWriter. Everything pointed to is allocated from the
+// reader, and lives as long as it does.
+class ApiDumpBinaryReader {
+   public:
+    ApiDumpBinaryReader(const char *data, size_t size) : data(data), size(size) {}
+
+    inline bool failed() const { return error; }
+    inline void fail() { error = true; }
+
+    inline void readBytes(void *destination, size_t count) {
+        if (count > size - position) {
+            error = true;
+            position = size;
+            memset(destination, 0, count);
+            return;
+        }
+        memcpy(destination, data + position, count);
+        position += count;
+    }
+
+    template <typename T>
+    inline void readValue(T &value) {
+        readBytes(&value, sizeof(T));
+    }
+
+    template <typename T>
+    inline T read() {
+        T value;
+        readValue(value);
+        return value;
+    }
+
+    // Returns the element count of the data that follows, or UINT64_MAX if the pointer was NULL.
+    inline uint64_t readPresence(size_t element_size) {
+        if (read<uint8_t>() == 0) return UINT64_MAX;
+        const uint64_t count = read<uint64_t>();
+        // Every element takes at least its raw size in the capture, so this catches corrupt counts
+        // before they turn into huge allocations.
+        if (element_size > 0 && count > (size - position) / element_size) {
+            error = true;
+            return UINT64_MAX;
+        }
+        return count;
+    }
+
+    template <typename T>
+    inline T *allocate(size_t count) {
+        const size_t bytes = std::max<size_t>(count * sizeof(T), 1);
+        allocations.emplace_back(new char[bytes]());
+        return reinterpret_cast<T *>(allocations.back().get());
+    }
+
+    inline const char *readCString() {
+        const uint64_t length = readPresence(1);
+        if (length == UINT64_MAX) return NULL;
+        char *string = allocate<char>(static_cast<size_t>(length) + 1);
+        readBytes(string, static_cast<size_t>(length));
+        return string;
+    }
+
+    inline const char *const *readCStringArray() {
+        const uint64_t count = readPresence(1);
+        if (count == UINT64_MAX) return NULL;
+        const char **strings = allocate<const char *>(static_cast<size_t>(count));
+        for (uint64_t i = 0; i < count; ++i) strings[i] = readCString();
+        return strings;
+    }
+
+   private:
+    const char *data;
+    size_t size;
+    size_t position = 0;
+    bool error = false;
+    std::vector<std::unique_ptr<char[]>> allocations;
+};
+
+template <typename T>
+inline void dump_binary_array(ApiDumpBinaryWriter &writer, const T *array, uint64_t len) {
+    if (array == NULL) {
+        writer.writeAbsent();
+        return;
+    }
+    writer.writePresent(len);
+    writer.writeBytes(array, static_cast<size_t>(len) * sizeof(T));
+}
+
+template <typename T, typename... Args>
+inline void dump_binary_array(ApiDumpBinaryWriter &writer, const T *array, uint64_t len,
+                              void (*pointers)(ApiDumpBinaryWriter &, const T &, Args... args), Args... args) {
+    if (array == NULL) {
+        writer.writeAbsent();
+        return;
+    }
+    writer.writePresent(len);
+    for (uint64_t i = 0; i < len; ++i) {
+        writer.writeValue(array[i]);
+        pointers(writer, array[i], args...);
+    }
+}
+
+template <typename T>
+inline void dump_binary_pointer(ApiDumpBinaryWriter &writer, const T *pointer) {
+    dump_binary_array(writer, pointer, 1);
+}
+
+template <typename T, typename... Args>
+inline void dump_binary_pointer(ApiDumpBinaryWriter &writer, const T *pointer,
+                                void (*pointers)(ApiDumpBinaryWriter &, const T &, Args... args), Args... args) {
+    dump_binary_array(writer, pointer, 1, pointers, args...);
+}
+
+// Fixed size arrays are part of the raw value of their struct, only what they point to is written.
+template <typename T, typename... Args>
+inline void dump_binary_fixed_array(ApiDumpBinaryWriter &writer, const T *array, uint64_t len,
+                                    void (*pointers)(ApiDumpBinaryWriter &, const T &, Args... args), Args... args) {
+    for (uint64_t i = 0; i < len; ++i) pointers(writer, array[i], args...);
+}
+
+// extra_elements pads the allocation for dump functions that read past the captured elements.
+template <typename T>
+inline T *read_binary_array(ApiDumpBinaryReader &reader, void (*pointers)(ApiDumpBinaryReader &, T &),
+                            uint64_t extra_elements = 0) {
+    const uint64_t count = reader.readPresence(sizeof(T));
+    if (count == UINT64_MAX) return NULL;
+    T *array = reader.allocate<T>(static_cast<size_t>(count + extra_elements));
+    for (uint64_t i = 0; i < count; ++i) {
+        reader.readValue(array[i]);
+        if (pointers != NULL) pointers(reader, array[i]);
+    }
+    return array;
+}
+
+template <typename T>
+inline void read_binary_fixed_array(ApiDumpBinaryReader &reader, T *array, uint64_t len,
+                                    void (*pointers)(ApiDumpBinaryReader &, T &)) {
+    for (uint64_t i = 0; i < len; ++i) pointers(reader, array[i]);
+}
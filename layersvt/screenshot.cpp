@@ -25,12 +25,19 @@
 #include <stdlib.h>
 #include <string.h>
 #include <assert.h>
+#include <limits.h>
 #include <unordered_map>
 #include <iostream>
 #include <algorithm>
 #include <map>
 #include <set>
 #include <vector>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <atomic>
 #include <fstream>
 
 using namespace std;
@@ -42,6 +49,11 @@ using namespace std;
 #include "vk_layer_utils.h"
 
 #include "screenshot_parsing.h"
+#include "screenshot_encoder.h"
+#include "screenshot_hash.h"
+#ifdef SCREENSHOT_CONVERT_COMP_GENERATED
+#include "screenshot_convert_comp.spv.h"
+#endif
 
 #ifdef ANDROID
 
@@ -52,16 +64,34 @@ const char *env_var_frames = "debug.vulkan.screenshot";
 const char *env_var_old = env_var_frames;
 const char *env_var_format = "debug.vulkan.screenshot.format";
 const char *env_var_dir = "debug.vulkan.screenshot.dir";
+const char *env_var_readback = "debug.vulkan.screenshot.readback";
+const char *env_var_file_format = "debug.vulkan.screenshot.file_format";
+const char *env_var_scale = "debug.vulkan.screenshot.scale";
+const char *env_var_hash = "debug.vulkan.screenshot.hash";
+const char *env_var_hash_manifest = "debug.vulkan.screenshot.hash_manifest";
+const char *env_var_golden_manifest = "debug.vulkan.screenshot.golden_manifest";
 #else  // Linux or Windows
 const char *env_var_old = "_VK_SCREENSHOT";
 const char *env_var_frames = "VK_SCREENSHOT_FRAMES";
 const char *env_var_format = "VK_SCREENSHOT_FORMAT";
 const char *env_var_dir = "VK_SCREENSHOT_DIR";
+const char *env_var_readback = "VK_SCREENSHOT_READBACK";
+const char *env_var_file_format = "VK_SCREENSHOT_FILE_FORMAT";
+const char *env_var_scale = "VK_SCREENSHOT_SCALE";
+const char *env_var_hash = "VK_SCREENSHOT_HASH";
+const char *env_var_hash_manifest = "VK_SCREENSHOT_HASH_MANIFEST";
+const char *env_var_golden_manifest = "VK_SCREENSHOT_GOLDEN_MANIFEST";
 #endif
 
 const char *settings_option_frames = "lunarg_screenshot.frames";
 const char *settings_option_format = "lunarg_screenshot.format";
 const char *settings_option_dir = "lunarg_screenshot.dir";
+const char *settings_option_readback = "lunarg_screenshot.readback";
+const char *settings_option_file_format = "lunarg_screenshot.file_format";
+const char *settings_option_scale = "lunarg_screenshot.scale";
+const char *settings_option_hash = "lunarg_screenshot.hash";
+const char *settings_option_hash_manifest = "lunarg_screenshot.hash_manifest";
+const char *settings_option_golden_manifest = "lunarg_screenshot.golden_manifest";
 
 #ifdef ANDROID
 
@@ -112,13 +142,14 @@ static inline void local_free_getenv(const char *val) { free((void *)val); }
 
 namespace screenshot {
 
-static int globalLockInitialized = 0;
-static loader_platform_thread_mutex globalLock;
-
 const char *vk_screenshot_dir = nullptr;
 bool vk_screenshot_dir_used_env_var = false;
 
 bool printFormatWarning = true;
+bool printReadbackWarning = true;
+bool printComputeWarning = true;
+bool printScaleWarning = true;
+bool printManifestWarning = true;
 
 typedef enum colorSpaceFormat {
     UNDEFINED = 0,
@@ -133,59 +164,165 @@ typedef enum colorSpaceFormat {
 
 colorSpaceFormat userColorSpaceFormat = UNDEFINED;
 
-// unordered map: associates Vulkan dispatchable objects to a dispatch table
-typedef struct {
-    VkLayerDispatchTable *device_dispatch_table;
-    PFN_vkSetDeviceLoaderData pfn_dev_init;
-} DispatchMapStruct;
-static unordered_map<VkDevice, DispatchMapStruct *> dispatchMap;
-
-// unordered map: associates a swap chain with a device, image extent, format,
-// and list of images
-typedef struct {
-    VkDevice device;
+// How a capture is copied into memory the CPU can read: into a linear
+// image, into a tightly packed buffer with any channel reordering done
+// on the CPU, or through a compute shader that packs the pixels as RGB and
+// can downscale them on the GPU.  READBACK_AUTO uses the compute shader
+// when captures are downscaled, and otherwise a buffer whenever the CPU
+// can produce the output format.
+typedef enum readbackMode { READBACK_AUTO = 0, READBACK_IMAGE = 1, READBACK_BUFFER = 2, READBACK_COMPUTE = 3 } readbackMode;
+
+readbackMode userReadbackMode = READBACK_AUTO;
+
+// Captures are written at 1/userScale of the swapchain's width and height.
+uint32_t userScale = 1;
+
+FileFormat userFileFormat = FILE_FORMAT_PPM;
+
+// In hash mode each captured frame is hashed instead of written, and a
+// "frame,hash" line is appended to the hash manifest.  HASH_PERCEPTUAL adds a
+// perceptual hash to each line, which lets frames that differ by no more than
+// perceptualHashTolerance bits of it match the golden manifest.  A frame is
+// only written when a golden manifest is supplied and it has no matching
+// line there.
+typedef enum hashMode { HASH_NONE = 0, HASH_CONTENT = 1, HASH_PERCEPTUAL = 2 } hashMode;
+
+hashMode userHashMode = HASH_NONE;
+static const uint32_t perceptualHashTolerance = 4;
+
+// The manifest is written by the capture writers, guarded by manifestLock.
+// It is truncated when it is first opened and appended to if it is opened
+// again after the last device is destroyed.
+static std::mutex manifestLock;
+static string hashManifestPath;
+static FILE *hashManifestFile = NULL;
+static bool hashManifestStarted = false;
+static bool goldenManifestSupplied = false;
+static unordered_map<string, FrameHash> goldenManifest;
+
+struct CapturePool;
+
+// A swapchain's image extent and format, its images, and the staging
+// resources used to capture them.  Swapchains rarely have more than a few
+// images, so their handles are stored in the struct itself, and only the
+// images after the first maxInlineSwapchainImages go in overflowImages.
+static const uint32_t maxInlineSwapchainImages = 8;
+struct SwapchainData {
     VkExtent2D imageExtent;
     VkFormat format;
-    VkImage *imageList;
-} SwapchainMapStruct;
-static unordered_map<VkSwapchainKHR, SwapchainMapStruct *> swapchainMap;
+    uint32_t imageCount;
+    VkImage images[maxInlineSwapchainImages];
+    vector<VkImage> overflowImages;
+    CapturePool *capturePool;
+
+    VkImage getImage(uint32_t index) const {
+        return index < maxInlineSwapchainImages ? images[index] : overflowImages[index - maxInlineSwapchainImages];
+    }
+};
 
-// unordered map: associates an image with a device, image extent, and format
-typedef struct {
+// Per device state.  A device's queues and the command buffers allocated
+// from it share its dispatch key, so the state of the device any of them
+// belongs to is found with getDeviceData().
+struct DeviceData {
     VkDevice device;
-    VkExtent2D imageExtent;
-    VkFormat format;
-} ImageMapStruct;
-static unordered_map<VkImage, ImageMapStruct *> imageMap;
-
-// unordered map: associates a device with per device info -
-//   wsi capability
-//   set of queues created for this device
-//   queue to queueFamilyIndex map
-//   physical device
-typedef struct {
-    bool wsi_enabled;
-    set<VkQueue> queues;
-    unordered_map<VkQueue, uint32_t> queueIndexMap;
     VkPhysicalDevice physicalDevice;
-} DeviceMapStruct;
-static unordered_map<VkDevice, DeviceMapStruct *> deviceMap;
+    VkLayerDispatchTable dispatchTable;
+    PFN_vkSetDeviceLoaderData pfn_dev_init;
+    bool wsi_enabled;
+    vector<VkQueueFamilyProperties> queueFamilyProperties;
+
+    // Guards queueFamilyIndices and swapchains.  It is taken when they
+    // change and on frames that are captured, never on other presents.
+    std::mutex lock;
+    unordered_map<VkQueue, uint32_t> queueFamilyIndices;
+    unordered_map<VkSwapchainKHR, SwapchainData> swapchains;
+};
 
-// unordered map: associates a physical device with an instance
-typedef struct {
-    VkInstance instance;
-} PhysDeviceMapStruct;
-static unordered_map<VkPhysicalDevice, PhysDeviceMapStruct *> physDeviceMap;
+// Instances and devices keyed by their dispatch key.  A physical device has
+// the same dispatch key as its instance.  instanceMap is only used when a
+// device is created, and is guarded by layerDataLock.
+//
+// Every hooked device call looks its device up, so the device map is never
+// changed in place.  CreateDevice and DestroyDevice publish a changed copy
+// of it under layerDataLock, and a lookup only loads the current copy.  The
+// copies a lookup may still be reading are kept until the last device is
+// destroyed, when no call can be looking a device up.
+typedef unordered_map<void *, DeviceData *> DeviceDataMap;
+static unordered_map<void *, VkInstance> instanceMap;
+static std::atomic<const DeviceDataMap *> deviceDataMap(new DeviceDataMap());
+static std::atomic<uint64_t> deviceDataMapVersion(0);
+static vector<const DeviceDataMap *> retiredDeviceDataMaps;
+static std::mutex layerDataLock;
+
+static DeviceData *getDeviceData(const void *object) {
+    const DeviceDataMap *map = deviceDataMap.load(std::memory_order_acquire);
+    auto it = map->find(get_dispatch_key(object));
+    return it == map->end() ? NULL : it->second;
+}
+
+// A thread usually presents to the same queue every frame, so the device it
+// presented to last is kept until the device map changes, and a present that
+// is not captured does not look its device up.
+static DeviceData *getPresentDeviceData(VkQueue queue) {
+    struct PresentDevice {
+        uint64_t version = UINT64_MAX;
+        void *key = NULL;
+        DeviceData *deviceData = NULL;
+    };
+    static thread_local PresentDevice last;
+    uint64_t const version = deviceDataMapVersion.load(std::memory_order_acquire);
+    void *const key = get_dispatch_key(queue);
+    if (last.version != version || last.key != key) {
+        last.deviceData = getDeviceData(queue);
+        last.version = version;
+        last.key = key;
+    }
+    return last.deviceData;
+}
+
+// Publish a copy of the device map with key set to deviceData, or erased
+// when deviceData is NULL.  Called with layerDataLock held.
+static void updateDeviceDataMap(void *key, DeviceData *deviceData) {
+    const DeviceDataMap *current = deviceDataMap.load(std::memory_order_relaxed);
+    DeviceDataMap *updated = new DeviceDataMap(*current);
+    if (deviceData) {
+        (*updated)[key] = deviceData;
+    } else {
+        updated->erase(key);
+    }
+    deviceDataMap.store(updated, std::memory_order_release);
+    deviceDataMapVersion.fetch_add(1, std::memory_order_release);
+
+    retiredDeviceDataMaps.push_back(current);
+    if (updated->empty()) {
+        for (auto map : retiredDeviceDataMaps) delete map;
+        retiredDeviceDataMaps.clear();
+    }
+}
+
+// Guards screenshotFrames, screenShotFrameRange and the updates of
+// nextCaptureFrame.
+static std::mutex scheduleLock;
 
 // set: list of frames to take screenshots without duplication.
 static set<int> screenshotFrames;
 
 // Flag indicating we have received the frame list
-static bool screenshotFramesReceived = false;
+static std::atomic<bool> screenshotFramesReceived(false);
 
 // Screenshots will be generated from screenShotFrameRange's startFrame to startFrame+count-1 with skipped Interval in between.
 static FrameRange screenShotFrameRange = {false, 0, SCREEN_SHOT_FRAMES_UNLIMITED, SCREEN_SHOT_FRAMES_INTERVAL_DEFAULT};
 
+// Frames are numbered by QueuePresentKHR as they are presented.
+// nextCaptureFrame is the first frame not yet presented that is scheduled
+// for a capture, or noCaptureFrame once there are none left, so a present
+// that is not captured only compares its frame number to it.  It may lag
+// behind while a captured frame is being handled, which only makes the
+// presents in between look their frame up in the schedule.
+static const int noCaptureFrame = INT_MAX;
+static std::atomic<int> frameCounter(0);
+static std::atomic<int> nextCaptureFrame(noCaptureFrame);
+
 // Get maximum frame number of the frame range
 // FrameRange* pFrameRange, the specified frame rang
 // return:
@@ -217,7 +354,7 @@ static bool isInScreenShotFrameRange(int frameNumber, FrameRange *pFrameRange, b
                 inRange = true;
             }
         } else {
-            inRange = true;
+            inRange = frameNumber >= pFrameRange->startFrame;
         }
         if (inRange) {
             screenShotFrame = (((frameNumber - pFrameRange->startFrame) % pFrameRange->interval) == 0);
@@ -278,6 +415,124 @@ void readScreenShotFormatENV(void) {
     }
 }
 
+// Get users request for how captures are read back
+void readScreenShotReadback(void) {
+    const char *vk_screenshot_readback = getLayerOption(settings_option_readback);
+    const char *env_var = local_getenv(env_var_readback);
+
+    if (env_var != NULL) {
+        if (strlen(env_var) > 0) {
+            vk_screenshot_readback = env_var;
+        } else if (strlen(env_var) == 0) {
+            local_free_getenv(env_var);
+            env_var = NULL;
+        }
+    }
+
+    if (vk_screenshot_readback && *vk_screenshot_readback) {
+        if (strcmp(vk_screenshot_readback, "IMAGE") == 0 || strcmp(vk_screenshot_readback, "image") == 0) {
+            userReadbackMode = READBACK_IMAGE;
+        } else if (strcmp(vk_screenshot_readback, "BUFFER") == 0 || strcmp(vk_screenshot_readback, "buffer") == 0) {
+            userReadbackMode = READBACK_BUFFER;
+        } else if (strcmp(vk_screenshot_readback, "COMPUTE") == 0 || strcmp(vk_screenshot_readback, "compute") == 0) {
+            userReadbackMode = READBACK_COMPUTE;
+        } else if (strcmp(vk_screenshot_readback, "AUTO") != 0 && strcmp(vk_screenshot_readback, "auto") != 0) {
+#ifdef ANDROID
+            __android_log_print(ANDROID_LOG_INFO, "screenshot",
+                                "Selected readback:%s\nIs NOT in the list:\nAUTO, IMAGE, BUFFER, COMPUTE\n"
+                                "AUTO will be used instead\n",
+                                vk_screenshot_readback);
+#else
+            fprintf(stderr, "Selected readback:%s\nIs NOT in the list:\nAUTO, IMAGE, BUFFER, COMPUTE\nAUTO will be used instead\n",
+                    vk_screenshot_readback);
+#endif
+        }
+    }
+
+    if (env_var != NULL) {
+        local_free_getenv(env_var);
+    }
+}
+
+// Get users request for the format of the files written
+void readScreenShotFileFormat(void) {
+    const char *vk_screenshot_file_format = getLayerOption(settings_option_file_format);
+    const char *env_var = local_getenv(env_var_file_format);
+
+    if (env_var != NULL) {
+        if (strlen(env_var) > 0) {
+            vk_screenshot_file_format = env_var;
+        } else if (strlen(env_var) == 0) {
+            local_free_getenv(env_var);
+            env_var = NULL;
+        }
+    }
+
+    if (vk_screenshot_file_format && *vk_screenshot_file_format) {
+        if (strcmp(vk_screenshot_file_format, "PNG") == 0 || strcmp(vk_screenshot_file_format, "png") == 0) {
+            userFileFormat = FILE_FORMAT_PNG;
+        } else if (strcmp(vk_screenshot_file_format, "QOI") == 0 || strcmp(vk_screenshot_file_format, "qoi") == 0) {
+            userFileFormat = FILE_FORMAT_QOI;
+        } else if (strcmp(vk_screenshot_file_format, "PPM") != 0 && strcmp(vk_screenshot_file_format, "ppm") != 0) {
+#ifdef ANDROID
+            __android_log_print(ANDROID_LOG_INFO, "screenshot",
+                                "Selected file format:%s\nIs NOT in the list:\nPPM, PNG, QOI\nPPM will be used instead\n",
+                                vk_screenshot_file_format);
+#else
+            fprintf(stderr, "Selected file format:%s\nIs NOT in the list:\nPPM, PNG, QOI\nPPM will be used instead\n",
+                    vk_screenshot_file_format);
+#endif
+        }
+    }
+
+    if (!isFileFormatSupported(userFileFormat)) {
+#ifdef ANDROID
+        __android_log_print(ANDROID_LOG_INFO, "screenshot", "The layer was built without PNG support, PPM will be used instead\n");
+#else
+        fprintf(stderr, "The layer was built without PNG support, PPM will be used instead\n");
+#endif
+        userFileFormat = FILE_FORMAT_PPM;
+    }
+
+    if (env_var != NULL) {
+        local_free_getenv(env_var);
+    }
+}
+
+// Get users request for how much captures are downscaled
+void readScreenShotScale(void) {
+    const char *vk_screenshot_scale = getLayerOption(settings_option_scale);
+    const char *env_var = local_getenv(env_var_scale);
+
+    if (env_var != NULL) {
+        if (strlen(env_var) > 0) {
+            vk_screenshot_scale = env_var;
+        } else if (strlen(env_var) == 0) {
+            local_free_getenv(env_var);
+            env_var = NULL;
+        }
+    }
+
+    if (vk_screenshot_scale && *vk_screenshot_scale) {
+        if (strcmp(vk_screenshot_scale, "2") == 0) {
+            userScale = 2;
+        } else if (strcmp(vk_screenshot_scale, "4") == 0) {
+            userScale = 4;
+        } else if (strcmp(vk_screenshot_scale, "1") != 0) {
+#ifdef ANDROID
+            __android_log_print(ANDROID_LOG_INFO, "screenshot",
+                                "Selected scale:%s\nIs NOT in the list:\n1, 2, 4\n1 will be used instead\n", vk_screenshot_scale);
+#else
+            fprintf(stderr, "Selected scale:%s\nIs NOT in the list:\n1, 2, 4\n1 will be used instead\n", vk_screenshot_scale);
+#endif
+        }
+    }
+
+    if (env_var != NULL) {
+        local_free_getenv(env_var);
+    }
+}
+
 void readScreenShotDir(void) {
     vk_screenshot_dir = getLayerOption(settings_option_dir);
     const char *env_var = local_getenv(env_var_dir);
@@ -297,30 +552,91 @@ void readScreenShotDir(void) {
 #endif
 }
 
-// detect if frameNumber reach or beyond the right edge for screenshot in the range.
-// return:
-//       if frameNumber is already the last screenshot frame of the range(mean no another screenshot frame number >frameNumber and
-//       just in the range)
-//       if the range is invalid, return true.
-static bool isEndOfScreenShotFrameRange(int frameNumber, FrameRange *pFrameRange) {
-    bool endOfScreenShotFrameRange = false, screenShotFrame = false;
-    if (!pFrameRange->valid) {
-        endOfScreenShotFrameRange = true;
-    } else {
-        int endFrame = getEndFrameOfRange(pFrameRange);
-        if (endFrame != SCREEN_SHOT_FRAMES_UNLIMITED) {
-            if (isInScreenShotFrameRange(frameNumber, pFrameRange, &screenShotFrame)) {
-                if ((frameNumber >= endFrame) && screenShotFrame) {
-                    endOfScreenShotFrameRange = true;
-                }
-            }
+// Get a setting the way the others are read, the environment variable
+// overriding the layer option, as a copy so the variable can be freed.
+static string readScreenShotOption(const char *settings_option, const char *env_var_name) {
+    const char *value = getLayerOption(settings_option);
+    string option = value ? value : "";
+    const char *env_var = local_getenv(env_var_name);
+
+    if (env_var != NULL) {
+        if (strlen(env_var) > 0) {
+            option = env_var;
         }
+        local_free_getenv(env_var);
     }
-    return endOfScreenShotFrameRange;
+    return option;
+}
+
+// Get users request for hashing frames instead of writing them, and the
+// manifests the hashes are written to and compared with.  Called after
+// readScreenShotDir, since the hash manifest defaults to the screenshot dir.
+// The settings are only read once, as the capture writers of an earlier
+// instance may be using them.
+void readScreenShotHash(void) {
+    if (userHashMode != HASH_NONE) return;
+
+    string const vk_screenshot_hash = readScreenShotOption(settings_option_hash, env_var_hash);
+    if (vk_screenshot_hash == "CONTENT" || vk_screenshot_hash == "content") {
+        userHashMode = HASH_CONTENT;
+    } else if (vk_screenshot_hash == "PERCEPTUAL" || vk_screenshot_hash == "perceptual") {
+        userHashMode = HASH_PERCEPTUAL;
+    } else if (!vk_screenshot_hash.empty() && vk_screenshot_hash != "NONE" && vk_screenshot_hash != "none") {
+#ifdef ANDROID
+        __android_log_print(ANDROID_LOG_INFO, "screenshot",
+                            "Selected hash:%s\nIs NOT in the list:\nNONE, CONTENT, PERCEPTUAL\nNONE will be used instead\n",
+                            vk_screenshot_hash.c_str());
+#else
+        fprintf(stderr, "Selected hash:%s\nIs NOT in the list:\nNONE, CONTENT, PERCEPTUAL\nNONE will be used instead\n",
+                vk_screenshot_hash.c_str());
+#endif
+    }
+    if (userHashMode == HASH_NONE) return;
+
+    hashManifestPath = readScreenShotOption(settings_option_hash_manifest, env_var_hash_manifest);
+    if (hashManifestPath.empty()) {
+        if (vk_screenshot_dir != NULL && strlen(vk_screenshot_dir) > 0) {
+            hashManifestPath = vk_screenshot_dir;
+            hashManifestPath += "/";
+        }
+        hashManifestPath += "hashes.csv";
+    }
+
+    // Without a golden manifest the frames are only hashed.  A golden manifest
+    // that cannot be read matches no frame, so every frame is written.
+    string const goldenManifestPath = readScreenShotOption(settings_option_golden_manifest, env_var_golden_manifest);
+    goldenManifestSupplied = !goldenManifestPath.empty();
+    if (goldenManifestSupplied && !readHashManifest(goldenManifestPath.c_str(), goldenManifest)) {
+#ifdef ANDROID
+        __android_log_print(ANDROID_LOG_INFO, "screenshot", "Failed to read golden manifest: %s, every frame will be written\n",
+                            goldenManifestPath.c_str());
+#else
+        fprintf(stderr, "Failed to read golden manifest:%s, every frame will be written\n", goldenManifestPath.c_str());
+#endif
+    }
+}
+
+// Get the first frame from frameNumber on that is in screenshotFrames or in
+// screenShotFrameRange, or noCaptureFrame if there is none.  Called with
+// scheduleLock held.
+static int getNextCaptureFrame(int frameNumber) {
+    int nextFrame = noCaptureFrame;
+    auto it = screenshotFrames.lower_bound(frameNumber);
+    if (it != screenshotFrames.end()) nextFrame = *it;
+
+    if (screenShotFrameRange.valid) {
+        int rangeFrame = screenShotFrameRange.startFrame;
+        int const interval = screenShotFrameRange.interval;
+        if (frameNumber > rangeFrame) rangeFrame += (frameNumber - rangeFrame + interval - 1) / interval * interval;
+        int const endFrame = getEndFrameOfRange(&screenShotFrameRange);
+        if ((endFrame == SCREEN_SHOT_FRAMES_UNLIMITED || rangeFrame <= endFrame) && rangeFrame < nextFrame) nextFrame = rangeFrame;
+    }
+    return nextFrame;
 }
 
 // Parse comma-separated frame list string into the set
 static void populate_frame_list(const char *vk_screenshot_frames) {
+    std::lock_guard<std::mutex> lock(scheduleLock);
     string spec(vk_screenshot_frames), word;
     size_t start = 0, comma = 0;
 
@@ -353,9 +669,14 @@ static void populate_frame_list(const char *vk_screenshot_frames) {
         }
     }
 
+    nextCaptureFrame.store(getNextCaptureFrame(frameCounter.load()));
     screenshotFramesReceived = true;
 }
 
+// Whether any frame may still be captured, so that the queues and
+// swapchains captures are made with need to be tracked.
+static bool capturesPending() { return !screenshotFramesReceived || nextCaptureFrame.load() != noCaptureFrame; }
+
 void readScreenShotFrames(void) {
     const char *vk_screenshot_frames = getLayerOption(settings_option_frames);
     const char *env_var = local_getenv(env_var_frames);
@@ -398,169 +719,526 @@ static bool memory_type_from_properties(VkPhysicalDeviceMemoryProperties *memory
     return false;
 }
 
-static DispatchMapStruct *get_dispatch_info(VkDevice dev) {
-    auto it = dispatchMap.find(dev);
-    if (it == dispatchMap.end())
-        return NULL;
-    else
-        return it->second;
-}
-
-static DeviceMapStruct *get_device_info(VkDevice dev) {
-    auto it = deviceMap.find(dev);
-    if (it == deviceMap.end())
-        return NULL;
-    else
-        return it->second;
-}
-
 static void init_screenshot() {
-    if (!globalLockInitialized) {
-        // TODO/TBD: Need to delete this mutex sometime.  How???  One
-        // suggestion is to call this during vkCreateInstance(), and then we
-        // can clean it up during vkDestroyInstance().  However, that requires
-        // that the layer have per-instance locks.  We need to come back and
-        // address this soon.
-        loader_platform_thread_create_mutex(&globalLock);
-        globalLockInitialized = 1;
-    }
     readScreenShotFormatENV();
+    // The capture writers of an earlier instance may be using these settings,
+    // so they are only read by the first vkCreateInstance.
+    static std::once_flag captureSettingsRead;
+    std::call_once(captureSettingsRead, [] {
+        readScreenShotReadback();
+        readScreenShotFileFormat();
+        readScreenShotScale();
+    });
     readScreenShotDir();
+    readScreenShotHash();
     readScreenShotFrames();
 }
 
-VkQueue getQueueForScreenshot(VkDevice device) {
-    // Find a queue that we can use for taking a screenshot
+// Find a queue of the device that we can use for taking a screenshot.
+// Called with the device's lock held.
+VkQueue getQueueForScreenshot(DeviceData *deviceData) {
     VkQueue queue = VK_NULL_HANDLE;
-    uint32_t count;
     VkBool32 graphicsCapable = VK_FALSE;
     VkBool32 presentCapable = VK_FALSE;
-    VkLayerInstanceDispatchTable *pInstanceTable;
-    DeviceMapStruct *devMap = get_device_info(device);
-    if (NULL == devMap) {
-        assert(0);
-        return queue;
-    }
-
-    pInstanceTable = instance_dispatch_table(physDeviceMap[devMap->physicalDevice]->instance);
-    assert(pInstanceTable);
-    pInstanceTable->GetPhysicalDeviceQueueFamilyProperties(devMap->physicalDevice, &count, NULL);
-
-    std::vector<VkQueueFamilyProperties> queueProps(count);
+    vector<VkQueueFamilyProperties> const &queueProps = deviceData->queueFamilyProperties;
 
 #if defined(__ANDROID__)
     // On Android, all physical devices and queue families must be capable of presentation with any native window
     presentCapable = VK_TRUE;
 #endif
 
-    if (queueProps.size() > 0) {
-        pInstanceTable->GetPhysicalDeviceQueueFamilyProperties(devMap->physicalDevice, &count, queueProps.data());
-
-        // Iterate over all queues for this device, searching for a queue that is graphics and present capable
-        deviceMap[device]->queues.begin();
-        for (auto it = deviceMap[device]->queues.begin(); it != deviceMap[device]->queues.end(); it++) {
-            queue = *it;
-            graphicsCapable = ((queueProps[deviceMap[device]->queueIndexMap[queue]].queueFlags & VK_QUEUE_GRAPHICS_BIT) != 0);
+    // Iterate over all queues for this device, searching for a queue that is graphics and present capable
+    for (auto it = deviceData->queueFamilyIndices.begin(); it != deviceData->queueFamilyIndices.end(); it++) {
+        queue = it->first;
+        if (it->second >= queueProps.size()) continue;
+        graphicsCapable = ((queueProps[it->second].queueFlags & VK_QUEUE_GRAPHICS_BIT) != 0);
 #if defined(_WIN32)
-            presentCapable =
-                instance_dispatch_table(devMap->physicalDevice)
-                    ->GetPhysicalDeviceWin32PresentationSupportKHR(devMap->physicalDevice, deviceMap[device]->queueIndexMap[queue]);
+        presentCapable = instance_dispatch_table(deviceData->physicalDevice)
+                             ->GetPhysicalDeviceWin32PresentationSupportKHR(deviceData->physicalDevice, it->second);
 #elif not defined(__ANDROID__)
-            // Everthing else not Windows or Android
-            // TODO: Make a function call to get present support from vkGetPhysicalDeviceXlibPresentationSupportKHR,
-            // vkGetPhysicalDeviceXcbPresentationSupportKHR, etc
-            presentCapable = graphicsCapable;
+        // Everthing else not Windows or Android
+        // TODO: Make a function call to get present support from vkGetPhysicalDeviceXlibPresentationSupportKHR,
+        // vkGetPhysicalDeviceXcbPresentationSupportKHR, etc
+        presentCapable = graphicsCapable;
 #endif
-            if (graphicsCapable && presentCapable) break;
-        }
+        if (graphicsCapable && presentCapable) return queue;
     }
-    return queue;
+    return VK_NULL_HANDLE;
 }
 
-// Track allocated resources in writePPM()
-// and clean them up when they go out of scope.
-struct WritePPMCleanupData {
-    VkDevice device;
-    VkLayerDispatchTable *pTableDevice;
+// Staging resources that one capture at a time copies a swapchain image
+// into: the image read by the CPU, the intermediate image when the copy
+// takes two steps, or the buffer read by the CPU when the pool reads back
+// through a buffer or a compute shader, their memory, a fence, and a
+// command buffer for each swapchain image, recorded the first time that
+// image is captured.  The memory read by the CPU stays mapped for the
+// lifetime of the slot.  A compute shader also needs the device local
+// buffer the swapchain image is copied into and the descriptor set that
+// binds both buffers.
+struct CaptureSlot {
+    CapturePool *pool;
     VkImage image2;
     VkImage image3;
+    VkBuffer buffer;
+    VkBuffer texelBuffer;
     VkDeviceMemory mem2;
     VkDeviceMemory mem3;
-    bool mem2mapped;
-    bool mem3mapped;
-    VkCommandBuffer commandBuffer;
+    VkDeviceMemory texelMem;
+    VkDescriptorPool descriptorPool;
+    VkDescriptorSet descriptorSet;
+    VkDeviceMemory mappedMem;
+    const char *mappedData;
+    VkSubresourceLayout srLayout;
     VkCommandPool commandPool;
-    ~WritePPMCleanupData();
+    vector<VkCommandBuffer> commandBuffers;
+    VkFence fence;
+
+    // File the capture currently using this slot is written to, and the
+    // name of its frame in the hash manifest.
+    string filename;
+    string frameName;
+
+    // The converted pixels and the encoded file, kept so that they are only
+    // allocated for the first capture written from this slot.
+    vector<uint8_t> pixels;
+    vector<uint8_t> encoded;
 };
 
-WritePPMCleanupData::~WritePPMCleanupData() {
-    if (mem2mapped) pTableDevice->UnmapMemory(device, mem2);
-    if (mem2) pTableDevice->FreeMemory(device, mem2, NULL);
-    if (image2) pTableDevice->DestroyImage(device, image2, NULL);
+// Staging resources for the captures of one swapchain.  The pool is created
+// the first time the swapchain is captured and holds up to
+// maxCapturesInFlight slots, which are recycled from frame to frame.  It is
+// only rebuilt when the swapchain is recreated.
+struct CapturePool {
+    VkDevice device;
+    VkLayerDispatchTable *pTableDevice;
+    DeviceData *deviceData;
+    uint32_t queueFamilyIndex;
+    uint32_t width;
+    uint32_t height;
+    uint32_t numChannels;
+    VkFormat destformat;
+    bool copyOnly;
+    bool need2steps;
+
+    // Copy the swapchain image into a buffer as it is, and swap red and blue
+    // on the CPU if the output format needs it.
+    bool useBuffer;
+    bool swapRedBlue;
+
+    // Convert the swapchain image to packed RGB, downscaled by scale, with
+    // a compute shader.  shifts move the top 8 bits of the red, green and
+    // blue channels of a texel to its bottom byte.  The rows of the output
+    // are rowWords words long, padded to a multiple of 4 pixels.
+    bool useCompute;
+    uint32_t shifts[3];
+    uint32_t scale;
+    uint32_t rowWords;
+    VkShaderModule shaderModule;
+    VkDescriptorSetLayout descriptorSetLayout;
+    VkPipelineLayout pipelineLayout;
+    VkPipeline pipeline;
+
+    // Size of the files written, smaller than the swapchain when it is
+    // downscaled.
+    uint32_t outWidth;
+    uint32_t outHeight;
+    vector<CaptureSlot *> slots;
+
+    // Slots that are not in use by a capture, guarded by captureLock.
+    vector<CaptureSlot *> freeSlots;
+};
+
+// Append the hashes of a converted frame to the hash manifest and compare
+// them with the frame's hashes in the golden manifest.
+// return:
+//      true if the frame has to be written because it does not match.
+static bool recordFrameHash(const string &frameName, const uint8_t *pixels, uint32_t width, uint32_t height) {
+    FrameHash hash = {};
+    hash.contentHash = hashXXH3(pixels, size_t(width) * height * 3);
+    if (userHashMode == HASH_PERCEPTUAL) {
+        hash.perceptualHash = hashPerceptual(pixels, width, height);
+        hash.hasPerceptualHash = true;
+    }
+    string const line = formatHashManifestLine(frameName, hash);
+
+    {
+        std::lock_guard<std::mutex> lock(manifestLock);
+        if (!hashManifestFile) {
+            hashManifestFile = fopen(hashManifestPath.c_str(), hashManifestStarted ? "a" : "w");
+            hashManifestStarted = true;
+        }
+        if (hashManifestFile) {
+            fputs(line.c_str(), hashManifestFile);
+            fflush(hashManifestFile);
+        } else if (printManifestWarning) {
+#ifdef ANDROID
+            __android_log_print(ANDROID_LOG_DEBUG, "screenshot",
+                                "Failed to open hash manifest: %s.  Be sure to grant read and write permissions.",
+                                hashManifestPath.c_str());
+#else
+            fprintf(stderr, "Failed to open hash manifest:%s,  Be sure to grant read and write permissions\n",
+                    hashManifestPath.c_str());
+#endif
+            printManifestWarning = false;
+        }
+    }
 
-    if (mem3mapped) pTableDevice->UnmapMemory(device, mem3);
-    if (mem3) pTableDevice->FreeMemory(device, mem3, NULL);
-    if (image3) pTableDevice->DestroyImage(device, image3, NULL);
+    // The golden manifest is only changed by init_screenshot, before any capture.
+    if (!goldenManifestSupplied) return false;
+    auto it = goldenManifest.find(frameName);
+    if (it == goldenManifest.end()) return true;
+    if (it->second.contentHash == hash.contentHash) return false;
+    return !(hash.hasPerceptualHash && it->second.hasPerceptualHash &&
+             hashDistance(hash.perceptualHash, it->second.perceptualHash) <= perceptualHashTolerance);
+}
 
-    if (commandBuffer) pTableDevice->FreeCommandBuffers(device, commandPool, 1, &commandBuffer);
-    if (commandPool) pTableDevice->DestroyCommandPool(device, commandPool, NULL);
+// Close the hash manifest once no device is left to capture frames.
+static void closeHashManifest() {
+    std::lock_guard<std::mutex> lock(manifestLock);
+    if (hashManifestFile) fclose(hashManifestFile);
+    hashManifestFile = NULL;
 }
 
-// Save an image to a PPM image file.
-//
-// This function issues commands to copy/convert the swapchain image
-// from whatever compatible format the swapchain image uses
-// to a single format (VK_FORMAT_R8G8B8A8_UNORM) so that the converted
-// result can be easily written to a PPM file.
-//
-// Error handling: If there is a problem, this function should silently
-// fail without affecting the Present operation going on in the caller.
-// The numerous debug asserts are to catch programming errors and are not
-// expected to assert.  Recovery and clean up are implemented for image memory
-// allocation failures.
-// (TODO) It would be nice to pass any failure info to DebugReport or something.
-static void writePPM(const char *filename, VkImage image1) {
+// Wait for a submitted capture to finish on the GPU, then convert the final
+// image to RGB, encode it and write the file in a single write.  In hash
+// mode the file is only written when the frame does not match the golden
+// manifest.
+static void writeCapture(CaptureSlot &slot) {
+    CapturePool *pool = slot.pool;
     VkResult err;
-    bool pass;
 
-    // Bail immediately if we can't find the image.
-    if (imageMap.empty() || imageMap.find(image1) == imageMap.end()) return;
+    err = pool->pTableDevice->WaitForFences(pool->device, 1, &slot.fence, VK_TRUE, UINT64_MAX);
+    assert(!err);
+    if (VK_SUCCESS != err) return;
+
+    // The memory stays mapped, but it may not be host coherent.
+    const VkMappedMemoryRange range = {VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE, NULL, slot.mappedMem, 0, VK_WHOLE_SIZE};
+    err = pool->pTableDevice->InvalidateMappedMemoryRanges(pool->device, 1, &range);
+    assert(!err);
 
-    // Collect object info from maps.  This info is generally recorded
-    // by the other functions hooked in this layer.
-    VkDevice device = imageMap[image1]->device;
-    VkPhysicalDevice physicalDevice = deviceMap[device]->physicalDevice;
-    VkInstance instance = physDeviceMap[physicalDevice]->instance;
-    DispatchMapStruct *dispMap = get_dispatch_info(device);
-    if (NULL == dispMap) {
-        assert(0);
+    // Buffers hold the swapchain format, so red and blue may need swapping.
+    // Images have already been converted by the blit, and the compute
+    // shader writes RGB.
+    const uint32_t width = pool->outWidth;
+    const uint32_t height = pool->outHeight;
+    const uint32_t numChannels = pool->useCompute ? 3 : pool->numChannels;
+    const bool swapRedBlue = pool->useBuffer && pool->swapRedBlue;
+    const uint8_t *ptr = (const uint8_t *)slot.mappedData + slot.srLayout.offset;
+    slot.pixels.resize(size_t(width) * height * 3);
+    for (uint32_t y = 0; y < height; y++) {
+        convertRowToRGB(slot.pixels.data() + size_t(y) * width * 3, ptr, width, numChannels, swapRedBlue);
+        ptr += slot.srLayout.rowPitch;
+    }
+
+    const char *filename = slot.filename.c_str();
+    if (userHashMode != HASH_NONE) {
+        if (!recordFrameHash(slot.frameName, slot.pixels.data(), width, height)) return;
+#ifdef ANDROID
+        __android_log_print(ANDROID_LOG_INFO, "screenshot", "Frame %s does not match the golden manifest, capture file is: %s",
+                            slot.frameName.c_str(), filename);
+#else
+        printf("Frame %s does not match the golden manifest, capture file is: %s \n", slot.frameName.c_str(), filename);
+#endif
+    }
+
+    if (!encodeImage(userFileFormat, slot.pixels.data(), width, height, slot.encoded)) {
+#ifdef ANDROID
+        __android_log_print(ANDROID_LOG_DEBUG, "screenshot", "Failed to encode output file: %s.", filename);
+#else
+        fprintf(stderr, "Failed to encode output file:%s\n", filename);
+#endif
         return;
     }
-    VkQueue queue = getQueueForScreenshot(device);
-    if (!queue) {
+
+    ofstream file(filename, ios::binary);
+    assert(file.is_open());
+
+    if (!file.is_open()) {
 #ifdef ANDROID
-        __android_log_print(ANDROID_LOG_ERROR, "screenshot", "Failure - capable queue not found\n");
+        __android_log_print(ANDROID_LOG_DEBUG, "screenshot",
+                            "Failed to open output file: %s.  Be sure to grant read and write permissions.", filename);
 #else
-        fprintf(stderr, "Screenshot could not find a capable queue\n");
+        fprintf(stderr, "Failed to open output file:%s,  Be sure to grant read and write permissions\n", filename);
 #endif
         return;
     }
-    VkLayerDispatchTable *pTableDevice = dispMap->device_dispatch_table;
-    VkLayerDispatchTable *pTableQueue = get_dispatch_info(static_cast<VkDevice>(static_cast<void *>(queue)))->device_dispatch_table;
-    VkLayerInstanceDispatchTable *pInstanceTable;
-    pInstanceTable = instance_dispatch_table(instance);
+    file.write((const char *)slot.encoded.data(), slot.encoded.size());
+    file.close();
+}
+
+// Captures submitted from QueuePresentKHR are written by separate threads,
+// so presenting a frame only submits the copy.  A writer waits for each
+// capture's fence, encodes and writes the file and returns the slot to its
+// pool.  Up to maxCaptureWriters writers encode captures side by side, one
+// more being started whenever captures are queued faster than the running
+// writers take them.  At most maxCapturesInFlight captures are held at once;
+// presenting waits for the writers when they fall that far behind.  Writers
+// exit as soon as they run out of captures, so none is left waiting when
+// the application exits.
+static const size_t maxCapturesInFlight = 8;
+static const size_t maxCaptureWriters = std::max<size_t>(1, std::min<size_t>(4, std::thread::hardware_concurrency() / 2));
+static std::mutex captureLock;
+static std::condition_variable captureCondition;
+static std::deque<CaptureSlot *> pendingCaptures;
+static size_t capturesInFlight = 0;
+static size_t captureWritersRunning = 0;
+
+static void captureWriterMain() {
+    std::unique_lock<std::mutex> lock(captureLock);
+    while (!pendingCaptures.empty()) {
+        CaptureSlot *slot = pendingCaptures.front();
+        pendingCaptures.pop_front();
+        lock.unlock();
+
+        writeCapture(*slot);
+
+        lock.lock();
+        slot->pool->freeSlots.push_back(slot);
+        capturesInFlight--;
+        captureCondition.notify_all();
+    }
+    captureWritersRunning--;
+    captureCondition.notify_all();
+}
+
+// Hand a submitted capture to the writer threads, starting another one if
+// there are more captures waiting than writers.  The threads are detached
+// so that an application exiting without destroying its device does not
+// have to join them.
+static void queueCapture(CaptureSlot *slot) {
+    std::unique_lock<std::mutex> lock(captureLock);
+    captureCondition.wait(lock, [] { return capturesInFlight < maxCapturesInFlight; });
+    pendingCaptures.push_back(slot);
+    capturesInFlight++;
+    if (captureWritersRunning < maxCaptureWriters && captureWritersRunning < pendingCaptures.size()) {
+        captureWritersRunning++;
+        std::thread(captureWriterMain).detach();
+    }
+}
+
+// Write any queued captures and wait for the writer threads to exit.
+static void stopCaptureWriter() {
+    std::unique_lock<std::mutex> lock(captureLock);
+    captureCondition.wait(lock, [] { return captureWritersRunning == 0; });
+}
+
+// Check whether the copy for a capture can be submitted to the queue the
+// frame is presented on.  Blits need a graphics queue.  Called with the
+// device's lock held.
+static bool queueCanCapture(DeviceData *deviceData, VkQueue queue) {
+    auto it = deviceData->queueFamilyIndices.find(queue);
+    if (it == deviceData->queueFamilyIndices.end()) return false;
+    vector<VkQueueFamilyProperties> const &queueProps = deviceData->queueFamilyProperties;
+    return it->second < queueProps.size() && (queueProps[it->second].queueFlags & VK_QUEUE_GRAPHICS_BIT) != 0;
+}
+
+static void destroyCaptureSlot(CaptureSlot *slot) {
+    CapturePool *pool = slot->pool;
+    VkDevice device = pool->device;
+    VkLayerDispatchTable *pTableDevice = pool->pTableDevice;
+
+    if (slot->mappedData) pTableDevice->UnmapMemory(device, slot->mappedMem);
+    if (slot->mem2) pTableDevice->FreeMemory(device, slot->mem2, NULL);
+    if (slot->image2) pTableDevice->DestroyImage(device, slot->image2, NULL);
+    if (slot->mem3) pTableDevice->FreeMemory(device, slot->mem3, NULL);
+    if (slot->image3) pTableDevice->DestroyImage(device, slot->image3, NULL);
+    if (slot->buffer) pTableDevice->DestroyBuffer(device, slot->buffer, NULL);
+    if (slot->texelMem) pTableDevice->FreeMemory(device, slot->texelMem, NULL);
+    if (slot->texelBuffer) pTableDevice->DestroyBuffer(device, slot->texelBuffer, NULL);
+    if (slot->descriptorPool) pTableDevice->DestroyDescriptorPool(device, slot->descriptorPool, NULL);
+
+    for (auto commandBuffer : slot->commandBuffers) {
+        if (commandBuffer) pTableDevice->FreeCommandBuffers(device, slot->commandPool, 1, &commandBuffer);
+    }
+    if (slot->commandPool) pTableDevice->DestroyCommandPool(device, slot->commandPool, NULL);
+    if (slot->fence) pTableDevice->DestroyFence(device, slot->fence, NULL);
+    delete slot;
+}
+
+// Destroy the compute pipeline of a capture pool and the objects it is
+// created from.
+static void destroyCapturePipeline(CapturePool *pool) {
+    VkDevice device = pool->device;
+    VkLayerDispatchTable *pTableDevice = pool->pTableDevice;
+
+    if (pool->pipeline) pTableDevice->DestroyPipeline(device, pool->pipeline, NULL);
+    if (pool->pipelineLayout) pTableDevice->DestroyPipelineLayout(device, pool->pipelineLayout, NULL);
+    if (pool->descriptorSetLayout) pTableDevice->DestroyDescriptorSetLayout(device, pool->descriptorSetLayout, NULL);
+    if (pool->shaderModule) pTableDevice->DestroyShaderModule(device, pool->shaderModule, NULL);
+    pool->pipeline = VK_NULL_HANDLE;
+    pool->pipelineLayout = VK_NULL_HANDLE;
+    pool->descriptorSetLayout = VK_NULL_HANDLE;
+    pool->shaderModule = VK_NULL_HANDLE;
+}
+
+// Destroy a capture pool once the writers have returned all of its slots.
+// Only this pool's captures are waited for, so the pool must already be
+// detached from its swapchain, and the device's lock must not be held.
+static void destroyCapturePool(CapturePool *pool) {
+    if (!pool) return;
+    {
+        std::unique_lock<std::mutex> lock(captureLock);
+        captureCondition.wait(lock, [pool] { return pool->freeSlots.size() == pool->slots.size(); });
+    }
+    for (auto slot : pool->slots) destroyCaptureSlot(slot);
+    destroyCapturePipeline(pool);
+    delete pool;
+}
+
+// Destroy capture pools detached with the device's lock held, after the
+// lock has been released.
+static void destroyCapturePools(vector<CapturePool *> &pools) {
+    for (auto pool : pools) destroyCapturePool(pool);
+    pools.clear();
+}
+
+// Detach the capture pools of all of a device's swapchains, to be destroyed
+// once the device's lock is released.  Called with the device's lock held.
+static void detachCapturePools(DeviceData *deviceData, vector<CapturePool *> &pools) {
+    for (auto &swapchain : deviceData->swapchains) {
+        if (swapchain.second.capturePool) pools.push_back(swapchain.second.capturePool);
+        swapchain.second.capturePool = NULL;
+    }
+}
+
+// Describe an 8 bit per channel format whose channels the CPU can reorder:
+// which of the UNORM, SNORM, USCALED, SSCALED, UINT, SINT and SRGB
+// encodings it uses, its channel count, and whether blue comes first.
+static bool getByteFormatLayout(VkFormat format, uint32_t *encoding, uint32_t *numChannels, bool *blueFirst) {
+    static const struct {
+        VkFormat first;
+        VkFormat last;
+        uint32_t numChannels;
+        bool blueFirst;
+    } layouts[] = {
+        {VK_FORMAT_R8G8B8_UNORM, VK_FORMAT_R8G8B8_SRGB, 3, false},
+        {VK_FORMAT_B8G8R8_UNORM, VK_FORMAT_B8G8R8_SRGB, 3, true},
+        {VK_FORMAT_R8G8B8A8_UNORM, VK_FORMAT_R8G8B8A8_SRGB, 4, false},
+        {VK_FORMAT_B8G8R8A8_UNORM, VK_FORMAT_B8G8R8A8_SRGB, 4, true},
+    };
+
+    for (size_t i = 0; i < ARRAY_SIZE(layouts); i++) {
+        if (format >= layouts[i].first && format <= layouts[i].last) {
+            *encoding = format - layouts[i].first;
+            *numChannels = layouts[i].numChannels;
+            *blueFirst = layouts[i].blueFirst;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Get the shifts that move the top 8 bits of the red, green and blue
+// channels of a 32 bit texel of format to its bottom byte, for the formats
+// the compute shader can read.  Like a buffer, the shader keeps the values
+// as they are encoded, so 8 bit formats need the encoding of destformat and
+// 10 bit formats are only read when they are written as UNORM.
+static bool getComputeShifts(VkFormat format, VkFormat destformat, uint32_t shifts[3]) {
+    uint32_t encoding, numChannels, dstEncoding, dstChannels;
+    bool blueFirst, dstBlueFirst;
+    if (getByteFormatLayout(format, &encoding, &numChannels, &blueFirst)) {
+        if (numChannels != 4 || !getByteFormatLayout(destformat, &dstEncoding, &dstChannels, &dstBlueFirst) ||
+            encoding != dstEncoding) {
+            return false;
+        }
+        shifts[0] = blueFirst ? 16 : 0;
+        shifts[1] = 8;
+        shifts[2] = blueFirst ? 0 : 16;
+        return true;
+    }
+    if (destformat != VK_FORMAT_R8G8B8A8_UNORM) return false;
+    if (format == VK_FORMAT_A2R10G10B10_UNORM_PACK32) {
+        shifts[0] = 22;
+        shifts[1] = 12;
+        shifts[2] = 2;
+        return true;
+    }
+    if (format == VK_FORMAT_A2B10G10R10_UNORM_PACK32) {
+        shifts[0] = 2;
+        shifts[1] = 12;
+        shifts[2] = 22;
+        return true;
+    }
+    return false;
+}
+
+// The push constants of screenshot_convert.comp.
+struct ConvertParameters {
+    uint32_t width;
+    uint32_t height;
+    uint32_t shifts[3];
+    uint32_t scale;
+    uint32_t dstWidth;
+    uint32_t dstHeight;
+    uint32_t dstRowWords;
+};
+
+// Create the compute pipeline that converts the captures of a pool, and the
+// layouts its slots bind their buffers with.  Layers built without
+// glslangValidator have no shader, so they always fail.
+static bool initCapturePipeline(CapturePool *pool) {
+#ifndef SCREENSHOT_CONVERT_COMP_GENERATED
+    (void)pool;
+    return false;
+#else
+    VkDevice device = pool->device;
+    VkLayerDispatchTable *pTableDevice = pool->pTableDevice;
+    VkResult err;
+
+    const VkShaderModuleCreateInfo shaderModuleCreateInfo = {VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO, NULL, 0,
+                                                             sizeof(screenshot_convert_comp), screenshot_convert_comp};
+    err = pTableDevice->CreateShaderModule(device, &shaderModuleCreateInfo, NULL, &pool->shaderModule);
+    if (VK_SUCCESS != err) return false;
+
+    const VkDescriptorSetLayoutBinding bindings[2] = {
+        {0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT, NULL},
+        {1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT, NULL},
+    };
+    const VkDescriptorSetLayoutCreateInfo descriptorSetLayoutCreateInfo = {
+        VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO, NULL, 0, 2, bindings};
+    err = pTableDevice->CreateDescriptorSetLayout(device, &descriptorSetLayoutCreateInfo, NULL, &pool->descriptorSetLayout);
+    if (VK_SUCCESS != err) return false;
+
+    const VkPushConstantRange pushConstantRange = {VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(ConvertParameters)};
+    const VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo = {
+        VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO, NULL, 0, 1, &pool->descriptorSetLayout, 1, &pushConstantRange};
+    err = pTableDevice->CreatePipelineLayout(device, &pipelineLayoutCreateInfo, NULL, &pool->pipelineLayout);
+    if (VK_SUCCESS != err) return false;
+
+    const VkPipelineShaderStageCreateInfo stageCreateInfo = {VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+                                                             NULL,
+                                                             0,
+                                                             VK_SHADER_STAGE_COMPUTE_BIT,
+                                                             pool->shaderModule,
+                                                             "main",
+                                                             NULL};
+    const VkComputePipelineCreateInfo pipelineCreateInfo = {
+        VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO, NULL, 0, stageCreateInfo, pool->pipelineLayout, VK_NULL_HANDLE, -1};
+    err = pTableDevice->CreateComputePipelines(device, VK_NULL_HANDLE, 1, &pipelineCreateInfo, NULL, &pool->pipeline);
+    return VK_SUCCESS == err;
+#endif
+}
+
+// Choose how captures of a swapchain are copied into host-visible memory.
+// The slots themselves are created as they are needed.
+static CapturePool *createCapturePool(DeviceData *deviceData, SwapchainData *swapchainData, uint32_t queueFamilyIndex) {
+    // Collect object info from the device state.  This info is generally
+    // recorded by the other functions hooked in this layer.
+    VkDevice device = deviceData->device;
+    VkPhysicalDevice physicalDevice = deviceData->physicalDevice;
+    VkLayerInstanceDispatchTable *pInstanceTable = instance_dispatch_table(physicalDevice);
 
     // Gather incoming image info and check image format for compatibility with
     // the target format.
     // This function supports both 24-bit and 32-bit swapchain images.
-    uint32_t const width = imageMap[image1]->imageExtent.width;
-    uint32_t const height = imageMap[image1]->imageExtent.height;
-    VkFormat const format = imageMap[image1]->format;
+    uint32_t const width = swapchainData->imageExtent.width;
+    uint32_t const height = swapchainData->imageExtent.height;
+    VkFormat const format = swapchainData->format;
     uint32_t const numChannels = FormatChannelCount(format);
 
     if ((3 != numChannels) && (4 != numChannels)) {
         assert(0);
-        return;
+        return NULL;
     }
 
     // Initial dest format is undefined as we will look for one
@@ -682,7 +1360,7 @@ static void writePPM(const char *filename, VkImage image1) {
 
     if ((FormatCompatibilityClass(destformat) != FormatCompatibilityClass(format))) {
         assert(0);
-        return;
+        return NULL;
     }
 
     // General Approach
@@ -741,11 +1419,149 @@ static void writePPM(const char *filename, VkImage image1) {
         // Else bltLinear is available and only 1 step is needed.
     }
 
-    // Put resources that need to be cleaned up in a struct with a destructor
-    // so that things get cleaned up when this function is exited.
-    WritePPMCleanupData data = {};
-    data.device = device;
-    data.pTableDevice = pTableDevice;
+    // A buffer can only be used when the CPU can turn the swapchain format
+    // into the destination format, which takes at most swapping red and
+    // blue.  Other conversions still need a blit into an image.
+    uint32_t srcEncoding, srcChannels, dstEncoding, dstChannels;
+    bool srcBlueFirst = false, dstBlueFirst = false;
+    bool const cpuConvertible = getByteFormatLayout(format, &srcEncoding, &srcChannels, &srcBlueFirst) &&
+                                getByteFormatLayout(destformat, &dstEncoding, &dstChannels, &dstBlueFirst) &&
+                                srcEncoding == dstEncoding && srcChannels == dstChannels;
+    bool useBuffer = false;
+    if (userReadbackMode != READBACK_IMAGE) {
+        useBuffer = cpuConvertible;
+        if (!cpuConvertible && userReadbackMode == READBACK_BUFFER && printReadbackWarning) {
+#ifdef ANDROID
+            __android_log_print(ANDROID_LOG_INFO, "screenshot",
+                                "Swapchain format cannot be converted on the CPU, an image will be used for readback\n");
+#else
+            fprintf(stderr, "Swapchain format cannot be converted on the CPU, an image will be used for readback\n");
+#endif
+            printReadbackWarning = false;
+        }
+    }
+
+    // The compute shader reads whole 32 bit texels and has to run on the
+    // queue the capture is submitted to.
+    uint32_t shifts[3] = {0, 0, 0};
+    bool const wantCompute = userReadbackMode == READBACK_COMPUTE || (userReadbackMode == READBACK_AUTO && userScale > 1);
+    bool useCompute = false;
+    if (wantCompute) {
+        vector<VkQueueFamilyProperties> const &queueProps = deviceData->queueFamilyProperties;
+        useCompute = getComputeShifts(format, destformat, shifts) && queueFamilyIndex < queueProps.size() &&
+                     (queueProps[queueFamilyIndex].queueFlags & VK_QUEUE_COMPUTE_BIT) != 0;
+    }
+
+    CapturePool *pool = new CapturePool();
+    pool->device = device;
+    pool->pTableDevice = &deviceData->dispatchTable;
+    pool->deviceData = deviceData;
+    pool->queueFamilyIndex = queueFamilyIndex;
+    pool->width = width;
+    pool->height = height;
+    pool->numChannels = numChannels;
+    pool->destformat = destformat;
+    pool->copyOnly = copyOnly;
+    pool->need2steps = need2steps;
+    pool->useBuffer = useBuffer;
+    pool->swapRedBlue = srcBlueFirst != dstBlueFirst;
+    pool->outWidth = width;
+    pool->outHeight = height;
+
+    if (useCompute && !initCapturePipeline(pool)) {
+        destroyCapturePipeline(pool);
+        useCompute = false;
+    }
+    if (wantCompute && !useCompute && printComputeWarning) {
+#ifdef ANDROID
+        __android_log_print(ANDROID_LOG_INFO, "screenshot",
+                            "Captures cannot be converted with a compute shader, it will not be used\n");
+#else
+        fprintf(stderr, "Captures cannot be converted with a compute shader, it will not be used\n");
+#endif
+        printComputeWarning = false;
+    }
+    if (useCompute) {
+        pool->useCompute = true;
+        pool->useBuffer = false;
+        memcpy(pool->shifts, shifts, sizeof(shifts));
+        pool->scale = userScale;
+        pool->outWidth = (width + userScale - 1) / userScale;
+        pool->outHeight = (height + userScale - 1) / userScale;
+        pool->rowWords = (pool->outWidth + 3) / 4 * 3;
+    } else if (userScale > 1 && printScaleWarning) {
+#ifdef ANDROID
+        __android_log_print(ANDROID_LOG_INFO, "screenshot",
+                            "Captures can only be downscaled by a compute shader, they will be written at full size\n");
+#else
+        fprintf(stderr, "Captures can only be downscaled by a compute shader, they will be written at full size\n");
+#endif
+        printScaleWarning = false;
+    }
+    return pool;
+}
+
+// Create the buffer of a capture slot that reads back through a buffer or a
+// compute shader and map its memory, preferring memory the CPU can cache
+// since the CPU reads every byte of it.
+static bool initCaptureBuffer(CaptureSlot *slot) {
+    CapturePool *pool = slot->pool;
+    VkDevice device = pool->device;
+    VkPhysicalDevice physicalDevice = pool->deviceData->physicalDevice;
+    VkLayerDispatchTable *pTableDevice = pool->pTableDevice;
+    VkLayerInstanceDispatchTable *pInstanceTable = instance_dispatch_table(physicalDevice);
+    VkResult err;
+    bool pass;
+
+    // The copy packs the rows tightly.  The compute shader writes whole
+    // words, so its rows are padded.
+    VkDeviceSize const rowPitch =
+        pool->useCompute ? (VkDeviceSize)pool->rowWords * 4 : (VkDeviceSize)pool->width * pool->numChannels;
+    VkBufferUsageFlags const usage = pool->useCompute ? VK_BUFFER_USAGE_STORAGE_BUFFER_BIT : VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+    const VkBufferCreateInfo bufferCreateInfo = {
+        VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO, NULL, 0, rowPitch * pool->outHeight, usage, VK_SHARING_MODE_EXCLUSIVE, 0, NULL};
+    err = pTableDevice->CreateBuffer(device, &bufferCreateInfo, NULL, &slot->buffer);
+    assert(!err);
+    if (VK_SUCCESS != err) return false;
+
+    VkMemoryRequirements memRequirements;
+    VkPhysicalDeviceMemoryProperties memoryProperties;
+    VkMemoryAllocateInfo memAllocInfo = {VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO, NULL, 0, 0};
+    pTableDevice->GetBufferMemoryRequirements(device, slot->buffer, &memRequirements);
+    memAllocInfo.allocationSize = memRequirements.size;
+    pInstanceTable->GetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
+    pass = memory_type_from_properties(&memoryProperties, memRequirements.memoryTypeBits,
+                                       VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT,
+                                       &memAllocInfo.memoryTypeIndex) ||
+           memory_type_from_properties(&memoryProperties, memRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
+                                       &memAllocInfo.memoryTypeIndex);
+    assert(pass);
+    err = pTableDevice->AllocateMemory(device, &memAllocInfo, NULL, &slot->mem2);
+    assert(!err);
+    if (VK_SUCCESS != err) return false;
+    err = pTableDevice->BindBufferMemory(device, slot->buffer, slot->mem2, 0);
+    assert(!err);
+    if (VK_SUCCESS != err) return false;
+
+    slot->mappedMem = slot->mem2;
+    slot->srLayout.offset = 0;
+    slot->srLayout.size = bufferCreateInfo.size;
+    slot->srLayout.rowPitch = rowPitch;
+    err = pTableDevice->MapMemory(device, slot->mappedMem, 0, VK_WHOLE_SIZE, 0, (void **)&slot->mappedData);
+    assert(!err);
+    return VK_SUCCESS == err;
+}
+
+// Create the images of a capture slot that reads back through images and
+// map the memory of the final one.
+static bool initCaptureImages(CaptureSlot *slot) {
+    CapturePool *pool = slot->pool;
+    VkDevice device = pool->device;
+    VkPhysicalDevice physicalDevice = pool->deviceData->physicalDevice;
+    VkLayerDispatchTable *pTableDevice = pool->pTableDevice;
+    VkLayerInstanceDispatchTable *pInstanceTable = instance_dispatch_table(physicalDevice);
+    VkResult err;
+    bool pass;
 
     // Set up the image creation info for both the blit and copy images, in case
     // both are needed.
@@ -754,8 +1570,8 @@ static void writePPM(const char *filename, VkImage image1) {
         NULL,
         0,
         VK_IMAGE_TYPE_2D,
-        destformat,
-        {width, height, 1},
+        pool->destformat,
+        {pool->width, pool->height, 1},
         1,
         1,
         VK_SAMPLE_COUNT_1_BIT,
@@ -769,7 +1585,7 @@ static void writePPM(const char *filename, VkImage image1) {
     VkImageCreateInfo imgCreateInfo3 = imgCreateInfo2;
 
     // If we need both images, set up image2 to be read/write and tiled.
-    if (need2steps) {
+    if (pool->need2steps) {
         imgCreateInfo2.tiling = VK_IMAGE_TILING_OPTIMAL;
         imgCreateInfo2.usage = VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
     }
@@ -784,87 +1600,215 @@ static void writePPM(const char *filename, VkImage image1) {
 
     // Create image2 and allocate its memory.  It could be the intermediate or
     // final image.
-    err = pTableDevice->CreateImage(device, &imgCreateInfo2, NULL, &data.image2);
+    err = pTableDevice->CreateImage(device, &imgCreateInfo2, NULL, &slot->image2);
     assert(!err);
-    if (VK_SUCCESS != err) return;
-    pTableDevice->GetImageMemoryRequirements(device, data.image2, &memRequirements);
+    if (VK_SUCCESS != err) return false;
+    pTableDevice->GetImageMemoryRequirements(device, slot->image2, &memRequirements);
     memAllocInfo.allocationSize = memRequirements.size;
     pInstanceTable->GetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
     pass = memory_type_from_properties(&memoryProperties, memRequirements.memoryTypeBits,
-                                       need2steps ? VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT : VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
+                                       pool->need2steps ? VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT : VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
                                        &memAllocInfo.memoryTypeIndex);
     assert(pass);
-    err = pTableDevice->AllocateMemory(device, &memAllocInfo, NULL, &data.mem2);
+    err = pTableDevice->AllocateMemory(device, &memAllocInfo, NULL, &slot->mem2);
     assert(!err);
-    if (VK_SUCCESS != err) return;
-    err = pTableQueue->BindImageMemory(device, data.image2, data.mem2, 0);
+    if (VK_SUCCESS != err) return false;
+    err = pTableDevice->BindImageMemory(device, slot->image2, slot->mem2, 0);
     assert(!err);
-    if (VK_SUCCESS != err) return;
+    if (VK_SUCCESS != err) return false;
 
     // Create image3 and allocate its memory, if needed.
-    if (need2steps) {
-        err = pTableDevice->CreateImage(device, &imgCreateInfo3, NULL, &data.image3);
+    if (pool->need2steps) {
+        err = pTableDevice->CreateImage(device, &imgCreateInfo3, NULL, &slot->image3);
         assert(!err);
-        if (VK_SUCCESS != err) return;
-        pTableDevice->GetImageMemoryRequirements(device, data.image3, &memRequirements);
+        if (VK_SUCCESS != err) return false;
+        pTableDevice->GetImageMemoryRequirements(device, slot->image3, &memRequirements);
         memAllocInfo.allocationSize = memRequirements.size;
         pInstanceTable->GetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
         pass = memory_type_from_properties(&memoryProperties, memRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
                                            &memAllocInfo.memoryTypeIndex);
         assert(pass);
-        err = pTableDevice->AllocateMemory(device, &memAllocInfo, NULL, &data.mem3);
+        err = pTableDevice->AllocateMemory(device, &memAllocInfo, NULL, &slot->mem3);
         assert(!err);
-        if (VK_SUCCESS != err) return;
-        err = pTableQueue->BindImageMemory(device, data.image3, data.mem3, 0);
+        if (VK_SUCCESS != err) return false;
+        err = pTableDevice->BindImageMemory(device, slot->image3, slot->mem3, 0);
         assert(!err);
-        if (VK_SUCCESS != err) return;
+        if (VK_SUCCESS != err) return false;
     }
 
+    // Map the final image so that the CPU can read it.
+    const VkImageSubresource sr = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0};
+    VkImage finalImage = pool->need2steps ? slot->image3 : slot->image2;
+    slot->mappedMem = pool->need2steps ? slot->mem3 : slot->mem2;
+    pTableDevice->GetImageSubresourceLayout(device, finalImage, &sr, &slot->srLayout);
+    err = pTableDevice->MapMemory(device, slot->mappedMem, 0, VK_WHOLE_SIZE, 0, (void **)&slot->mappedData);
+    assert(!err);
+    return VK_SUCCESS == err;
+}
+
+// Create the device local buffer that the swapchain image is copied into
+// for the compute shader, and the descriptor set that binds it and the
+// buffer the shader writes.
+static bool initCaptureTexelBuffer(CaptureSlot *slot) {
+    CapturePool *pool = slot->pool;
+    VkDevice device = pool->device;
+    VkPhysicalDevice physicalDevice = pool->deviceData->physicalDevice;
+    VkLayerDispatchTable *pTableDevice = pool->pTableDevice;
+    VkLayerInstanceDispatchTable *pInstanceTable = instance_dispatch_table(physicalDevice);
+    VkResult err;
+    bool pass;
+
+    const VkBufferCreateInfo bufferCreateInfo = {VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+                                                 NULL,
+                                                 0,
+                                                 (VkDeviceSize)pool->width * pool->height * 4,
+                                                 VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                                                 VK_SHARING_MODE_EXCLUSIVE,
+                                                 0,
+                                                 NULL};
+    err = pTableDevice->CreateBuffer(device, &bufferCreateInfo, NULL, &slot->texelBuffer);
+    assert(!err);
+    if (VK_SUCCESS != err) return false;
+
+    VkMemoryRequirements memRequirements;
+    VkPhysicalDeviceMemoryProperties memoryProperties;
+    VkMemoryAllocateInfo memAllocInfo = {VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO, NULL, 0, 0};
+    pTableDevice->GetBufferMemoryRequirements(device, slot->texelBuffer, &memRequirements);
+    memAllocInfo.allocationSize = memRequirements.size;
+    pInstanceTable->GetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
+    pass = memory_type_from_properties(&memoryProperties, memRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                                       &memAllocInfo.memoryTypeIndex) ||
+           memory_type_from_properties(&memoryProperties, memRequirements.memoryTypeBits, 0, &memAllocInfo.memoryTypeIndex);
+    assert(pass);
+    err = pTableDevice->AllocateMemory(device, &memAllocInfo, NULL, &slot->texelMem);
+    assert(!err);
+    if (VK_SUCCESS != err) return false;
+    err = pTableDevice->BindBufferMemory(device, slot->texelBuffer, slot->texelMem, 0);
+    assert(!err);
+    if (VK_SUCCESS != err) return false;
+
+    const VkDescriptorPoolSize poolSize = {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2};
+    const VkDescriptorPoolCreateInfo descriptorPoolCreateInfo = {VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO, NULL, 0, 1, 1,
+                                                                 &poolSize};
+    err = pTableDevice->CreateDescriptorPool(device, &descriptorPoolCreateInfo, NULL, &slot->descriptorPool);
+    assert(!err);
+    if (VK_SUCCESS != err) return false;
+    const VkDescriptorSetAllocateInfo descriptorSetAllocateInfo = {VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO, NULL,
+                                                                   slot->descriptorPool, 1, &pool->descriptorSetLayout};
+    err = pTableDevice->AllocateDescriptorSets(device, &descriptorSetAllocateInfo, &slot->descriptorSet);
+    assert(!err);
+    if (VK_SUCCESS != err) return false;
+
+    const VkDescriptorBufferInfo bufferInfos[2] = {{slot->texelBuffer, 0, VK_WHOLE_SIZE}, {slot->buffer, 0, VK_WHOLE_SIZE}};
+    VkWriteDescriptorSet writes[2];
+    for (uint32_t i = 0; i < 2; i++) {
+        writes[i] = {VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+                     NULL,
+                     slot->descriptorSet,
+                     i,
+                     0,
+                     1,
+                     VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                     NULL,
+                     &bufferInfos[i],
+                     NULL};
+    }
+    pTableDevice->UpdateDescriptorSets(device, 2, writes, 0, NULL);
+    return true;
+}
+
+// Create the staging resources, command pool and fence of a capture slot.
+static bool initCaptureSlot(CaptureSlot *slot, uint32_t imageCount) {
+    CapturePool *pool = slot->pool;
+    VkDevice device = pool->device;
+    VkLayerDispatchTable *pTableDevice = pool->pTableDevice;
+    VkResult err;
+
+    if (!(pool->useBuffer || pool->useCompute ? initCaptureBuffer(slot) : initCaptureImages(slot))) return false;
+    if (pool->useCompute && !initCaptureTexelBuffer(slot)) return false;
+
     // We want to create our own command pool to be sure we can use it from this thread
     VkCommandPoolCreateInfo cmd_pool_info = {};
     cmd_pool_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
     cmd_pool_info.pNext = NULL;
-    auto it = deviceMap[device]->queueIndexMap.find(queue);
-    assert(it != deviceMap[device]->queueIndexMap.end());
-    cmd_pool_info.queueFamilyIndex = it->second;
+    cmd_pool_info.queueFamilyIndex = pool->queueFamilyIndex;
     cmd_pool_info.flags = 0;
 
-    err = pTableDevice->CreateCommandPool(device, &cmd_pool_info, NULL, &data.commandPool);
+    err = pTableDevice->CreateCommandPool(device, &cmd_pool_info, NULL, &slot->commandPool);
+    assert(!err);
+    if (VK_SUCCESS != err) return false;
+    slot->commandBuffers.resize(imageCount, VK_NULL_HANDLE);
+
+    const VkFenceCreateInfo fenceCreateInfo = {VK_STRUCTURE_TYPE_FENCE_CREATE_INFO, NULL, 0};
+    err = pTableDevice->CreateFence(device, &fenceCreateInfo, NULL, &slot->fence);
     assert(!err);
+    return VK_SUCCESS == err;
+}
+
+// Take a free slot from the pool, creating one if the pool is not full, or
+// wait for the writer thread to return one.
+static CaptureSlot *acquireCaptureSlot(CapturePool *pool, uint32_t imageCount) {
+    {
+        std::unique_lock<std::mutex> lock(captureLock);
+        if (pool->freeSlots.empty() && pool->slots.size() >= maxCapturesInFlight) {
+            captureCondition.wait(lock, [pool] { return !pool->freeSlots.empty(); });
+        }
+        if (!pool->freeSlots.empty()) {
+            CaptureSlot *slot = pool->freeSlots.back();
+            pool->freeSlots.pop_back();
+            return slot;
+        }
+    }
+
+    CaptureSlot *slot = new CaptureSlot();
+    slot->pool = pool;
+    if (!initCaptureSlot(slot, imageCount)) {
+        destroyCaptureSlot(slot);
+        return NULL;
+    }
+    pool->slots.push_back(slot);
+    return slot;
+}
+
+// Get the command buffer that copies swapchain image imageIndex into the
+// slot, recording it the first time it is needed.  Every barrier starts
+// from the layout the image is left in, so the command buffer can be
+// submitted again for each capture.
+static VkCommandBuffer getCaptureCommandBuffer(CaptureSlot *slot, uint32_t imageIndex, VkImage image1) {
+    CapturePool *pool = slot->pool;
+    if (slot->commandBuffers[imageIndex]) return slot->commandBuffers[imageIndex];
+
+    VkDevice device = pool->device;
+    DeviceData *deviceData = pool->deviceData;
+    VkCommandBuffer commandBuffer;
+    VkResult err;
 
     // Set up the command buffer.
     const VkCommandBufferAllocateInfo allocCommandBufferInfo = {VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO, NULL,
-                                                                data.commandPool, VK_COMMAND_BUFFER_LEVEL_PRIMARY, 1};
-    err = pTableDevice->AllocateCommandBuffers(device, &allocCommandBufferInfo, &data.commandBuffer);
+                                                                slot->commandPool, VK_COMMAND_BUFFER_LEVEL_PRIMARY, 1};
+    err = pool->pTableDevice->AllocateCommandBuffers(device, &allocCommandBufferInfo, &commandBuffer);
     assert(!err);
-    if (VK_SUCCESS != err) return;
+    if (VK_SUCCESS != err) return VK_NULL_HANDLE;
 
-    VkDevice cmdBuf = static_cast<VkDevice>(static_cast<void *>(data.commandBuffer));
-    if (deviceMap.find(cmdBuf) != deviceMap.end()) {
-        // Remove element with key cmdBuf from deviceMap so we can replace it
-        deviceMap.erase(cmdBuf);
-    }
-    dispatchMap.emplace(cmdBuf, dispMap);
-    VkLayerDispatchTable *pTableCommandBuffer;
-    pTableCommandBuffer = get_dispatch_info(cmdBuf)->device_dispatch_table;
+    VkLayerDispatchTable *pTableCommandBuffer = pool->pTableDevice;
 
     // We have just created a dispatchable object, but the dispatch table has
     // not been placed in the object yet.  When a "normal" application creates
     // a command buffer, the dispatch table is installed by the top-level api
     // binding (trampoline.c). But here, we have to do it ourselves.
-    if (!dispMap->pfn_dev_init) {
-        *((const void **)data.commandBuffer) = *(void **)device;
+    if (!deviceData->pfn_dev_init) {
+        *((const void **)commandBuffer) = *(void **)device;
     } else {
-        err = dispMap->pfn_dev_init(device, (void *)data.commandBuffer);
+        err = deviceData->pfn_dev_init(device, (void *)commandBuffer);
         assert(!err);
     }
 
     const VkCommandBufferBeginInfo commandBufferBeginInfo = {
         VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
         NULL,
-        VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+        0,
     };
-    err = pTableCommandBuffer->BeginCommandBuffer(data.commandBuffer, &commandBufferBeginInfo);
+    err = pTableCommandBuffer->BeginCommandBuffer(commandBuffer, &commandBufferBeginInfo);
     assert(!err);
 
     // This barrier is used to transition from/to present Layout
@@ -889,7 +1833,7 @@ static void writePPM(const char *filename, VkImage image1) {
                                               VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
                                               VK_QUEUE_FAMILY_IGNORED,
                                               VK_QUEUE_FAMILY_IGNORED,
-                                              data.image2,
+                                              slot->image2,
                                               {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1}};
 
     // This barrier is used to transition a dest layout to general layout.
@@ -901,74 +1845,140 @@ static void writePPM(const char *filename, VkImage image1) {
                                                  VK_IMAGE_LAYOUT_GENERAL,
                                                  VK_QUEUE_FAMILY_IGNORED,
                                                  VK_QUEUE_FAMILY_IGNORED,
-                                                 data.image2,
+                                                 slot->image2,
                                                  {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1}};
 
     VkPipelineStageFlags srcStages = VK_PIPELINE_STAGE_TRANSFER_BIT;
     VkPipelineStageFlags dstStages = VK_PIPELINE_STAGE_TRANSFER_BIT;
 
     // The source image needs to be transitioned from present to transfer
-    // source.
-    pTableCommandBuffer->CmdPipelineBarrier(data.commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, dstStages, 0, 0, NULL, 0,
-                                            NULL, 1, &presentMemoryBarrier);
-
-    // image2 needs to be transitioned from its undefined state to transfer
-    // destination.
-    pTableCommandBuffer->CmdPipelineBarrier(data.commandBuffer, srcStages, dstStages, 0, 0, NULL, 0, NULL, 1, &destMemoryBarrier);
-
-    const VkImageCopy imageCopyRegion = {
-        {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1}, {0, 0, 0}, {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1}, {0, 0, 0}, {width, height, 1}};
+    // source, after every earlier command on the queue and the semaphores
+    // the present waits on.
+    pTableCommandBuffer->CmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, dstStages, 0, 0, NULL, 0, NULL, 1,
+                                            &presentMemoryBarrier);
 
-    if (copyOnly) {
-        pTableCommandBuffer->CmdCopyImage(data.commandBuffer, image1, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, data.image2,
-                                          VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &imageCopyRegion);
+    if (pool->useCompute) {
+        // Copy the image as it is into the texel buffer and convert it into
+        // the buffer read by the CPU, making the result visible to the host
+        // once the fence signals.
+        const VkBufferImageCopy bufferCopyRegion = {
+            0, 0, 0, {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1}, {0, 0, 0}, {pool->width, pool->height, 1}};
+        pTableCommandBuffer->CmdCopyImageToBuffer(commandBuffer, image1, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, slot->texelBuffer,
+                                                  1, &bufferCopyRegion);
+
+        VkBufferMemoryBarrier bufferMemoryBarrier = {VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+                                                     NULL,
+                                                     VK_ACCESS_TRANSFER_WRITE_BIT,
+                                                     VK_ACCESS_SHADER_READ_BIT,
+                                                     VK_QUEUE_FAMILY_IGNORED,
+                                                     VK_QUEUE_FAMILY_IGNORED,
+                                                     slot->texelBuffer,
+                                                     0,
+                                                     VK_WHOLE_SIZE};
+        pTableCommandBuffer->CmdPipelineBarrier(commandBuffer, srcStages, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, NULL, 1,
+                                                &bufferMemoryBarrier, 0, NULL);
+
+        const ConvertParameters parameters = {pool->width,
+                                              pool->height,
+                                              {pool->shifts[0], pool->shifts[1], pool->shifts[2]},
+                                              pool->scale,
+                                              pool->outWidth,
+                                              pool->outHeight,
+                                              pool->rowWords};
+        pTableCommandBuffer->CmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pool->pipeline);
+        pTableCommandBuffer->CmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pool->pipelineLayout, 0, 1,
+                                                   &slot->descriptorSet, 0, NULL);
+        pTableCommandBuffer->CmdPushConstants(commandBuffer, pool->pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0,
+                                              sizeof(parameters), &parameters);
+        // Each invocation writes 4 pixels, in 8x8 workgroups.
+        pTableCommandBuffer->CmdDispatch(commandBuffer, (pool->rowWords / 3 + 7) / 8, (pool->outHeight + 7) / 8, 1);
+
+        bufferMemoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        bufferMemoryBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+        bufferMemoryBarrier.buffer = slot->buffer;
+        pTableCommandBuffer->CmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0,
+                                                0, NULL, 1, &bufferMemoryBarrier, 0, NULL);
+    } else if (pool->useBuffer) {
+        // Copy the image as it is into the buffer, and make the copy visible
+        // to the host once the fence signals.
+        const VkBufferImageCopy bufferCopyRegion = {
+            0, 0, 0, {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1}, {0, 0, 0}, {pool->width, pool->height, 1}};
+        pTableCommandBuffer->CmdCopyImageToBuffer(commandBuffer, image1, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, slot->buffer, 1,
+                                                  &bufferCopyRegion);
+
+        const VkBufferMemoryBarrier hostMemoryBarrier = {VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+                                                         NULL,
+                                                         VK_ACCESS_TRANSFER_WRITE_BIT,
+                                                         VK_ACCESS_HOST_READ_BIT,
+                                                         VK_QUEUE_FAMILY_IGNORED,
+                                                         VK_QUEUE_FAMILY_IGNORED,
+                                                         slot->buffer,
+                                                         0,
+                                                         VK_WHOLE_SIZE};
+        pTableCommandBuffer->CmdPipelineBarrier(commandBuffer, srcStages, VK_PIPELINE_STAGE_HOST_BIT, 0, 0, NULL, 1,
+                                                &hostMemoryBarrier, 0, NULL);
     } else {
-        VkImageBlit imageBlitRegion = {};
-        imageBlitRegion.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-        imageBlitRegion.srcSubresource.baseArrayLayer = 0;
-        imageBlitRegion.srcSubresource.layerCount = 1;
-        imageBlitRegion.srcSubresource.mipLevel = 0;
-        imageBlitRegion.srcOffsets[1].x = width;
-        imageBlitRegion.srcOffsets[1].y = height;
-        imageBlitRegion.srcOffsets[1].z = 1;
-        imageBlitRegion.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-        imageBlitRegion.dstSubresource.baseArrayLayer = 0;
-        imageBlitRegion.dstSubresource.layerCount = 1;
-        imageBlitRegion.dstSubresource.mipLevel = 0;
-        imageBlitRegion.dstOffsets[1].x = width;
-        imageBlitRegion.dstOffsets[1].y = height;
-        imageBlitRegion.dstOffsets[1].z = 1;
-
-        pTableCommandBuffer->CmdBlitImage(data.commandBuffer, image1, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, data.image2,
-                                          VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &imageBlitRegion, VK_FILTER_NEAREST);
-        if (need2steps) {
-            // image 3 needs to be transitioned from its undefined state to a
-            // transfer destination.
-            destMemoryBarrier.image = data.image3;
-            pTableCommandBuffer->CmdPipelineBarrier(data.commandBuffer, srcStages, dstStages, 0, 0, NULL, 0, NULL, 1,
-                                                    &destMemoryBarrier);
-
-            // Transition image2 so that it can be read for the upcoming copy to
-            // image 3.
-            destMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-            destMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
-            destMemoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-            destMemoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
-            destMemoryBarrier.image = data.image2;
-            pTableCommandBuffer->CmdPipelineBarrier(data.commandBuffer, srcStages, dstStages, 0, 0, NULL, 0, NULL, 1,
-                                                    &destMemoryBarrier);
-
-            // This step essentially untiles the image.
-            pTableCommandBuffer->CmdCopyImage(data.commandBuffer, data.image2, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, data.image3,
+        // image2 needs to be transitioned from its undefined state to transfer
+        // destination.
+        pTableCommandBuffer->CmdPipelineBarrier(commandBuffer, srcStages, dstStages, 0, 0, NULL, 0, NULL, 1, &destMemoryBarrier);
+
+        const VkImageCopy imageCopyRegion = {{VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1},
+                                             {0, 0, 0},
+                                             {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1},
+                                             {0, 0, 0},
+                                             {pool->width, pool->height, 1}};
+
+        if (pool->copyOnly) {
+            pTableCommandBuffer->CmdCopyImage(commandBuffer, image1, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, slot->image2,
                                               VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &imageCopyRegion);
-            generalMemoryBarrier.image = data.image3;
+        } else {
+            VkImageBlit imageBlitRegion = {};
+            imageBlitRegion.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+            imageBlitRegion.srcSubresource.baseArrayLayer = 0;
+            imageBlitRegion.srcSubresource.layerCount = 1;
+            imageBlitRegion.srcSubresource.mipLevel = 0;
+            imageBlitRegion.srcOffsets[1].x = pool->width;
+            imageBlitRegion.srcOffsets[1].y = pool->height;
+            imageBlitRegion.srcOffsets[1].z = 1;
+            imageBlitRegion.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+            imageBlitRegion.dstSubresource.baseArrayLayer = 0;
+            imageBlitRegion.dstSubresource.layerCount = 1;
+            imageBlitRegion.dstSubresource.mipLevel = 0;
+            imageBlitRegion.dstOffsets[1].x = pool->width;
+            imageBlitRegion.dstOffsets[1].y = pool->height;
+            imageBlitRegion.dstOffsets[1].z = 1;
+
+            pTableCommandBuffer->CmdBlitImage(commandBuffer, image1, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, slot->image2,
+                                              VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &imageBlitRegion, VK_FILTER_NEAREST);
+            if (pool->need2steps) {
+                // image 3 needs to be transitioned from its undefined state to a
+                // transfer destination.
+                destMemoryBarrier.image = slot->image3;
+                pTableCommandBuffer->CmdPipelineBarrier(commandBuffer, srcStages, dstStages, 0, 0, NULL, 0, NULL, 1,
+                                                        &destMemoryBarrier);
+
+                // Transition image2 so that it can be read for the upcoming copy to
+                // image 3.
+                destMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+                destMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+                destMemoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+                destMemoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+                destMemoryBarrier.image = slot->image2;
+                pTableCommandBuffer->CmdPipelineBarrier(commandBuffer, srcStages, dstStages, 0, 0, NULL, 0, NULL, 1,
+                                                        &destMemoryBarrier);
+
+                // This step essentially untiles the image.
+                pTableCommandBuffer->CmdCopyImage(commandBuffer, slot->image2, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, slot->image3,
+                                                  VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &imageCopyRegion);
+                generalMemoryBarrier.image = slot->image3;
+            }
         }
-    }
 
-    // The destination needs to be transitioned from the optimal copy format to
-    // the format we can read with the CPU.
-    pTableCommandBuffer->CmdPipelineBarrier(data.commandBuffer, srcStages, dstStages, 0, 0, NULL, 0, NULL, 1,
-                                            &generalMemoryBarrier);
+        // The destination needs to be transitioned from the optimal copy format to
+        // the format we can read with the CPU.
+        pTableCommandBuffer->CmdPipelineBarrier(commandBuffer, srcStages, dstStages, 0, 0, NULL, 0, NULL, 1,
+                                                &generalMemoryBarrier);
+    }
 
     // Restore the swap chain image layout to what it was before.
     // This may not be strictly needed, but it is generally good to restore
@@ -977,89 +1987,115 @@ static void writePPM(const char *filename, VkImage image1) {
     presentMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
     presentMemoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
     presentMemoryBarrier.dstAccessMask = 0;
-    pTableCommandBuffer->CmdPipelineBarrier(data.commandBuffer, srcStages, dstStages, 0, 0, NULL, 0, NULL, 1,
+    pTableCommandBuffer->CmdPipelineBarrier(commandBuffer, srcStages, dstStages, 0, 0, NULL, 0, NULL, 1,
                                             &presentMemoryBarrier);
 
-    err = pTableCommandBuffer->EndCommandBuffer(data.commandBuffer);
-    assert(!err);
-
-    VkFence nullFence = {VK_NULL_HANDLE};
-    VkSubmitInfo submitInfo;
-    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-    submitInfo.pNext = NULL;
-    submitInfo.waitSemaphoreCount = 0;
-    submitInfo.pWaitSemaphores = NULL;
-    submitInfo.pWaitDstStageMask = NULL;
-    submitInfo.commandBufferCount = 1;
-    submitInfo.pCommandBuffers = &data.commandBuffer;
-    submitInfo.signalSemaphoreCount = 0;
-    submitInfo.pSignalSemaphores = NULL;
-
-    err = pTableQueue->QueueSubmit(queue, 1, &submitInfo, nullFence);
-    assert(!err);
-
-    err = pTableQueue->QueueWaitIdle(queue);
-    assert(!err);
-
-    err = pTableDevice->DeviceWaitIdle(device);
+    err = pTableCommandBuffer->EndCommandBuffer(commandBuffer);
     assert(!err);
+    slot->commandBuffers[imageIndex] = commandBuffer;
+    return commandBuffer;
+}
 
-    // Map the final image so that the CPU can read it.
-    const VkImageSubresource sr = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0};
-    VkSubresourceLayout srLayout;
-    const char *ptr;
-    if (!need2steps) {
-        pTableDevice->GetImageSubresourceLayout(device, data.image2, &sr, &srLayout);
-        err = pTableDevice->MapMemory(device, data.mem2, 0, VK_WHOLE_SIZE, 0, (void **)&ptr);
-        assert(!err);
-        if (VK_SUCCESS != err) return;
-        data.mem2mapped = true;
-    } else {
-        pTableDevice->GetImageSubresourceLayout(device, data.image3, &sr, &srLayout);
-        err = pTableDevice->MapMemory(device, data.mem3, 0, VK_WHOLE_SIZE, 0, (void **)&ptr);
-        assert(!err);
-        if (VK_SUCCESS != err) return;
-        data.mem3mapped = true;
-    }
+// Save a swapchain image to a PPM, PNG or QOI image file.
+//
+// This function submits commands to copy/convert the swapchain image
+// from whatever compatible format the swapchain image uses
+// to a single format (VK_FORMAT_R8G8B8A8_UNORM) so that the converted
+// result can be easily written to an RGB file, copies it as it is into a
+// buffer when the CPU can do the conversion, or converts and downscales it
+// with a compute shader before it is read back.  The staging resources, memory
+// and command buffers come from the swapchain's capture pool, so nothing
+// is allocated once the pool has warmed up.
+//
+// The copy is submitted with its slot's fence and the file is encoded and
+// written later by a capture writer thread, so the GPU is never idled here.
+// The submission waits on the semaphores the present waits on and signals
+// them again, so the copy starts once the frame is rendered and the present
+// still waits for the same semaphores, now signaled after the copy.  When the
+// frame is presented on a queue that cannot blit, the copy goes to another
+// queue and this function waits for its fence before returning, because
+// nothing else orders the copy before the present.
+//
+// Error handling: If there is a problem, this function should silently
+// fail without affecting the Present operation going on in the caller.
+// The numerous debug asserts are to catch programming errors and are not
+// expected to assert.  Recovery and clean up are implemented for image memory
+// allocation failures.
+// (TODO) It would be nice to pass any failure info to DebugReport or something.
+// Called with the device's lock held.  A pool that has to be replaced is
+// added to stalePools, for the caller to destroy once the lock is released.
+static void writeScreenshot(const char *filename, const char *frameName, DeviceData *deviceData, SwapchainData *swapchainData,
+                            uint32_t imageIndex, VkQueue presentQueue, uint32_t waitSemaphoreCount,
+                            const VkSemaphore *pWaitSemaphores, vector<CapturePool *> &stalePools) {
+    VkResult err;
 
-    // Write the data to a PPM file.
-    ofstream file(filename, ios::binary);
-    assert(file.is_open());
+    // Bail immediately if we don't have the swapchain images.
+    if (imageIndex >= swapchainData->imageCount) return;
+    VkImage image1 = swapchainData->getImage(imageIndex);
+    VkDevice device = deviceData->device;
 
-    if (!file.is_open()) {
+    // Submitting to the present queue orders the present after the copy
+    // without waiting for it.
+    bool const asyncCapture = queueCanCapture(deviceData, presentQueue);
+    VkQueue queue = asyncCapture ? presentQueue : getQueueForScreenshot(deviceData);
+    if (!queue) {
 #ifdef ANDROID
-        __android_log_print(ANDROID_LOG_DEBUG, "screenshot",
-                            "Failed to open output file: %s.  Be sure to grant read and write permissions.", filename);
+        __android_log_print(ANDROID_LOG_ERROR, "screenshot", "Failure - capable queue not found\n");
 #else
-        fprintf(stderr, "Failed to open output file:%s,  Be sure to grant read and write permissions\n", filename);
+        fprintf(stderr, "Screenshot could not find a capable queue\n");
 #endif
         return;
     }
+    VkLayerDispatchTable *pTableQueue = &deviceData->dispatchTable;
+    auto it = deviceData->queueFamilyIndices.find(queue);
+    assert(it != deviceData->queueFamilyIndices.end());
+    uint32_t const queueFamilyIndex = it->second;
+
+    // The command pools of the slots belong to one queue family.
+    CapturePool *pool = swapchainData->capturePool;
+    if (pool && pool->queueFamilyIndex != queueFamilyIndex) {
+        stalePools.push_back(pool);
+        pool = swapchainData->capturePool = NULL;
+    }
+    if (!pool) {
+        pool = swapchainData->capturePool = createCapturePool(deviceData, swapchainData, queueFamilyIndex);
+        if (!pool) return;
+    }
 
-    file << "P6\n";
-    file << width << "\n";
-    file << height << "\n";
-    file << 255 << "\n";
+    CaptureSlot *slot = acquireCaptureSlot(pool, swapchainData->imageCount);
+    if (!slot) return;
+    slot->filename = filename;
+    slot->frameName = frameName;
 
-    ptr += srLayout.offset;
-    if (3 == numChannels) {
-        for (uint32_t y = 0; y < height; y++) {
-            file.write(ptr, 3 * width);
-            ptr += srLayout.rowPitch;
-        }
-    } else if (4 == numChannels) {
-        for (uint32_t y = 0; y < height; y++) {
-            const unsigned int *row = (const unsigned int *)ptr;
-            for (uint32_t x = 0; x < width; x++) {
-                file.write((char *)row, 3);
-                row++;
-            }
-            ptr += srLayout.rowPitch;
-        }
+    VkCommandBuffer commandBuffer = getCaptureCommandBuffer(slot, imageIndex, image1);
+    err = commandBuffer ? pool->pTableDevice->ResetFences(device, 1, &slot->fence) : VK_ERROR_INITIALIZATION_FAILED;
+    assert(!err);
+
+    vector<VkPipelineStageFlags> waitStages(waitSemaphoreCount, VK_PIPELINE_STAGE_TRANSFER_BIT);
+    VkSubmitInfo submitInfo;
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.pNext = NULL;
+    submitInfo.waitSemaphoreCount = waitSemaphoreCount;
+    submitInfo.pWaitSemaphores = pWaitSemaphores;
+    submitInfo.pWaitDstStageMask = waitStages.data();
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &commandBuffer;
+    submitInfo.signalSemaphoreCount = waitSemaphoreCount;
+    submitInfo.pSignalSemaphores = pWaitSemaphores;
+
+    if (VK_SUCCESS == err) {
+        err = pTableQueue->QueueSubmit(queue, 1, &submitInfo, slot->fence);
+        assert(!err);
     }
-    file.close();
 
-    // Clean up handled by ~WritePPMCleanupData()
+    if (VK_SUCCESS == err && asyncCapture) {
+        queueCapture(slot);
+        return;
+    }
+    if (VK_SUCCESS == err) writeCapture(*slot);
+    std::lock_guard<std::mutex> lock(captureLock);
+    pool->freeSlots.push_back(slot);
+    captureCondition.notify_all();
 }
 
 VKAPI_ATTR VkResult VKAPI_CALL CreateInstance(const VkInstanceCreateInfo *pCreateInfo, const VkAllocationCallbacks *pAllocator,
@@ -1081,6 +2117,10 @@ VKAPI_ATTR VkResult VKAPI_CALL CreateInstance(const VkInstanceCreateInfo *pCreat
     if (result != VK_SUCCESS) return result;
 
     initInstanceTable(*pInstance, fpGetInstanceProcAddr);
+    {
+        std::lock_guard<std::mutex> lock(layerDataLock);
+        instanceMap[get_dispatch_key(*pInstance)] = *pInstance;
+    }
 
     init_screenshot();
 
@@ -1089,19 +2129,18 @@ VKAPI_ATTR VkResult VKAPI_CALL CreateInstance(const VkInstanceCreateInfo *pCreat
 
 // TODO hook DestroyInstance to cleanup
 
-static void createDeviceRegisterExtensions(const VkDeviceCreateInfo *pCreateInfo, VkDevice device) {
+static void createDeviceRegisterExtensions(const VkDeviceCreateInfo *pCreateInfo, DeviceData *deviceData) {
     uint32_t i;
-    DispatchMapStruct *dispMap = get_dispatch_info(device);
-    DeviceMapStruct *devMap = get_device_info(device);
-    VkLayerDispatchTable *pDisp = dispMap->device_dispatch_table;
+    VkDevice device = deviceData->device;
+    VkLayerDispatchTable *pDisp = &deviceData->dispatchTable;
     PFN_vkGetDeviceProcAddr gpa = pDisp->GetDeviceProcAddr;
     pDisp->CreateSwapchainKHR = (PFN_vkCreateSwapchainKHR)gpa(device, "vkCreateSwapchainKHR");
     pDisp->GetSwapchainImagesKHR = (PFN_vkGetSwapchainImagesKHR)gpa(device, "vkGetSwapchainImagesKHR");
     pDisp->AcquireNextImageKHR = (PFN_vkAcquireNextImageKHR)gpa(device, "vkAcquireNextImageKHR");
     pDisp->QueuePresentKHR = (PFN_vkQueuePresentKHR)gpa(device, "vkQueuePresentKHR");
-    devMap->wsi_enabled = false;
+    deviceData->wsi_enabled = false;
     for (i = 0; i < pCreateInfo->enabledExtensionCount; i++) {
-        if (strcmp(pCreateInfo->ppEnabledExtensionNames[i], VK_KHR_SWAPCHAIN_EXTENSION_NAME) == 0) devMap->wsi_enabled = true;
+        if (strcmp(pCreateInfo->ppEnabledExtensionNames[i], VK_KHR_SWAPCHAIN_EXTENSION_NAME) == 0) deviceData->wsi_enabled = true;
     }
 }
 
@@ -1112,7 +2151,12 @@ VKAPI_ATTR VkResult VKAPI_CALL CreateDevice(VkPhysicalDevice gpu, const VkDevice
     assert(chain_info->u.pLayerInfo);
     PFN_vkGetInstanceProcAddr fpGetInstanceProcAddr = chain_info->u.pLayerInfo->pfnNextGetInstanceProcAddr;
     PFN_vkGetDeviceProcAddr fpGetDeviceProcAddr = chain_info->u.pLayerInfo->pfnNextGetDeviceProcAddr;
-    VkInstance instance = physDeviceMap[gpu]->instance;
+    VkInstance instance = VK_NULL_HANDLE;
+    {
+        std::lock_guard<std::mutex> lock(layerDataLock);
+        auto instanceIter = instanceMap.find(get_dispatch_key(gpu));
+        if (instanceIter != instanceMap.end()) instance = instanceIter->second;
+    }
     PFN_vkCreateDevice fpCreateDevice = (PFN_vkCreateDevice)fpGetInstanceProcAddr(instance, "vkCreateDevice");
     if (fpCreateDevice == NULL) {
         return VK_ERROR_INITIALIZATION_FAILED;
@@ -1126,102 +2170,78 @@ VKAPI_ATTR VkResult VKAPI_CALL CreateDevice(VkPhysicalDevice gpu, const VkDevice
         return result;
     }
 
-    assert(deviceMap.find(*pDevice) == deviceMap.end());
-    DeviceMapStruct *deviceMapElem = new DeviceMapStruct;
-    deviceMap[*pDevice] = deviceMapElem;
-    assert(dispatchMap.find(*pDevice) == dispatchMap.end());
-    DispatchMapStruct *dispatchMapElem = new DispatchMapStruct;
-    dispatchMap[*pDevice] = dispatchMapElem;
+    DeviceData *deviceData = new DeviceData();
+    deviceData->device = *pDevice;
+    deviceData->physicalDevice = gpu;
 
     // Setup device dispatch table
-    dispatchMapElem->device_dispatch_table = new VkLayerDispatchTable;
-    layer_init_device_dispatch_table(*pDevice, dispatchMapElem->device_dispatch_table, fpGetDeviceProcAddr);
+    layer_init_device_dispatch_table(*pDevice, &deviceData->dispatchTable, fpGetDeviceProcAddr);
 
-    createDeviceRegisterExtensions(pCreateInfo, *pDevice);
-    // Create a mapping from a device to a physicalDevice
-    deviceMapElem->physicalDevice = gpu;
+    createDeviceRegisterExtensions(pCreateInfo, deviceData);
+
+    // The queue families are checked on every capture, so they are only
+    // queried once.
+    uint32_t count;
+    VkLayerInstanceDispatchTable *pInstanceTable = instance_dispatch_table(gpu);
+    pInstanceTable->GetPhysicalDeviceQueueFamilyProperties(gpu, &count, NULL);
+    deviceData->queueFamilyProperties.resize(count);
+    pInstanceTable->GetPhysicalDeviceQueueFamilyProperties(gpu, &count, deviceData->queueFamilyProperties.data());
 
     // store the loader callback for initializing created dispatchable objects
     chain_info = get_chain_info(pCreateInfo, VK_LOADER_DATA_CALLBACK);
     if (chain_info) {
-        dispatchMapElem->pfn_dev_init = chain_info->u.pfnSetDeviceLoaderData;
+        deviceData->pfn_dev_init = chain_info->u.pfnSetDeviceLoaderData;
     } else {
-        dispatchMapElem->pfn_dev_init = NULL;
+        deviceData->pfn_dev_init = NULL;
     }
-    return result;
-}
-
-VKAPI_ATTR VkResult VKAPI_CALL EnumeratePhysicalDevices(VkInstance instance, uint32_t *pPhysicalDeviceCount,
-                                                        VkPhysicalDevice *pPhysicalDevices) {
-    VkResult result;
 
-    VkLayerInstanceDispatchTable *pTable = instance_dispatch_table(instance);
-    result = pTable->EnumeratePhysicalDevices(instance, pPhysicalDeviceCount, pPhysicalDevices);
-    if (result == VK_SUCCESS && *pPhysicalDeviceCount > 0 && pPhysicalDevices) {
-        for (uint32_t i = 0; i < *pPhysicalDeviceCount; i++) {
-            // Create a mapping from a physicalDevice to an instance
-            if (physDeviceMap[pPhysicalDevices[i]] == NULL) {
-                PhysDeviceMapStruct *physDeviceMapElem = new PhysDeviceMapStruct;
-                physDeviceMap[pPhysicalDevices[i]] = physDeviceMapElem;
-            }
-            physDeviceMap[pPhysicalDevices[i]]->instance = instance;
-        }
-    }
+    std::lock_guard<std::mutex> lock(layerDataLock);
+    assert(!getDeviceData(*pDevice));
+    updateDeviceDataMap(get_dispatch_key(*pDevice), deviceData);
     return result;
 }
 
 VKAPI_ATTR void VKAPI_CALL DestroyDevice(VkDevice device, const VkAllocationCallbacks *pAllocator) {
-    DispatchMapStruct *dispMap = get_dispatch_info(device);
-    DeviceMapStruct *devMap = get_device_info(device);
-    assert(dispMap);
-    assert(devMap);
-    VkLayerDispatchTable *pDisp = dispMap->device_dispatch_table;
+    dispatch_key key = get_dispatch_key(device);
+    DeviceData *deviceData = getDeviceData(device);
+    assert(deviceData);
+    VkLayerDispatchTable *pDisp = &deviceData->dispatchTable;
+
+    // Free the capture pools of swapchains that were not destroyed, which
+    // waits for the captures still being written from them.
+    vector<CapturePool *> pools;
+    {
+        std::lock_guard<std::mutex> lock(deviceData->lock);
+        detachCapturePools(deviceData, pools);
+    }
+    destroyCapturePools(pools);
     pDisp->DestroyDevice(device, pAllocator);
 
     if (vk_screenshot_dir_used_env_var) {
         local_free_getenv(vk_screenshot_dir);
     }
 
-    loader_platform_thread_lock_mutex(&globalLock);
-    delete pDisp;
-    delete dispMap;
-    delete devMap;
-
-    deviceMap.erase(device);
-    loader_platform_thread_unlock_mutex(&globalLock);
+    std::lock_guard<std::mutex> lock(layerDataLock);
+    updateDeviceDataMap(key, NULL);
+    delete deviceData;
+    if (deviceDataMap.load(std::memory_order_relaxed)->empty()) {
+        stopCaptureWriter();
+        closeHashManifest();
+    }
 }
 
 VKAPI_ATTR void VKAPI_CALL GetDeviceQueue(VkDevice device, uint32_t queueFamilyIndex, uint32_t queueIndex, VkQueue *pQueue) {
-    DispatchMapStruct *dispMap = get_dispatch_info(device);
-    assert(dispMap);
-    VkLayerDispatchTable *pDisp = dispMap->device_dispatch_table;
+    DeviceData *deviceData = getDeviceData(device);
+    assert(deviceData);
+    VkLayerDispatchTable *pDisp = &deviceData->dispatchTable;
     pDisp->GetDeviceQueue(device, queueFamilyIndex, queueIndex, pQueue);
 
-    // Save the device queue in a map if we are taking screenshots.
-    loader_platform_thread_lock_mutex(&globalLock);
-    if (screenshotFramesReceived && screenshotFrames.empty() && !screenShotFrameRange.valid) {
-        // No screenshots in the list to take
-        loader_platform_thread_unlock_mutex(&globalLock);
-        return;
-    }
-
-    // Add this queue to deviceMap[device].queues, and queueFamilyIndex to deviceMap[device].queueIndexMap
-    if (deviceMap.find(device) != deviceMap.end()) {
-        deviceMap[device]->queues.emplace(*pQueue);
-
-        if (deviceMap[device]->queueIndexMap.find(*pQueue) != deviceMap[device]->queueIndexMap.end())
-            deviceMap[device]->queueIndexMap.erase(*pQueue);
-        deviceMap[device]->queueIndexMap.emplace(*pQueue, queueFamilyIndex);
-    }
-
-    // queues are dispatchable objects.
-    // Create dispatchMap entry with this queue as its key.
-    // Copy the device dispatch table to the new dispatch table.
-    VkDevice que = static_cast<VkDevice>(static_cast<void *>(*pQueue));
-    if (dispatchMap.find(que) != dispatchMap.end()) dispatchMap.erase(que);
-    dispatchMap.emplace(que, dispMap);
-
-    loader_platform_thread_unlock_mutex(&globalLock);
+    // Save the queue's family if we are taking screenshots.  Queues share
+    // their device's dispatch key, so nothing else is needed to find the
+    // device's state from a queue.
+    if (!capturesPending()) return;
+    std::lock_guard<std::mutex> lock(deviceData->lock);
+    deviceData->queueFamilyIndices[*pQueue] = queueFamilyIndex;
 }
 
 VKAPI_ATTR void VKAPI_CALL GetDeviceQueue2(VkDevice device, const VkDeviceQueueInfo2 *pQueueInfo, VkQueue *pQueue) {
@@ -1230,9 +2250,9 @@ VKAPI_ATTR void VKAPI_CALL GetDeviceQueue2(VkDevice device, const VkDeviceQueueI
 
 VKAPI_ATTR VkResult VKAPI_CALL CreateSwapchainKHR(VkDevice device, const VkSwapchainCreateInfoKHR *pCreateInfo,
                                                   const VkAllocationCallbacks *pAllocator, VkSwapchainKHR *pSwapchain) {
-    DispatchMapStruct *dispMap = get_dispatch_info(device);
-    assert(dispMap);
-    VkLayerDispatchTable *pDisp = dispMap->device_dispatch_table;
+    DeviceData *deviceData = getDeviceData(device);
+    assert(deviceData);
+    VkLayerDispatchTable *pDisp = &deviceData->dispatchTable;
 
     // This layer does an image copy later on, and the copy command expects the
     // transfer src bit to be on.
@@ -1240,152 +2260,154 @@ VKAPI_ATTR VkResult VKAPI_CALL CreateSwapchainKHR(VkDevice device, const VkSwapc
     myCreateInfo.imageUsage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
     VkResult result = pDisp->CreateSwapchainKHR(device, &myCreateInfo, pAllocator, pSwapchain);
 
-    // Save the swapchain in a map of we are taking screenshots.
-    loader_platform_thread_lock_mutex(&globalLock);
-    if (screenshotFramesReceived && screenshotFrames.empty() && !screenShotFrameRange.valid) {
-        // No screenshots in the list to take
-        loader_platform_thread_unlock_mutex(&globalLock);
-        return result;
+    // Save the swapchain's image extent and format if we are taking
+    // screenshots.
+    if (result != VK_SUCCESS || !capturesPending()) return result;
+
+    // If there's a (destroyed) swapchain with the same handle, replace it.
+    CapturePool *stalePool;
+    {
+        std::lock_guard<std::mutex> lock(deviceData->lock);
+        SwapchainData &swapchainData = deviceData->swapchains[*pSwapchain];
+        stalePool = swapchainData.capturePool;
+        swapchainData = SwapchainData();
+        swapchainData.imageExtent = pCreateInfo->imageExtent;
+        swapchainData.format = pCreateInfo->imageFormat;
     }
-
-    if (result == VK_SUCCESS) {
-        // Create a mapping for a swapchain to a device, image extent, and
-        // format
-        SwapchainMapStruct *swapchainMapElem = new SwapchainMapStruct;
-        swapchainMapElem->device = device;
-        swapchainMapElem->imageExtent = pCreateInfo->imageExtent;
-        swapchainMapElem->format = pCreateInfo->imageFormat;
-        // If there's a (destroyed) swapchain with the same handle, remove it from the swapchainMap
-        if (swapchainMap.find(*pSwapchain) != swapchainMap.end()) {
-            delete swapchainMap[*pSwapchain];
-            swapchainMap.erase(*pSwapchain);
-        }
-        swapchainMap.insert(make_pair(*pSwapchain, swapchainMapElem));
-
-        // Create a mapping for the swapchain object into the dispatch table
-        // TODO is this needed? screenshot_device_table_map.emplace((void
-        // *)pSwapchain, pTable);
-    }
-    loader_platform_thread_unlock_mutex(&globalLock);
-
+    destroyCapturePool(stalePool);
     return result;
 }
 
 VKAPI_ATTR VkResult VKAPI_CALL GetSwapchainImagesKHR(VkDevice device, VkSwapchainKHR swapchain, uint32_t *pCount,
                                                      VkImage *pSwapchainImages) {
-    DispatchMapStruct *dispMap = get_dispatch_info(device);
-    assert(dispMap);
-    VkLayerDispatchTable *pDisp = dispMap->device_dispatch_table;
+    DeviceData *deviceData = getDeviceData(device);
+    assert(deviceData);
+    VkLayerDispatchTable *pDisp = &deviceData->dispatchTable;
     VkResult result = pDisp->GetSwapchainImagesKHR(device, swapchain, pCount, pSwapchainImages);
 
-    // Save the swapchain images in a map if we are taking screenshots
-    loader_platform_thread_lock_mutex(&globalLock);
-    if (screenshotFramesReceived && screenshotFrames.empty() && !screenShotFrameRange.valid) {
-        // No screenshots in the list to take
-        loader_platform_thread_unlock_mutex(&globalLock);
-        return result;
-    }
-
-    if (result == VK_SUCCESS && pSwapchainImages && !swapchainMap.empty() && swapchainMap.find(swapchain) != swapchainMap.end()) {
-        unsigned i;
-
-        for (i = 0; i < *pCount; i++) {
-            // Create a mapping for an image to a device, image extent, and
-            // format
-            if (imageMap[pSwapchainImages[i]] == NULL) {
-                ImageMapStruct *imageMapElem = new ImageMapStruct;
-                imageMap[pSwapchainImages[i]] = imageMapElem;
-            }
-            imageMap[pSwapchainImages[i]]->device = swapchainMap[swapchain]->device;
-            imageMap[pSwapchainImages[i]]->imageExtent = swapchainMap[swapchain]->imageExtent;
-            imageMap[pSwapchainImages[i]]->format = swapchainMap[swapchain]->format;
+    // Save the swapchain images if we are taking screenshots
+    if (result != VK_SUCCESS || !pSwapchainImages || *pCount < 1 || !capturesPending()) return result;
+
+    CapturePool *stalePool = NULL;
+    {
+        std::lock_guard<std::mutex> lock(deviceData->lock);
+        auto it = deviceData->swapchains.find(swapchain);
+        if (it != deviceData->swapchains.end()) {
+            SwapchainData &swapchainData = it->second;
+            // Command buffers in the capture pool were recorded for the old list.
+            stalePool = swapchainData.capturePool;
+            swapchainData.capturePool = NULL;
+            uint32_t const inlineCount = std::min(*pCount, maxInlineSwapchainImages);
+            std::copy(pSwapchainImages, pSwapchainImages + inlineCount, swapchainData.images);
+            swapchainData.overflowImages.assign(pSwapchainImages + inlineCount, pSwapchainImages + *pCount);
+            swapchainData.imageCount = *pCount;
         }
+    }
+    destroyCapturePool(stalePool);
+    return result;
+}
 
-        // Add list of images to swapchain to image map
-        SwapchainMapStruct *swapchainMapElem = swapchainMap[swapchain];
-        if (i >= 1 && swapchainMapElem) {
-            VkImage *imageList = new VkImage[i];
-            swapchainMapElem->imageList = imageList;
-            for (unsigned j = 0; j < i; j++) {
-                swapchainMapElem->imageList[j] = pSwapchainImages[j];
-            }
+VKAPI_ATTR void VKAPI_CALL DestroySwapchainKHR(VkDevice device, VkSwapchainKHR swapchain, const VkAllocationCallbacks *pAllocator) {
+    DeviceData *deviceData = getDeviceData(device);
+    assert(deviceData);
+    VkLayerDispatchTable *pDisp = &deviceData->dispatchTable;
+
+    // Free the swapchain's capture pool, which waits for captures still using it.
+    CapturePool *stalePool = NULL;
+    {
+        std::lock_guard<std::mutex> lock(deviceData->lock);
+        auto it = deviceData->swapchains.find(swapchain);
+        if (it != deviceData->swapchains.end()) {
+            stalePool = it->second.capturePool;
+            deviceData->swapchains.erase(it);
         }
     }
-    loader_platform_thread_unlock_mutex(&globalLock);
-    return result;
+    destroyCapturePool(stalePool);
+
+    pDisp->DestroySwapchainKHR(device, swapchain, pAllocator);
 }
 
-VKAPI_ATTR VkResult VKAPI_CALL QueuePresentKHR(VkQueue queue, const VkPresentInfoKHR *pPresentInfo) {
-    static int frameNumber = 0;
-    DispatchMapStruct *dispMap = get_dispatch_info((VkDevice)queue);
-    assert(dispMap);
-    loader_platform_thread_lock_mutex(&globalLock);
-
-    if (!screenshotFrames.empty() || screenShotFrameRange.valid) {
-        set<int>::iterator it;
-        bool inScreenShotFrames = false;
-        bool inScreenShotFrameRange = false;
-        it = screenshotFrames.find(frameNumber);
+// Capture the swapchains of a present whose frame may be scheduled for a
+// capture, and move nextCaptureFrame on to the next frame that is.
+static void captureFrame(DeviceData *deviceData, int frameNumber, VkQueue queue, const VkPresentInfoKHR *pPresentInfo) {
+    bool inScreenShotFrames = false;
+    bool inScreenShotFrameRange = false;
+    vector<CapturePool *> stalePools;
+    {
+        std::lock_guard<std::mutex> lock(scheduleLock);
+        auto it = screenshotFrames.find(frameNumber);
         inScreenShotFrames = (it != screenshotFrames.end());
+        if (inScreenShotFrames) screenshotFrames.erase(it);
         isInScreenShotFrameRange(frameNumber, &screenShotFrameRange, &inScreenShotFrameRange);
-        if ((inScreenShotFrames) || (inScreenShotFrameRange)) {
-            string fileName;
-
-            if (vk_screenshot_dir == NULL || strlen(vk_screenshot_dir) == 0) {
-                fileName = to_string(frameNumber) + ".ppm";
-            } else {
-                fileName = vk_screenshot_dir;
-                fileName += "/" + to_string(frameNumber) + ".ppm";
-            }
-#ifdef ANDROID
-            __android_log_print(ANDROID_LOG_INFO, "screenshot", "Screen capture file is: %s", fileName.c_str());
-#else
-            printf("Screen Capture file is: %s \n", fileName.c_str());
-#endif
+        nextCaptureFrame.store(getNextCaptureFrame(frameNumber + 1));
+    }
 
-            VkImage image;
-            VkSwapchainKHR swapchain;
-            // We'll dump only one image: the first
-            // If there are 0 swapchains, skip taking the snapshot
-            if (pPresentInfo && pPresentInfo->swapchainCount > 0) {
-                swapchain = pPresentInfo->pSwapchains[0];
-                image = swapchainMap[swapchain]->imageList[pPresentInfo->pImageIndices[0]];
-                writePPM(fileName.c_str(), image);
-            } else {
+    if ((inScreenShotFrames) || (inScreenShotFrameRange)) {
+        string baseName;
+
+        if (vk_screenshot_dir == NULL || strlen(vk_screenshot_dir) == 0) {
+            baseName = to_string(frameNumber);
+        } else {
+            baseName = vk_screenshot_dir;
+            baseName += "/" + to_string(frameNumber);
+        }
+
+        // Dump every swapchain presented.  When there is more than one,
+        // the index of the swapchain in the present is added to the file
+        // name.
+        // If there are 0 swapchains, skip taking the snapshot
+        if (pPresentInfo && pPresentInfo->swapchainCount > 0) {
+            std::unique_lock<std::mutex> lock(deviceData->lock);
+            for (uint32_t i = 0; i < pPresentInfo->swapchainCount; i++) {
+                string frameName = to_string(frameNumber);
+                if (pPresentInfo->swapchainCount > 1) frameName += "_" + to_string(i);
+                string fileName = baseName;
+                if (pPresentInfo->swapchainCount > 1) fileName += "_" + to_string(i);
+                fileName += getFileFormatExtension(userFileFormat);
+                // In hash mode the file name is only printed if it is written.
+                if (userHashMode == HASH_NONE) {
 #ifdef ANDROID
-                __android_log_print(ANDROID_LOG_ERROR, "screenshot", "Failure - no swapchain specified\n");
+                    __android_log_print(ANDROID_LOG_INFO, "screenshot", "Screen capture file is: %s", fileName.c_str());
 #else
-                fprintf(stderr, "Screenshot failure - no swapchain specified\n");
+                    printf("Screen Capture file is: %s \n", fileName.c_str());
 #endif
-            }
-            if (inScreenShotFrames) {
-                screenshotFrames.erase(it);
-            }
-
-            if (screenshotFrames.empty() && isEndOfScreenShotFrameRange(frameNumber, &screenShotFrameRange)) {
-                // Free all our maps since we are done with them.
-                for (auto swapchainIter = swapchainMap.begin(); swapchainIter != swapchainMap.end(); swapchainIter++) {
-                    SwapchainMapStruct *swapchainMapElem = swapchainIter->second;
-                    delete swapchainMapElem;
                 }
-                for (auto imageIter = imageMap.begin(); imageIter != imageMap.end(); imageIter++) {
-                    ImageMapStruct *imageMapElem = imageIter->second;
-                    delete imageMapElem;
-                }
-                for (auto physDeviceIter = physDeviceMap.begin(); physDeviceIter != physDeviceMap.end(); physDeviceIter++) {
-                    PhysDeviceMapStruct *physDeviceMapElem = physDeviceIter->second;
-                    delete physDeviceMapElem;
+
+                auto swapchainIter = deviceData->swapchains.find(pPresentInfo->pSwapchains[i]);
+                if (swapchainIter != deviceData->swapchains.end()) {
+                    writeScreenshot(fileName.c_str(), frameName.c_str(), deviceData, &swapchainIter->second,
+                                    pPresentInfo->pImageIndices[i], queue, pPresentInfo->waitSemaphoreCount,
+                                    pPresentInfo->pWaitSemaphores, stalePools);
                 }
-                swapchainMap.clear();
-                imageMap.clear();
-                physDeviceMap.clear();
-                screenShotFrameRange.valid = false;
             }
+            lock.unlock();
+        } else {
+#ifdef ANDROID
+            __android_log_print(ANDROID_LOG_ERROR, "screenshot", "Failure - no swapchain specified\n");
+#else
+            fprintf(stderr, "Screenshot failure - no swapchain specified\n");
+#endif
         }
     }
-    frameNumber++;
-    loader_platform_thread_unlock_mutex(&globalLock);
-    VkLayerDispatchTable *pDisp = dispMap->device_dispatch_table;
+
+    destroyCapturePools(stalePools);
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL QueuePresentKHR(VkQueue queue, const VkPresentInfoKHR *pPresentInfo) {
+    // A frame before the next one scheduled for a capture is presented
+    // without taking a lock, and once no frames are left to capture they are
+    // not counted either.  The frame number is taken after loading
+    // nextCaptureFrame, so a capture of a later frame cannot have moved
+    // nextCaptureFrame past this one.
+    int const nextFrame = nextCaptureFrame.load(std::memory_order_acquire);
+    if (nextFrame != noCaptureFrame) {
+        int const frameNumber = frameCounter.fetch_add(1, std::memory_order_acq_rel);
+        if (frameNumber >= nextFrame) captureFrame(getDeviceData(queue), frameNumber, queue, pPresentInfo);
+    }
+
+    DeviceData *deviceData = getPresentDeviceData(queue);
+    assert(deviceData);
+    VkLayerDispatchTable *pDisp = &deviceData->dispatchTable;
     VkResult result = pDisp->QueuePresentKHR(queue, pPresentInfo);
     return result;
 }
@@ -1477,9 +2499,9 @@ VKAPI_ATTR PFN_vkVoidFunction VKAPI_CALL GetDeviceProcAddr(VkDevice dev, const c
     proc = intercept_khr_swapchain_command(funcName, dev);
     if (proc) return proc;
 
-    DispatchMapStruct *dispMap = get_dispatch_info(dev);
-    assert(dispMap);
-    VkLayerDispatchTable *pDisp = dispMap->device_dispatch_table;
+    DeviceData *deviceData = getDeviceData(dev);
+    assert(deviceData);
+    VkLayerDispatchTable *pDisp = &deviceData->dispatchTable;
 
     if (pDisp->GetDeviceProcAddr == NULL) return NULL;
     return pDisp->GetDeviceProcAddr(dev, funcName);
@@ -1508,7 +2530,6 @@ static PFN_vkVoidFunction intercept_core_instance_command(const char *name) {
         {"vkGetInstanceProcAddr", reinterpret_cast<PFN_vkVoidFunction>(GetInstanceProcAddr)},
         {"vkCreateInstance", reinterpret_cast<PFN_vkVoidFunction>(CreateInstance)},
         {"vkCreateDevice", reinterpret_cast<PFN_vkVoidFunction>(CreateDevice)},
-        {"vkEnumeratePhysicalDevices", reinterpret_cast<PFN_vkVoidFunction>(EnumeratePhysicalDevices)},
         {"vkEnumerateInstanceLayerProperties", reinterpret_cast<PFN_vkVoidFunction>(EnumerateInstanceLayerProperties)},
         {"vkEnumerateDeviceLayerProperties", reinterpret_cast<PFN_vkVoidFunction>(EnumerateDeviceLayerProperties)},
         {"vkEnumerateInstanceExtensionProperties", reinterpret_cast<PFN_vkVoidFunction>(EnumerateInstanceExtensionProperties)},
@@ -1547,12 +2568,13 @@ static PFN_vkVoidFunction intercept_khr_swapchain_command(const char *name, VkDe
     } khr_swapchain_commands[] = {
         {"vkCreateSwapchainKHR", reinterpret_cast<PFN_vkVoidFunction>(CreateSwapchainKHR)},
         {"vkGetSwapchainImagesKHR", reinterpret_cast<PFN_vkVoidFunction>(GetSwapchainImagesKHR)},
+        {"vkDestroySwapchainKHR", reinterpret_cast<PFN_vkVoidFunction>(DestroySwapchainKHR)},
         {"vkQueuePresentKHR", reinterpret_cast<PFN_vkVoidFunction>(QueuePresentKHR)},
     };
 
     if (dev) {
-        DeviceMapStruct *devMap = get_device_info(dev);
-        if (!devMap->wsi_enabled) return nullptr;
+        DeviceData *deviceData = getDeviceData(dev);
+        if (!deviceData->wsi_enabled) return nullptr;
     }
 
     for (size_t i = 0; i < ARRAY_SIZE(khr_swapchain_commands); i++) {
@@ -0,0 +1,281 @@
+/* Copyright (c) 2020 Valve Corporation
+ * Copyright (c) 2020 LunarG, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "screenshot_encoder.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#if defined(SCREENSHOT_USE_ZLIB)
+#include <zlib.h>
+#endif
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define SCREENSHOT_USE_SSSE3
+#include <tmmintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define SSSE3_FUNCTION
+#else
+#define SSSE3_FUNCTION __attribute__((target("ssse3")))
+#endif
+#endif
+
+using namespace std;
+
+namespace screenshot {
+
+bool isFileFormatSupported(FileFormat fileFormat) {
+    switch (fileFormat) {
+        case FILE_FORMAT_PPM:
+        case FILE_FORMAT_QOI:
+            return true;
+#if defined(SCREENSHOT_USE_ZLIB)
+        case FILE_FORMAT_PNG:
+            return true;
+#endif
+        default:
+            return false;
+    }
+}
+
+const char *getFileFormatExtension(FileFormat fileFormat) {
+    switch (fileFormat) {
+        case FILE_FORMAT_PNG:
+            return ".png";
+        case FILE_FORMAT_QOI:
+            return ".qoi";
+        default:
+            return ".ppm";
+    }
+}
+
+#if defined(SCREENSHOT_USE_SSSE3)
+static bool checkSSSE3() {
+#if defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 1);
+    return (info[2] & (1 << 9)) != 0;
+#else
+    return __builtin_cpu_supports("ssse3");
+#endif
+}
+
+// check once whether the processor can run the SSSE3 row conversion, the layer is not built to require it.
+static bool hasSSSE3() {
+    static const bool supported = checkSSSE3();
+    return supported;
+}
+
+// convert 4 channel pixels 16 at a time, shuffling each group of 4 down to 12 bytes and packing the
+// four groups into three stores.
+// return:
+//      the number of pixels converted, the caller converts the rest.
+SSSE3_FUNCTION static uint32_t convertRowToRGBSSSE3(uint8_t *dst, const uint8_t *src, uint32_t width, bool swapRedBlue) {
+    const __m128i shuffle = swapRedBlue ? _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1)
+                                        : _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+    uint32_t x = 0;
+    for (; x + 16 <= width; x += 16) {
+        const __m128i a = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(src + 4 * x)), shuffle);
+        const __m128i b = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(src + 4 * x + 16)), shuffle);
+        const __m128i c = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(src + 4 * x + 32)), shuffle);
+        const __m128i d = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(src + 4 * x + 48)), shuffle);
+        _mm_storeu_si128((__m128i *)(dst + 3 * x), _mm_or_si128(a, _mm_slli_si128(b, 12)));
+        _mm_storeu_si128((__m128i *)(dst + 3 * x + 16), _mm_or_si128(_mm_srli_si128(b, 4), _mm_slli_si128(c, 8)));
+        _mm_storeu_si128((__m128i *)(dst + 3 * x + 32), _mm_or_si128(_mm_srli_si128(c, 8), _mm_slli_si128(d, 4)));
+    }
+    return x;
+}
+#endif
+
+void convertRowToRGB(uint8_t *dst, const uint8_t *src, uint32_t width, uint32_t numChannels, bool swapRedBlue) {
+    if (numChannels == 3 && !swapRedBlue) {
+        memcpy(dst, src, 3 * width);
+        return;
+    }
+
+    uint32_t x = 0;
+#if defined(SCREENSHOT_USE_SSSE3)
+    if (numChannels == 4 && hasSSSE3()) x = convertRowToRGBSSSE3(dst, src, width, swapRedBlue);
+#endif
+    const int red = swapRedBlue ? 2 : 0;
+    const int blue = swapRedBlue ? 0 : 2;
+    for (; x < width; x++) {
+        const uint8_t *pixel = src + numChannels * x;
+        dst[3 * x] = pixel[red];
+        dst[3 * x + 1] = pixel[1];
+        dst[3 * x + 2] = pixel[blue];
+    }
+}
+
+static void putUint32BE(uint8_t *dst, uint32_t value) {
+    dst[0] = static_cast<uint8_t>(value >> 24);
+    dst[1] = static_cast<uint8_t>(value >> 16);
+    dst[2] = static_cast<uint8_t>(value >> 8);
+    dst[3] = static_cast<uint8_t>(value);
+}
+
+static bool encodePPM(const uint8_t *rgb, uint32_t width, uint32_t height, vector<uint8_t> &output) {
+    char header[64];
+    const int headerSize = snprintf(header, sizeof(header), "P6\n%u\n%u\n255\n", width, height);
+    const size_t pixelSize = size_t(width) * height * 3;
+    output.resize(headerSize + pixelSize);
+    memcpy(output.data(), header, headerSize);
+    memcpy(output.data() + headerSize, rgb, pixelSize);
+    return true;
+}
+
+#if defined(SCREENSHOT_USE_ZLIB)
+// write the length, type and CRC of a chunk whose data has already been written after its type.
+static void finishPNGChunk(uint8_t *chunk, const char *type, uint32_t size) {
+    putUint32BE(chunk, size);
+    memcpy(chunk + 4, type, 4);
+    putUint32BE(chunk + 8 + size, static_cast<uint32_t>(crc32(0, chunk + 4, 4 + size)));
+}
+
+// The rows are deflated one at a time straight into the output at the fastest level. Each row uses the Sub
+// filter, which costs a subtraction per byte and lets smooth gradients compress far better than no filter.
+static bool encodePNG(const uint8_t *rgb, uint32_t width, uint32_t height, vector<uint8_t> &output) {
+    static const uint8_t signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+    const size_t rowSize = size_t(width) * 3;
+
+    z_stream stream = {};
+    if (deflateInit(&stream, Z_BEST_SPEED) != Z_OK) return false;
+
+    // The signature and IHDR chunk come first, then the IDAT chunk holding all the rows, then IEND.
+    const size_t idatOffset = sizeof(signature) + 12 + 13;
+    output.resize(idatOffset + 12 + deflateBound(&stream, static_cast<uLong>((1 + rowSize) * height)) + 12);
+    memcpy(output.data(), signature, sizeof(signature));
+    uint8_t *ihdr = output.data() + sizeof(signature);
+    putUint32BE(ihdr + 8, width);
+    putUint32BE(ihdr + 12, height);
+    ihdr[16] = 8;  // bit depth
+    ihdr[17] = 2;  // truecolor
+    ihdr[18] = 0;  // deflate
+    ihdr[19] = 0;  // adaptive filtering
+    ihdr[20] = 0;  // no interlace
+    finishPNGChunk(ihdr, "IHDR", 13);
+
+    uint8_t *idat = output.data() + idatOffset;
+    stream.next_out = idat + 8;
+    stream.avail_out = static_cast<uInt>(output.size() - idatOffset - 24);
+
+    vector<uint8_t> filtered(1 + rowSize);
+    filtered[0] = 1;  // Sub
+    bool success = true;
+    for (uint32_t y = 0; y < height && success; y++) {
+        const uint8_t *row = rgb + y * rowSize;
+        memcpy(filtered.data() + 1, row, rowSize < 3 ? rowSize : 3);
+        for (size_t i = 3; i < rowSize; i++) filtered[1 + i] = static_cast<uint8_t>(row[i] - row[i - 3]);
+        stream.next_in = filtered.data();
+        stream.avail_in = static_cast<uInt>(filtered.size());
+        success = deflate(&stream, Z_NO_FLUSH) == Z_OK && stream.avail_in == 0;
+    }
+    success = success && deflate(&stream, Z_FINISH) == Z_STREAM_END;
+    const uint32_t idatSize = static_cast<uint32_t>(stream.total_out);
+    deflateEnd(&stream);
+    if (!success) return false;
+
+    finishPNGChunk(idat, "IDAT", idatSize);
+    uint8_t *iend = idat + 12 + idatSize;
+    finishPNGChunk(iend, "IEND", 0);
+    output.resize(iend + 12 - output.data());
+    return true;
+}
+#endif
+
+// Follows the QOI specification, version 1.0. The pixels are opaque, so the RGBA op is never needed.
+static bool encodeQOI(const uint8_t *rgb, uint32_t width, uint32_t height, vector<uint8_t> &output) {
+    static const uint8_t endMarker[8] = {0, 0, 0, 0, 0, 0, 0, 1};
+    const size_t pixelCount = size_t(width) * height;
+
+    // The largest op takes 4 bytes, so no image needs more than 4 bytes per pixel.
+    output.resize(14 + 4 * pixelCount + sizeof(endMarker));
+    uint8_t *out = output.data();
+    memcpy(out, "qoif", 4);
+    putUint32BE(out + 4, width);
+    putUint32BE(out + 8, height);
+    out[12] = 3;  // channels
+    out[13] = 0;  // sRGB with linear alpha
+    out += 14;
+
+    // Seen pixels are kept as RGBA words with opaque alpha, so the zeroed entries never match.
+    uint32_t index[64] = {};
+    uint8_t prevRed = 0, prevGreen = 0, prevBlue = 0;
+    uint32_t run = 0;
+    for (size_t i = 0; i < pixelCount; i++) {
+        const uint8_t red = rgb[3 * i], green = rgb[3 * i + 1], blue = rgb[3 * i + 2];
+        if (red == prevRed && green == prevGreen && blue == prevBlue) {
+            run++;
+            if (run == 62 || i + 1 == pixelCount) {
+                *out++ = static_cast<uint8_t>(0xc0 | (run - 1));
+                run = 0;
+            }
+            continue;
+        }
+        if (run > 0) {
+            *out++ = static_cast<uint8_t>(0xc0 | (run - 1));
+            run = 0;
+        }
+
+        const uint32_t pixel = (uint32_t(red) << 24) | (uint32_t(green) << 16) | (uint32_t(blue) << 8) | 0xff;
+        const uint32_t hash = (red * 3 + green * 5 + blue * 7 + 255 * 11) % 64;
+        if (index[hash] == pixel) {
+            *out++ = static_cast<uint8_t>(hash);
+        } else {
+            index[hash] = pixel;
+            const int8_t dr = static_cast<int8_t>(red - prevRed);
+            const int8_t dg = static_cast<int8_t>(green - prevGreen);
+            const int8_t db = static_cast<int8_t>(blue - prevBlue);
+            const int drdg = dr - dg;
+            const int dbdg = db - dg;
+            if (dr >= -2 && dr <= 1 && dg >= -2 && dg <= 1 && db >= -2 && db <= 1) {
+                *out++ = static_cast<uint8_t>(0x40 | ((dr + 2) << 4) | ((dg + 2) << 2) | (db + 2));
+            } else if (dg >= -32 && dg <= 31 && drdg >= -8 && drdg <= 7 && dbdg >= -8 && dbdg <= 7) {
+                *out++ = static_cast<uint8_t>(0x80 | (dg + 32));
+                *out++ = static_cast<uint8_t>(((drdg + 8) << 4) | (dbdg + 8));
+            } else {
+                *out++ = 0xfe;
+                *out++ = red;
+                *out++ = green;
+                *out++ = blue;
+            }
+        }
+        prevRed = red;
+        prevGreen = green;
+        prevBlue = blue;
+    }
+
+    memcpy(out, endMarker, sizeof(endMarker));
+    output.resize(out + sizeof(endMarker) - output.data());
+    return true;
+}
+
+bool encodeImage(FileFormat fileFormat, const uint8_t *rgb, uint32_t width, uint32_t height, vector<uint8_t> &output) {
+    switch (fileFormat) {
+        case FILE_FORMAT_PPM:
+            return encodePPM(rgb, width, height, output);
+#if defined(SCREENSHOT_USE_ZLIB)
+        case FILE_FORMAT_PNG:
+            return encodePNG(rgb, width, height, output);
+#endif
+        case FILE_FORMAT_QOI:
+            return encodeQOI(rgb, width, height, output);
+        default:
+            return false;
+    }
+}
+}
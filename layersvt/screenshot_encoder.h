@@ -0,0 +1,41 @@
+/* Copyright (c) 2020 Valve Corporation
+ * Copyright (c) 2020 LunarG, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+namespace screenshot {
+
+typedef enum FileFormat { FILE_FORMAT_PPM = 0, FILE_FORMAT_PNG = 1, FILE_FORMAT_QOI = 2 } FileFormat;
+
+// return whether the layer was built with what it needs to write fileFormat. PNG files need zlib.
+bool isFileFormatSupported(FileFormat fileFormat);
+
+// return the extension of files written in fileFormat, including the dot.
+const char *getFileFormatExtension(FileFormat fileFormat);
+
+// convert a row of width 8 bit pixels with numChannels channels, 3 or 4, to packed RGB, dropping alpha and
+// swapping the red and blue channels when swapRedBlue is set.
+void convertRowToRGB(uint8_t *dst, const uint8_t *src, uint32_t width, uint32_t numChannels, bool swapRedBlue);
+
+// encode packed RGB pixels, stored row after row, as a complete file in fileFormat. output is resized to
+// the size of the file, so the same vector can be reused from image to image without allocating.
+// return:
+//      false if fileFormat is not supported or the encoder fails.
+bool encodeImage(FileFormat fileFormat, const uint8_t *rgb, uint32_t width, uint32_t height, std::vector<uint8_t> &output);
+}
@@ -0,0 +1,296 @@
+/* Copyright (c) 2020 Valve Corporation
+ * Copyright (c) 2020 LunarG, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "screenshot_hash.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <fstream>
+
+#if defined(_MSC_VER) && defined(_M_X64)
+#include <intrin.h>
+#endif
+
+using namespace std;
+
+namespace screenshot {
+
+// XXH3 as specified by the xxHash project, for the default secret and a seed of 0, so that the hashes match
+// those of other XXH3 implementations such as xxhsum -H3.
+static const uint64_t PRIME32_1 = 0x9E3779B1U;
+static const uint64_t PRIME32_2 = 0x85EBCA77U;
+static const uint64_t PRIME32_3 = 0xC2B2AE3DU;
+static const uint64_t PRIME64_1 = 0x9E3779B185EBCA87ULL;
+static const uint64_t PRIME64_2 = 0xC2B2AE3D27D4EB4FULL;
+static const uint64_t PRIME64_3 = 0x165667B19E3779F9ULL;
+static const uint64_t PRIME64_4 = 0x85EBCA77C2B2AE63ULL;
+static const uint64_t PRIME64_5 = 0x27D4EB2F165667C5ULL;
+static const uint64_t PRIME_MX1 = 0x165667919E3779F9ULL;
+static const uint64_t PRIME_MX2 = 0x9FB21C651E98DF25ULL;
+
+static const size_t secretSize = 192;
+static const uint8_t secret[secretSize] = {
+    0xb8, 0xfe, 0x6c, 0x39, 0x23, 0xa4, 0x4b, 0xbe, 0x7c, 0x01, 0x81, 0x2c, 0xf7, 0x21, 0xad, 0x1c, 0xde, 0xd4, 0x6d, 0xe9,
+    0x83, 0x90, 0x97, 0xdb, 0x72, 0x40, 0xa4, 0xa4, 0xb7, 0xb3, 0x67, 0x1f, 0xcb, 0x79, 0xe6, 0x4e, 0xcc, 0xc0, 0xe5, 0x78,
+    0x82, 0x5a, 0xd0, 0x7d, 0xcc, 0xff, 0x72, 0x21, 0xb8, 0x08, 0x46, 0x74, 0xf7, 0x43, 0x24, 0x8e, 0xe0, 0x35, 0x90, 0xe6,
+    0x81, 0x3a, 0x26, 0x4c, 0x3c, 0x28, 0x52, 0xbb, 0x91, 0xc3, 0x00, 0xcb, 0x88, 0xd0, 0x65, 0x8b, 0x1b, 0x53, 0x2e, 0xa3,
+    0x71, 0x64, 0x48, 0x97, 0xa2, 0x0d, 0xf9, 0x4e, 0x38, 0x19, 0xef, 0x46, 0xa9, 0xde, 0xac, 0xd8, 0xa8, 0xfa, 0x76, 0x3f,
+    0xe3, 0x9c, 0x34, 0x3f, 0xf9, 0xdc, 0xbb, 0xc7, 0xc7, 0x0b, 0x4f, 0x1d, 0x8a, 0x51, 0xe0, 0x4b, 0xcd, 0xb4, 0x59, 0x31,
+    0xc8, 0x9f, 0x7e, 0xc9, 0xd9, 0x78, 0x73, 0x64, 0xea, 0xc5, 0xac, 0x83, 0x34, 0xd3, 0xeb, 0xc3, 0xc5, 0x81, 0xa0, 0xff,
+    0xfa, 0x13, 0x63, 0xeb, 0x17, 0x0d, 0xdd, 0x51, 0xb7, 0xf0, 0xda, 0x49, 0xd3, 0x16, 0x55, 0x26, 0x29, 0xd4, 0x68, 0x9e,
+    0x2b, 0x16, 0xbe, 0x58, 0x7d, 0x47, 0xa1, 0xfc, 0x8f, 0xf8, 0xb8, 0xd1, 0x7a, 0xd0, 0x31, 0xce, 0x45, 0xcb, 0x3a, 0x8f,
+    0x95, 0x16, 0x04, 0x28, 0xaf, 0xd7, 0xfb, 0xca, 0xbb, 0x4b, 0x40, 0x7e,
+};
+
+// the hash reads its input as little endian words whatever the byte order of the processor.
+static inline uint32_t read32(const uint8_t *p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static inline uint64_t read64(const uint8_t *p) { return (uint64_t)read32(p) | ((uint64_t)read32(p + 4) << 32); }
+
+static inline uint64_t rotl64(uint64_t x, int r) { return (x << r) | (x >> (64 - r)); }
+
+static inline uint64_t swap64(uint64_t x) {
+    x = ((x << 8) & 0xff00ff00ff00ff00ULL) | ((x >> 8) & 0x00ff00ff00ff00ffULL);
+    x = ((x << 16) & 0xffff0000ffff0000ULL) | ((x >> 16) & 0x0000ffff0000ffffULL);
+    return (x << 32) | (x >> 32);
+}
+
+// multiply two 64 bit numbers and fold the 128 bit product by xoring its halves.
+static inline uint64_t mul128Fold64(uint64_t lhs, uint64_t rhs) {
+#if defined(__SIZEOF_INT128__)
+    const unsigned __int128 product = (unsigned __int128)lhs * rhs;
+    return (uint64_t)product ^ (uint64_t)(product >> 64);
+#elif defined(_MSC_VER) && defined(_M_X64)
+    uint64_t high;
+    const uint64_t low = _umul128(lhs, rhs, &high);
+    return low ^ high;
+#else
+    const uint64_t lowLow = (lhs & 0xffffffff) * (rhs & 0xffffffff);
+    const uint64_t highLow = (lhs >> 32) * (rhs & 0xffffffff);
+    const uint64_t lowHigh = (lhs & 0xffffffff) * (rhs >> 32);
+    const uint64_t highHigh = (lhs >> 32) * (rhs >> 32);
+    const uint64_t cross = (lowLow >> 32) + (highLow & 0xffffffff) + lowHigh;
+    const uint64_t upper = (highLow >> 32) + (cross >> 32) + highHigh;
+    const uint64_t lower = (cross << 32) | (lowLow & 0xffffffff);
+    return lower ^ upper;
+#endif
+}
+
+static inline uint64_t avalancheXXH64(uint64_t h) {
+    h ^= h >> 33;
+    h *= PRIME64_2;
+    h ^= h >> 29;
+    h *= PRIME64_3;
+    return h ^ (h >> 32);
+}
+
+static inline uint64_t avalanche(uint64_t h) {
+    h ^= h >> 37;
+    h *= PRIME_MX1;
+    return h ^ (h >> 32);
+}
+
+static inline uint64_t rrmxmx(uint64_t h, uint64_t len) {
+    h ^= rotl64(h, 49) ^ rotl64(h, 24);
+    h *= PRIME_MX2;
+    h ^= (h >> 35) + len;
+    h *= PRIME_MX2;
+    return h ^ (h >> 28);
+}
+
+static inline uint64_t mix16B(const uint8_t *input, const uint8_t *key) {
+    return mul128Fold64(read64(input) ^ read64(key), read64(input + 8) ^ read64(key + 8));
+}
+
+static uint64_t hashShort(const uint8_t *input, size_t len) {
+    if (len > 8) {
+        const uint64_t inputLow = read64(input) ^ (read64(secret + 24) ^ read64(secret + 32));
+        const uint64_t inputHigh = read64(input + len - 8) ^ (read64(secret + 40) ^ read64(secret + 48));
+        return avalanche(len + swap64(inputLow) + inputHigh + mul128Fold64(inputLow, inputHigh));
+    }
+    if (len >= 4) {
+        const uint64_t input64 = read32(input + len - 4) + ((uint64_t)read32(input) << 32);
+        return rrmxmx(input64 ^ (read64(secret + 8) ^ read64(secret + 16)), len);
+    }
+    if (len > 0) {
+        const uint32_t combined =
+            ((uint32_t)input[0] << 16) | ((uint32_t)input[len >> 1] << 24) | input[len - 1] | ((uint32_t)len << 8);
+        return avalancheXXH64(combined ^ (uint64_t)(read32(secret) ^ read32(secret + 4)));
+    }
+    return avalancheXXH64(read64(secret + 56) ^ read64(secret + 64));
+}
+
+static uint64_t hashMedium(const uint8_t *input, size_t len) {
+    uint64_t acc = len * PRIME64_1;
+    if (len <= 128) {
+        if (len > 32) {
+            if (len > 64) {
+                if (len > 96) {
+                    acc += mix16B(input + 48, secret + 96);
+                    acc += mix16B(input + len - 64, secret + 112);
+                }
+                acc += mix16B(input + 32, secret + 64);
+                acc += mix16B(input + len - 48, secret + 80);
+            }
+            acc += mix16B(input + 16, secret + 32);
+            acc += mix16B(input + len - 32, secret + 48);
+        }
+        acc += mix16B(input, secret);
+        acc += mix16B(input + len - 16, secret + 16);
+        return avalanche(acc);
+    }
+
+    const size_t rounds = len / 16;
+    for (size_t i = 0; i < 8; i++) acc += mix16B(input + 16 * i, secret + 16 * i);
+    acc = avalanche(acc);
+    for (size_t i = 8; i < rounds; i++) acc += mix16B(input + 16 * i, secret + 16 * (i - 8) + 3);
+    acc += mix16B(input + len - 16, secret + 136 - 17);
+    return avalanche(acc);
+}
+
+static const size_t stripeLen = 64;
+static const size_t stripesPerBlock = (secretSize - stripeLen) / 8;
+
+static inline void accumulateStripe(uint64_t acc[8], const uint8_t *input, const uint8_t *key) {
+    for (int i = 0; i < 8; i++) {
+        const uint64_t value = read64(input + 8 * i);
+        const uint64_t keyed = value ^ read64(key + 8 * i);
+        acc[i ^ 1] += value;
+        acc[i] += (keyed & 0xffffffff) * (keyed >> 32);
+    }
+}
+
+static inline void scrambleAccumulators(uint64_t acc[8], const uint8_t *key) {
+    for (int i = 0; i < 8; i++) {
+        uint64_t value = acc[i];
+        value ^= value >> 47;
+        value ^= read64(key + 8 * i);
+        acc[i] = value * PRIME32_1;
+    }
+}
+
+// hash inputs over 240 bytes, such as image rows, in blocks of 16 stripes of 64 bytes.
+static uint64_t hashLong(const uint8_t *input, size_t len) {
+    uint64_t acc[8] = {PRIME32_3, PRIME64_1, PRIME64_2, PRIME64_3, PRIME64_4, PRIME32_2, PRIME64_5, PRIME32_1};
+    const size_t blockLen = stripeLen * stripesPerBlock;
+    const size_t blocks = (len - 1) / blockLen;
+
+    for (size_t n = 0; n < blocks; n++) {
+        for (size_t s = 0; s < stripesPerBlock; s++) accumulateStripe(acc, input + n * blockLen + s * stripeLen, secret + s * 8);
+        scrambleAccumulators(acc, secret + secretSize - stripeLen);
+    }
+
+    const size_t stripes = ((len - 1) - blockLen * blocks) / stripeLen;
+    for (size_t s = 0; s < stripes; s++) accumulateStripe(acc, input + blocks * blockLen + s * stripeLen, secret + s * 8);
+    accumulateStripe(acc, input + len - stripeLen, secret + secretSize - stripeLen - 7);
+
+    uint64_t result = len * PRIME64_1;
+    for (int i = 0; i < 4; i++) {
+        result += mul128Fold64(acc[2 * i] ^ read64(secret + 11 + 16 * i), acc[2 * i + 1] ^ read64(secret + 11 + 16 * i + 8));
+    }
+    return avalanche(result);
+}
+
+uint64_t hashXXH3(const void *data, size_t size) {
+    const uint8_t *input = (const uint8_t *)data;
+    if (size <= 16) return hashShort(input, size);
+    if (size <= 240) return hashMedium(input, size);
+    return hashLong(input, size);
+}
+
+uint64_t hashPerceptual(const uint8_t *rgb, uint32_t width, uint32_t height) {
+    if (width == 0 || height == 0) return 0;
+
+    // sum the luma of each block, giving every block at least one pixel when the image is smaller than the grid.
+    uint64_t sums[8][9] = {};
+    uint64_t counts[8][9] = {};
+    for (uint32_t by = 0; by < 8; by++) {
+        const uint32_t y0 = by * height / 8;
+        const uint32_t y1 = std::max(y0 + 1, (by + 1) * height / 8);
+        for (uint32_t bx = 0; bx < 9; bx++) {
+            const uint32_t x0 = bx * width / 9;
+            const uint32_t x1 = std::max(x0 + 1, (bx + 1) * width / 9);
+            uint64_t sum = 0;
+            for (uint32_t y = y0; y < y1; y++) {
+                const uint8_t *pixel = rgb + (size_t(y) * width + x0) * 3;
+                for (uint32_t x = x0; x < x1; x++, pixel += 3) sum += 77 * pixel[0] + 150 * pixel[1] + 29 * pixel[2];
+            }
+            sums[by][bx] = sum;
+            counts[by][bx] = uint64_t(y1 - y0) * (x1 - x0);
+        }
+    }
+
+    // compare the averages without dividing.
+    uint64_t hash = 0;
+    for (uint32_t by = 0; by < 8; by++) {
+        for (uint32_t bx = 0; bx < 8; bx++) {
+            if (sums[by][bx] * counts[by][bx + 1] > sums[by][bx + 1] * counts[by][bx]) hash |= 1ULL << (by * 8 + bx);
+        }
+    }
+    return hash;
+}
+
+uint32_t hashDistance(uint64_t hash1, uint64_t hash2) {
+    uint64_t bits = hash1 ^ hash2;
+    uint32_t count = 0;
+    for (; bits; bits &= bits - 1) count++;
+    return count;
+}
+
+string formatHashManifestLine(const string &frame, const FrameHash &hash) {
+    char hashes[40];
+    if (hash.hasPerceptualHash) {
+        snprintf(hashes, sizeof(hashes), ",%016llx,%016llx\n", (unsigned long long)hash.contentHash,
+                 (unsigned long long)hash.perceptualHash);
+    } else {
+        snprintf(hashes, sizeof(hashes), ",%016llx\n", (unsigned long long)hash.contentHash);
+    }
+    return frame + hashes;
+}
+
+// parse a hash written as hex digits, which must make up the whole of the field.
+static bool parseHash(const string &field, uint64_t *hash) {
+    if (field.empty() || field.size() > 16) return false;
+    char *end;
+    *hash = strtoull(field.c_str(), &end, 16);
+    return *end == '\0';
+}
+
+bool readHashManifest(const char *path, unordered_map<string, FrameHash> &manifest) {
+    ifstream file(path);
+    if (!file.is_open()) return false;
+
+    string line;
+    while (getline(file, line)) {
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        const size_t comma1 = line.find(',');
+        if (comma1 == string::npos || comma1 == 0) continue;
+        const size_t comma2 = line.find(',', comma1 + 1);
+
+        FrameHash hash = {};
+        if (!parseHash(line.substr(comma1 + 1, comma2 == string::npos ? string::npos : comma2 - comma1 - 1), &hash.contentHash)) {
+            continue;
+        }
+        if (comma2 != string::npos) hash.hasPerceptualHash = parseHash(line.substr(comma2 + 1), &hash.perceptualHash);
+        manifest[line.substr(0, comma1)] = hash;
+    }
+    return true;
+}
+}
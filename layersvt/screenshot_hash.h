@@ -0,0 +1,52 @@
+/* Copyright (c) 2020 Valve Corporation
+ * Copyright (c) 2020 LunarG, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <unordered_map>
+
+namespace screenshot {
+
+// the hashes of a frame recorded in a hash manifest, one line per frame: the frame's name, its content hash and
+// optionally its perceptual hash, separated by commas, with the hashes written as 16 hex digits.
+typedef struct {
+    uint64_t contentHash;
+    uint64_t perceptualHash;
+    bool hasPerceptualHash;
+} FrameHash;
+
+// return the 64 bit XXH3 hash of size bytes at data, with the default secret and no seed.
+uint64_t hashXXH3(const void *data, size_t size);
+
+// return a 64 bit difference hash of packed RGB pixels, stored row after row. the image is reduced to 9 x 8 blocks
+// of average luma, and each bit tells whether a block is brighter than the block to its right, so images that look
+// alike have hashes that differ in few bits.
+uint64_t hashPerceptual(const uint8_t *rgb, uint32_t width, uint32_t height);
+
+// return the number of bits that differ between two hashes.
+uint32_t hashDistance(uint64_t hash1, uint64_t hash2);
+
+// return the manifest line for the hashes of frame, including the newline.
+std::string formatHashManifestLine(const std::string &frame, const FrameHash &hash);
+
+// read the lines of a hash manifest into manifest, keyed by frame name. lines that cannot be parsed are skipped.
+// return:
+//      false if the file cannot be opened.
+bool readHashManifest(const char *path, std::unordered_map<std::string, FrameHash> &manifest);
+}
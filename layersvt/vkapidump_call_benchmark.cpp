@@ -0,0 +1,138 @@
+/* Copyright (c) 2020 Valve Corporation
+ * Copyright (c) 2020 LunarG, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// vkapidump-call-benchmark measures what the api_dump layer adds to each api call: the check made
+// while capture is off, and dumping a call as text and as a binary record. The calls are dumped the
+// way the layer's entry points dump them, and the output is written to the null device, so only the
+// layer's own work is timed.
+
+#include "api_dump_text.h"
+#include "api_dump_binary.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+static void SetEnvVar(const char *name, const char *value) {
+#if defined(_WIN32)
+    _putenv_s(name, value);
+#else
+    setenv(name, value, 1);
+#endif
+}
+
+static int PrintUsage(const char *program) {
+    fprintf(stderr, "Usage: %s [--calls count]\n", program);
+    return 1;
+}
+
+static double NanosecondsSince(std::chrono::steady_clock::time_point start, uint64_t count) {
+    const std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count() / static_cast<double>(count);
+}
+
+// A vkBeginCommandBuffer and a vkCmdSetBlendConstants, as a recording loop makes them.
+static void DumpTextCalls(ApiDumpInstance &dump_inst, VkCommandBuffer cmd_buffer, const VkCommandBufferBeginInfo *begin_info,
+                          const float *blend_constants) {
+    if (!dump_inst.shouldDumpOutput()) return;
+    dump_inst.beginRecord();
+    dump_text_head_vkBeginCommandBuffer(dump_inst, cmd_buffer, begin_info);
+    dump_text_body_vkBeginCommandBuffer(dump_inst, VK_SUCCESS, cmd_buffer, begin_info);
+    dump_inst.commitRecord();
+
+    if (!dump_inst.shouldDumpOutput()) return;
+    dump_inst.beginRecord();
+    dump_text_head_vkCmdSetBlendConstants(dump_inst, cmd_buffer, blend_constants);
+    dump_text_body_vkCmdSetBlendConstants(dump_inst, cmd_buffer, blend_constants);
+    dump_inst.commitRecord();
+}
+
+static void DumpBinaryCalls(ApiDumpInstance &dump_inst, VkCommandBuffer cmd_buffer, const VkCommandBufferBeginInfo *begin_info,
+                            const float *blend_constants) {
+    if (!dump_inst.shouldDumpOutput()) return;
+    dump_inst.beginRecord();
+    dump_binary_head_vkBeginCommandBuffer(dump_inst, cmd_buffer, begin_info);
+    dump_binary_body_vkBeginCommandBuffer(dump_inst, VK_SUCCESS, cmd_buffer, begin_info);
+    dump_inst.commitRecord();
+
+    if (!dump_inst.shouldDumpOutput()) return;
+    dump_inst.beginRecord();
+    dump_binary_head_vkCmdSetBlendConstants(dump_inst, cmd_buffer, blend_constants);
+    dump_binary_body_vkCmdSetBlendConstants(dump_inst, cmd_buffer, blend_constants);
+    dump_inst.commitRecord();
+}
+
+int main(int argc, char **argv) {
+    uint64_t call_count = 1000000;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--calls" && i + 1 < argc) {
+            call_count = strtoull(argv[++i], NULL, 10);
+        } else {
+            return PrintUsage(argv[0]);
+        }
+    }
+    if (call_count < 2) return PrintUsage(argv[0]);
+
+#if defined(_WIN32)
+    SetEnvVar(API_DUMP_ENV_VAR_LOG_FILE, "NUL");
+#else
+    SetEnvVar(API_DUMP_ENV_VAR_LOG_FILE, "/dev/null");
+#endif
+    SetEnvVar(API_DUMP_ENV_VAR_FLUSH_FILE, "false");
+    SetEnvVar(API_DUMP_ENV_VAR_ASYNC_OUTPUT, "false");
+    ApiDumpInstance &dump_inst = ApiDumpInstance::current();
+    dump_inst.settings();
+
+    // Secondary command buffers, so the inheritance info is dumped too.
+    VkCommandBuffer cmd_buffers[16];
+    for (uintptr_t i = 0; i < 16; ++i) cmd_buffers[i] = reinterpret_cast<VkCommandBuffer>(0x1000 + i * 0x40);
+    dump_inst.addCmdBuffers(VK_NULL_HANDLE, VK_NULL_HANDLE, cmd_buffers, 16, VK_COMMAND_BUFFER_LEVEL_SECONDARY);
+
+    VkCommandBufferInheritanceInfo inheritance_info = {};
+    inheritance_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+    VkCommandBufferBeginInfo begin_info = {};
+    begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    begin_info.pInheritanceInfo = &inheritance_info;
+    const float blend_constants[4] = {0.0f, 0.25f, 0.5f, 1.0f};
+    const uint64_t loop_count = call_count / 2;
+
+    // While capture is off, a call is only the check of the output state.
+    dump_inst.setTriggered(false);
+    auto start = std::chrono::steady_clock::now();
+    for (uint64_t i = 0; i < loop_count; ++i) {
+        DumpTextCalls(dump_inst, cmd_buffers[i % 16], &begin_info, blend_constants);
+    }
+    const double off_ns = NanosecondsSince(start, loop_count * 2);
+    dump_inst.setTriggered(true);
+
+    start = std::chrono::steady_clock::now();
+    for (uint64_t i = 0; i < loop_count; ++i) {
+        DumpBinaryCalls(dump_inst, cmd_buffers[i % 16], &begin_info, blend_constants);
+    }
+    const double binary_ns = NanosecondsSince(start, loop_count * 2);
+
+    start = std::chrono::steady_clock::now();
+    for (uint64_t i = 0; i < loop_count; ++i) {
+        DumpTextCalls(dump_inst, cmd_buffers[i % 16], &begin_info, blend_constants);
+    }
+    const double text_ns = NanosecondsSince(start, loop_count * 2);
+
+    printf("Capture off: %.1f ns per call\n", off_ns);
+    printf("Binary: %.1f ns per call\n", binary_ns);
+    printf("Text: %.1f ns per call, %.1f times binary\n", text_ns, text_ns / binary_ns);
+    return 0;
+}
@@ -0,0 +1,136 @@
+/* Copyright (c) 2020 Valve Corporation
+ * Copyright (c) 2020 LunarG, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// vkapidump-convert renders a binary capture written by the api_dump layer as text, HTML, JSON or a
+// Chrome trace. The capture is replayed through the same dump functions the layer uses, so the result
+// matches what the layer would have written itself. Record framing and array sizes are bounds
+// checked, but the Vulkan structures inside a record are trusted, so only captures written by the
+// layer should be converted.
+
+#include "api_dump_binary_replay.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+static void SetEnvVar(const char *name, const char *value) {
+#if defined(_WIN32)
+    _putenv_s(name, value);
+#else
+    setenv(name, value, 1);
+#endif
+}
+
+static int PrintUsage(const char *program) {
+    fprintf(stderr, "Usage: %s [--format text|html|json|trace] [-o output_file] capture_file\n", program);
+    return 1;
+}
+
+int main(int argc, char **argv) {
+    std::string format = "text";
+    std::string output_filename;
+    std::string input_filename;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if ((arg == "--format" || arg == "-f") && i + 1 < argc) {
+            format = argv[++i];
+        } else if (arg == "-o" && i + 1 < argc) {
+            output_filename = argv[++i];
+        } else if (input_filename.empty() && arg[0] != '-') {
+            input_filename = arg;
+        } else {
+            return PrintUsage(argv[0]);
+        }
+    }
+    if (input_filename.empty() || (format != "text" && format != "html" && format != "json" && format != "trace")) return PrintUsage(argv[0]);
+
+    std::ifstream input(input_filename, std::ifstream::in | std::ifstream::binary);
+    if (!input) {
+        fprintf(stderr, "Could not open %s\n", input_filename.c_str());
+        return 1;
+    }
+
+    ApiDumpBinaryFileHeader header;
+    if (!input.read(reinterpret_cast<char *>(&header), sizeof(header)) ||
+        memcmp(header.magic, API_DUMP_BINARY_MAGIC, sizeof(header.magic)) != 0) {
+        fprintf(stderr, "%s is not an api_dump binary capture\n", input_filename.c_str());
+        return 1;
+    }
+    if (header.version != API_DUMP_BINARY_VERSION) {
+        fprintf(stderr, "%s uses binary capture version %u, this converter reads version %u\n", input_filename.c_str(),
+                header.version, API_DUMP_BINARY_VERSION);
+        return 1;
+    }
+    // Records hold raw Vulkan structures, so they can only be read with the layout they were written with.
+    if (header.header_version != VK_HEADER_VERSION || header.pointer_size != sizeof(void *)) {
+        fprintf(stderr,
+                "%s was captured with Vulkan header version %u and %u byte pointers, this converter was built with "
+                "version %u and %u byte pointers\n",
+                input_filename.c_str(), header.header_version, header.pointer_size, VK_HEADER_VERSION,
+                static_cast<uint32_t>(sizeof(void *)));
+        return 1;
+    }
+
+    // The dump instance reads its settings the same way the layer does, the environment only overrides
+    // what the output has to be. Every other setting, including the output range, still applies.
+    SetEnvVar(API_DUMP_ENV_VAR_OUTPUT_FMT, format.c_str());
+    if (!output_filename.empty()) SetEnvVar(API_DUMP_ENV_VAR_LOG_FILE, output_filename.c_str());
+    SetEnvVar(API_DUMP_ENV_VAR_ASYNC_OUTPUT, "false");
+    ApiDumpInstance &dump_inst = ApiDumpInstance::current();
+    dump_inst.beginReplay();
+
+    uint64_t skipped_records = 0;
+    bool started = false;
+    std::vector<char> payload;
+    ApiDumpBinaryRecordHeader record;
+    while (input.read(reinterpret_cast<char *>(&record), sizeof(record))) {
+        if (record.size < sizeof(record)) {
+            fprintf(stderr, "%s is corrupt\n", input_filename.c_str());
+            return 1;
+        }
+        payload.resize(record.size - sizeof(record));
+        if (!input.read(payload.data(), payload.size())) {
+            fprintf(stderr, "%s is truncated, the last record was not converted\n", input_filename.c_str());
+            break;
+        }
+
+        // The layer writes a marker for every frame, whether or not the frame is in its output range.
+        // A flight recorder capture starts with the marker of the oldest frame it kept.
+        const bool first_record = !started;
+        started = true;
+        if (record.function == API_DUMP_BINARY_FRAME_MARKER) {
+            if (first_record && record.frame > 1) {
+                dump_inst.startAtFrame(record.frame);
+                continue;
+            }
+            if (record.frame != dump_inst.frameCount() + 1) {
+                fprintf(stderr, "%s is corrupt\n", input_filename.c_str());
+                return 1;
+            }
+            dump_inst.nextFrame();
+            continue;
+        }
+
+        dump_inst.setReplayCallInfo(record.thread, record.os_thread, record.time, record.duration);
+        ApiDumpBinaryReader reader(payload.data(), payload.size());
+        if (!replay_binary_record(dump_inst, reader, record.function)) ++skipped_records;
+    }
+
+    if (skipped_records > 0) {
+        fprintf(stderr, "%llu records of %s could not be converted\n", static_cast<unsigned long long>(skipped_records),
+                input_filename.c_str());
+    }
+    return 0;
+}
@@ -0,0 +1,241 @@
+/* Copyright (c) 2020 Valve Corporation
+ * Copyright (c) 2020 LunarG, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// vkapidump-format-check checks that ApiDumpFormatter writes every kind of value the dump functions
+// write exactly as a default std::ostringstream does, which is what the api_dump layer used before it
+// had its own formatter. It exits with 1 if any value differs. With --benchmark, it also measures how
+// long each takes to format a mix of values like that of a typical call.
+
+#include "api_dump_text.h"
+
+#include <float.h>
+#include <limits.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <iomanip>
+#include <limits>
+#include <sstream>
+
+enum FormatCheckEnum { FORMAT_CHECK_NEGATIVE = -2, FORMAT_CHECK_ZERO = 0, FORMAT_CHECK_MAX_ENUM = 0x7FFFFFFF };
+
+static uint32_t mismatch_count = 0;
+
+static void Compare(const char *description, const std::string &expected, const ApiDumpFormatter &formatter) {
+    if (formatter.str() == expected) return;
+    fprintf(stderr, "%s: expected \"%s\", got \"%s\"\n", description, expected.c_str(), formatter.str().c_str());
+    ++mismatch_count;
+}
+
+template <typename T>
+static void CheckValue(const char *description, const T &value) {
+    std::ostringstream expected;
+    expected << value;
+    ApiDumpFormatter formatter;
+    formatter << value;
+    Compare(description, expected.str(), formatter);
+}
+
+template <typename T>
+static void CheckLimits(const char *description) {
+    CheckValue(description, std::numeric_limits<T>::min());
+    CheckValue(description, std::numeric_limits<T>::max());
+    CheckValue(description, static_cast<T>(0));
+    CheckValue(description, static_cast<T>(1));
+    CheckValue(description, static_cast<T>(std::numeric_limits<T>::max() / 3));
+    CheckValue(description, static_cast<T>(std::numeric_limits<T>::min() / 3));
+}
+
+template <typename T>
+static void CheckFloatingPoint(const char *description) {
+    const T values[] = {0,
+                        -static_cast<T>(0),
+                        1,
+                        -1,
+                        static_cast<T>(0.1),
+                        static_cast<T>(1.0 / 3.0),
+                        static_cast<T>(123456.5),
+                        static_cast<T>(1234567.0),
+                        static_cast<T>(1e-5),
+                        static_cast<T>(1e-4),
+                        static_cast<T>(-2.5e20),
+                        std::numeric_limits<T>::min(),
+                        std::numeric_limits<T>::denorm_min(),
+                        std::numeric_limits<T>::max(),
+                        std::numeric_limits<T>::lowest(),
+                        std::numeric_limits<T>::epsilon(),
+                        std::numeric_limits<T>::infinity(),
+                        -std::numeric_limits<T>::infinity(),
+                        std::numeric_limits<T>::quiet_NaN(),
+                        -std::numeric_limits<T>::quiet_NaN()};
+    for (const T value : values) CheckValue(description, value);
+}
+
+static void CheckPointers() {
+    const void *pointers[] = {NULL, reinterpret_cast<const void *>(1), reinterpret_cast<const void *>(0x1000),
+                              reinterpret_cast<const void *>(static_cast<uintptr_t>(0xDEADBEEF)),
+                              reinterpret_cast<const void *>(UINTPTR_MAX), &mismatch_count};
+    for (const void *pointer : pointers) {
+        CheckValue("const void *", pointer);
+        CheckValue("uint32_t *", reinterpret_cast<const uint32_t *>(pointer));
+        // Non-dispatchable handles on 32-bit platforms, and dispatchable handles everywhere, are
+        // pointers to opaque structs.
+        CheckValue("VkInstance", reinterpret_cast<VkInstance>(const_cast<void *>(pointer)));
+    }
+
+    // Function pointers are written through their conversion to bool.
+    PFN_vkVoidFunction function = reinterpret_cast<PFN_vkVoidFunction>(&CheckPointers);
+    CheckValue("PFN_vkVoidFunction", function);
+    function = NULL;
+    CheckValue("PFN_vkVoidFunction", function);
+}
+
+static void CheckStrings() {
+    const char *strings[] = {"", "VK_LAYER_LUNARG_api_dump", "pNext", "a\tb\nc"};
+    for (const char *string : strings) {
+        CheckValue("const char *", string);
+        CheckValue("std::string", std::string(string));
+    }
+    char mutable_string[] = "VkApplicationInfo";
+    CheckValue("char *", static_cast<char *>(mutable_string));
+    for (int c = CHAR_MIN; c <= CHAR_MAX; ++c) {
+        if (c == 0) continue;
+        CheckValue("char", static_cast<char>(c));
+        CheckValue("signed char", static_cast<signed char>(c));
+        CheckValue("unsigned char", static_cast<unsigned char>(c));
+    }
+}
+
+// The hex dump of shader code used std::hex, std::setw(2) and std::setfill('0') on an int.
+static void CheckHex() {
+    for (int byte = 0; byte < 256; ++byte) {
+        std::ostringstream expected;
+        expected << std::hex << std::setw(2) << std::setfill('0') << byte;
+        ApiDumpFormatter formatter;
+        formatter.appendHex(static_cast<uint8_t>(byte), 2);
+        Compare("shader byte", expected.str(), formatter);
+    }
+}
+
+static void CheckIndexNames() {
+    const size_t indices[] = {0, 9, 10, 12345, SIZE_MAX};
+    for (const size_t index : indices) {
+        std::ostringstream expected;
+        expected << "pBindings[" << index << "]";
+        ApiDumpFormatter formatter;
+        formatter << ApiDumpIndexName("pBindings", index).c_str();
+        Compare("array element name", expected.str(), formatter);
+    }
+}
+
+// Formats the values of a call like vkGetPhysicalDeviceFormatProperties: names, enums, handles,
+// flags and a few floats.
+template <typename Stream>
+static void FormatCall(Stream &stream, uint32_t i) {
+    stream << "vkGetPhysicalDeviceFormatProperties(" << '\n'
+           << "    physicalDevice:                 VkPhysicalDevice = " << reinterpret_cast<const void *>(0x55d0c0a1e2f0ULL + i)
+           << '\n'
+           << "    format:                         VkFormat = " << static_cast<VkFormat>(i % 185) << '\n'
+           << "    linearTilingFeatures:           VkFormatFeatureFlags = " << (i * 0x1d401u) << '\n'
+           << "    optimalTilingFeatures:          VkFormatFeatureFlags = " << (i * 0x1f4ffu) << '\n'
+           << "    maxSamplerAnisotropy:           float = " << 16.0f + static_cast<float>(i % 7) * 0.25f << '\n'
+           << "    timestampPeriod:                float = " << 1.0f / static_cast<float>(i + 1) << '\n'
+           << "    size:                           VkDeviceSize = " << static_cast<uint64_t>(i) * 65536ULL << '\n'
+           << "    supported:                      VkBool32 = " << (i % 2 == 0) << '\n';
+}
+
+static const uint32_t VALUES_PER_CALL = 9;
+
+static double NanosecondsPerValue(std::chrono::steady_clock::time_point start, uint32_t call_count) {
+    const std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count() / (static_cast<double>(call_count) * VALUES_PER_CALL);
+}
+
+static void Benchmark(uint32_t call_count) {
+    // Each call is formatted into a fresh record, which is how the layer used the stream before and
+    // how it uses the formatter now, which keeps its storage between calls.
+    size_t total = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < call_count; ++i) {
+        std::ostringstream stream;
+        FormatCall(stream, i);
+        total += stream.str().size();
+    }
+    printf("std::ostringstream: %.1f ns per value\n", NanosecondsPerValue(start, call_count));
+
+    ApiDumpFormatter formatter;
+    start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < call_count; ++i) {
+        formatter.clear();
+        FormatCall(formatter, i);
+        total -= formatter.size();
+    }
+    printf("ApiDumpFormatter: %.1f ns per value\n", NanosecondsPerValue(start, call_count));
+    if (total != 0) fprintf(stderr, "The benchmark formatted different output with the two\n");
+}
+
+int main(int argc, char **argv) {
+    uint32_t benchmark_calls = 0;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--benchmark") {
+            benchmark_calls = 1000000;
+            if (i + 1 < argc && argv[i + 1][0] != '-') benchmark_calls = static_cast<uint32_t>(strtoul(argv[++i], NULL, 10));
+        } else {
+            fprintf(stderr, "Usage: %s [--benchmark [call_count]]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    CheckValue("bool", true);
+    CheckValue("bool", false);
+    CheckLimits<short>("short");
+    CheckLimits<unsigned short>("unsigned short");
+    CheckLimits<int>("int");
+    CheckLimits<unsigned int>("unsigned int");
+    CheckLimits<long>("long");
+    CheckLimits<unsigned long>("unsigned long");
+    CheckLimits<long long>("long long");
+    CheckLimits<unsigned long long>("unsigned long long");
+    CheckFloatingPoint<float>("float");
+    CheckFloatingPoint<double>("double");
+    CheckValue("enum", FORMAT_CHECK_NEGATIVE);
+    CheckValue("enum", FORMAT_CHECK_ZERO);
+    CheckValue("enum", FORMAT_CHECK_MAX_ENUM);
+    CheckValue("VkFormat", VK_FORMAT_R8G8B8A8_UNORM);
+    CheckValue("VkResult", VK_ERROR_OUT_OF_DATE_KHR);
+    CheckPointers();
+    CheckStrings();
+    CheckHex();
+    CheckIndexNames();
+    for (uint32_t i = 0; i < 1000; ++i) {
+        std::ostringstream expected;
+        FormatCall(expected, i * 7919);
+        ApiDumpFormatter formatter;
+        FormatCall(formatter, i * 7919);
+        Compare("call", expected.str(), formatter);
+    }
+
+    if (mismatch_count != 0) {
+        fprintf(stderr, "%u values were formatted differently from std::ostringstream\n", mismatch_count);
+        return 1;
+    }
+    printf("Every value was formatted like std::ostringstream formats it\n");
+
+    if (benchmark_calls != 0) Benchmark(benchmark_calls);
+    return 0;
+}
@@ -0,0 +1,109 @@
+/* Copyright (c) 2020 Valve Corporation
+ * Copyright (c) 2020 LunarG, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// vkapidump-name-benchmark measures the cost of handle names in the api_dump layer, for applications
+// that name every resource they create. It names a set of buffers, then dumps handles through the text
+// back end on several threads, three quarters of them named, first alone and then while another
+// thread keeps renaming buffers. Nothing is written out, so only the dumping itself is timed.
+
+#include "api_dump_text.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+static int PrintUsage(const char *program) {
+    fprintf(stderr, "Usage: %s [--handles count] [--threads count] [--dumps count_per_thread]\n", program);
+    return 1;
+}
+
+static double NanosecondsSince(std::chrono::steady_clock::time_point start, uint64_t count) {
+    const std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count() / static_cast<double>(count);
+}
+
+static uint64_t FakeHandle(uint64_t index) { return 0x10000 + index * 0x40; }
+
+// Dumps handles the way the text back end dumps parameters, starting over in a new record every 64
+// handles. Records are never committed, so nothing is written.
+static void DumpHandles(ApiDumpInstance &dump_inst, uint64_t handle_count, uint64_t dump_count, uint64_t seed) {
+    const ApiDumpSettings &settings(dump_inst.settings());
+    uint64_t index = seed;
+    for (uint64_t i = 0; i < dump_count; ++i) {
+        if (i % 64 == 0) dump_inst.beginRecord();
+        // Every fourth handle dumped is one that was never named.
+        index = index * 6364136223846793005ULL + 1442695040888963407ULL;
+        const uint64_t handle = (index >> 33) % handle_count + ((i % 4 == 3) ? handle_count : 0);
+        dump_text_VkBuffer((VkBuffer)FakeHandle(handle), settings, 0);
+    }
+}
+
+static double TimeDumps(ApiDumpInstance &dump_inst, uint64_t handle_count, uint32_t thread_count, uint64_t dump_count) {
+    const auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    for (uint32_t t = 0; t < thread_count; ++t) {
+        threads.emplace_back([&dump_inst, handle_count, dump_count, t]() { DumpHandles(dump_inst, handle_count, dump_count, t); });
+    }
+    for (auto &thread : threads) thread.join();
+    return NanosecondsSince(start, dump_count);
+}
+
+int main(int argc, char **argv) {
+    uint64_t handle_count = 100000;
+    uint32_t thread_count = 4;
+    uint64_t dump_count = 10000000;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--handles" && i + 1 < argc) {
+            handle_count = strtoull(argv[++i], NULL, 10);
+        } else if (arg == "--threads" && i + 1 < argc) {
+            thread_count = static_cast<uint32_t>(strtoul(argv[++i], NULL, 10));
+        } else if (arg == "--dumps" && i + 1 < argc) {
+            dump_count = strtoull(argv[++i], NULL, 10);
+        } else {
+            return PrintUsage(argv[0]);
+        }
+    }
+    if (handle_count == 0 || thread_count == 0 || dump_count == 0) return PrintUsage(argv[0]);
+
+    ApiDumpInstance &dump_inst = ApiDumpInstance::current();
+    dump_inst.settings();
+
+    char name[64];
+    auto start = std::chrono::steady_clock::now();
+    for (uint64_t i = 0; i < handle_count; ++i) {
+        snprintf(name, sizeof(name), "Buffer %llu", static_cast<unsigned long long>(i));
+        dump_inst.setObjectName(FakeHandle(i), name);
+    }
+    printf("Naming %llu buffers: %.1f ns per name\n", static_cast<unsigned long long>(handle_count),
+           NanosecondsSince(start, handle_count));
+
+    printf("Dumping buffers on %u threads: %.1f ns per handle\n", thread_count,
+           TimeDumps(dump_inst, handle_count, thread_count, dump_count));
+
+    std::atomic<bool> renaming{true};
+    std::thread renamer([&]() {
+        char new_name[64];
+        for (uint64_t i = 0; renaming.load(std::memory_order_relaxed); ++i) {
+            snprintf(new_name, sizeof(new_name), "Buffer %llu (renamed)", static_cast<unsigned long long>(i % handle_count));
+            dump_inst.setObjectName(FakeHandle(i % handle_count), new_name);
+        }
+    });
+    printf("Dumping buffers on %u threads while renaming: %.1f ns per handle\n", thread_count,
+           TimeDumps(dump_inst, handle_count, thread_count, dump_count));
+    renaming.store(false, std::memory_order_relaxed);
+    renamer.join();
+    return 0;
+}
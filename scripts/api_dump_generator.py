@@ -37,6 +37,7 @@
 #   * api_dump_text.h: TEXT_CODEGEN - Provides the back end for dumping to a text file
 #   * api_dump_html.h: HTML_CODEGEN - Provides the back end for dumping to a html document
 #   * api_dump_json.h: JSON_CODEGEN - Provides the back end for dumping to a JSON file
+#   * api_dump_trace.h: TRACE_CODEGEN - Provides the back end for dumping to a Chrome trace file
 #
 
 import os,re,sys,string
@@ -75,14 +76,20 @@ COMMON_CODEGEN = """
 #include "api_dump_text.h"
 #include "api_dump_html.h"
 #include "api_dump_json.h"
+#include "api_dump_trace.h"
+#include "api_dump_binary.h"
 
 //============================= Dump Functions ==============================//
 
 @foreach function where(not '{funcName}' in ['vkGetDeviceProcAddr', 'vkGetInstanceProcAddr', 'vkDebugMarkerSetObjectNameEXT','vkSetDebugUtilsObjectNameEXT'])
 inline void dump_head_{funcName}(ApiDumpInstance& dump_inst, {funcTypedParams})
 {{
+    @if('{funcName}' in ['vkCmdBeginDebugUtilsLabelEXT', 'vkCmdInsertDebugUtilsLabelEXT', 'vkQueueBeginDebugUtilsLabelEXT', 'vkQueueInsertDebugUtilsLabelEXT'])
+    dump_inst.checkTriggerLabel(pLabelInfo);
+    @end if
     if (!dump_inst.shouldDumpOutput()) return ;
-    dump_inst.outputMutex()->lock();
+    if (!dump_inst.shouldDumpFunction({funcIndex})) return ;
+    dump_inst.beginRecord();
     switch(dump_inst.settings().format())
     {{
     case ApiDumpFormat::Text:
@@ -94,38 +101,50 @@ inline void dump_head_{funcName}(ApiDumpInstance& dump_inst, {funcTypedParams})
     case ApiDumpFormat::Json:
         dump_json_head_{funcName}(dump_inst, {funcNamedParams});
         break;
+    case ApiDumpFormat::Trace:
+        dump_trace_head_{funcName}(dump_inst, {funcNamedParams});
+        break;
+    case ApiDumpFormat::Binary:
+        dump_binary_head_{funcName}(dump_inst, {funcNamedParams});
+        break;
     }}
-    //Keep lock
 }}
 @end function
 
 @foreach function where('{funcReturn}' != 'void' and not '{funcName}' in ['vkGetDeviceProcAddr', 'vkGetInstanceProcAddr', 'vkDebugMarkerSetObjectNameEXT','vkSetDebugUtilsObjectNameEXT'])
 inline void dump_body_{funcName}(ApiDumpInstance& dump_inst, {funcReturn} result, {funcTypedParams})
 {{
-    if (!dump_inst.shouldDumpOutput()) return;
-
-    //Lock is already held
-    switch(dump_inst.settings().format())
-    {{
-    case ApiDumpFormat::Text:
-        dump_text_body_{funcName}(dump_inst, result, {funcNamedParams});
-        break;
-    case ApiDumpFormat::Html:
-        dump_html_body_{funcName}(dump_inst, result, {funcNamedParams});
-        break;
-    case ApiDumpFormat::Json:
-        dump_json_body_{funcName}(dump_inst, result, {funcNamedParams});
-        break;
+    if (dump_inst.recordOpen()) {{
+        switch(dump_inst.settings().format())
+        {{
+        case ApiDumpFormat::Text:
+            dump_text_body_{funcName}(dump_inst, result, {funcNamedParams});
+            break;
+        case ApiDumpFormat::Html:
+            dump_html_body_{funcName}(dump_inst, result, {funcNamedParams});
+            break;
+        case ApiDumpFormat::Json:
+            dump_json_body_{funcName}(dump_inst, result, {funcNamedParams});
+            break;
+        case ApiDumpFormat::Trace:
+            dump_trace_body_{funcName}(dump_inst, result, {funcNamedParams});
+            break;
+        case ApiDumpFormat::Binary:
+            dump_binary_body_{funcName}(dump_inst, result, {funcNamedParams});
+            break;
+        }}
+        dump_inst.commitRecord();
     }}
-    dump_inst.outputMutex()->unlock();
+    @if('{funcReturn}' == 'VkResult')
+    dump_inst.checkResult(result);
+    @end if
 }}
 @end function
 
 @foreach function where('{funcReturn}' == 'void')
 inline void dump_body_{funcName}(ApiDumpInstance& dump_inst, {funcTypedParams})
 {{
-    if (!dump_inst.shouldDumpOutput()) return ;
-    //Lock is already held
+    if (!dump_inst.recordOpen()) return ;
     switch(dump_inst.settings().format())
     {{
     case ApiDumpFormat::Text:
@@ -137,8 +156,14 @@ inline void dump_body_{funcName}(ApiDumpInstance& dump_inst, {funcTypedParams})
     case ApiDumpFormat::Json:
         dump_json_body_{funcName}(dump_inst, {funcNamedParams});
         break;
+    case ApiDumpFormat::Trace:
+        dump_trace_body_{funcName}(dump_inst, {funcNamedParams});
+        break;
+    case ApiDumpFormat::Binary:
+        dump_binary_body_{funcName}(dump_inst, {funcNamedParams});
+        break;
     }}
-    dump_inst.outputMutex()->unlock();
+    dump_inst.commitRecord();
 }}
 @end function
 
@@ -146,18 +171,10 @@ inline void dump_body_{funcName}(ApiDumpInstance& dump_inst, {funcTypedParams})
 @foreach function where('{funcName}' == 'vkDebugMarkerSetObjectNameEXT')
 inline void dump_head_{funcName}(ApiDumpInstance& dump_inst, {funcTypedParams})
 {{
-    dump_inst.outputMutex()->lock();
-
-    if (pNameInfo->pObjectName)
-    {{
-        dump_inst.object_name_map.insert(std::make_pair<uint64_t, std::string>((uint64_t &&)pNameInfo->object, pNameInfo->pObjectName));
-    }}
-    else
-    {{
-        dump_inst.object_name_map.erase(pNameInfo->object);
-    }}
+    dump_inst.setObjectName(pNameInfo->object, pNameInfo->pObjectName);
 
-    if (dump_inst.shouldDumpOutput()) {{
+    if (dump_inst.shouldDumpOutput() && dump_inst.shouldDumpFunction({funcIndex})) {{
+        dump_inst.beginRecord();
         switch(dump_inst.settings().format())
         {{
         case ApiDumpFormat::Text:
@@ -169,18 +186,21 @@ inline void dump_head_{funcName}(ApiDumpInstance& dump_inst, {funcTypedParams})
         case ApiDumpFormat::Json:
             dump_json_head_{funcName}(dump_inst, {funcNamedParams});
             break;
+        case ApiDumpFormat::Trace:
+            dump_trace_head_{funcName}(dump_inst, {funcNamedParams});
+            break;
+        case ApiDumpFormat::Binary:
+            dump_binary_head_{funcName}(dump_inst, {funcNamedParams});
+            break;
         }}
     }}
-
-    //Keep lock
 }}
 @end function
 
 @foreach function where('{funcName}' == 'vkDebugMarkerSetObjectNameEXT')
 inline void dump_body_{funcName}(ApiDumpInstance& dump_inst, {funcReturn} result, {funcTypedParams})
 {{
-    //Lock is already held
-    if (dump_inst.shouldDumpOutput()) {{
+    if (dump_inst.recordOpen()) {{
         switch(dump_inst.settings().format())
         {{
         case ApiDumpFormat::Text:
@@ -192,26 +212,24 @@ inline void dump_body_{funcName}(ApiDumpInstance& dump_inst, {funcReturn} result
         case ApiDumpFormat::Json:
             dump_json_body_{funcName}(dump_inst, result, {funcNamedParams});
             break;
+        case ApiDumpFormat::Trace:
+            dump_trace_body_{funcName}(dump_inst, result, {funcNamedParams});
+            break;
+        case ApiDumpFormat::Binary:
+            dump_binary_body_{funcName}(dump_inst, result, {funcNamedParams});
+            break;
         }}
+        dump_inst.commitRecord();
     }}
-
-    dump_inst.outputMutex()->unlock();
 }}
 @end function
 
 @foreach function where('{funcName}' == 'vkSetDebugUtilsObjectNameEXT')
 inline void dump_head_{funcName}(ApiDumpInstance& dump_inst, {funcTypedParams})
 {{
-    dump_inst.outputMutex()->lock();
-    if (pNameInfo->pObjectName)
-    {{
-        dump_inst.object_name_map.insert(std::make_pair<uint64_t, std::string>((uint64_t &&)pNameInfo->objectHandle, pNameInfo->pObjectName));
-    }}
-    else
-    {{
-        dump_inst.object_name_map.erase(pNameInfo->objectHandle);
-    }}
-    if (dump_inst.shouldDumpOutput()) {{
+    dump_inst.setObjectName(pNameInfo->objectHandle, pNameInfo->pObjectName);
+    if (dump_inst.shouldDumpOutput() && dump_inst.shouldDumpFunction({funcIndex})) {{
+        dump_inst.beginRecord();
         switch(dump_inst.settings().format())
         {{
         case ApiDumpFormat::Text:
@@ -223,17 +241,21 @@ inline void dump_head_{funcName}(ApiDumpInstance& dump_inst, {funcTypedParams})
         case ApiDumpFormat::Json:
             dump_json_head_{funcName}(dump_inst, {funcNamedParams});
             break;
+        case ApiDumpFormat::Trace:
+            dump_trace_head_{funcName}(dump_inst, {funcNamedParams});
+            break;
+        case ApiDumpFormat::Binary:
+            dump_binary_head_{funcName}(dump_inst, {funcNamedParams});
+            break;
         }}
     }}
-    //Keep lock
 }}
 @end function
 
 @foreach function where('{funcName}' == 'vkSetDebugUtilsObjectNameEXT')
 inline void dump_body_{funcName}(ApiDumpInstance& dump_inst, {funcReturn} result, {funcTypedParams})
 {{
-    //Lock is already held
-    if (dump_inst.shouldDumpOutput()) {{
+    if (dump_inst.recordOpen()) {{
         switch(dump_inst.settings().format())
         {{
         case ApiDumpFormat::Text:
@@ -245,9 +267,15 @@ inline void dump_body_{funcName}(ApiDumpInstance& dump_inst, {funcReturn} result
         case ApiDumpFormat::Json:
             dump_json_body_{funcName}(dump_inst, result, {funcNamedParams});
             break;
+        case ApiDumpFormat::Trace:
+            dump_trace_body_{funcName}(dump_inst, result, {funcNamedParams});
+            break;
+        case ApiDumpFormat::Binary:
+            dump_binary_body_{funcName}(dump_inst, result, {funcNamedParams});
+            break;
         }}
+        dump_inst.commitRecord();
     }}
-    dump_inst.outputMutex()->unlock();
 }}
 @end function
 
@@ -272,7 +300,9 @@ VK_LAYER_EXPORT VKAPI_ATTR {funcReturn} VKAPI_CALL {funcName}({funcTypedParams})
 
     // Call the function and create the dispatch table
     chain_info->u.pLayerInfo = chain_info->u.pLayerInfo->pNext;
+    const uint64_t call_start = ApiDumpInstance::current().beginCall();
     {funcReturn} result = fpCreateInstance({funcNamedParams});
+    ApiDumpInstance::current().endCall({funcIndex}, call_start);
     if(result == VK_SUCCESS) {{
         initInstanceTable(*pInstance, fpGetInstanceProcAddr);
     }}
@@ -289,7 +319,9 @@ VK_LAYER_EXPORT VKAPI_ATTR {funcReturn} VKAPI_CALL {funcName}({funcTypedParams})
     dump_head_{funcName}(ApiDumpInstance::current(), {funcNamedParams});
     // Destroy the dispatch table
     dispatch_key key = get_dispatch_key({funcDispatchParam});
+    const uint64_t call_start = ApiDumpInstance::current().beginCall();
     instance_dispatch_table({funcDispatchParam})->DestroyInstance({funcNamedParams});
+    ApiDumpInstance::current().endCall({funcIndex}, call_start);
     destroy_instance_dispatch_table(key);
     {funcStateTrackingCode}
     // Output the API dump
@@ -314,7 +346,9 @@ VK_LAYER_EXPORT VKAPI_ATTR {funcReturn} VKAPI_CALL {funcName}({funcTypedParams})
 
     // Call the function and create the dispatch table
     chain_info->u.pLayerInfo = chain_info->u.pLayerInfo->pNext;
+    const uint64_t call_start = ApiDumpInstance::current().beginCall();
     {funcReturn} result = fpCreateDevice({funcNamedParams});
+    ApiDumpInstance::current().endCall({funcIndex}, call_start);
     if(result == VK_SUCCESS) {{
         initDeviceTable(*pDevice, fpGetDeviceProcAddr);
     }}
@@ -332,7 +366,9 @@ VK_LAYER_EXPORT VKAPI_ATTR {funcReturn} VKAPI_CALL {funcName}({funcTypedParams})
 
     // Destroy the dispatch table
     dispatch_key key = get_dispatch_key({funcDispatchParam});
+    const uint64_t call_start = ApiDumpInstance::current().beginCall();
     device_dispatch_table({funcDispatchParam})->DestroyDevice({funcNamedParams});
+    ApiDumpInstance::current().endCall({funcIndex}, call_start);
     destroy_device_dispatch_table(key);
     {funcStateTrackingCode}
     // Output the API dump
@@ -382,15 +418,15 @@ VK_LAYER_EXPORT VKAPI_ATTR {funcReturn} VKAPI_CALL {funcName}({funcTypedParams})
 @foreach function where('{funcName}' == 'vkQueuePresentKHR')
 VK_LAYER_EXPORT VKAPI_ATTR {funcReturn} VKAPI_CALL {funcName}({funcTypedParams})
 {{
-    ApiDumpInstance::current().outputMutex()->lock();
     dump_head_{funcName}(ApiDumpInstance::current(), {funcNamedParams});
 
+    const uint64_t call_start = ApiDumpInstance::current().beginCall();
     {funcReturn} result = device_dispatch_table({funcDispatchParam})->{funcShortName}({funcNamedParams});
+    ApiDumpInstance::current().endCall({funcIndex}, call_start);
     {funcStateTrackingCode}
     dump_body_{funcName}(ApiDumpInstance::current(), result, {funcNamedParams});
 
     ApiDumpInstance::current().nextFrame();
-    ApiDumpInstance::current().outputMutex()->unlock();
     return result;
 }}
 @end function
@@ -401,7 +437,9 @@ VK_LAYER_EXPORT VKAPI_ATTR {funcReturn} VKAPI_CALL {funcName}({funcTypedParams})
 VK_LAYER_EXPORT VKAPI_ATTR {funcReturn} VKAPI_CALL {funcName}({funcTypedParams})
 {{
     dump_head_{funcName}(ApiDumpInstance::current(), {funcNamedParams});
+    const uint64_t call_start = ApiDumpInstance::current().beginCall();
     {funcReturn} result = instance_dispatch_table({funcDispatchParam})->{funcShortName}({funcNamedParams});
+    ApiDumpInstance::current().endCall({funcIndex}, call_start);
     {funcStateTrackingCode}
     dump_body_{funcName}(ApiDumpInstance::current(), result, {funcNamedParams});
     return result;
@@ -412,7 +450,9 @@ VK_LAYER_EXPORT VKAPI_ATTR {funcReturn} VKAPI_CALL {funcName}({funcTypedParams})
 VK_LAYER_EXPORT VKAPI_ATTR {funcReturn} VKAPI_CALL {funcName}({funcTypedParams})
 {{
     dump_head_{funcName}(ApiDumpInstance::current(), {funcNamedParams});
+    const uint64_t call_start = ApiDumpInstance::current().beginCall();
     instance_dispatch_table({funcDispatchParam})->{funcShortName}({funcNamedParams});
+    ApiDumpInstance::current().endCall({funcIndex}, call_start);
     {funcStateTrackingCode}
     dump_body_{funcName}(ApiDumpInstance::current(), {funcNamedParams});    
 }}
@@ -424,7 +464,9 @@ VK_LAYER_EXPORT VKAPI_ATTR {funcReturn} VKAPI_CALL {funcName}({funcTypedParams})
 VK_LAYER_EXPORT VKAPI_ATTR {funcReturn} VKAPI_CALL {funcName}({funcTypedParams})
 {{
     dump_head_{funcName}(ApiDumpInstance::current(), {funcNamedParams});
+    const uint64_t call_start = ApiDumpInstance::current().beginCall();
     {funcReturn} result = device_dispatch_table({funcDispatchParam})->{funcShortName}({funcNamedParams});
+    ApiDumpInstance::current().endCall({funcIndex}, call_start);
     {funcStateTrackingCode}
     dump_body_{funcName}(ApiDumpInstance::current(), result, {funcNamedParams});
     return result;
@@ -435,12 +477,15 @@ VK_LAYER_EXPORT VKAPI_ATTR {funcReturn} VKAPI_CALL {funcName}({funcTypedParams})
 VK_LAYER_EXPORT VKAPI_ATTR {funcReturn} VKAPI_CALL {funcName}({funcTypedParams})
 {{
     dump_head_{funcName}(ApiDumpInstance::current(), {funcNamedParams});
+    const uint64_t call_start = ApiDumpInstance::current().beginCall();
     device_dispatch_table({funcDispatchParam})->{funcShortName}({funcNamedParams});
+    ApiDumpInstance::current().endCall({funcIndex}, call_start);
     {funcStateTrackingCode}
     dump_body_{funcName}(ApiDumpInstance::current(), {funcNamedParams});
 }}
 @end function
 
+@foreach function where('{funcName}' == 'vkGetPhysicalDeviceToolPropertiesEXT')
 VK_LAYER_EXPORT VKAPI_ATTR VkResult VKAPI_CALL vkGetPhysicalDeviceToolPropertiesEXT(VkPhysicalDevice physicalDevice, uint32_t *pToolCount, VkPhysicalDeviceToolPropertiesEXT *pToolProperties)
 {{
     dump_head_vkGetPhysicalDeviceToolPropertiesEXT(ApiDumpInstance::current(), physicalDevice, pToolCount, pToolProperties);
@@ -461,7 +506,9 @@ VK_LAYER_EXPORT VKAPI_ATTR VkResult VKAPI_CALL vkGetPhysicalDeviceToolProperties
     }}
 
     VkLayerInstanceDispatchTable *pInstanceTable = instance_dispatch_table(physicalDevice);
+    const uint64_t call_start = ApiDumpInstance::current().beginCall();
     VkResult result = pInstanceTable->GetPhysicalDeviceToolPropertiesEXT(physicalDevice, pToolCount, pToolProperties);
+    ApiDumpInstance::current().endCall({funcIndex}, call_start);
 
     if (original_pToolProperties != nullptr) {{
         pToolProperties = original_pToolProperties;
@@ -471,6 +518,7 @@ VK_LAYER_EXPORT VKAPI_ATTR VkResult VKAPI_CALL vkGetPhysicalDeviceToolProperties
     dump_body_vkGetPhysicalDeviceToolPropertiesEXT(ApiDumpInstance::current(), result, physicalDevice, pToolCount, pToolProperties);
     return result;
 }}
+@end function
 
 VK_LAYER_EXPORT VKAPI_ATTR PFN_vkVoidFunction VKAPI_CALL vkGetInstanceProcAddr(VkInstance instance, const char* pName)
 {{
@@ -528,33 +576,33 @@ TEXT_CODEGEN = """
 #include "api_dump.h"
 
 @foreach struct
-std::ostream& dump_text_{sctName}(const {sctName}& object, const ApiDumpSettings& settings, int indents{sctConditionVars});
+ApiDumpFormatter& dump_text_{sctName}(const {sctName}& object, const ApiDumpSettings& settings, int indents{sctConditionVars});
 @end struct
 @foreach union
-std::ostream& dump_text_{unName}(const {unName}& object, const ApiDumpSettings& settings, int indents);
+ApiDumpFormatter& dump_text_{unName}(const {unName}& object, const ApiDumpSettings& settings, int indents);
 @end union
 
 //============================= typedefs ==============================//
 
 // Functions for dumping typedef types that the codegen scripting can't handle
 #if defined(VK_ENABLE_BETA_EXTENSIONS)
-std::ostream& dump_text_VkAccelerationStructureTypeKHR(VkAccelerationStructureTypeKHR object, const ApiDumpSettings& settings, int indents);
-std::ostream& dump_text_VkAccelerationStructureTypeNV(VkAccelerationStructureTypeNV object, const ApiDumpSettings& settings, int indents)
+ApiDumpFormatter& dump_text_VkAccelerationStructureTypeKHR(VkAccelerationStructureTypeKHR object, const ApiDumpSettings& settings, int indents);
+ApiDumpFormatter& dump_text_VkAccelerationStructureTypeNV(VkAccelerationStructureTypeNV object, const ApiDumpSettings& settings, int indents)
 {{
     return dump_text_VkAccelerationStructureTypeKHR(object, settings, indents);
 }}
-std::ostream& dump_text_VkBuildAccelerationStructureFlagsKHR(VkBuildAccelerationStructureFlagsKHR object, const ApiDumpSettings& settings, int indents);
-inline std::ostream& dump_text_VkBuildAccelerationStructureFlagsNV(VkBuildAccelerationStructureFlagsNV object, const ApiDumpSettings& settings, int indents)
+ApiDumpFormatter& dump_text_VkBuildAccelerationStructureFlagsKHR(VkBuildAccelerationStructureFlagsKHR object, const ApiDumpSettings& settings, int indents);
+inline ApiDumpFormatter& dump_text_VkBuildAccelerationStructureFlagsNV(VkBuildAccelerationStructureFlagsNV object, const ApiDumpSettings& settings, int indents)
 {{
     return dump_text_VkBuildAccelerationStructureFlagsKHR(object, settings, indents);
 }}
-std::ostream& dump_text_VkAccelerationStructureMemoryRequirementsTypeKHR(VkAccelerationStructureMemoryRequirementsTypeKHR object, const ApiDumpSettings& settings, int indents);
-std::ostream& dump_text_VkAccelerationStructureMemoryRequirementsTypeNV(VkAccelerationStructureMemoryRequirementsTypeNV object, const ApiDumpSettings& settings, int indents)
+ApiDumpFormatter& dump_text_VkAccelerationStructureMemoryRequirementsTypeKHR(VkAccelerationStructureMemoryRequirementsTypeKHR object, const ApiDumpSettings& settings, int indents);
+ApiDumpFormatter& dump_text_VkAccelerationStructureMemoryRequirementsTypeNV(VkAccelerationStructureMemoryRequirementsTypeNV object, const ApiDumpSettings& settings, int indents)
 {{
     return dump_text_VkAccelerationStructureMemoryRequirementsTypeKHR(object, settings, indents);
 }}
-std::ostream& dump_text_VkAccelerationStructureKHR(const VkAccelerationStructureKHR object, const ApiDumpSettings& settings, int indents);
-std::ostream& dump_text_VkAccelerationStructureNV(const VkAccelerationStructureNV object, const ApiDumpSettings& settings, int indents)
+ApiDumpFormatter& dump_text_VkAccelerationStructureKHR(const VkAccelerationStructureKHR object, const ApiDumpSettings& settings, int indents);
+ApiDumpFormatter& dump_text_VkAccelerationStructureNV(const VkAccelerationStructureNV object, const ApiDumpSettings& settings, int indents)
 {{
     return dump_text_VkAccelerationStructureKHR(object, settings, indents);
 }}
@@ -563,7 +611,7 @@ std::ostream& dump_text_VkAccelerationStructureNV(const VkAccelerationStructureN
 
 //======================== pNext Chain Implementation =======================//
 
-std::ostream& dump_text_pNext_trampoline(const void* object, const ApiDumpSettings& settings, int indents)
+ApiDumpFormatter& dump_text_pNext_trampoline(const void* object, const ApiDumpSettings& settings, int indents)
 {{
     switch((int64_t) (static_cast<const VkBaseInStructure*>(object)->sType)) {{
     @foreach struct where('{sctName}' not in ['VkPipelineViewportStateCreateInfo', 'VkCommandBufferBeginInfo'])
@@ -590,19 +638,19 @@ std::ostream& dump_text_pNext_trampoline(const void* object, const ApiDumpSettin
     return settings.stream(); 
 }}
 
-inline std::ostream& dump_text_pNext_trampoline(const void* object, const ApiDumpSettings& settings, int indents, bool is_dynamic_viewport, bool is_dynamic_scissor)
+inline ApiDumpFormatter& dump_text_pNext_trampoline(const void* object, const ApiDumpSettings& settings, int indents, bool is_dynamic_viewport, bool is_dynamic_scissor)
 {{
     dump_text_pNext<const VkPipelineViewportStateCreateInfo>(static_cast<const VkPipelineViewportStateCreateInfo*>(object), settings, "VkPipelineViewportStateCreateInfo", indents, dump_text_VkPipelineViewportStateCreateInfo, is_dynamic_viewport, is_dynamic_scissor);
     return settings.stream(); 
 }}
 
-inline std::ostream& dump_text_pNext_trampoline(const void* object, const ApiDumpSettings& settings, int indents, VkCommandBuffer cmd_buffer)
+inline ApiDumpFormatter& dump_text_pNext_trampoline(const void* object, const ApiDumpSettings& settings, int indents, VkCommandBuffer cmd_buffer)
 {{
     dump_text_pNext<const VkCommandBufferBeginInfo>(static_cast<const VkCommandBufferBeginInfo*>(object), settings, "VkCommandBufferBeginInfo", indents, dump_text_VkCommandBufferBeginInfo, cmd_buffer);
     return settings.stream(); 
 }}
 
-std::ostream& dump_text_pNext_struct_name(const void* object, const ApiDumpSettings& settings, int indents)
+ApiDumpFormatter& dump_text_pNext_struct_name(const void* object, const ApiDumpSettings& settings, int indents)
 {{
     switch((int64_t) (static_cast<const VkBaseInStructure*>(object)->sType)) {{
     @foreach struct where('{sctName}' not in ['VkPipelineViewportStateCreateInfo', 'VkCommandBufferBeginInfo'])
@@ -629,7 +677,7 @@ std::ostream& dump_text_pNext_struct_name(const void* object, const ApiDumpSetti
 //=========================== Type Implementations ==========================//
 
 @foreach type where('{etyName}' != 'void')
-inline std::ostream& dump_text_{etyName}({etyName} object, const ApiDumpSettings& settings, int indents)
+inline ApiDumpFormatter& dump_text_{etyName}({etyName} object, const ApiDumpSettings& settings, int indents)
 {{
     @if('{etyName}' != 'uint8_t')
     return settings.stream() << object;
@@ -643,14 +691,14 @@ inline std::ostream& dump_text_{etyName}({etyName} object, const ApiDumpSettings
 //========================= Basetype Implementations ========================//
 
 @foreach basetype where(not '{baseName}' in ['ANativeWindow', 'AHardwareBuffer', 'CAMetalLayer'])
-inline std::ostream& dump_text_{baseName}({baseName} object, const ApiDumpSettings& settings, int indents)
+inline ApiDumpFormatter& dump_text_{baseName}({baseName} object, const ApiDumpSettings& settings, int indents)
 {{
     return settings.stream() << object;
 }}
 @end basetype
 @foreach basetype where('{baseName}' in ['ANativeWindow', 'AHardwareBuffer'])
 #if defined(VK_USE_PLATFORM_ANDROID_KHR)
-inline std::ostream& dump_text_{baseName}(const {baseName}* object, const ApiDumpSettings& settings, int indents)
+inline ApiDumpFormatter& dump_text_{baseName}(const {baseName}* object, const ApiDumpSettings& settings, int indents)
 {{
     return settings.stream() << object;
 }}
@@ -658,7 +706,7 @@ inline std::ostream& dump_text_{baseName}(const {baseName}* object, const ApiDum
 @end basetype
 @foreach basetype where('{baseName}' in ['CAMetalLayer'])
 #if defined(VK_USE_PLATFORM_METAL_EXT)
-inline std::ostream& dump_text_{baseName}({baseName} object, const ApiDumpSettings& settings, int indents)
+inline ApiDumpFormatter& dump_text_{baseName}({baseName} object, const ApiDumpSettings& settings, int indents)
 {{
     return settings.stream() << object;
 }}
@@ -668,7 +716,7 @@ inline std::ostream& dump_text_{baseName}({baseName} object, const ApiDumpSettin
 //======================= System Type Implementations =======================//
 
 @foreach systype
-inline std::ostream& dump_text_{sysName}(const {sysType} object, const ApiDumpSettings& settings, int indents)
+inline ApiDumpFormatter& dump_text_{sysName}(const {sysType} object, const ApiDumpSettings& settings, int indents)
 {{
     return settings.stream() << object;
 }}
@@ -677,14 +725,14 @@ inline std::ostream& dump_text_{sysName}(const {sysType} object, const ApiDumpSe
 //========================== Handle Implementations =========================//
 
 @foreach handle
-inline std::ostream& dump_text_{hdlName}(const {hdlName} object, const ApiDumpSettings& settings, int indents)
+inline ApiDumpFormatter& dump_text_{hdlName}(const {hdlName} object, const ApiDumpSettings& settings, int indents)
 {{
     if(settings.showAddress()) {{
         settings.stream() << object;
 
-        std::unordered_map<uint64_t, std::string>::const_iterator it = ApiDumpInstance::current().object_name_map.find((uint64_t) object);
-        if (it != ApiDumpInstance::current().object_name_map.end()) {{
-            settings.stream() << " [" << it->second << "]";
+        const char* object_name = ApiDumpInstance::current().getObjectName((uint64_t) object);
+        if (object_name != NULL) {{
+            settings.stream() << " [" << object_name << "]";
         }}
     }} else {{
         settings.stream() << "address";
@@ -697,7 +745,7 @@ inline std::ostream& dump_text_{hdlName}(const {hdlName} object, const ApiDumpSe
 //=========================== Enum Implementations ==========================//
 
 @foreach enum
-std::ostream& dump_text_{enumName}({enumName} object, const ApiDumpSettings& settings, int indents)
+ApiDumpFormatter& dump_text_{enumName}({enumName} object, const ApiDumpSettings& settings, int indents)
 {{
     switch((int64_t) object)
     {{
@@ -716,7 +764,7 @@ std::ostream& dump_text_{enumName}({enumName} object, const ApiDumpSettings& set
 //========================= Bitmask Implementations =========================//
 
 @foreach bitmask
-std::ostream& dump_text_{bitName}({bitName} object, const ApiDumpSettings& settings, int indents)
+ApiDumpFormatter& dump_text_{bitName}({bitName} object, const ApiDumpSettings& settings, int indents)
 {{
     bool is_first = true;
     //settings.formatNameType(stream, indents, name, type_string) << object;
@@ -741,13 +789,13 @@ std::ostream& dump_text_{bitName}({bitName} object, const ApiDumpSettings& setti
 //=========================== Flag Implementations ==========================//
 
 @foreach flag where('{flagEnum}' != 'None')
-inline std::ostream& dump_text_{flagName}({flagName} object, const ApiDumpSettings& settings, int indents)
+inline ApiDumpFormatter& dump_text_{flagName}({flagName} object, const ApiDumpSettings& settings, int indents)
 {{
     return dump_text_{flagEnum}(({flagEnum}) object, settings, indents);
 }}
 @end flag
 @foreach flag where('{flagEnum}' == 'None')
-inline std::ostream& dump_text_{flagName}({flagName} object, const ApiDumpSettings& settings, int indents)
+inline ApiDumpFormatter& dump_text_{flagName}({flagName} object, const ApiDumpSettings& settings, int indents)
 {{
     return settings.stream() << object;
 }}
@@ -756,7 +804,7 @@ inline std::ostream& dump_text_{flagName}({flagName} object, const ApiDumpSettin
 //======================= Func Pointer Implementations ======================//
 
 @foreach funcpointer
-inline std::ostream& dump_text_{pfnName}({pfnName} object, const ApiDumpSettings& settings, int indents)
+inline ApiDumpFormatter& dump_text_{pfnName}({pfnName} object, const ApiDumpSettings& settings, int indents)
 {{
     if(settings.showAddress())
         return settings.stream() << object;
@@ -768,7 +816,7 @@ inline std::ostream& dump_text_{pfnName}({pfnName} object, const ApiDumpSettings
 //========================== Struct Implementations =========================//
 
 @foreach struct where('{sctName}' not in ['VkPhysicalDeviceMemoryProperties','VkPhysicalDeviceGroupProperties'])
-std::ostream& dump_text_{sctName}(const {sctName}& object, const ApiDumpSettings& settings, int indents{sctConditionVars})
+ApiDumpFormatter& dump_text_{sctName}(const {sctName}& object, const ApiDumpSettings& settings, int indents{sctConditionVars})
 {{
     if(settings.showAddress())
         settings.stream() << &object << ":\\n";
@@ -803,13 +851,15 @@ std::ostream& dump_text_{sctName}(const {sctName}& object, const ApiDumpSettings
     dump_text_array<const {memBaseType}>(object.{memName}, {memLength}, settings, "{memType}", "{memChildType}", "{memName}", indents + 1, dump_text_{memTypeID}{memInheritedConditions}); // BQA
     @end if
     @if(not ('{memLength}'[0].isdigit() or '{memLength}'[0].isupper()))
-    dump_text_array<const {memBaseType}>(object.{memName}, object.{memLength}, settings, "{memType}", "{memChildType}", "{memName}", indents + 1, dump_text_{memTypeID}{memInheritedConditions}); // BQB
+    dump_text_array<const {memBaseType}>(object.{memName}, {memObjectLength}, settings, "{memType}", "{memChildType}", "{memName}", indents + 1, dump_text_{memTypeID}{memInheritedConditions}); // BQB
     @end if
     @end if
 
     @if('{sctName}' == 'VkShaderModuleCreateInfo')
     @if('{memName}' == 'pCode')
-    if(settings.showShader())
+    if(settings.writeShaderFiles())
+        dump_text_shader(object.{memName}, object.codeSize, settings, "{memType}", "{memName}", indents + 1);
+    else if(settings.showShader())
         dump_text_array<const {memBaseType}>(object.{memName}, object.{memLength}, settings, "{memType}", "{memChildType}", "{memName}", indents + 1, dump_text_{memTypeID}{memInheritedConditions}); // CQA
     else
         dump_text_special("SHADER DATA", settings, "{memType}", "{memName}", indents + 1);
@@ -835,7 +885,7 @@ std::ostream& dump_text_{sctName}(const {sctName}& object, const ApiDumpSettings
 }}
 @end struct
 
-std::ostream& dump_text_VkPhysicalDeviceMemoryProperties(const VkPhysicalDeviceMemoryProperties& object, const ApiDumpSettings& settings, int indents)
+ApiDumpFormatter& dump_text_VkPhysicalDeviceMemoryProperties(const VkPhysicalDeviceMemoryProperties& object, const ApiDumpSettings& settings, int indents)
 {{
     if(settings.showAddress())
         settings.stream() << &object << ":\\n";
@@ -849,7 +899,7 @@ std::ostream& dump_text_VkPhysicalDeviceMemoryProperties(const VkPhysicalDeviceM
     return settings.stream();
 }}
 
-std::ostream& dump_text_VkPhysicalDeviceGroupProperties(const VkPhysicalDeviceGroupProperties& object, const ApiDumpSettings& settings, int indents)
+ApiDumpFormatter& dump_text_VkPhysicalDeviceGroupProperties(const VkPhysicalDeviceGroupProperties& object, const ApiDumpSettings& settings, int indents)
 {{
     if(settings.showAddress())
         settings.stream() << &object << ":\\n";
@@ -866,7 +916,7 @@ std::ostream& dump_text_VkPhysicalDeviceGroupProperties(const VkPhysicalDeviceGr
 //========================== Union Implementations ==========================//
 
 @foreach union
-std::ostream& dump_text_{unName}(const {unName}& object, const ApiDumpSettings& settings, int indents)
+ApiDumpFormatter& dump_text_{unName}(const {unName}& object, const ApiDumpSettings& settings, int indents)
 {{
     if(settings.showAddress())
         settings.stream() << &object << " (Union):\\n";
@@ -891,11 +941,16 @@ std::ostream& dump_text_{unName}(const {unName}& object, const ApiDumpSettings&
 //========================= Function Implementations ========================//
 
 @foreach function where('{funcName}' not in ['vkGetDeviceProcAddr', 'vkGetInstanceProcAddr'])
-std::ostream& dump_text_head_{funcName}(ApiDumpInstance& dump_inst, {funcTypedParams})
+ApiDumpFormatter& dump_text_head_{funcName}(ApiDumpInstance& dump_inst, {funcTypedParams})
 {{
     const ApiDumpSettings& settings(dump_inst.settings());
     if (settings.showThreadAndFrame()) {{
-        settings.stream() << "Thread " << dump_inst.threadID() << ", Frame " << dump_inst.frameCount();
+        settings.stream() << "Thread " << dump_inst.threadID();
+        if (settings.showOSThreadID()) {{
+            settings.stream() << " (TID " << dump_inst.osThreadID() << ")";
+        }}
+        settings.stream() << ", Frame ";
+        dump_text_frame(dump_inst, settings);
     }}
     if(settings.showTimestamp() && settings.showThreadAndFrame()) {{
         settings.stream() << ", ";
@@ -906,18 +961,19 @@ std::ostream& dump_text_head_{funcName}(ApiDumpInstance& dump_inst, {funcTypedPa
     if (settings.showTimestamp() || settings.showThreadAndFrame()) {{
         settings.stream() << ":\\n";
     }}
+    dump_text_header_end(settings);
     settings.stream() << "{funcName}({funcNamedParams}) returns {funcReturn}";
 
-    return settings.shouldFlush() ? settings.stream() << std::flush : settings.stream();
+    return settings.stream();
 }}
 @end function
 
 @foreach function where('{funcName}' not in ['vkGetDeviceProcAddr', 'vkGetInstanceProcAddr'])
 @if('{funcReturn}' != 'void')
-std::ostream& dump_text_body_{funcName}(ApiDumpInstance& dump_inst, {funcReturn} result, {funcTypedParams})
+ApiDumpFormatter& dump_text_body_{funcName}(ApiDumpInstance& dump_inst, {funcReturn} result, {funcTypedParams})
 @end if
 @if('{funcReturn}' == 'void')
-std::ostream& dump_text_body_{funcName}(ApiDumpInstance& dump_inst, {funcTypedParams})
+ApiDumpFormatter& dump_text_body_{funcName}(ApiDumpInstance& dump_inst, {funcTypedParams})
 @end if
 {{
     const ApiDumpSettings& settings(dump_inst.settings());
@@ -926,6 +982,9 @@ std::ostream& dump_text_body_{funcName}(ApiDumpInstance& dump_inst, {funcTypedPa
     settings.stream() << " ";
     dump_text_{funcReturn}(result, settings, 0);
     @end if
+    if (settings.showDuration()) {{
+        dump_text_duration(dump_inst, settings);
+    }}
     settings.stream() << ":\\n";
     if(settings.showParams())
     {{
@@ -941,12 +1000,37 @@ std::ostream& dump_text_body_{funcName}(ApiDumpInstance& dump_inst, {funcTypedPa
         @end if
         @end parameter
     }}
-    settings.shouldFlush() ? settings.stream() << std::endl : settings.stream() << "\\n";
+    settings.stream() << "\\n";
 
     return settings.stream();
 }}
 @end function
 
+//========================== Function Filter =========================//
+
+void resolve_function_filter(ApiDumpFunctionFilter& filter)
+{{
+    @foreach function where('{funcName}' not in ['vkGetDeviceProcAddr', 'vkGetInstanceProcAddr'])
+    filter.resolve({funcIndex}, "{funcName}", {funcCategories});
+    @end function
+}}
+
+uint32_t api_dump_function_count()
+{{
+    return {functionCount};
+}}
+
+const char* api_dump_function_name(uint32_t function)
+{{
+    switch(function)
+    {{
+    @foreach function where('{funcName}' not in ['vkGetDeviceProcAddr', 'vkGetInstanceProcAddr'])
+    case {funcIndex}: return "{funcName}";
+    @end function
+    }}
+    return NULL;
+}}
+
 """
 
 # This HTML Codegen is essentially copied from the format above.
@@ -985,33 +1069,33 @@ HTML_CODEGEN = """
 #include "api_dump.h"
 
 @foreach struct
-std::ostream& dump_html_{sctName}(const {sctName}& object, const ApiDumpSettings& settings, int indents{sctConditionVars});
+ApiDumpFormatter& dump_html_{sctName}(const {sctName}& object, const ApiDumpSettings& settings, int indents{sctConditionVars});
 @end struct
 @foreach union
-std::ostream& dump_html_{unName}(const {unName}& object, const ApiDumpSettings& settings, int indents);
+ApiDumpFormatter& dump_html_{unName}(const {unName}& object, const ApiDumpSettings& settings, int indents);
 @end union
 
 //============================= typedefs ==============================//
 
 // Functions for dumping typedef types that the codegen scripting can't handle
 #if defined(VK_ENABLE_BETA_EXTENSIONS)
-std::ostream& dump_html_VkAccelerationStructureTypeKHR(VkAccelerationStructureTypeKHR object, const ApiDumpSettings& settings, int indents);
-std::ostream& dump_html_VkAccelerationStructureTypeNV(VkAccelerationStructureTypeNV object, const ApiDumpSettings& settings, int indents)
+ApiDumpFormatter& dump_html_VkAccelerationStructureTypeKHR(VkAccelerationStructureTypeKHR object, const ApiDumpSettings& settings, int indents);
+ApiDumpFormatter& dump_html_VkAccelerationStructureTypeNV(VkAccelerationStructureTypeNV object, const ApiDumpSettings& settings, int indents)
 {{
     return dump_html_VkAccelerationStructureTypeKHR(object, settings, indents);
 }}
-std::ostream& dump_html_VkBuildAccelerationStructureFlagsKHR(VkBuildAccelerationStructureFlagsKHR object, const ApiDumpSettings& settings, int indents);
-inline std::ostream& dump_html_VkBuildAccelerationStructureFlagsNV(VkBuildAccelerationStructureFlagsNV object, const ApiDumpSettings& settings, int indents)
+ApiDumpFormatter& dump_html_VkBuildAccelerationStructureFlagsKHR(VkBuildAccelerationStructureFlagsKHR object, const ApiDumpSettings& settings, int indents);
+inline ApiDumpFormatter& dump_html_VkBuildAccelerationStructureFlagsNV(VkBuildAccelerationStructureFlagsNV object, const ApiDumpSettings& settings, int indents)
 {{
     return dump_html_VkBuildAccelerationStructureFlagsKHR(object, settings, indents);
 }}
-std::ostream& dump_html_VkAccelerationStructureMemoryRequirementsTypeKHR(VkAccelerationStructureMemoryRequirementsTypeKHR object, const ApiDumpSettings& settings, int indents);
-std::ostream& dump_html_VkAccelerationStructureMemoryRequirementsTypeNV(VkAccelerationStructureMemoryRequirementsTypeNV object, const ApiDumpSettings& settings, int indents)
+ApiDumpFormatter& dump_html_VkAccelerationStructureMemoryRequirementsTypeKHR(VkAccelerationStructureMemoryRequirementsTypeKHR object, const ApiDumpSettings& settings, int indents);
+ApiDumpFormatter& dump_html_VkAccelerationStructureMemoryRequirementsTypeNV(VkAccelerationStructureMemoryRequirementsTypeNV object, const ApiDumpSettings& settings, int indents)
 {{
     return dump_html_VkAccelerationStructureMemoryRequirementsTypeKHR(object, settings, indents);
 }}
-std::ostream& dump_html_VkAccelerationStructureKHR(const VkAccelerationStructureKHR object, const ApiDumpSettings& settings, int indents);
-std::ostream& dump_html_VkAccelerationStructureNV(const VkAccelerationStructureNV object, const ApiDumpSettings& settings, int indents)
+ApiDumpFormatter& dump_html_VkAccelerationStructureKHR(const VkAccelerationStructureKHR object, const ApiDumpSettings& settings, int indents);
+ApiDumpFormatter& dump_html_VkAccelerationStructureNV(const VkAccelerationStructureNV object, const ApiDumpSettings& settings, int indents)
 {{
     return dump_html_VkAccelerationStructureKHR(object, settings, indents);
 }}
@@ -1020,7 +1104,7 @@ std::ostream& dump_html_VkAccelerationStructureNV(const VkAccelerationStructureN
 
 //======================== pNext Chain Implementation =======================//
 
-std::ostream& dump_html_pNext_trampoline(const void* object, const ApiDumpSettings& settings, int indents)
+ApiDumpFormatter& dump_html_pNext_trampoline(const void* object, const ApiDumpSettings& settings, int indents)
 {{
     switch((int64_t) (static_cast<const VkBaseInStructure*>(object)->sType)) {{
     @foreach struct where('{sctName}' not in ['VkPipelineViewportStateCreateInfo', 'VkCommandBufferBeginInfo'])
@@ -1049,13 +1133,13 @@ std::ostream& dump_html_pNext_trampoline(const void* object, const ApiDumpSettin
     return settings.stream(); 
 }}
 
-inline std::ostream& dump_html_pNext_trampoline(const void* object, const ApiDumpSettings& settings, int indents, bool is_dynamic_viewport, bool is_dynamic_scissor)
+inline ApiDumpFormatter& dump_html_pNext_trampoline(const void* object, const ApiDumpSettings& settings, int indents, bool is_dynamic_viewport, bool is_dynamic_scissor)
 {{
     dump_html_pNext<const VkPipelineViewportStateCreateInfo>(static_cast<const VkPipelineViewportStateCreateInfo*>(object), settings, "VkPipelineViewportStateCreateInfo", indents, dump_html_VkPipelineViewportStateCreateInfo, is_dynamic_viewport, is_dynamic_scissor);
     return settings.stream(); 
 }}
 
-inline std::ostream& dump_html_pNext_trampoline(const void* object, const ApiDumpSettings& settings, int indents, VkCommandBuffer cmd_buffer)
+inline ApiDumpFormatter& dump_html_pNext_trampoline(const void* object, const ApiDumpSettings& settings, int indents, VkCommandBuffer cmd_buffer)
 {{
     dump_html_pNext<const VkCommandBufferBeginInfo>(static_cast<const VkCommandBufferBeginInfo*>(object), settings, "VkCommandBufferBeginInfo", indents, dump_html_VkCommandBufferBeginInfo, cmd_buffer);
     return settings.stream(); 
@@ -1064,7 +1148,7 @@ inline std::ostream& dump_html_pNext_trampoline(const void* object, const ApiDum
 //=========================== Type Implementations ==========================//
 
 @foreach type where('{etyName}' != 'void')
-inline std::ostream& dump_html_{etyName}({etyName} object, const ApiDumpSettings& settings, int indents)
+inline ApiDumpFormatter& dump_html_{etyName}({etyName} object, const ApiDumpSettings& settings, int indents)
 {{
     settings.stream() << "<div class='val'>";
     @if('{etyName}' != 'uint8_t')
@@ -1080,14 +1164,14 @@ inline std::ostream& dump_html_{etyName}({etyName} object, const ApiDumpSettings
 //========================= Basetype Implementations ========================//
 
 @foreach basetype where(not '{baseName}' in ['ANativeWindow', 'AHardwareBuffer', 'CAMetalLayer'])
-inline std::ostream& dump_html_{baseName}({baseName} object, const ApiDumpSettings& settings, int indents)
+inline ApiDumpFormatter& dump_html_{baseName}({baseName} object, const ApiDumpSettings& settings, int indents)
 {{
     return settings.stream() << "<div class='val'>" << object << "</div></summary>";
 }}
 @end basetype
 @foreach basetype where('{baseName}' in ['ANativeWindow', 'AHardwareBuffer'])
 #if defined(VK_USE_PLATFORM_ANDROID_KHR)
-inline std::ostream& dump_html_{baseName}(const {baseName}* object, const ApiDumpSettings& settings, int indents)
+inline ApiDumpFormatter& dump_html_{baseName}(const {baseName}* object, const ApiDumpSettings& settings, int indents)
 {{
     return settings.stream() << "<div class='val'>" << object << "</div></summary>";
 }}
@@ -1095,7 +1179,7 @@ inline std::ostream& dump_html_{baseName}(const {baseName}* object, const ApiDum
 @end basetype
 @foreach basetype where('{baseName}' in ['CAMetalLayer'])
 #if defined(VK_USE_PLATFORM_METAL_EXT)
-inline std::ostream& dump_html_{baseName}({baseName} object, const ApiDumpSettings& settings, int indents)
+inline ApiDumpFormatter& dump_html_{baseName}({baseName} object, const ApiDumpSettings& settings, int indents)
 {{
     return settings.stream() << "<div class='val'>" << object << "</div></summary>";
 }}
@@ -1105,7 +1189,7 @@ inline std::ostream& dump_html_{baseName}({baseName} object, const ApiDumpSettin
 //======================= System Type Implementations =======================//
 
 @foreach systype
-inline std::ostream& dump_html_{sysName}(const {sysType} object, const ApiDumpSettings& settings, int indents)
+inline ApiDumpFormatter& dump_html_{sysName}(const {sysType} object, const ApiDumpSettings& settings, int indents)
 {{
     return settings.stream() << "<div class='val'>" << object << "</div></summary>";
 }}
@@ -1114,15 +1198,15 @@ inline std::ostream& dump_html_{sysName}(const {sysType} object, const ApiDumpSe
 //========================== Handle Implementations =========================//
 
 @foreach handle
-inline std::ostream& dump_html_{hdlName}(const {hdlName} object, const ApiDumpSettings& settings, int indents)
+inline ApiDumpFormatter& dump_html_{hdlName}(const {hdlName} object, const ApiDumpSettings& settings, int indents)
 {{
     settings.stream() << "<div class='val'>";
     if(settings.showAddress()) {{
         settings.stream() << object;
 
-        std::unordered_map<uint64_t, std::string>::const_iterator it = ApiDumpInstance::current().object_name_map.find((uint64_t) object);
-        if (it != ApiDumpInstance::current().object_name_map.end()) {{
-            settings.stream() << "</div><div class='val'>[" << it->second << "]";
+        const char* object_name = ApiDumpInstance::current().getObjectName((uint64_t) object);
+        if (object_name != NULL) {{
+            settings.stream() << "</div><div class='val'>[" << object_name << "]";
         }}
     }} else {{
         settings.stream() << "address";
@@ -1134,7 +1218,7 @@ inline std::ostream& dump_html_{hdlName}(const {hdlName} object, const ApiDumpSe
 //=========================== Enum Implementations ==========================//
 
 @foreach enum
-std::ostream& dump_html_{enumName}({enumName} object, const ApiDumpSettings& settings, int indents)
+ApiDumpFormatter& dump_html_{enumName}({enumName} object, const ApiDumpSettings& settings, int indents)
 {{
     settings.stream() << "<div class='val'>";
     switch((int64_t) object)
@@ -1154,7 +1238,7 @@ std::ostream& dump_html_{enumName}({enumName} object, const ApiDumpSettings& set
 //========================= Bitmask Implementations =========================//
 
 @foreach bitmask
-std::ostream& dump_html_{bitName}({bitName} object, const ApiDumpSettings& settings, int indents)
+ApiDumpFormatter& dump_html_{bitName}({bitName} object, const ApiDumpSettings& settings, int indents)
 {{
     settings.stream() << "<div class=\'val\'>";
     bool is_first = true;
@@ -1178,13 +1262,13 @@ std::ostream& dump_html_{bitName}({bitName} object, const ApiDumpSettings& setti
 //=========================== Flag Implementations ==========================//
 
 @foreach flag where('{flagEnum}' != 'None')
-inline std::ostream& dump_html_{flagName}({flagName} object, const ApiDumpSettings& settings, int indents)
+inline ApiDumpFormatter& dump_html_{flagName}({flagName} object, const ApiDumpSettings& settings, int indents)
 {{
     return dump_html_{flagEnum}(({flagEnum}) object, settings, indents);
 }}
 @end flag
 @foreach flag where('{flagEnum}' == 'None')
-inline std::ostream& dump_html_{flagName}({flagName} object, const ApiDumpSettings& settings, int indents)
+inline ApiDumpFormatter& dump_html_{flagName}({flagName} object, const ApiDumpSettings& settings, int indents)
 {{
     return settings.stream() << "<div class=\'val\'>"
                              << object << "</div></summary>";
@@ -1194,7 +1278,7 @@ inline std::ostream& dump_html_{flagName}({flagName} object, const ApiDumpSettin
 //======================= Func Pointer Implementations ======================//
 
 @foreach funcpointer
-inline std::ostream& dump_html_{pfnName}({pfnName} object, const ApiDumpSettings& settings, int indents)
+inline ApiDumpFormatter& dump_html_{pfnName}({pfnName} object, const ApiDumpSettings& settings, int indents)
 {{
     settings.stream() << "<div class=\'val\'>";
     if(settings.showAddress())
@@ -1208,7 +1292,7 @@ inline std::ostream& dump_html_{pfnName}({pfnName} object, const ApiDumpSettings
 //========================== Struct Implementations =========================//
 
 @foreach struct where('{sctName}' not in ['VkPhysicalDeviceMemoryProperties' ,'VkPhysicalDeviceGroupProperties'])
-std::ostream& dump_html_{sctName}(const {sctName}& object, const ApiDumpSettings& settings, int indents{sctConditionVars})
+ApiDumpFormatter& dump_html_{sctName}(const {sctName}& object, const ApiDumpSettings& settings, int indents{sctConditionVars})
 {{
     settings.stream() << "<div class=\'val\'>";
     if(settings.showAddress())
@@ -1245,12 +1329,14 @@ std::ostream& dump_html_{sctName}(const {sctName}& object, const ApiDumpSettings
     dump_html_array<const {memBaseType}>(object.{memName}, {memLength}, settings, "{memType}", "{memChildType}", "{memName}", indents + 1, dump_html_{memTypeID}{memInheritedConditions}); // ZRS
     @end if
     @if(not ('{memLength}'[0].isdigit() or '{memLength}'[0].isupper()))
-    dump_html_array<const {memBaseType}>(object.{memName}, object.{memLength}, settings, "{memType}", "{memChildType}", "{memName}", indents + 1, dump_html_{memTypeID}{memInheritedConditions}); // ZRT
+    dump_html_array<const {memBaseType}>(object.{memName}, {memObjectLength}, settings, "{memType}", "{memChildType}", "{memName}", indents + 1, dump_html_{memTypeID}{memInheritedConditions}); // ZRT
     @end if
     @end if
     @if('{sctName}' == 'VkShaderModuleCreateInfo')
     @if('{memName}' == 'pCode')
-    if(settings.showShader())
+    if(settings.writeShaderFiles())
+        dump_html_shader(object.{memName}, object.codeSize, settings, "{memType}", "{memName}", indents + 1);
+    else if(settings.showShader())
         dump_html_array<const {memBaseType}>(object.{memName}, object.{memLength}, settings, "{memType}", "{memChildType}", "{memName}", indents + 1, dump_html_{memTypeID}{memInheritedConditions}); // ZRU
     else
         dump_html_special("SHADER DATA", settings, "{memType}", "{memName}", indents + 1);
@@ -1266,7 +1352,7 @@ std::ostream& dump_html_{sctName}(const {sctName}& object, const ApiDumpSettings
 }}
 @end struct
 
-std::ostream& dump_html_VkPhysicalDeviceMemoryProperties(const VkPhysicalDeviceMemoryProperties& object, const ApiDumpSettings& settings, int indents)
+ApiDumpFormatter& dump_html_VkPhysicalDeviceMemoryProperties(const VkPhysicalDeviceMemoryProperties& object, const ApiDumpSettings& settings, int indents)
 {{
     settings.stream() << "<div class='val'>";
     if(settings.showAddress())
@@ -1281,7 +1367,7 @@ std::ostream& dump_html_VkPhysicalDeviceMemoryProperties(const VkPhysicalDeviceM
     return settings.stream();
 }}
 
-std::ostream& dump_html_VkPhysicalDeviceGroupProperties(const VkPhysicalDeviceGroupProperties& object, const ApiDumpSettings& settings, int indents)
+ApiDumpFormatter& dump_html_VkPhysicalDeviceGroupProperties(const VkPhysicalDeviceGroupProperties& object, const ApiDumpSettings& settings, int indents)
 {{
     settings.stream() << "<div class='val'>";
     if(settings.showAddress())
@@ -1300,7 +1386,7 @@ std::ostream& dump_html_VkPhysicalDeviceGroupProperties(const VkPhysicalDeviceGr
 //========================== Union Implementations ==========================//
 
 @foreach union
-std::ostream& dump_html_{unName}(const {unName}& object, const ApiDumpSettings& settings, int indents)
+ApiDumpFormatter& dump_html_{unName}(const {unName}& object, const ApiDumpSettings& settings, int indents)
 {{
     settings.stream() << "<div class='val'>";
     if(settings.showAddress())
@@ -1327,27 +1413,31 @@ std::ostream& dump_html_{unName}(const {unName}& object, const ApiDumpSettings&
 //========================= Function Implementations ========================//
 
 @foreach function where('{funcName}' not in ['vkGetDeviceProcAddr', 'vkGetInstanceProcAddr'])
-std::ostream& dump_html_head_{funcName}(ApiDumpInstance& dump_inst, {funcTypedParams})
+ApiDumpFormatter& dump_html_head_{funcName}(ApiDumpInstance& dump_inst, {funcTypedParams})
 {{
     const ApiDumpSettings& settings(dump_inst.settings());
     if (settings.showThreadAndFrame()){{
-        settings.stream() << "<div class='thd'>Thread: " << dump_inst.threadID() << "</div>";
+        settings.stream() << "<div class='thd'>Thread: " << dump_inst.threadID();
+        if (settings.showOSThreadID()) {{
+            settings.stream() << " (TID " << dump_inst.osThreadID() << ")";
+        }}
+        settings.stream() << "</div>";
     }}
     if(settings.showTimestamp())
         settings.stream() << "<div class='time'>Time: " << dump_inst.current_time_since_start().count() << " us</div>";
     settings.stream() << "<details class='fn'><summary>";
     dump_html_nametype(settings.stream(), settings.showType(), "{funcName}({funcNamedParams})", "{funcReturn}");
 
-    return settings.shouldFlush() ? settings.stream() << std::flush : settings.stream();
+    return settings.stream();
 }}
 @end function
 
 @foreach function where('{funcName}' not in ['vkGetDeviceProcAddr', 'vkGetInstanceProcAddr'])
 @if('{funcReturn}' != 'void')
-std::ostream& dump_html_body_{funcName}(ApiDumpInstance& dump_inst, {funcReturn} result, {funcTypedParams})
+ApiDumpFormatter& dump_html_body_{funcName}(ApiDumpInstance& dump_inst, {funcReturn} result, {funcTypedParams})
 @end if 
 @if('{funcReturn}' == 'void')
-std::ostream& dump_html_body_{funcName}(ApiDumpInstance& dump_inst, {funcTypedParams})
+ApiDumpFormatter& dump_html_body_{funcName}(ApiDumpInstance& dump_inst, {funcTypedParams})
 @end if
 {{ 
     const ApiDumpSettings& settings(dump_inst.settings());
@@ -1355,6 +1445,8 @@ std::ostream& dump_html_body_{funcName}(ApiDumpInstance& dump_inst, {funcTypedPa
     @if('{funcReturn}' != 'void')
     dump_html_{funcReturn}(result, settings, 0);
     @end if
+    if(settings.showDuration())
+        settings.stream() << "<div class='time'>Duration: " << dump_inst.callDuration() << " ns</div>";
     settings.stream() << "</summary>";
 
     if(settings.showParams())
@@ -1371,7 +1463,7 @@ std::ostream& dump_html_body_{funcName}(ApiDumpInstance& dump_inst, {funcTypedPa
         @end if
         @end parameter
     }}
-    settings.shouldFlush() ? settings.stream() << std::endl : settings.stream() << "\\n";
+    settings.stream() << "\\n";
 
     return settings.stream() << "</details>";
 }}
@@ -1413,33 +1505,33 @@ JSON_CODEGEN = """
 #include "api_dump.h"
 
 @foreach struct
-std::ostream& dump_json_{sctName}(const {sctName}& object, const ApiDumpSettings& settings, int indents{sctConditionVars});
+ApiDumpFormatter& dump_json_{sctName}(const {sctName}& object, const ApiDumpSettings& settings, int indents{sctConditionVars});
 @end struct
 @foreach union
-std::ostream& dump_json_{unName}(const {unName}& object, const ApiDumpSettings& settings, int indents);
+ApiDumpFormatter& dump_json_{unName}(const {unName}& object, const ApiDumpSettings& settings, int indents);
 @end union
 
 //============================= typedefs ==============================//
 
 // Functions for dumping typedef types that the codegen scripting can't handle
 #if defined(VK_ENABLE_BETA_EXTENSIONS)
-std::ostream& dump_json_VkAccelerationStructureTypeKHR(VkAccelerationStructureTypeKHR object, const ApiDumpSettings& settings, int indents);
-std::ostream& dump_json_VkAccelerationStructureTypeNV(VkAccelerationStructureTypeNV object, const ApiDumpSettings& settings, int indents)
+ApiDumpFormatter& dump_json_VkAccelerationStructureTypeKHR(VkAccelerationStructureTypeKHR object, const ApiDumpSettings& settings, int indents);
+ApiDumpFormatter& dump_json_VkAccelerationStructureTypeNV(VkAccelerationStructureTypeNV object, const ApiDumpSettings& settings, int indents)
 {{
     return dump_json_VkAccelerationStructureTypeKHR(object, settings, indents);
 }}
-std::ostream& dump_json_VkBuildAccelerationStructureFlagsKHR(VkBuildAccelerationStructureFlagsKHR object, const ApiDumpSettings& settings, int indents);
-inline std::ostream& dump_json_VkBuildAccelerationStructureFlagsNV(VkBuildAccelerationStructureFlagsNV object, const ApiDumpSettings& settings, int indents)
+ApiDumpFormatter& dump_json_VkBuildAccelerationStructureFlagsKHR(VkBuildAccelerationStructureFlagsKHR object, const ApiDumpSettings& settings, int indents);
+inline ApiDumpFormatter& dump_json_VkBuildAccelerationStructureFlagsNV(VkBuildAccelerationStructureFlagsNV object, const ApiDumpSettings& settings, int indents)
 {{
     return dump_json_VkBuildAccelerationStructureFlagsKHR(object, settings, indents);
 }}
-std::ostream& dump_json_VkAccelerationStructureMemoryRequirementsTypeKHR(VkAccelerationStructureMemoryRequirementsTypeKHR object, const ApiDumpSettings& settings, int indents);
-std::ostream& dump_json_VkAccelerationStructureMemoryRequirementsTypeNV(VkAccelerationStructureMemoryRequirementsTypeNV object, const ApiDumpSettings& settings, int indents)
+ApiDumpFormatter& dump_json_VkAccelerationStructureMemoryRequirementsTypeKHR(VkAccelerationStructureMemoryRequirementsTypeKHR object, const ApiDumpSettings& settings, int indents);
+ApiDumpFormatter& dump_json_VkAccelerationStructureMemoryRequirementsTypeNV(VkAccelerationStructureMemoryRequirementsTypeNV object, const ApiDumpSettings& settings, int indents)
 {{
     return dump_json_VkAccelerationStructureMemoryRequirementsTypeKHR(object, settings, indents);
 }}
-std::ostream& dump_json_VkAccelerationStructureKHR(const VkAccelerationStructureKHR object, const ApiDumpSettings& settings, int indents);
-std::ostream& dump_json_VkAccelerationStructureNV(const VkAccelerationStructureNV object, const ApiDumpSettings& settings, int indents)
+ApiDumpFormatter& dump_json_VkAccelerationStructureKHR(const VkAccelerationStructureKHR object, const ApiDumpSettings& settings, int indents);
+ApiDumpFormatter& dump_json_VkAccelerationStructureNV(const VkAccelerationStructureNV object, const ApiDumpSettings& settings, int indents)
 {{
     return dump_json_VkAccelerationStructureKHR(object, settings, indents);
 }}
@@ -1448,7 +1540,7 @@ std::ostream& dump_json_VkAccelerationStructureNV(const VkAccelerationStructureN
 
 //======================== pNext Chain Implementation =======================//
 
-std::ostream& dump_json_pNext_trampoline(const void* object, const ApiDumpSettings& settings, int indents)
+ApiDumpFormatter& dump_json_pNext_trampoline(const void* object, const ApiDumpSettings& settings, int indents)
 {{
     switch((int64_t) (static_cast<const VkBaseInStructure*>(object)->sType)) {{
     @foreach struct where('{sctName}' not in ['VkPipelineViewportStateCreateInfo', 'VkCommandBufferBeginInfo'])
@@ -1481,13 +1573,13 @@ std::ostream& dump_json_pNext_trampoline(const void* object, const ApiDumpSettin
     return settings.stream(); 
 }}
 
-inline std::ostream& dump_json_pNext_trampoline(const void* object, const ApiDumpSettings& settings, int indents, bool is_dynamic_viewport, bool is_dynamic_scissor)
+inline ApiDumpFormatter& dump_json_pNext_trampoline(const void* object, const ApiDumpSettings& settings, int indents, bool is_dynamic_viewport, bool is_dynamic_scissor)
 {{
     dump_json_pNext<const VkPipelineViewportStateCreateInfo>(static_cast<const VkPipelineViewportStateCreateInfo*>(object), settings, "VkPipelineViewportStateCreateInfo", indents, dump_json_VkPipelineViewportStateCreateInfo, is_dynamic_viewport, is_dynamic_scissor);
     return settings.stream(); 
 }}
 
-inline std::ostream& dump_json_pNext_trampoline(const void* object, const ApiDumpSettings& settings, int indents, VkCommandBuffer cmd_buffer)
+inline ApiDumpFormatter& dump_json_pNext_trampoline(const void* object, const ApiDumpSettings& settings, int indents, VkCommandBuffer cmd_buffer)
 {{
     dump_json_pNext<const VkCommandBufferBeginInfo>(static_cast<const VkCommandBufferBeginInfo*>(object), settings, "VkCommandBufferBeginInfo", indents, dump_json_VkCommandBufferBeginInfo, cmd_buffer);
     return settings.stream(); 
@@ -1496,7 +1588,7 @@ inline std::ostream& dump_json_pNext_trampoline(const void* object, const ApiDum
 //=========================== Type Implementations ==========================//
 
 @foreach type where('{etyName}' != 'void')
-inline std::ostream& dump_json_{etyName}({etyName} object, const ApiDumpSettings& settings, int indents)
+inline ApiDumpFormatter& dump_json_{etyName}({etyName} object, const ApiDumpSettings& settings, int indents)
 {{
 
     //settings.stream() << settings.indentation(indents);
@@ -1512,14 +1604,14 @@ inline std::ostream& dump_json_{etyName}({etyName} object, const ApiDumpSettings
 //========================= Basetype Implementations ========================//
 
 @foreach basetype where(not '{baseName}' in ['ANativeWindow', 'AHardwareBuffer', 'CAMetalLayer'])
-inline std::ostream& dump_json_{baseName}({baseName} object, const ApiDumpSettings& settings, int indents)
+inline ApiDumpFormatter& dump_json_{baseName}({baseName} object, const ApiDumpSettings& settings, int indents)
 {{
     return settings.stream() << "\\"" << object << "\\"";
 }}
 @end basetype
 @foreach basetype where('{baseName}' in ['ANativeWindow', 'AHardwareBuffer'])
 #if defined(VK_USE_PLATFORM_ANDROID_KHR)
-inline std::ostream& dump_json_{baseName}(const {baseName}* object, const ApiDumpSettings& settings, int indents)
+inline ApiDumpFormatter& dump_json_{baseName}(const {baseName}* object, const ApiDumpSettings& settings, int indents)
 {{
     return settings.stream() << "\\"" << object << "\\"";
 }}
@@ -1527,7 +1619,7 @@ inline std::ostream& dump_json_{baseName}(const {baseName}* object, const ApiDum
 @end basetype
 @foreach basetype where('{baseName}' in ['CAMetalLayer'])
 #if defined(VK_USE_PLATFORM_METAL_EXT)
-inline std::ostream& dump_json_{baseName}({baseName} object, const ApiDumpSettings& settings, int indents)
+inline ApiDumpFormatter& dump_json_{baseName}({baseName} object, const ApiDumpSettings& settings, int indents)
 {{
     return settings.stream() << "\\"" << object << "\\"";
 }}
@@ -1537,7 +1629,7 @@ inline std::ostream& dump_json_{baseName}({baseName} object, const ApiDumpSettin
 //======================= System Type Implementations =======================//
 
 @foreach systype
-inline std::ostream& dump_json_{sysName}(const {sysType} object, const ApiDumpSettings& settings, int indents)
+inline ApiDumpFormatter& dump_json_{sysName}(const {sysType} object, const ApiDumpSettings& settings, int indents)
 {{
     return settings.stream() << "\\"" << object << "\\"";
 }}
@@ -1546,7 +1638,7 @@ inline std::ostream& dump_json_{sysName}(const {sysType} object, const ApiDumpSe
 //========================== Handle Implementations =========================//
 
 @foreach handle
-inline std::ostream& dump_json_{hdlName}(const {hdlName} object, const ApiDumpSettings& settings, int indents)
+inline ApiDumpFormatter& dump_json_{hdlName}(const {hdlName} object, const ApiDumpSettings& settings, int indents)
 {{
     if(settings.showAddress()) {{
         return settings.stream() << "\\"" << object << "\\"";
@@ -1560,7 +1652,7 @@ inline std::ostream& dump_json_{hdlName}(const {hdlName} object, const ApiDumpSe
 //=========================== Enum Implementations ==========================//
 
 @foreach enum
-std::ostream& dump_json_{enumName}({enumName} object, const ApiDumpSettings& settings, int indents)
+ApiDumpFormatter& dump_json_{enumName}({enumName} object, const ApiDumpSettings& settings, int indents)
 {{
     switch((int64_t) object)
     {{
@@ -1579,7 +1671,7 @@ std::ostream& dump_json_{enumName}({enumName} object, const ApiDumpSettings& set
 //========================= Bitmask Implementations =========================//
 
 @foreach bitmask
-std::ostream& dump_json_{bitName}({bitName} object, const ApiDumpSettings& settings, int indents)
+ApiDumpFormatter& dump_json_{bitName}({bitName} object, const ApiDumpSettings& settings, int indents)
 {{
     bool is_first = true;
     settings.stream() << '"' << object;
@@ -1604,13 +1696,13 @@ std::ostream& dump_json_{bitName}({bitName} object, const ApiDumpSettings& setti
 //=========================== Flag Implementations ==========================//
 
 @foreach flag where('{flagEnum}' != 'None')
-inline std::ostream& dump_json_{flagName}({flagName} object, const ApiDumpSettings& settings, int indents)
+inline ApiDumpFormatter& dump_json_{flagName}({flagName} object, const ApiDumpSettings& settings, int indents)
 {{
     return dump_json_{flagEnum}(({flagEnum}) object, settings, indents);
 }}
 @end flag
 @foreach flag where('{flagEnum}' == 'None')
-inline std::ostream& dump_json_{flagName}({flagName} object, const ApiDumpSettings& settings, int indents)
+inline ApiDumpFormatter& dump_json_{flagName}({flagName} object, const ApiDumpSettings& settings, int indents)
 {{
     return settings.stream() << '"' << object << "\\"";
 }}
@@ -1619,7 +1711,7 @@ inline std::ostream& dump_json_{flagName}({flagName} object, const ApiDumpSettin
 //======================= Func Pointer Implementations ======================//
 
 @foreach funcpointer
-inline std::ostream& dump_json_{pfnName}({pfnName} object, const ApiDumpSettings& settings, int indents)
+inline ApiDumpFormatter& dump_json_{pfnName}({pfnName} object, const ApiDumpSettings& settings, int indents)
 {{
     if(settings.showAddress())
        settings.stream() << "\\"" << object << "\\"";
@@ -1632,7 +1724,7 @@ inline std::ostream& dump_json_{pfnName}({pfnName} object, const ApiDumpSettings
 //========================== Struct Implementations =========================//
 
 @foreach struct where('{sctName}' not in ['VkPhysicalDeviceMemoryProperties' ,'VkPhysicalDeviceGroupProperties'])
-std::ostream& dump_json_{sctName}(const {sctName}& object, const ApiDumpSettings& settings, int indents{sctConditionVars})
+ApiDumpFormatter& dump_json_{sctName}(const {sctName}& object, const ApiDumpSettings& settings, int indents{sctConditionVars})
 {{
     settings.stream() << settings.indentation(indents) << "[\\n";
 
@@ -1666,12 +1758,14 @@ std::ostream& dump_json_{sctName}(const {sctName}& object, const ApiDumpSettings
     dump_json_array<const {memBaseType}>(object.{memName}, {memLength}, settings, "{memType}", "{memChildType}", "{memName}", indents + 1, dump_json_{memTypeID}{memInheritedConditions}); // JQA
     @end if
     @if(not ('{memLength}'[0].isdigit() or '{memLength}'[0].isupper()))
-    dump_json_array<const {memBaseType}>(object.{memName}, object.{memLength}, settings, "{memType}", "{memChildType}", "{memName}", indents + 1, dump_json_{memTypeID}{memInheritedConditions}); // JQA
+    dump_json_array<const {memBaseType}>(object.{memName}, {memObjectLength}, settings, "{memType}", "{memChildType}", "{memName}", indents + 1, dump_json_{memTypeID}{memInheritedConditions}); // JQA
     @end if
     @end if
     @if('{sctName}' == 'VkShaderModuleCreateInfo')
     @if('{memName}' == 'pCode')
-    if(settings.showShader())
+    if(settings.writeShaderFiles())
+        dump_json_shader(object.{memName}, object.codeSize, settings, "{memType}", "{memName}", indents + 1);
+    else if(settings.showShader())
         dump_json_array<const {memBaseType}>(object.{memName}, object.{memLength}, settings, "{memType}", "{memChildType}", "{memName}", indents + 1, dump_json_{memTypeID}{memInheritedConditions}); // KQA
     else
         dump_json_special("SHADER DATA", settings, "{memType}", "{memName}", indents + 1);
@@ -1708,7 +1802,7 @@ bool is_struct(const char *t)
     return false;
 }}
 
-std::ostream& dump_json_VkPhysicalDeviceMemoryProperties(const VkPhysicalDeviceMemoryProperties& object, const ApiDumpSettings& settings, int indents)
+ApiDumpFormatter& dump_json_VkPhysicalDeviceMemoryProperties(const VkPhysicalDeviceMemoryProperties& object, const ApiDumpSettings& settings, int indents)
 {{
     settings.stream() << settings.indentation(indents) << "[\\n";
 
@@ -1723,7 +1817,7 @@ std::ostream& dump_json_VkPhysicalDeviceMemoryProperties(const VkPhysicalDeviceM
     return settings.stream();
 }}
 
-std::ostream& dump_json_VkPhysicalDeviceGroupProperties(const VkPhysicalDeviceGroupProperties& object, const ApiDumpSettings& settings, int indents)
+ApiDumpFormatter& dump_json_VkPhysicalDeviceGroupProperties(const VkPhysicalDeviceGroupProperties& object, const ApiDumpSettings& settings, int indents)
 {{
     settings.stream() << settings.indentation(indents) << "[\\n";
 
@@ -1742,7 +1836,7 @@ std::ostream& dump_json_VkPhysicalDeviceGroupProperties(const VkPhysicalDeviceGr
 
 //========================== Union Implementations ==========================//
 @foreach union
-std::ostream& dump_json_{unName}(const {unName}& object, const ApiDumpSettings& settings, int indents)
+ApiDumpFormatter& dump_json_{unName}(const {unName}& object, const ApiDumpSettings& settings, int indents)
 {{
     settings.stream() << settings.indentation(indents) << "[\\n";
 
@@ -1781,18 +1875,11 @@ bool is_union(const char *t)
 
 //========================= Function Implementations ========================//
 
-static bool needFuncComma = false;
-
 @foreach function where(not '{funcName}' in ['vkGetDeviceProcAddr', 'vkGetInstanceProcAddr'])
-std::ostream& dump_json_head_{funcName}(ApiDumpInstance& dump_inst, {funcTypedParams})
+ApiDumpFormatter& dump_json_head_{funcName}(ApiDumpInstance& dump_inst, {funcTypedParams})
 {{
     const ApiDumpSettings& settings(dump_inst.settings());
 
-    if(dump_inst.firstFunctionCallOnFrame())
-        needFuncComma = false;
-
-    if (needFuncComma) settings.stream() << ",\\n";
-
     // Display apicall name
     settings.stream() << settings.indentation(2) << "{{\\n";
     settings.stream() << settings.indentation(3) << "\\\"name\\\" : \\\"{funcName}\\\",\\n";
@@ -1800,6 +1887,9 @@ std::ostream& dump_json_head_{funcName}(ApiDumpInstance& dump_inst, {funcTypedPa
     // Display thread info
     if (settings.showThreadAndFrame()){{
         settings.stream() << settings.indentation(3) << "\\\"thread\\\" : \\\"Thread " << dump_inst.threadID() << "\\\",\\n";
+        if (settings.showOSThreadID()) {{
+            settings.stream() << settings.indentation(3) << "\\\"tid\\\" : \\\"" << dump_inst.osThreadID() << "\\\",\\n";
+        }}
     }}
 
     // Display elapsed time
@@ -1810,20 +1900,25 @@ std::ostream& dump_json_head_{funcName}(ApiDumpInstance& dump_inst, {funcTypedPa
     // Display return value
     settings.stream() << settings.indentation(3) << "\\\"returnType\\\" : " << "\\\"{funcReturn}\\\",\\n";
 
-    return settings.shouldFlush() ? settings.stream() << std::flush : settings.stream();
+    return settings.stream();
 }}
 @end function
 
 @foreach function where(not '{funcName}' in ['vkGetDeviceProcAddr', 'vkGetInstanceProcAddr'])
 @if('{funcReturn}' != 'void')
-std::ostream& dump_json_body_{funcName}(ApiDumpInstance& dump_inst, {funcReturn} result, {funcTypedParams})
+ApiDumpFormatter& dump_json_body_{funcName}(ApiDumpInstance& dump_inst, {funcReturn} result, {funcTypedParams})
 @end if
 @if('{funcReturn}' == 'void')
-std::ostream& dump_json_body_{funcName}(ApiDumpInstance& dump_inst, {funcTypedParams})
+ApiDumpFormatter& dump_json_body_{funcName}(ApiDumpInstance& dump_inst, {funcTypedParams})
 @end if
 {{
     const ApiDumpSettings& settings(dump_inst.settings());
 
+    // Display how long the driver took
+    if(settings.showDuration()) {{
+        settings.stream() << settings.indentation(3) << "\\\"duration\\\" : \\\""<< dump_inst.callDuration() << " ns\\\",\\n";
+    }}
+
     @if('{funcReturn}' != 'void')
     settings.stream() << settings.indentation(3) << "\\\"returnValue\\\" : ";
     dump_json_{funcReturn}(result, settings, 0);
@@ -1857,13 +1952,518 @@ std::ostream& dump_json_body_{funcName}(ApiDumpInstance& dump_inst, {funcTypedPa
         settings.stream() << "\\n" << settings.indentation(3) << "]\\n";
     }}
     settings.stream() << settings.indentation(2) << "}}";
-    needFuncComma = true;
-    if (settings.shouldFlush()) settings.stream().flush();
     return settings.stream();
 }}
 @end function
 """
 
+TRACE_CODEGEN = """
+/* Copyright (c) 2015-2019, 2019 Valve Corporation
+ * Copyright (c) 2015-2019, 2019 LunarG, Inc.
+ * Copyright (c) 2015-2017, 2019 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Author: Lenny Komow <lenny@lunarg.com>
+ * Author: Shannon McPherson <shannon@lunarg.com>
+ * Author: Charles Giessen <charles@lunarg.com>
+ */
+
+/*
+ * This file is generated from the Khronos Vulkan XML API Registry.
+ */
+
+#pragma once
+
+#include "api_dump_json.h"
+
+// Each api call is written as a complete event in the Chrome trace event format, which chrome://tracing
+// and Perfetto load. Its arguments are summarized as values and addresses, unless the full structures
+// are asked for, which are written the way the JSON format writes them.
+
+//========================= Function Implementations ========================//
+
+@foreach function where(not '{funcName}' in ['vkGetDeviceProcAddr', 'vkGetInstanceProcAddr'])
+ApiDumpFormatter& dump_trace_head_{funcName}(ApiDumpInstance& dump_inst, {funcTypedParams})
+{{
+    const ApiDumpSettings& settings(dump_inst.settings());
+
+    @if('{funcName}' in ['vkQueueSubmit', 'vkQueueSubmit2', 'vkQueueSubmit2KHR', 'vkQueuePresentKHR'])
+    // Mark the submission on the thread's track
+    dump_trace_event_head(dump_inst, "{funcName}", "i");
+    settings.stream() << ", \\"s\\" : \\"t\\"}}";
+    @end if
+    dump_trace_event_head(dump_inst, "{funcName}", "X");
+
+    return settings.stream();
+}}
+@end function
+
+@foreach function where(not '{funcName}' in ['vkGetDeviceProcAddr', 'vkGetInstanceProcAddr'])
+@if('{funcReturn}' != 'void')
+ApiDumpFormatter& dump_trace_body_{funcName}(ApiDumpInstance& dump_inst, {funcReturn} result, {funcTypedParams})
+@end if
+@if('{funcReturn}' == 'void')
+ApiDumpFormatter& dump_trace_body_{funcName}(ApiDumpInstance& dump_inst, {funcTypedParams})
+@end if
+{{
+    const ApiDumpSettings& settings(dump_inst.settings());
+
+    settings.stream() << ", \\"dur\\" : ";
+    dump_trace_duration(settings, dump_inst.callDuration());
+    settings.stream() << ", \\"args\\" : {{";
+
+    bool needArgumentComma = false;
+    @if('{funcReturn}' != 'void')
+    settings.stream() << "\\"result\\" : ";
+    dump_json_{funcReturn}(result, settings, 0);
+    needArgumentComma = true;
+    @end if
+
+    // Display parameter values
+    if(settings.showParams() && settings.traceFullArgs())
+    {{
+        bool needParameterComma = false;
+
+        if (needArgumentComma) settings.stream() << ", ";
+        settings.stream() << "\\"params\\" :\\n";
+        settings.stream() << settings.indentation(1) << "[\\n";
+
+        @foreach parameter
+        if (needParameterComma) settings.stream() << ",\\n";
+        @if({prmPtrLevel} == 0)
+        dump_json_value<const {prmBaseType}>({prmName}, NULL, settings, "{prmType}", "{prmName}", 2, dump_json_{prmTypeID}{prmInheritedConditions});
+        @end if
+        @if({prmPtrLevel} == 1 and '{prmLength}' == 'None')
+        dump_json_pointer<const {prmBaseType}>({prmName}, settings, "{prmType}", "{prmName}", 2, dump_json_{prmTypeID}{prmInheritedConditions});
+        @end if
+        @if({prmPtrLevel} == 1 and '{prmLength}' != 'None')
+        dump_json_array<const {prmBaseType}>({prmName}, {prmLength}, settings, "{prmType}", "{prmChildType}", "{prmName}", 2, dump_json_{prmTypeID}{prmInheritedConditions}); // PQA
+        @end if
+        needParameterComma = true;
+        @end parameter
+
+        settings.stream() << "\\n" << settings.indentation(1) << "]";
+    }}
+    else if(settings.showParams())
+    {{
+        @foreach parameter
+        if (needArgumentComma) settings.stream() << ", ";
+        settings.stream() << "\\"{prmName}\\" : ";
+        @if({prmPtrLevel} != 0 or ('{prmBaseType}'.endswith('*') and '{prmTypeID}' != 'cstring'))
+        OutputAddress(settings, {prmName}, true);
+        @end if
+        @if({prmPtrLevel} == 0 and '{prmBinaryKind}' == 'struct')
+        settings.stream() << "\\"{prmType}\\"";
+        @end if
+        @if({prmPtrLevel} == 0 and not '{prmBaseType}'.endswith('*') and '{prmBinaryKind}' != 'struct')
+        dump_json_{prmTypeID}({prmName}, settings, 0{prmInheritedConditions});
+        @end if
+        @if({prmPtrLevel} == 0 and '{prmTypeID}' == 'cstring')
+        dump_json_cstring({prmName}, settings, 0);
+        @end if
+        needArgumentComma = true;
+        @end parameter
+    }}
+    settings.stream() << "}}}}";
+    return settings.stream();
+}}
+@end function
+"""
+
+BINARY_CODEGEN = """
+/* Copyright (c) 2015-2019, 2019 Valve Corporation
+ * Copyright (c) 2015-2019, 2019 LunarG, Inc.
+ * Copyright (c) 2015-2017, 2019 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Author: Lenny Komow <lenny@lunarg.com>
+ * Author: Shannon McPherson <shannon@lunarg.com>
+ * Author: Charles Giessen <charles@lunarg.com>
+ */
+
+/*
+ * This file is generated from the Khronos Vulkan XML API Registry.
+ */
+
+#pragma once
+
+#include "api_dump.h"
+
+@foreach struct
+void dump_binary_pointers_{sctName}(ApiDumpBinaryWriter& writer, const {sctName}& object{sctConditionVars});
+@end struct
+void dump_binary_pNext(ApiDumpBinaryWriter& writer, const void* object);
+
+//========================= pNext Chain Implementation =======================//
+
+// Each structure in a pNext chain is written as a tag and its sType, followed by its raw value and
+// everything it points to. Structures that are not dumped are written as their sType alone, so the
+// converter can rebuild the chain exactly as the layer would have dumped it.
+void dump_binary_pNext(ApiDumpBinaryWriter& writer, const void* object)
+{{
+    if(object == NULL) {{
+        writer.writeAbsent();
+        return;
+    }}
+
+    const int32_t sType = (int32_t) (static_cast<const VkBaseInStructure*>(object)->sType);
+    switch(sType) {{
+    @foreach struct where('{sctConditionVars}' == '')
+        @if({sctStructureTypeIndex} != -1)
+    case {sctStructureTypeIndex}:
+        writer.writeValue<uint8_t>(1);
+        writer.writeValue(sType);
+        writer.writeValue(*static_cast<const {sctName}*>(object));
+        dump_binary_pointers_{sctName}(writer, *static_cast<const {sctName}*>(object));
+        break;
+        @end if
+    @end struct
+
+    case 47: // VK_STRUCTURE_TYPE_LOADER_INSTANCE_CREATE_INFO
+    case 48: // VK_STRUCTURE_TYPE_LOADER_DEVICE_CREATE_INFO
+        writer.writeValue<uint8_t>(2);
+        writer.writeValue(sType);
+        dump_binary_pNext(writer, static_cast<const VkBaseInStructure*>(object)->pNext);
+        break;
+    default:
+        writer.writeValue<uint8_t>(2);
+        writer.writeValue(sType);
+        writer.writeAbsent();
+    }}
+}}
+
+//========================== Struct Implementations =========================//
+
+@foreach struct
+void dump_binary_pointers_{sctName}(ApiDumpBinaryWriter& writer, const {sctName}& object{sctConditionVars})
+{{
+    @foreach member
+    @if('{memBinaryKind}' == 'pnext')
+    dump_binary_pNext(writer, object.{memName});
+    @end if
+    @if('{memBinaryKind}' == 'cstring')
+    writer.writeCString(object.{memName});
+    @end if
+    @if('{memBinaryKind}' == 'struct')
+    dump_binary_pointers_{memTypeID}(writer, object.{memName}{memInheritedConditions});
+    @end if
+    @if('{memBinaryKind}' == 'fixed_struct')
+    dump_binary_fixed_array<{memBaseType}>(writer, object.{memName}, {memLength}, dump_binary_pointers_{memTypeID}{memInheritedConditions});
+    @end if
+    @if('{memBinaryKind}' in ['cstring_array', 'struct_array', 'array'])
+    @if('{memCondition}' != 'None')
+    if({memCondition}) {{
+    @end if
+    @if('{memBinaryKind}' == 'cstring_array')
+    writer.writeCStringArray(object.{memName}, {memBinaryLength});
+    @end if
+    @if('{memBinaryKind}' == 'struct_array')
+    dump_binary_array<{memBaseType}>(writer, object.{memName}, {memBinaryLength}, dump_binary_pointers_{memTypeID}{memInheritedConditions});
+    @end if
+    @if('{memBinaryKind}' == 'array')
+    dump_binary_array<{memBaseType}>(writer, object.{memName}, {memBinaryLength});
+    @end if
+    @if('{memCondition}' != 'None')
+    }} else {{
+        writer.writeAbsent();
+    }}
+    @end if
+    @end if
+    @end member
+}}
+@end struct
+
+//========================= Function Implementations ========================//
+
+@foreach function where('{funcName}' not in ['vkGetDeviceProcAddr', 'vkGetInstanceProcAddr'])
+inline void dump_binary_head_{funcName}(ApiDumpInstance& dump_inst, {funcTypedParams})
+{{
+    ApiDumpBinaryWriter writer(dump_inst.settings().stream());
+    writer.beginRecord({funcIndex}, dump_inst.threadID(), dump_inst.osThreadID(), dump_inst.frameCount(), dump_inst.current_time_since_start().count());
+}}
+@end function
+
+@foreach function where('{funcName}' not in ['vkGetDeviceProcAddr', 'vkGetInstanceProcAddr'])
+@if('{funcReturn}' != 'void')
+inline void dump_binary_body_{funcName}(ApiDumpInstance& dump_inst, {funcReturn} result, {funcTypedParams})
+@end if
+@if('{funcReturn}' == 'void')
+inline void dump_binary_body_{funcName}(ApiDumpInstance& dump_inst, {funcTypedParams})
+@end if
+{{
+    ApiDumpBinaryWriter writer(dump_inst.settings().stream());
+    @if('{funcReturn}' != 'void')
+    writer.writeValue(result);
+    @end if
+    @foreach parameter
+    @if('{prmBinaryKind}' == 'value')
+    writer.writeValue({prmName});
+    @end if
+    @if('{prmBinaryKind}' == 'cstring')
+    writer.writeCString({prmName});
+    @end if
+    @if('{prmBinaryKind}' == 'struct')
+    writer.writeValue({prmName});
+    dump_binary_pointers_{prmTypeID}(writer, {prmName}{prmInheritedConditions});
+    @end if
+    @if('{prmBinaryKind}' == 'cstring_array')
+    writer.writeCStringArray({prmName}, {prmBinaryLength});
+    @end if
+    @if('{prmBinaryKind}' == 'struct_array')
+    dump_binary_array<{prmBaseType}>(writer, {prmName}, {prmBinaryLength}, dump_binary_pointers_{prmTypeID}{prmInheritedConditions});
+    @end if
+    @if('{prmBinaryKind}' == 'array')
+    dump_binary_array<{prmBaseType}>(writer, {prmName}, {prmBinaryLength});
+    @end if
+    @end parameter
+    writer.endRecord(dump_inst.callDuration());
+}}
+@end function
+"""
+
+BINARY_REPLAY_CODEGEN = """
+/* Copyright (c) 2015-2019, 2019 Valve Corporation
+ * Copyright (c) 2015-2019, 2019 LunarG, Inc.
+ * Copyright (c) 2015-2017, 2019 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Author: Lenny Komow <lenny@lunarg.com>
+ * Author: Shannon McPherson <shannon@lunarg.com>
+ * Author: Charles Giessen <charles@lunarg.com>
+ */
+
+/*
+ * This file is generated from the Khronos Vulkan XML API Registry.
+ */
+
+#pragma once
+
+#include "api_dump_text.h"
+#include "api_dump_html.h"
+#include "api_dump_json.h"
+#include "api_dump_trace.h"
+
+@foreach struct
+void read_binary_pointers_{sctName}(ApiDumpBinaryReader& reader, {sctName}& object);
+@end struct
+void* read_binary_pNext(ApiDumpBinaryReader& reader);
+
+//========================= pNext Chain Implementation =======================//
+
+void* read_binary_pNext(ApiDumpBinaryReader& reader)
+{{
+    const uint8_t tag = reader.read<uint8_t>();
+    if(tag == 0) return NULL;
+
+    const int32_t sType = reader.read<int32_t>();
+    if(tag == 1) {{
+        switch(sType) {{
+        @foreach struct where('{sctConditionVars}' == '')
+            @if({sctStructureTypeIndex} != -1)
+        case {sctStructureTypeIndex}:
+        {{
+            {sctName}* object = reader.allocate<{sctName}>(1);
+            reader.readValue(*object);
+            read_binary_pointers_{sctName}(reader, *object);
+            return object;
+        }}
+            @end if
+        @end struct
+        default:
+            // The capture contains a structure this converter was not built with
+            reader.fail();
+            return NULL;
+        }}
+    }}
+
+    VkBaseInStructure* object = reader.allocate<VkBaseInStructure>(1);
+    object->sType = static_cast<VkStructureType>(sType);
+    object->pNext = static_cast<const VkBaseInStructure*>(read_binary_pNext(reader));
+    return object;
+}}
+
+//========================== Struct Implementations =========================//
+
+@foreach struct
+void read_binary_pointers_{sctName}(ApiDumpBinaryReader& reader, {sctName}& object)
+{{
+    @foreach member
+    @if('{memBinaryKind}' == 'pnext')
+    object.{memName} = static_cast<decltype(object.{memName})>(read_binary_pNext(reader));
+    @end if
+    @if('{memBinaryKind}' == 'cstring')
+    object.{memName} = reader.readCString();
+    @end if
+    @if('{memBinaryKind}' == 'struct')
+    read_binary_pointers_{memTypeID}(reader, object.{memName});
+    @end if
+    @if('{memBinaryKind}' == 'fixed_struct')
+    read_binary_fixed_array<{memBaseType}>(reader, object.{memName}, {memLength}, read_binary_pointers_{memTypeID});
+    @end if
+    @if('{memBinaryKind}' == 'cstring_array')
+    object.{memName} = reader.readCStringArray();
+    @end if
+    @if('{memBinaryKind}' == 'struct_array')
+    object.{memName} = read_binary_array<{memBaseType}>(reader, read_binary_pointers_{memTypeID});
+    @end if
+    @if('{memBinaryKind}' == 'array')
+    object.{memName} = read_binary_array<{memBaseType}>(reader, NULL);
+    @end if
+    @if('{memBinaryKind}' == 'opaque')
+    object.{memName} = NULL;
+    @end if
+    @end member
+}}
+@end struct
+
+//========================= Function Implementations ========================//
+
+@foreach function where('{funcName}' not in ['vkGetDeviceProcAddr', 'vkGetInstanceProcAddr'])
+inline void replay_binary_{funcName}(ApiDumpInstance& dump_inst, ApiDumpBinaryReader& reader)
+{{
+    @if('{funcReturn}' != 'void')
+    {funcReturn} result = reader.read<{funcReturn}>();
+    @end if
+    @foreach parameter
+    @if('{prmBinaryKind}' == 'value')
+    {prmType} {prmName};
+    reader.readValue({prmName});
+    @end if
+    @if('{prmBinaryKind}' == 'cstring')
+    const char* {prmName} = reader.readCString();
+    @end if
+    @if('{prmBinaryKind}' == 'struct')
+    {prmBaseType} {prmName};
+    reader.readValue({prmName});
+    read_binary_pointers_{prmTypeID}(reader, {prmName});
+    @end if
+    @if('{prmBinaryKind}' == 'cstring_array')
+    const char* const* {prmName} = reader.readCStringArray();
+    @end if
+    @if('{prmBinaryKind}' == 'struct_array')
+    {prmBaseType}* {prmName} = read_binary_array<{prmBaseType}>(reader, read_binary_pointers_{prmTypeID});
+    @end if
+    @if('{prmBinaryKind}' == 'array')
+    {prmBaseType}* {prmName} = read_binary_array<{prmBaseType}>(reader, NULL);
+    @end if
+    @if('{prmBinaryKind}' == 'opaque')
+    {prmBaseType}* {prmName} = NULL;
+    @end if
+    @if('{prmBinaryKind}' == 'none')
+    {prmType} {prmName} = NULL;
+    @end if
+    @end parameter
+    if(reader.failed()) return;
+
+    @if('{funcName}' == 'vkDebugMarkerSetObjectNameEXT')
+    dump_inst.setObjectName(pNameInfo->object, pNameInfo->pObjectName);
+    @end if
+    @if('{funcName}' == 'vkSetDebugUtilsObjectNameEXT')
+    dump_inst.setObjectName(pNameInfo->objectHandle, pNameInfo->pObjectName);
+    @end if
+    @if('{funcName}' in ['vkCmdBeginDebugUtilsLabelEXT', 'vkCmdInsertDebugUtilsLabelEXT', 'vkQueueBeginDebugUtilsLabelEXT', 'vkQueueInsertDebugUtilsLabelEXT'])
+    dump_inst.checkTriggerLabel(pLabelInfo);
+    @end if
+    if(dump_inst.shouldDumpOutput() && dump_inst.shouldDumpFunction({funcIndex})) {{
+        dump_inst.beginRecord();
+        switch(dump_inst.settings().format())
+        {{
+        case ApiDumpFormat::Text:
+            dump_text_head_{funcName}(dump_inst, {funcNamedParams});
+            @if('{funcReturn}' != 'void')
+            dump_text_body_{funcName}(dump_inst, result, {funcNamedParams});
+            @end if
+            @if('{funcReturn}' == 'void')
+            dump_text_body_{funcName}(dump_inst, {funcNamedParams});
+            @end if
+            break;
+        case ApiDumpFormat::Html:
+            dump_html_head_{funcName}(dump_inst, {funcNamedParams});
+            @if('{funcReturn}' != 'void')
+            dump_html_body_{funcName}(dump_inst, result, {funcNamedParams});
+            @end if
+            @if('{funcReturn}' == 'void')
+            dump_html_body_{funcName}(dump_inst, {funcNamedParams});
+            @end if
+            break;
+        case ApiDumpFormat::Json:
+            dump_json_head_{funcName}(dump_inst, {funcNamedParams});
+            @if('{funcReturn}' != 'void')
+            dump_json_body_{funcName}(dump_inst, result, {funcNamedParams});
+            @end if
+            @if('{funcReturn}' == 'void')
+            dump_json_body_{funcName}(dump_inst, {funcNamedParams});
+            @end if
+            break;
+        case ApiDumpFormat::Trace:
+            dump_trace_head_{funcName}(dump_inst, {funcNamedParams});
+            @if('{funcReturn}' != 'void')
+            dump_trace_body_{funcName}(dump_inst, result, {funcNamedParams});
+            @end if
+            @if('{funcReturn}' == 'void')
+            dump_trace_body_{funcName}(dump_inst, {funcNamedParams});
+            @end if
+            break;
+        case ApiDumpFormat::Binary:
+            break;
+        }}
+        dump_inst.commitRecord();
+    }}
+    {funcStateTrackingCode}
+}}
+@end function
+
+// Renders one api call record of a binary capture. Returns false if the call is unknown to this
+// converter or its record is malformed.
+bool replay_binary_record(ApiDumpInstance& dump_inst, ApiDumpBinaryReader& reader, uint32_t function)
+{{
+    switch(function)
+    {{
+    @foreach function where('{funcName}' not in ['vkGetDeviceProcAddr', 'vkGetInstanceProcAddr'])
+    case {funcIndex}:
+        replay_binary_{funcName}(dump_inst, reader);
+        break;
+    @end function
+    default:
+        return false;
+    }}
+    return !reader.failed();
+}}
+"""
+
 POINTER_TYPES = ['void', 'xcb_connection_t', 'Display', 'SECURITY_ATTRIBUTES', 'ANativeWindow', 'AHardwareBuffer']
 
 TRACKED_STATE = {
@@ -1872,14 +2472,15 @@ TRACKED_STATE = {
             'ApiDumpInstance::current().addCmdBuffers(\n' +
                 'device,\n' +
                 'pAllocateInfo->commandPool,\n' +
-                'std::vector<VkCommandBuffer>(pCommandBuffers, pCommandBuffers + pAllocateInfo->commandBufferCount),\n' +
+                'pCommandBuffers,\n' +
+                'pAllocateInfo->commandBufferCount,\n' +
                 'pAllocateInfo->level\n'
             ');',
     'vkDestroyCommandPool':
         'ApiDumpInstance::current().eraseCmdBufferPool(device, commandPool);'
     ,
     'vkFreeCommandBuffers':
-        'ApiDumpInstance::current().eraseCmdBuffers(device, commandPool, std::vector<VkCommandBuffer>(pCommandBuffers, pCommandBuffers + commandBufferCount));'
+        'ApiDumpInstance::current().eraseCmdBuffers(pCommandBuffers, commandBufferCount);'
     ,
 }
 
@@ -2104,6 +2705,19 @@ class ApiDumpOutputGenerator(OutputGenerator):
                                         if sysType not in self.sysTypes:
                                             self.sysTypes.add(sysType)
 
+        # Binary captures identify functions by their index in name order
+        for index, func in enumerate(sorted(self.functions, key=lambda func: func.name)):
+            func.index = index
+
+        structNames = set(struct.name for struct in self.structs)
+        opaqueNames = set(sysType.name for sysType in self.sysTypes)
+        for struct in self.structs:
+            for member in struct.members:
+                member.setBinaryKind(structNames, opaqueNames, True)
+        for func in self.functions:
+            for param in func.parameters:
+                param.setBinaryKind(structNames, opaqueNames, False)
+
         # Find every @foreach, @if, and @end
         forIter = re.finditer('(^\\s*\\@foreach\\s+[a-z]+(\\s+where\\(.*\\))?\\s*^)|(\\@foreach [a-z]+(\\s+where\\(.*\\))?\\b)', self.format, flags=re.MULTILINE)
         ifIter = re.finditer('(^\\s*\\@if\\(.*\\)\\s*^)|(\\@if\\(.*\\))', self.format, flags=re.MULTILINE)
@@ -2174,13 +2788,18 @@ class ApiDumpOutputGenerator(OutputGenerator):
                 except StopIteration:
                     nextEnd = None
 
+        # Values that can be used outside of any loop
+        fileValues = {
+            'functionCount': len(self.functions),
+        }
+
         # Expand each loop into its full form
         lastIndex = 0
         for _, loop in loops:
-            gen.write(self.format[lastIndex:loop.startPos[0]].format(**{}), file=self.outFile)
+            gen.write(self.format[lastIndex:loop.startPos[0]].format(**fileValues), file=self.outFile)
             gen.write(self.expand(loop), file=self.outFile)
             lastIndex = loop.endPos[1]
-        gen.write(self.format[lastIndex:-1].format(**{}), file=self.outFile)
+        gen.write(self.format[lastIndex:-1].format(**fileValues), file=self.outFile)
 
         gen.OutputGenerator.endFile(self)
 
@@ -2398,11 +3017,21 @@ class VulkanVariable:
             code = self.arrayLength[10:len(self.arrayLength)]
             code = re.sub('\\[', '', code)
             code = re.sub('\\]', '', code)
+            roundUp = '\\lceil' in code
             code = re.sub('\\\\(lceil|rceil)', '', code)
             code = re.sub('{|}', '', code)
             code = re.sub('\\\\mathit', '', code)
             code = re.sub('\\\\over', '/', code)
             code = re.sub('\\\\textrm', '', code)
+            code = code.strip()
+            # Integer division rounds down, so a rounded up quotient like the length of pSampleMask,
+            # latexmath:[\lceil{\mathit{rasterizationSamples} \over 32}\rceil], adds the divisor less one first
+            if roundUp and '/' in code:
+                dividend, divisor = [part.strip() for part in code.rsplit('/', 1)]
+                if divisor.isdigit():
+                    code = '({0} + {1}) / {2}'.format(dividend, int(divisor) - 1, divisor)
+                else:
+                    code = '({0} + {1} - 1) / {1}'.format(dividend, divisor)
             self.arrayLength = code
 
         # Dereference if necessary and handle members of variables
@@ -2427,6 +3056,33 @@ class VulkanVariable:
             for states in INHERITED_STATE[self.typeID][parentName]:
                 self.inheritedConditions += ', ' + states['expr']
 
+        # How the variable is written to binary captures, set once all of the structs are known
+        self.binaryKind = 'none'
+        self.binaryLength = '1' if self.arrayLength is None else self.arrayLength
+
+    def setBinaryKind(self, structNames, opaqueNames, isMember):
+        if isMember and self.name == 'pNext':
+            self.binaryKind = 'pnext'
+        elif self.pointerLevels == 0:
+            if self.typeID == 'cstring' and self.arrayLength is None:
+                self.binaryKind = 'cstring'
+            elif self.typeID in structNames:
+                self.binaryKind = 'struct'
+            else:
+                self.binaryKind = 'value'
+        elif self.pointerLevels == 1:
+            if isMember and self.arrayLength is not None and not self.lengthMember:
+                # Fixed size arrays are stored inline in the struct
+                self.binaryKind = 'fixed_struct' if self.typeID in structNames else 'value'
+            elif self.typeID in opaqueNames:
+                self.binaryKind = 'opaque'
+            elif self.typeID == 'cstring':
+                self.binaryKind = 'cstring_array'
+            elif self.typeID in structNames:
+                self.binaryKind = 'struct_array'
+            else:
+                self.binaryKind = 'array'
+
 class VulkanBasetype:
 
     def __init__(self, rootNode):
@@ -2658,6 +3314,8 @@ class VulkanFunction:
                 'prmPtrLevel': self.pointerLevels,
                 'prmLength': self.arrayLength,
                 'prmInheritedConditions': self.inheritedConditions,
+                'prmBinaryKind': self.binaryKind,
+                'prmBinaryLength': self.binaryLength,
             }
 
     def __init__(self, rootNode, constants, aliases, extensions):
@@ -2689,6 +3347,22 @@ class VulkanFunction:
         if self.name in TRACKED_STATE:
             self.stateTrackingCode = TRACKED_STATE[self.name]
 
+        self.index = -1
+
+        # Categories the function filter can select the function by
+        categories = []
+        if self.name.startswith('vkCmd'):
+            categories.append('API_DUMP_CATEGORY_COMMANDS')
+        if self.name.startswith('vkQueue'):
+            categories.append('API_DUMP_CATEGORY_QUEUE')
+        if 'Memory' in self.name:
+            categories.append('API_DUMP_CATEGORY_MEMORY')
+        if any(word in self.name for word in ['Fence', 'Semaphore', 'Event', 'WaitIdle']):
+            categories.append('API_DUMP_CATEGORY_SYNC')
+        if any(word in self.name for word in ['Surface', 'Swapchain', 'Display', 'Present', 'AcquireNextImage']):
+            categories.append('API_DUMP_CATEGORY_WSI')
+        self.categories = ' | '.join(categories) if categories else '0'
+
         self.safeToPrint = True
         for param in self.parameters:
             if param.pointerLevels == 1 and param.type.find("const") == -1:
@@ -2706,6 +3380,8 @@ class VulkanFunction:
             'funcDispatchType' : self.dispatchType, 
             'funcStateTrackingCode': self.stateTrackingCode,
             'funcSafeToPrint': self.safeToPrint,
+            'funcIndex': self.index,
+            'funcCategories': self.categories,
         }
 
 class VulkanFunctionPointer:
@@ -2748,6 +3424,12 @@ class VulkanStruct:
                 self.condition = VALIDITY_CHECKS[parentName][self.name]
             self.structValues = rootNode.get('values')
 
+            # The length as an expression of the struct being dumped, with its members qualified
+            self.objectLength = self.arrayLength
+            if self.lengthMember and not (self.arrayLength[0].isdigit() or self.arrayLength[0].isupper()):
+                self.objectLength = re.sub('(?<![\\w.>])([a-z]\\w*)', 'object.\\1', self.arrayLength)
+                self.binaryLength = self.objectLength
+
         def values(self):
             return {
                 'memName': self.name,
@@ -2757,9 +3439,12 @@ class VulkanStruct:
                 'memChildType': self.childType,
                 'memPtrLevel': self.pointerLevels,
                 'memLength': self.arrayLength,
+                'memObjectLength': self.objectLength,
                 'memLengthIsMember': self.lengthMember,
                 'memCondition': self.condition,
                 'memInheritedConditions': self.inheritedConditions,
+                'memBinaryKind': self.binaryKind,
+                'memBinaryLength': self.binaryLength,
             }
 
 
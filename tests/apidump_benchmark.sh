@@ -0,0 +1,103 @@
+#!/bin/bash
+
+# apidump_benchmark.sh
+# This script measures how long the api_dump layer takes to format its output. It runs the demo
+# vulkaninfo with the api_dump layer writing each output format to a file, and converts a binary
+# capture of the same run with vkapidump-convert, which spends nearly all of its time formatting.
+# Run it from the tests directory of two builds to compare them. Like apidump_test.sh, the script
+# requires a path to the Vulkan-Tools build directory so that it can locate vulkaninfo and the mock
+# ICD. The path can be defined using the environment variable VULKAN_TOOLS_BUILD_DIR or using the
+# command-line argument -t or --tools. The number of runs averaged for each measurement can be set
+# with -r or --runs. Last, vkapidump-format-check compares the layer's formatter with std::ostream,
+# vkapidump-call-benchmark measures what each call costs while capture is off and when it is dumped
+# as text or as a binary record, and vkapidump-name-benchmark measures dumping named handles, as
+# applications that name every resource they create do.
+
+RUNS=10
+
+# Track unrecognized arguments.
+UNRECOGNIZED=()
+
+# Parse the command-line arguments.
+while [[ $# -gt 0 ]]
+do
+   KEY="$1"
+   case $KEY in
+      -t|--tools)
+      VULKAN_TOOLS_BUILD_DIR="$2"
+      shift
+      shift
+      ;;
+      -r|--runs)
+      RUNS="$2"
+      shift
+      shift
+      ;;
+      *)
+      UNRECOGNIZED+=("$1")
+      shift
+      ;;
+   esac
+done
+
+# Reject unrecognized arguments.
+if [[ ${#UNRECOGNIZED[@]} -ne 0 ]]; then
+   echo "ERROR: $0:$LINENO"
+   echo "Unrecognized command-line arguments: ${UNRECOGNIZED[*]}"
+   exit 1
+fi
+
+if [ -z ${VULKAN_TOOLS_BUILD_DIR+x} ]; then
+   echo "ERROR: $0:$LINENO"
+   echo "Vulkan-Tools build directory is undefined."
+   echo "Please set VULKAN_TOOLS_BUILD_DIR or use the -t|--tools <path> command line option."
+   exit 1
+fi
+
+pushd $(dirname "${BASH_SOURCE[0]}") > /dev/null
+
+VULKANINFO="$VULKAN_TOOLS_BUILD_DIR/install/bin/vulkaninfo"
+export VK_ICD_FILENAMES="$VULKAN_TOOLS_BUILD_DIR/icd/VkICD_mock_icd.json"
+export VK_APIDUMP_FLUSH=false
+
+# Prints the average wall clock time of RUNS runs of the given command in milliseconds.
+time_runs() {
+    local start=$(date +%s%N)
+    for (( i = 0; i < RUNS; ++i ))
+    do
+        "$@" > /dev/null
+    done
+    local end=$(date +%s%N)
+    echo $(( (end - start) / RUNS / 1000000 ))
+}
+
+printf "%-8s %12s %12s %14s\n" "Format" "Output size" "Layer (ms)" "Convert (ms)"
+
+VK_INSTANCE_LAYERS=VK_LAYER_LUNARG_api_dump VK_APIDUMP_OUTPUT_FORMAT=binary \
+    VK_APIDUMP_LOG_FILENAME=apidump_benchmark_capture.tmp "$VULKANINFO" --show-formats > /dev/null
+
+for FORMAT in text html json trace
+do
+    layer_ms=$(VK_INSTANCE_LAYERS=VK_LAYER_LUNARG_api_dump VK_APIDUMP_OUTPUT_FORMAT=$FORMAT \
+        VK_APIDUMP_LOG_FILENAME=apidump_benchmark_output.tmp time_runs "$VULKANINFO" --show-formats)
+    size=$(wc -c < apidump_benchmark_output.tmp)
+    convert_ms=$(time_runs ../layersvt/vkapidump-convert --format $FORMAT -o apidump_benchmark_output.tmp \
+        apidump_benchmark_capture.tmp)
+    printf "%-8s %12s %12s %14s\n" $FORMAT $size $layer_ms $convert_ms
+done
+
+layer_ms=$(VK_INSTANCE_LAYERS=VK_LAYER_LUNARG_api_dump VK_APIDUMP_OUTPUT_FORMAT=binary \
+    VK_APIDUMP_LOG_FILENAME=apidump_benchmark_output.tmp time_runs "$VULKANINFO" --show-formats)
+printf "%-8s %12s %12s %14s\n" binary $(wc -c < apidump_benchmark_capture.tmp) $layer_ms -
+
+rm -f apidump_benchmark_capture.tmp apidump_benchmark_output.tmp
+
+echo
+../layersvt/vkapidump-format-check --benchmark
+echo
+../layersvt/vkapidump-call-benchmark
+echo
+../layersvt/vkapidump-name-benchmark
+popd > /dev/null
+
+exit 0
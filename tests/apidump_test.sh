@@ -6,7 +6,11 @@
 # If the threshold is met, the test will indicate PASS, else FAILURE. This
 # script requires a path to the Vulkan-Tools build directory so that it can locate
 # vulkaninfo and the mock ICD. The path can be defined using the environment variable
-# VULKAN_TOOLS_BUILD_DIR or using the command-line argument -t or --tools.
+# VULKAN_TOOLS_BUILD_DIR or using the command-line argument -t or --tools. With -b or --baseline,
+# the text, HTML and JSON output of this build's layer is also compared with that of the layer in the
+# given directory, a build of the layer from before it had its own formatter. The tests that need
+# frames run the demo vkcube, and fail when there is no display, so run the script under xvfb-run
+# on machines without one.
 
 # Track unrecognized arguments.
 UNRECOGNIZED=()
@@ -21,6 +25,11 @@ do
       shift
       shift
       ;;
+      -b|--baseline)
+      BASELINE_LAYER_DIR="$2"
+      shift
+      shift
+      ;;
       *)
       UNRECOGNIZED+=("$1")
       shift
@@ -83,6 +92,304 @@ then
 fi
 
 rm apidump_file.tmp
+
+# A binary capture converted with vkapidump-convert should match the text the layer writes directly.
+printf "$GREEN[ RUN      ]$NC $0 binary capture\n"
+VK_ICD_FILENAMES="$VULKAN_TOOLS_BUILD_DIR/icd/VkICD_mock_icd.json" \
+    VK_INSTANCE_LAYERS=VK_LAYER_LUNARG_api_dump VK_APIDUMP_NO_ADDR=true \
+    VK_APIDUMP_LOG_FILENAME=apidump_text.tmp "$VULKANINFO" --show-formats > /dev/null
+VK_ICD_FILENAMES="$VULKAN_TOOLS_BUILD_DIR/icd/VkICD_mock_icd.json" \
+    VK_INSTANCE_LAYERS=VK_LAYER_LUNARG_api_dump VK_APIDUMP_OUTPUT_FORMAT=binary \
+    VK_APIDUMP_LOG_FILENAME=apidump_capture.tmp "$VULKANINFO" --show-formats > /dev/null
+VK_APIDUMP_NO_ADDR=true ../layersvt/vkapidump-convert --format text -o apidump_converted.tmp apidump_capture.tmp
+if [ -s apidump_converted.tmp ] && diff -q apidump_text.tmp apidump_converted.tmp > /dev/null
+then
+    printf "$GREEN[  PASSED  ]$NC $0 binary capture\n"
+else
+    printf "$RED[  FAILED  ]$NC $0 binary capture\n"
+    rm -f apidump_text.tmp apidump_capture.tmp apidump_converted.tmp
+    popd
+    exit 1
+fi
+
+rm apidump_text.tmp apidump_capture.tmp apidump_converted.tmp
+
+# Excluded functions should be left out of the output while everything else is still written.
+printf "$GREEN[ RUN      ]$NC $0 function filter\n"
+VK_ICD_FILENAMES="$VULKAN_TOOLS_BUILD_DIR/icd/VkICD_mock_icd.json" \
+    VK_INSTANCE_LAYERS=VK_LAYER_LUNARG_api_dump VK_APIDUMP_EXCLUDE_FUNCTIONS="vkGetPhysicalDeviceFormat*" \
+    VK_APIDUMP_LOG_FILENAME=apidump_filtered.tmp "$VULKANINFO" --show-formats > /dev/null
+GPDFP_count=$(grep vkGetPhysicalDeviceFormatProperties apidump_filtered.tmp | wc -l)
+GPDP_count=$(grep vkGetPhysicalDeviceProperties apidump_filtered.tmp | wc -l)
+if (( $GPDFP_count == 0 && $GPDP_count > 0 ))
+then
+    printf "$GREEN[  PASSED  ]$NC $0 function filter\n"
+else
+    printf "$RED[  FAILED  ]$NC $0 function filter\n"
+    rm -f apidump_filtered.tmp
+    popd
+    exit 1
+fi
+
+rm apidump_filtered.tmp
+
+# The latency statistics should have a line for the functions vulkaninfo called.
+printf "$GREEN[ RUN      ]$NC $0 latency statistics\n"
+VK_ICD_FILENAMES="$VULKAN_TOOLS_BUILD_DIR/icd/VkICD_mock_icd.json" \
+    VK_INSTANCE_LAYERS=VK_LAYER_LUNARG_api_dump VK_APIDUMP_LATENCY_FILE=apidump_latency.tmp \
+    VK_APIDUMP_LOG_FILENAME=apidump_output.tmp "$VULKANINFO" --show-formats > /dev/null
+GPDFP_count=$(grep "^vkGetPhysicalDeviceFormatProperties," apidump_latency.tmp | cut -d, -f2)
+if [[ "$(head -n 1 apidump_latency.tmp)" == function,count,* && ${GPDFP_count:-0} -gt 0 ]]
+then
+    printf "$GREEN[  PASSED  ]$NC $0 latency statistics\n"
+else
+    printf "$RED[  FAILED  ]$NC $0 latency statistics\n"
+    rm -f apidump_latency.tmp apidump_output.tmp
+    popd
+    exit 1
+fi
+
+rm apidump_latency.tmp apidump_output.tmp
+
+# The trace should be a complete JSON array with a slice for the functions vulkaninfo called.
+printf "$GREEN[ RUN      ]$NC $0 trace output\n"
+VK_ICD_FILENAMES="$VULKAN_TOOLS_BUILD_DIR/icd/VkICD_mock_icd.json" \
+    VK_INSTANCE_LAYERS=VK_LAYER_LUNARG_api_dump VK_APIDUMP_OUTPUT_FORMAT=trace \
+    VK_APIDUMP_LOG_FILENAME=apidump_trace.tmp "$VULKANINFO" --show-formats > /dev/null
+GPDFP_count=$(grep "\"name\" : \"vkGetPhysicalDeviceFormatProperties\", .*\"ph\" : \"X\"" apidump_trace.tmp | wc -l)
+if [[ "$(head -n 1 apidump_trace.tmp)" == "[" && "$(tail -n 1 apidump_trace.tmp)" == "]" ]] && (( $GPDFP_count > 50 ))
+then
+    printf "$GREEN[  PASSED  ]$NC $0 trace output\n"
+else
+    printf "$RED[  FAILED  ]$NC $0 trace output\n"
+    rm -f apidump_trace.tmp
+    popd
+    exit 1
+fi
+
+rm apidump_trace.tmp
+
+# Delta output should number every call vulkaninfo made, whether it is written in full or referenced.
+printf "$GREEN[ RUN      ]$NC $0 delta output\n"
+VK_ICD_FILENAMES="$VULKAN_TOOLS_BUILD_DIR/icd/VkICD_mock_icd.json" \
+    VK_INSTANCE_LAYERS=VK_LAYER_LUNARG_api_dump VK_APIDUMP_NO_ADDR=true \
+    VK_APIDUMP_LOG_FILENAME=apidump_text.tmp "$VULKANINFO" --show-formats > /dev/null
+VK_ICD_FILENAMES="$VULKAN_TOOLS_BUILD_DIR/icd/VkICD_mock_icd.json" \
+    VK_INSTANCE_LAYERS=VK_LAYER_LUNARG_api_dump VK_APIDUMP_NO_ADDR=true VK_APIDUMP_DELTA=true \
+    VK_APIDUMP_LOG_FILENAME=apidump_delta.tmp "$VULKANINFO" --show-formats > /dev/null
+call_count=$(grep -c "^Thread " apidump_text.tmp)
+last_call=$(grep -oE "^(Thread .*Call |Frame [0-9]+, calls? ([0-9]+-)?)[0-9]+:" apidump_delta.tmp | grep -oE "[0-9]+:$" | tr -d : | sort -n | tail -n 1)
+if (( ${last_call:-0} == $call_count ))
+then
+    printf "$GREEN[  PASSED  ]$NC $0 delta output\n"
+else
+    printf "$RED[  FAILED  ]$NC $0 delta output\n"
+    rm -f apidump_text.tmp apidump_delta.tmp
+    popd
+    exit 1
+fi
+
+rm apidump_text.tmp apidump_delta.tmp
+
+# The summary should count every call the full output has.
+printf "$GREEN[ RUN      ]$NC $0 summary mode\n"
+VK_ICD_FILENAMES="$VULKAN_TOOLS_BUILD_DIR/icd/VkICD_mock_icd.json" \
+    VK_INSTANCE_LAYERS=VK_LAYER_LUNARG_api_dump VK_APIDUMP_MODE=summary \
+    VK_APIDUMP_LOG_FILENAME=apidump_summary.tmp "$VULKANINFO" --show-formats > /dev/null
+VK_ICD_FILENAMES="$VULKAN_TOOLS_BUILD_DIR/icd/VkICD_mock_icd.json" \
+    VK_INSTANCE_LAYERS=VK_LAYER_LUNARG_api_dump VK_APIDUMP_LOG_FILENAME=apidump_text.tmp \
+    "$VULKANINFO" --show-formats > /dev/null
+GPDFP_count=$(grep -c "^vkGetPhysicalDeviceFormatProperties(" apidump_text.tmp)
+GPDFP_summary=$(awk -F, '$2 == "vkGetPhysicalDeviceFormatProperties" { sum += $3 } END { print sum + 0 }' apidump_summary.tmp)
+if [[ "$(head -n 1 apidump_summary.tmp)" == "frame,function,count" ]] && (( ${GPDFP_summary:-0} == $GPDFP_count && $GPDFP_count > 50 ))
+then
+    printf "$GREEN[  PASSED  ]$NC $0 summary mode\n"
+else
+    printf "$RED[  FAILED  ]$NC $0 summary mode\n"
+    rm -f apidump_summary.tmp apidump_text.tmp
+    popd
+    exit 1
+fi
+
+rm apidump_summary.tmp apidump_text.tmp
+
+# With a trigger file, output should be written only while the file exists.
+printf "$GREEN[ RUN      ]$NC $0 trigger file\n"
+rm -f apidump_trigger.tmp
+VK_ICD_FILENAMES="$VULKAN_TOOLS_BUILD_DIR/icd/VkICD_mock_icd.json" \
+    VK_INSTANCE_LAYERS=VK_LAYER_LUNARG_api_dump VK_APIDUMP_TRIGGER_FILE=apidump_trigger.tmp \
+    VK_APIDUMP_LOG_FILENAME=apidump_off.tmp "$VULKANINFO" --show-formats > /dev/null
+touch apidump_trigger.tmp
+VK_ICD_FILENAMES="$VULKAN_TOOLS_BUILD_DIR/icd/VkICD_mock_icd.json" \
+    VK_INSTANCE_LAYERS=VK_LAYER_LUNARG_api_dump VK_APIDUMP_TRIGGER_FILE=apidump_trigger.tmp \
+    VK_APIDUMP_LOG_FILENAME=apidump_on.tmp "$VULKANINFO" --show-formats > /dev/null
+off_count=$(grep -c "^Thread " apidump_off.tmp 2> /dev/null)
+create_count=$(grep -c "^vkCreateInstance(" apidump_on.tmp 2> /dev/null)
+GPDFP_count=$(grep -c "^vkGetPhysicalDeviceFormatProperties(" apidump_on.tmp 2> /dev/null)
+if (( ${off_count:-0} == 0 && ${create_count:-0} == 1 && ${GPDFP_count:-0} > 50 ))
+then
+    printf "$GREEN[  PASSED  ]$NC $0 trigger file\n"
+else
+    printf "$RED[  FAILED  ]$NC $0 trigger file\n"
+    rm -f apidump_trigger.tmp apidump_off.tmp apidump_on.tmp
+    popd
+    exit 1
+fi
+
+rm -f apidump_trigger.tmp apidump_off.tmp apidump_on.tmp
+
+# Array lengths that the registry gives as a rounded up quotient, like that of pSampleMask, should be
+# rounded up in every generated header that dumps the array.
+printf "$GREEN[ RUN      ]$NC $0 generated array lengths\n"
+passed=true
+for HEADER in api_dump_text.h api_dump_html.h api_dump_json.h api_dump_binary.h
+do
+    if ! grep -qF "object.pSampleMask, (object.rasterizationSamples + 31) / 32" ../layersvt/$HEADER; then
+        passed=false
+    fi
+done
+if $passed
+then
+    printf "$GREEN[  PASSED  ]$NC $0 generated array lengths\n"
+else
+    printf "$RED[  FAILED  ]$NC $0 generated array lengths\n"
+    popd
+    exit 1
+fi
+
+# The layer's formatter should write every kind of value exactly as std::ostream does.
+printf "$GREEN[ RUN      ]$NC $0 formatter\n"
+if ../layersvt/vkapidump-format-check
+then
+    printf "$GREEN[  PASSED  ]$NC $0 formatter\n"
+else
+    printf "$RED[  FAILED  ]$NC $0 formatter\n"
+    popd
+    exit 1
+fi
+
+# The text, HTML and JSON output should be byte for byte that of the baseline layer.
+if [ -n "$BASELINE_LAYER_DIR" ]; then
+    printf "$GREEN[ RUN      ]$NC $0 baseline output\n"
+    passed=true
+    for FORMAT in text html json
+    do
+        VK_ICD_FILENAMES="$VULKAN_TOOLS_BUILD_DIR/icd/VkICD_mock_icd.json" VK_LAYER_PATH=../layersvt \
+            VK_INSTANCE_LAYERS=VK_LAYER_LUNARG_api_dump VK_APIDUMP_NO_ADDR=true VK_APIDUMP_OUTPUT_FORMAT=$FORMAT \
+            VK_APIDUMP_LOG_FILENAME=apidump_current.tmp "$VULKANINFO" --show-formats > /dev/null
+        VK_ICD_FILENAMES="$VULKAN_TOOLS_BUILD_DIR/icd/VkICD_mock_icd.json" VK_LAYER_PATH="$BASELINE_LAYER_DIR" \
+            VK_INSTANCE_LAYERS=VK_LAYER_LUNARG_api_dump VK_APIDUMP_NO_ADDR=true VK_APIDUMP_OUTPUT_FORMAT=$FORMAT \
+            VK_APIDUMP_LOG_FILENAME=apidump_baseline.tmp "$VULKANINFO" --show-formats > /dev/null
+        if [ ! -s apidump_current.tmp ] || ! diff apidump_baseline.tmp apidump_current.tmp > apidump_diff.tmp; then
+            echo "The $FORMAT output differs from the baseline:"
+            head -n 40 apidump_diff.tmp
+            passed=false
+        fi
+        rm -f apidump_current.tmp apidump_baseline.tmp apidump_diff.tmp
+    done
+    if $passed
+    then
+        printf "$GREEN[  PASSED  ]$NC $0 baseline output\n"
+    else
+        printf "$RED[  FAILED  ]$NC $0 baseline output\n"
+        popd
+        exit 1
+    fi
+fi
+
+# The remaining tests need frames, so they run vkcube, which needs a display.
+if [ -z "$DISPLAY" ] && [ -z "$WAYLAND_DISPLAY" ]; then
+    echo "ERROR: $0:$LINENO"
+    echo "vkcube needs a display. Run $0 under xvfb-run on machines without one."
+    popd
+    exit 1
+fi
+
+VKCUBE="$VULKAN_TOOLS_BUILD_DIR/install/bin/vkcube"
+
+# The flight recorder should save a binary capture of only the last two frames at exit.
+printf "$GREEN[ RUN      ]$NC $0 flight recorder\n"
+VK_ICD_FILENAMES="$VULKAN_TOOLS_BUILD_DIR/icd/VkICD_mock_icd.json" \
+    VK_INSTANCE_LAYERS=VK_LAYER_LUNARG_api_dump VK_APIDUMP_FLIGHT_RECORDER_FRAMES=2 \
+    VK_APIDUMP_LOG_FILENAME=apidump_flight.tmp "$VKCUBE" --c 5 > /dev/null
+../layersvt/vkapidump-convert --format text -o apidump_converted.tmp apidump_flight.tmp
+frames=($(grep -oE "^Thread [0-9]+, Frame [0-9]+" apidump_converted.tmp | grep -oE "[0-9]+$" | sort -un))
+present_count=$(grep -c "^vkQueuePresentKHR(" apidump_converted.tmp)
+create_count=$(grep -c "^vkCreateInstance(" apidump_converted.tmp)
+if [[ "$(head -c 8 apidump_flight.tmp)" == "VKAPIDMP" ]] && (( ${#frames[@]} == 2 && frames[0] > 0 )) &&
+   (( frames[1] == frames[0] + 1 && $present_count > 0 && $create_count == 0 ))
+then
+    printf "$GREEN[  PASSED  ]$NC $0 flight recorder\n"
+else
+    printf "$RED[  FAILED  ]$NC $0 flight recorder\n"
+    rm -f apidump_flight.tmp apidump_converted.tmp
+    popd
+    exit 1
+fi
+
+rm apidump_flight.tmp apidump_converted.tmp
+
+# Later frames of vkcube repeat the first, so delta output should write back references, and every
+# call a reference names should be written in full.
+printf "$GREEN[ RUN      ]$NC $0 delta references\n"
+VK_ICD_FILENAMES="$VULKAN_TOOLS_BUILD_DIR/icd/VkICD_mock_icd.json" \
+    VK_INSTANCE_LAYERS=VK_LAYER_LUNARG_api_dump VK_APIDUMP_NO_ADDR=true VK_APIDUMP_DELTA=true \
+    VK_APIDUMP_LOG_FILENAME=apidump_delta.tmp "$VKCUBE" --c 3 > /dev/null
+declare -A written
+while read -r frame call; do
+    written[$frame,$call]=1
+done < <(sed -nE 's/^Thread .*Frame ([0-9]+).*, Call ([0-9]+):$/\1 \2/p' apidump_delta.tmp)
+reference_count=0
+missing_count=0
+while read -r origin_frame first last; do
+    reference_count=$((reference_count + 1))
+    for (( call = first; call <= ${last:-$first}; call++ )); do
+        if [ -z "${written[$origin_frame,$call]}" ]; then
+            missing_count=$((missing_count + 1))
+        fi
+    done
+done < <(sed -nE 's/^Frame [0-9]+, calls? [0-9-]+: same as frame ([0-9]+), calls? ([0-9]+)-?([0-9]*)$/\1 \2 \3/p' apidump_delta.tmp)
+if (( $reference_count > 0 && $missing_count == 0 ))
+then
+    printf "$GREEN[  PASSED  ]$NC $0 delta references\n"
+else
+    printf "$RED[  FAILED  ]$NC $0 delta references\n"
+    rm -f apidump_delta.tmp
+    popd
+    exit 1
+fi
+
+rm apidump_delta.tmp
+
+# With "Show Shader" and file output, vkcube's shaders should be written once each as SPIR-V files
+# next to the output, and the output should name exactly those files.
+printf "$GREEN[ RUN      ]$NC $0 shader files\n"
+rm -rf apidump_shader.tmp
+mkdir apidump_shader.tmp
+echo "lunarg_api_dump.show_shader = TRUE" > apidump_shader.tmp/vk_layer_settings.txt
+VK_ICD_FILENAMES="$VULKAN_TOOLS_BUILD_DIR/icd/VkICD_mock_icd.json" \
+    VK_INSTANCE_LAYERS=VK_LAYER_LUNARG_api_dump VK_LAYER_SETTINGS_PATH="$PWD/apidump_shader.tmp/vk_layer_settings.txt" \
+    VK_APIDUMP_LOG_FILENAME=apidump_shader.tmp/vk_apidump.txt "$VKCUBE" --c 3 > /dev/null
+named=$(grep -oE "\(shader_[0-9a-f]{16}\.spv\)" apidump_shader.tmp/vk_apidump.txt | tr -d "()" | sort -u)
+written=$(cd apidump_shader.tmp && ls shader_*.spv 2> /dev/null | sort)
+passed=true
+for SHADER in $written
+do
+    if [[ "$(head -c 4 apidump_shader.tmp/$SHADER | od -An -tx1 | tr -d " ")" != "03022307" ]]; then
+        passed=false
+    fi
+done
+if $passed && [ -n "$written" ] && [ "$named" == "$written" ]
+then
+    printf "$GREEN[  PASSED  ]$NC $0 shader files\n"
+else
+    printf "$RED[  FAILED  ]$NC $0 shader files\n"
+    rm -rf apidump_shader.tmp
+    popd
+    exit 1
+fi
+
+rm -rf apidump_shader.tmp
 popd
 
 exit 0
@@ -0,0 +1,206 @@
+#!/bin/bash
+
+# screenshot_test.sh
+# This script will run the demo vkcube with the screenshot layer for a few frames, once reading
+# frames back through an image and once through a buffer, and check that each run writes every
+# requested frame as a PPM file of the same size. It then checks that frames downscaled by the
+# compute shader are half the size, and that PNG and QOI files are written. Since vkcube needs a
+# window, the test fails when there is no display, so run it under xvfb-run on machines without
+# one. This script requires a path to the Vulkan-Tools build directory so that it can locate vkcube
+# and the mock ICD. The path can be defined using the environment variable VULKAN_TOOLS_BUILD_DIR
+# or using the command-line argument -t or --tools.
+
+# Track unrecognized arguments.
+UNRECOGNIZED=()
+
+# Parse the command-line arguments.
+while [[ $# -gt 0 ]]
+do
+   KEY="$1"
+   case $KEY in
+      -t|--tools)
+      VULKAN_TOOLS_BUILD_DIR="$2"
+      shift
+      shift
+      ;;
+      *)
+      UNRECOGNIZED+=("$1")
+      shift
+      ;;
+   esac
+done
+
+# Reject unrecognized arguments.
+if [[ ${#UNRECOGNIZED[@]} -ne 0 ]]; then
+   echo "ERROR: $0:$LINENO"
+   echo "Unrecognized command-line arguments: ${UNRECOGNIZED[*]}"
+   exit 1
+fi
+
+if [ -z ${VULKAN_TOOLS_BUILD_DIR+x} ]; then
+   echo "ERROR: $0:$LINENO"
+   echo "Vulkan-Tools build directory is undefined."
+   echo "Please set VULKAN_TOOLS_BUILD_DIR or use the -t|--tools <path> command line option."
+   exit 1
+fi
+
+if [ -t 1 ] ; then
+    RED='\033[0;31m'
+    GREEN='\033[0;32m'
+    NC='\033[0m' # No Color
+else
+    RED=''
+    GREEN=''
+    NC=''
+fi
+
+if [ -z "$DISPLAY" ] && [ -z "$WAYLAND_DISPLAY" ]; then
+    echo "ERROR: $0:$LINENO"
+    echo "vkcube needs a display. Run $0 under xvfb-run on machines without one."
+    exit 1
+fi
+
+pushd $(dirname "${BASH_SOURCE[0]}")
+
+VKCUBE="$VULKAN_TOOLS_BUILD_DIR/install/bin/vkcube"
+
+for READBACK in image buffer
+do
+    printf "$GREEN[ RUN      ]$NC $0 $READBACK readback\n"
+    rm -rf screenshot_$READBACK.tmp
+    mkdir screenshot_$READBACK.tmp
+    VK_ICD_FILENAMES="$VULKAN_TOOLS_BUILD_DIR/icd/VkICD_mock_icd.json" \
+        VK_INSTANCE_LAYERS=VK_LAYER_LUNARG_screenshot VK_SCREENSHOT_FRAMES=1-3 \
+        VK_SCREENSHOT_DIR=screenshot_$READBACK.tmp VK_SCREENSHOT_READBACK=$READBACK \
+        "$VKCUBE" --c 5 > /dev/null
+    passed=true
+    for FRAME in 1 2 3
+    do
+        if [[ "$(head -c 2 screenshot_$READBACK.tmp/$FRAME.ppm 2> /dev/null)" != "P6" ]]; then
+            passed=false
+        fi
+    done
+    if $passed
+    then
+        printf "$GREEN[  PASSED  ]$NC $0 $READBACK readback\n"
+    else
+        printf "$RED[  FAILED  ]$NC $0 $READBACK readback\n"
+        rm -rf screenshot_image.tmp screenshot_buffer.tmp
+        popd
+        exit 1
+    fi
+done
+
+# Both paths write the frames with the same header and the same number of pixels.
+printf "$GREEN[ RUN      ]$NC $0 matching sizes\n"
+if cmp -s <(wc -c < screenshot_image.tmp/1.ppm) <(wc -c < screenshot_buffer.tmp/1.ppm) && \
+    cmp -s <(head -n 3 screenshot_image.tmp/1.ppm) <(head -n 3 screenshot_buffer.tmp/1.ppm)
+then
+    printf "$GREEN[  PASSED  ]$NC $0 matching sizes\n"
+else
+    printf "$RED[  FAILED  ]$NC $0 matching sizes\n"
+    rm -rf screenshot_image.tmp screenshot_buffer.tmp
+    popd
+    exit 1
+fi
+
+# Frames downscaled by 2 are half the width and height, rounded up.
+printf "$GREEN[ RUN      ]$NC $0 compute scale\n"
+rm -rf screenshot_compute.tmp
+mkdir screenshot_compute.tmp
+VK_ICD_FILENAMES="$VULKAN_TOOLS_BUILD_DIR/icd/VkICD_mock_icd.json" \
+    VK_INSTANCE_LAYERS=VK_LAYER_LUNARG_screenshot VK_SCREENSHOT_FRAMES=1-3 \
+    VK_SCREENSHOT_DIR=screenshot_compute.tmp VK_SCREENSHOT_READBACK=compute VK_SCREENSHOT_SCALE=2 \
+    "$VKCUBE" --c 5 > /dev/null
+read -d '' -r WIDTH HEIGHT < <(head -n 3 screenshot_image.tmp/1.ppm | tail -n 2)
+if [[ "$(head -n 3 screenshot_compute.tmp/1.ppm 2> /dev/null)" == "$(printf "P6\n%d\n%d" $(((WIDTH + 1) / 2)) $(((HEIGHT + 1) / 2)))" ]]
+then
+    printf "$GREEN[  PASSED  ]$NC $0 compute scale\n"
+else
+    printf "$RED[  FAILED  ]$NC $0 compute scale\n"
+    rm -rf screenshot_image.tmp screenshot_buffer.tmp screenshot_compute.tmp
+    popd
+    exit 1
+fi
+
+rm -rf screenshot_image.tmp screenshot_buffer.tmp screenshot_compute.tmp
+
+# PNG and QOI files start with their signatures. Layers built without zlib write PPM files instead of PNG files.
+for FILE_FORMAT in png qoi
+do
+    printf "$GREEN[ RUN      ]$NC $0 $FILE_FORMAT files\n"
+    rm -rf screenshot_$FILE_FORMAT.tmp
+    mkdir screenshot_$FILE_FORMAT.tmp
+    VK_ICD_FILENAMES="$VULKAN_TOOLS_BUILD_DIR/icd/VkICD_mock_icd.json" \
+        VK_INSTANCE_LAYERS=VK_LAYER_LUNARG_screenshot VK_SCREENSHOT_FRAMES=1-3 \
+        VK_SCREENSHOT_DIR=screenshot_$FILE_FORMAT.tmp VK_SCREENSHOT_FILE_FORMAT=$FILE_FORMAT \
+        "$VKCUBE" --c 5 > /dev/null
+    if [ $FILE_FORMAT == png ]; then SIGNATURE=$'\x89PNG'; else SIGNATURE=qoif; fi
+    passed=true
+    for FRAME in 1 2 3
+    do
+        if [ $FILE_FORMAT == png ] && [ ! -f screenshot_png.tmp/$FRAME.png ] && [ -f screenshot_png.tmp/$FRAME.ppm ]; then
+            continue
+        fi
+        if [[ "$(head -c 4 screenshot_$FILE_FORMAT.tmp/$FRAME.$FILE_FORMAT 2> /dev/null)" != "$SIGNATURE" ]]; then
+            passed=false
+        fi
+    done
+    rm -rf screenshot_$FILE_FORMAT.tmp
+    if $passed
+    then
+        printf "$GREEN[  PASSED  ]$NC $0 $FILE_FORMAT files\n"
+    else
+        printf "$RED[  FAILED  ]$NC $0 $FILE_FORMAT files\n"
+        popd
+        exit 1
+    fi
+done
+
+# Hashed frames are only listed in the manifest, until they differ from the golden manifest.
+printf "$GREEN[ RUN      ]$NC $0 hash manifest\n"
+rm -rf screenshot_hash.tmp
+mkdir screenshot_hash.tmp
+VK_ICD_FILENAMES="$VULKAN_TOOLS_BUILD_DIR/icd/VkICD_mock_icd.json" \
+    VK_INSTANCE_LAYERS=VK_LAYER_LUNARG_screenshot VK_SCREENSHOT_FRAMES=1-3 \
+    VK_SCREENSHOT_DIR=screenshot_hash.tmp VK_SCREENSHOT_HASH=content \
+    "$VKCUBE" --c 5 > /dev/null
+if [[ "$(grep -cE '^[123],[0-9a-f]{16}$' screenshot_hash.tmp/hashes.csv 2> /dev/null)" == "3" ]] && \
+    [[ "$(ls screenshot_hash.tmp)" == "hashes.csv" ]]
+then
+    printf "$GREEN[  PASSED  ]$NC $0 hash manifest\n"
+else
+    printf "$RED[  FAILED  ]$NC $0 hash manifest\n"
+    rm -rf screenshot_hash.tmp
+    popd
+    exit 1
+fi
+
+printf "$GREEN[ RUN      ]$NC $0 golden manifest\n"
+sed -e 's/^2,.*/2,0123456789abcdef/' -e '/^3,/d' screenshot_hash.tmp/hashes.csv > screenshot_golden.csv
+rm -rf screenshot_hash.tmp
+mkdir screenshot_hash.tmp
+VK_ICD_FILENAMES="$VULKAN_TOOLS_BUILD_DIR/icd/VkICD_mock_icd.json" \
+    VK_INSTANCE_LAYERS=VK_LAYER_LUNARG_screenshot VK_SCREENSHOT_FRAMES=1-3 \
+    VK_SCREENSHOT_DIR=screenshot_hash.tmp VK_SCREENSHOT_HASH=content VK_SCREENSHOT_GOLDEN_MANIFEST=screenshot_golden.csv \
+    "$VKCUBE" --c 5 > /dev/null
+if [ ! -f screenshot_hash.tmp/1.ppm ] && [[ "$(head -c 2 screenshot_hash.tmp/2.ppm 2> /dev/null)" == "P6" ]] && \
+    [[ "$(head -c 2 screenshot_hash.tmp/3.ppm 2> /dev/null)" == "P6" ]]
+then
+    passed=true
+else
+    passed=false
+fi
+rm -rf screenshot_hash.tmp screenshot_golden.csv
+if $passed
+then
+    printf "$GREEN[  PASSED  ]$NC $0 golden manifest\n"
+else
+    printf "$RED[  FAILED  ]$NC $0 golden manifest\n"
+    popd
+    exit 1
+fi
+
+popd
+
+exit 0